@@ -0,0 +1,166 @@
+/* Measure the rate of Distributed Objects messages over a loopback socket.
+
+  Copyright (C) 2026 Free Software Foundation
+
+  Copying and distribution of this file, with or without modification,
+  are permitted in any medium without royalty provided the copyright
+  notice and this notice are preserved.
+
+   Vends an object from a server thread using an NSSocketPort on the
+   loopback interface, then times bursts of messages sent to it from the
+   main thread: methods returning a value (which must always wait for
+   a reply), void methods and oneway void methods, both normally and
+   with the connection pipelining requests.  */
+
+
+#include <Foundation/Foundation.h>
+
+@protocol	Counter
+- (int) next;
+- (void) add: (int)n;
+- (oneway void) post: (int)n;
+- (int) total;
+@end
+
+@interface	Counter : NSObject <Counter>
+{
+  int	total;
+}
+@end
+@implementation	Counter
+- (int) next
+{
+  return ++total;
+}
+- (void) add: (int)n
+{
+  total += n;
+}
+- (oneway void) post: (int)n
+{
+  total += n;
+}
+- (int) total
+{
+  return total;
+}
+@end
+
+@interface	Server : NSObject
+@end
+@implementation	Server
++ (void) run: (NSSocketPort*)port
+{
+  CREATE_AUTORELEASE_POOL(pool);
+  NSConnection	*c;
+
+  c = [[NSConnection alloc] initWithReceivePort: port sendPort: nil];
+  [c setRootObject: AUTORELEASE([Counter new])];
+  [[NSRunLoop currentRunLoop] run];
+  RELEASE(pool);
+}
+@end
+
+static void
+report(NSString *name, NSDate *start, unsigned count)
+{
+  NSTimeInterval	t = -[start timeIntervalSinceNow];
+
+  printf("%-24s %10.0f calls/sec\n", [name UTF8String], count / t);
+}
+
+static void
+run(id<Counter> proxy, NSConnection *c, BOOL pipelining, unsigned count)
+{
+  CREATE_AUTORELEASE_POOL(pool);
+  NSString	*suffix = (pipelining ? @" (pipelined)" : @"");
+  NSDate	*start;
+  unsigned	i;
+  int		before;
+
+  [c setPipelinesRequests: pipelining];
+
+  start = [NSDate date];
+  for (i = 0; i < count; i++)
+    {
+      [proxy next];
+    }
+  report([@"int result" stringByAppendingString: suffix], start, count);
+
+  start = [NSDate date];
+  for (i = 0; i < count; i++)
+    {
+      [proxy add: 1];
+    }
+  [c flushRequests];
+  report([@"void" stringByAppendingString: suffix], start, count);
+
+  before = [proxy total];
+  start = [NSDate date];
+  for (i = 0; i < count; i++)
+    {
+      [proxy post: 1];
+      if (i % 100 == 99)
+	{
+	  /* Let the run loop send any batched messages, as a real
+	   * application would between events.
+	   */
+	  [[NSRunLoop currentRunLoop] runMode: NSDefaultRunLoopMode
+				   beforeDate: [NSDate date]];
+	}
+    }
+  /* Wait until the server has handled them all.
+   */
+  while ([proxy total] - before < (int)count)
+    {
+      [NSThread sleepForTimeInterval: 0.001];
+    }
+  report([@"oneway" stringByAppendingString: suffix], start, count);
+  RELEASE(pool);
+}
+
+int
+main(int argc, char **argv)
+{
+  CREATE_AUTORELEASE_POOL(pool);
+  unsigned	count = 20000;
+  NSSocketPort	*server;
+  NSSocketPort	*remote;
+  NSConnection	*c;
+  id		proxy;
+
+  if (argc > 1)
+    {
+      count = atoi(argv[1]);
+    }
+
+  server = [NSSocketPort portWithNumber: 0
+				 onHost: nil
+			   forceAddress: @"127.0.0.1"
+			       listener: YES];
+  [NSThread detachNewThreadSelector: @selector(run:)
+			   toTarget: [Server class]
+			 withObject: server];
+  [NSThread sleepForTimeInterval: 0.5];
+
+  remote = [NSSocketPort portWithNumber: [server portNumber]
+				 onHost: [NSHost hostWithAddress: @"127.0.0.1"]
+			   forceAddress: nil
+			       listener: NO];
+  c = [NSConnection connectionWithReceivePort:
+    [NSSocketPort portWithNumber: 0
+			  onHost: nil
+		    forceAddress: @"127.0.0.1"
+			listener: YES]
+				     sendPort: remote];
+  proxy = [c rootProxy];
+  [proxy setProtocolForProxy: @protocol(Counter)];
+
+  printf("%u calls of each kind\n", count);
+  run(proxy, c, NO, count);
+  run(proxy, c, YES, count);
+
+  [c invalidate];
+  RELEASE(pool);
+  return 0;
+}
@@ -0,0 +1,78 @@
+/* Measure the cost of dispatching large numbers of queued operations.
+
+  Copyright (C) 2026 Free Software Foundation
+
+  Copying and distribution of this file, with or without modification,
+  are permitted in any medium without royalty provided the copyright
+  notice and this notice are preserved.
+
+   Queues a large number of trivial operations (with mixed priorities)
+   on a suspended queue, then resumes it and times how long it takes to
+   dispatch and run them all, first one at a time and then using as many
+   threads as the queue chooses.  */
+
+
+#include <Foundation/Foundation.h>
+
+@interface	EmptyOperation : NSOperation
+@end
+@implementation	EmptyOperation
+- (void) main
+{
+}
+@end
+
+static void
+run(NSUInteger count, NSInteger concurrency)
+{
+  CREATE_AUTORELEASE_POOL(pool);
+  NSOperationQueue	*q = [NSOperationQueue new];
+  NSMutableArray	*a = [NSMutableArray arrayWithCapacity: count];
+  NSDate		*start;
+  NSTimeInterval	t;
+  NSUInteger		i;
+
+  for (i = 0; i < count; i++)
+    {
+      NSOperation	*op = [EmptyOperation new];
+
+      [op setQueuePriority: (NSOperationQueuePriority)((i % 5) * 4 - 8)];
+      [a addObject: op];
+      [op release];
+    }
+  [q setMaxConcurrentOperationCount: concurrency];
+  [q setSuspended: YES];
+  [q addOperations: a waitUntilFinished: NO];
+
+  start = [NSDate date];
+  [q setSuspended: NO];
+  [q waitUntilAllOperationsAreFinished];
+  t = [[NSDate date] timeIntervalSinceDate: start];
+
+  printf("%8lu operations (%s): %.3f seconds, %.0f operations/second\n",
+    (unsigned long)count, (1 == concurrency) ? "serial" : "concurrent",
+    t, count / t);
+  [q release];
+  DESTROY(pool);
+}
+
+int
+main(int argc, char **argv)
+{
+  CREATE_AUTORELEASE_POOL(pool);
+
+  if (argc > 1)
+    {
+      run((NSUInteger)atol(argv[1]), 1);
+      run((NSUInteger)atol(argv[1]),
+	NSOperationQueueDefaultMaxConcurrentOperationCount);
+    }
+  else
+    {
+      run(10000, 1);
+      run(100000, 1);
+      run(100000, NSOperationQueueDefaultMaxConcurrentOperationCount);
+    }
+  DESTROY(pool);
+  exit(0);
+}
@@ -0,0 +1,124 @@
+/* Measure how filtering a large array with a predicate scales with threads.
+
+  Copyright (C) 2026 Free Software Foundation
+
+  Copying and distribution of this file, with or without modification,
+  are permitted in any medium without royalty provided the copyright
+  notice and this notice are preserved.
+
+   Builds an array of objects (2000000 by default) and filters it with
+   a predicate comparing a number and following a key path, first with
+   -filteredArrayUsingPredicate: and then with the concurrent
+   -filteredArrayUsingPredicate:chunkSize:queue: using queues allowing
+   1, 2, 4 ... threads up to the number of processors (or the number
+   given as the second argument).  Reports the time taken and speedup
+   for each and checks that every variant gives the same result.  */
+
+
+#include <Foundation/Foundation.h>
+
+@interface	Item : NSObject
+{
+  int		quantity;
+  double	price;
+  Item		*owner;
+}
+- (id) initWithQuantity: (int)q price: (double)p owner: (Item*)o;
+@end
+
+@implementation	Item
+- (void) dealloc
+{
+  [owner release];
+  [super dealloc];
+}
+- (id) initWithQuantity: (int)q price: (double)p owner: (Item*)o
+{
+  if ((self = [super init]) != nil)
+    {
+      quantity = q;
+      price = p;
+      owner = [o retain];
+    }
+  return self;
+}
+@end
+
+int
+main(int argc, char **argv)
+{
+  CREATE_AUTORELEASE_POOL(pool);
+  unsigned	count = (argc > 1) ? (unsigned)atol(argv[1]) : 2000000;
+  unsigned	max = (argc > 2) ? (unsigned)atol(argv[2])
+    : (unsigned)[[NSProcessInfo processInfo] activeProcessorCount];
+  NSMutableArray	*items = [NSMutableArray arrayWithCapacity: count];
+  NSMutableArray	*owners = [NSMutableArray array];
+  NSPredicate		*p;
+  NSArray		*expect;
+  NSDate		*start;
+  NSTimeInterval	base;
+  unsigned		threads;
+  unsigned		i;
+
+  for (i = 0; i < 16; i++)
+    {
+      Item	*o = [Item alloc];
+
+      o = [o initWithQuantity: i price: i * 10.0 owner: nil];
+      [owners addObject: o];
+      [o release];
+    }
+  for (i = 0; i < count; i++)
+    {
+      Item	*item = [Item alloc];
+
+      item = [item initWithQuantity: i % 1000
+			      price: (i % 997) / 10.0
+			      owner: [owners objectAtIndex: i % 16]];
+      [items addObject: item];
+      [item release];
+    }
+  p = [NSPredicate predicateWithFormat:
+    @"quantity < 500 AND price > 25.0 AND owner.quantity > 3"];
+
+  start = [NSDate date];
+  expect = [items filteredArrayUsingPredicate: p];
+  base = [[NSDate date] timeIntervalSinceDate: start];
+  printf("%u objects, %u passed\n", count, (unsigned)[expect count]);
+  printf("serial:     %.3f seconds\n", base);
+
+  threads = (max > 0) ? 1 : 0;
+  while (threads > 0)
+    {
+      CREATE_AUTORELEASE_POOL(arp);
+      NSOperationQueue	*q = [[NSOperationQueue new] autorelease];
+      NSArray		*result;
+      NSTimeInterval	t;
+
+      [q setMaxConcurrentOperationCount: threads];
+      start = [NSDate date];
+      result = [items filteredArrayUsingPredicate: p chunkSize: 0 queue: q];
+      t = [[NSDate date] timeIntervalSinceDate: start];
+      printf("%2u threads: %.3f seconds, speedup %.2f%s\n",
+	threads, t, t > 0.0 ? base / t : 0.0,
+	[result isEqual: expect] ? "" : " (WRONG RESULT)");
+      DESTROY(arp);
+
+      /* Double the number of threads each time, finishing with max.
+       */
+      if (threads >= max)
+	{
+	  threads = 0;
+	}
+      else if (threads * 2 > max)
+	{
+	  threads = max;
+	}
+      else
+	{
+	  threads *= 2;
+	}
+    }
+  DESTROY(pool);
+  exit(0);
+}
@@ -0,0 +1,131 @@
+/* Measure the cost of retain/release of objects shared between threads.
+
+  Copyright (C) 2026 Free Software Foundation
+
+  Copying and distribution of this file, with or without modification,
+  are permitted in any medium without royalty provided the copyright
+  notice and this notice are preserved.
+
+   Starts a number of threads (4 by default) which all repeatedly retain
+   and release the same small set of objects, and reports the time taken.
+   For comparison, the same number of count updates are then done using
+   a table of locks chosen by object address, as NSObject does when no
+   atomic operations are available.  Build the library with and without
+   --disable-c11-atomics to compare the atomic implementations.  */
+
+
+#include <Foundation/Foundation.h>
+
+#define	OBJECTS		8
+#define	LOCKCOUNT	32
+
+static id		objects[OBJECTS];
+static NSUInteger	counts[OBJECTS];
+static NSLock		*locks[LOCKCOUNT];
+static unsigned		iterations = 10000000;
+
+@interface	Worker : NSObject
+{
+@public
+  NSConditionLock	*done;
+  BOOL			useLocks;
+}
+- (void) run: (id)arg;
+@end
+
+@implementation	Worker
+- (void) run: (id)arg
+{
+  CREATE_AUTORELEASE_POOL(pool);
+  unsigned	i;
+
+  if (useLocks == YES)
+    {
+      for (i = 0; i < iterations; i++)
+	{
+	  unsigned	o = i % OBJECTS;
+	  NSLock	*l;
+
+	  l = locks[(((uintptr_t)objects[o]) >> 3) % LOCKCOUNT];
+	  [l lock];
+	  counts[o]++;
+	  [l unlock];
+	  [l lock];
+	  counts[o]--;
+	  [l unlock];
+	}
+    }
+  else
+    {
+      for (i = 0; i < iterations; i++)
+	{
+	  id	o = objects[i % OBJECTS];
+
+	  [o retain];
+	  [o release];
+	}
+    }
+  [done lock];
+  [done unlockWithCondition: [done condition] - 1];
+  DESTROY(pool);
+}
+@end
+
+static void
+run(unsigned threads, BOOL useLocks)
+{
+  CREATE_AUTORELEASE_POOL(pool);
+  NSConditionLock	*done;
+  NSDate		*start;
+  NSTimeInterval	t;
+  unsigned		i;
+
+  done = [[NSConditionLock alloc] initWithCondition: threads];
+  start = [NSDate date];
+  for (i = 0; i < threads; i++)
+    {
+      Worker	*w = [[Worker new] autorelease];
+
+      w->done = done;
+      w->useLocks = useLocks;
+      [NSThread detachNewThreadSelector: @selector(run:)
+			       toTarget: w
+			     withObject: nil];
+    }
+  [done lockWhenCondition: 0];
+  [done unlock];
+  t = [[NSDate date] timeIntervalSinceDate: start];
+  printf("%2u threads %-15s %.3f seconds, %.1f nanoseconds/pair\n",
+    threads, useLocks ? "(lock table):" : "(retain):", t,
+    t * 1000000000.0 / ((double)iterations * threads));
+  [done release];
+  DESTROY(pool);
+}
+
+int
+main(int argc, char **argv)
+{
+  CREATE_AUTORELEASE_POOL(pool);
+  unsigned	threads = (argc > 1) ? (unsigned)atol(argv[1]) : 4;
+  unsigned	i;
+
+  if (argc > 2)
+    {
+      iterations = (unsigned)atol(argv[2]);
+    }
+  for (i = 0; i < OBJECTS; i++)
+    {
+      objects[i] = [NSObject new];
+    }
+  for (i = 0; i < LOCKCOUNT; i++)
+    {
+      locks[i] = [NSLock new];
+    }
+
+  run(1, NO);
+  run(1, YES);
+  run(threads, NO);
+  run(threads, YES);
+  DESTROY(pool);
+  exit(0);
+}
@@ -0,0 +1,130 @@
+/* Measure the cost of run loop iterations with many idle descriptors.
+
+  Copyright (C) 2026 Free Software Foundation
+
+  Copying and distribution of this file, with or without modification,
+  are permitted in any medium without royalty provided the copyright
+  notice and this notice are preserved.
+
+   Adds a large number of idle pipes (10000 by default) to the run loop
+   as read descriptors, then times how long it takes to handle a byte
+   written to one more pipe, over many run loop iterations.  With poll()
+   each iteration costs time proportional to the number of descriptors
+   watched; with epoll() it should be nearly independent of it.  */
+
+
+#include <Foundation/Foundation.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+@interface	Reader : NSObject <RunLoopEvents>
+{
+@public
+  unsigned	count;
+}
+@end
+@implementation	Reader
+- (void) receivedEvent: (void*)data
+		  type: (RunLoopEventType)type
+		 extra: (void*)extra
+	       forMode: (NSString*)mode
+{
+  char	c;
+
+  if (read((int)(intptr_t)extra, &c, 1) == 1)
+    {
+      count++;
+    }
+}
+@end
+
+static void
+run(unsigned idle, unsigned iterations)
+{
+  CREATE_AUTORELEASE_POOL(pool);
+  NSRunLoop	*loop = [NSRunLoop currentRunLoop];
+  Reader	*reader = [Reader new];
+  int		*fds = malloc(sizeof(int) * 2 * idle);
+  int		active[2];
+  NSDate	*limit = [NSDate distantFuture];
+  NSDate	*start;
+  NSTimeInterval	t;
+  unsigned	i;
+
+  for (i = 0; i < idle; i++)
+    {
+      if (pipe(&fds[i * 2]) < 0)
+	{
+	  printf("Unable to create %u pipes (%s)\n", idle, strerror(errno));
+	  exit(1);
+	}
+      [loop addEvent: (void*)(intptr_t)fds[i * 2]
+		type: ET_RDESC
+	     watcher: reader
+	     forMode: NSDefaultRunLoopMode];
+    }
+  pipe(active);
+  [loop addEvent: (void*)(intptr_t)active[0]
+	    type: ET_RDESC
+	 watcher: reader
+	 forMode: NSDefaultRunLoopMode];
+
+  start = [NSDate date];
+  for (i = 0; i < iterations; i++)
+    {
+      write(active[1], "x", 1);
+      while (reader->count == i)
+	{
+	  [loop runMode: NSDefaultRunLoopMode beforeDate: limit];
+	}
+    }
+  t = [[NSDate date] timeIntervalSinceDate: start];
+  printf("%6u idle descriptors: %.3f seconds, %.1f microseconds/iteration\n",
+    idle, t, t * 1000000.0 / iterations);
+
+  [loop removeEvent: (void*)(intptr_t)active[0]
+	       type: ET_RDESC
+	    forMode: NSDefaultRunLoopMode
+		all: YES];
+  close(active[0]);
+  close(active[1]);
+  for (i = 0; i < idle; i++)
+    {
+      [loop removeEvent: (void*)(intptr_t)fds[i * 2]
+		   type: ET_RDESC
+		forMode: NSDefaultRunLoopMode
+		    all: YES];
+      close(fds[i * 2]);
+      close(fds[i * 2 + 1]);
+    }
+  free(fds);
+  [reader release];
+  DESTROY(pool);
+}
+
+int
+main(int argc, char **argv)
+{
+  CREATE_AUTORELEASE_POOL(pool);
+  struct rlimit	rl;
+  unsigned	idle = (argc > 1) ? (unsigned)atol(argv[1]) : 10000;
+
+  /* Make sure we are allowed enough descriptors for both ends of
+   * every pipe.
+   */
+  if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < idle * 2 + 64)
+    {
+      rl.rlim_cur = idle * 2 + 64;
+      if (rl.rlim_max != RLIM_INFINITY && rl.rlim_cur > rl.rlim_max)
+	{
+	  rl.rlim_cur = rl.rlim_max;
+	}
+      setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+  run(0, 10000);
+  run(idle / 10, 10000);
+  run(idle, 10000);
+  DESTROY(pool);
+  exit(0);
+}
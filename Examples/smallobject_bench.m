@@ -0,0 +1,79 @@
+/* Measure how many objects are stored in pointers rather than allocated.
+
+  Copyright (C) 2026 Free Software Foundation
+
+  Copying and distribution of this file, with or without modification,
+  are permitted in any medium without royalty provided the copyright
+  notice and this notice are preserved.
+
+   Builds a collection of dictionaries (as might be produced by parsing
+   a property list, JSON or a database query), each with a few large
+   integers, a date and keys and values which are short strings, and
+   reports how long that took and what proportion of the objects created
+   did not need to be allocated on the heap.  On a 64-bit system with a
+   runtime supporting small objects, integers of up to 61 bits, most
+   dates and short ASCII strings are stored within the pointer.  */
+
+
+#include <Foundation/Foundation.h>
+
+static unsigned	objects = 0;
+static unsigned	small = 0;
+
+static inline id
+note(id o)
+{
+  objects++;
+  if (((uintptr_t)o & 7) != 0)
+    {
+      small++;
+    }
+  return o;
+}
+
+int
+main(int argc, char **argv)
+{
+  CREATE_AUTORELEASE_POOL(pool);
+  unsigned		count = (argc > 1) ? (unsigned)atol(argv[1]) : 200000;
+  NSMutableArray	*rows = [NSMutableArray arrayWithCapacity: count];
+  NSTimeInterval	base = [NSDate timeIntervalSinceReferenceDate];
+  NSDate		*start;
+  NSTimeInterval	t;
+  unsigned		i;
+
+  start = [NSDate date];
+  for (i = 0; i < count; i++)
+    {
+      NSMutableDictionary	*row = [NSMutableDictionary new];
+      char			buf[32];
+      NSString			*s;
+
+      [row setObject: note([NSNumber numberWithLongLong:
+	10000000000LL + i * 7919LL])
+	      forKey: note([NSString stringWithUTF8String: "identifier"])];
+      [row setObject: note([NSNumber numberWithLongLong:
+	(long long)i * 1000LL * 86400LL])
+	      forKey: note([NSString stringWithUTF8String: "timestamp"])];
+      [row setObject: note([NSNumber numberWithInt: i % 100])
+	      forKey: note([NSString stringWithUTF8String: "category"])];
+      [row setObject: note([NSDate dateWithTimeIntervalSinceReferenceDate:
+	base + i * 0.25])
+	      forKey: note([NSString stringWithUTF8String: "createdAt"])];
+      [row setObject: note([NSDate date])
+	      forKey: note([NSString stringWithUTF8String: "updatedAt"])];
+      snprintf(buf, sizeof(buf), "user_%05u", i % 100000);
+      s = note([NSString stringWithUTF8String: buf]);
+      [row setObject: s
+	      forKey: note([NSString stringWithUTF8String: "owner"])];
+      [rows addObject: row];
+      [row release];
+    }
+  t = [[NSDate date] timeIntervalSinceDate: start];
+
+  printf("%u rows built in %.3f seconds\n", count, t);
+  printf("%u of %u objects (%.1f%%) were not allocated on the heap\n",
+    small, objects, objects ? small * 100.0 / objects : 0.0);
+  DESTROY(pool);
+  exit(0);
+}
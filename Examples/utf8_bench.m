@@ -0,0 +1,85 @@
+/* Measure the cost of converting between UTF-8 data and strings.
+
+  Copyright (C) 2026 Free Software Foundation
+
+  Copying and distribution of this file, with or without modification,
+  are permitted in any medium without royalty provided the copyright
+  notice and this notice are preserved.
+
+   Builds three corpora of about a megabyte each (plain ASCII text,
+   European text which is mostly ASCII with some accented Latin letters,
+   and Japanese text in which almost every character is multibyte) and
+   reports the throughput of creating strings from the UTF-8 data and
+   of converting those strings back to UTF-8 data.  */
+
+
+#include <Foundation/Foundation.h>
+
+static NSData *
+corpus(const char *seed, NSUInteger size)
+{
+  NSMutableData	*d = [NSMutableData dataWithCapacity: size];
+  NSUInteger	l = strlen(seed);
+
+  while ([d length] + l <= size)
+    {
+      [d appendBytes: seed length: l];
+    }
+  return d;
+}
+
+static void
+run(const char *name, NSData *d, unsigned iterations)
+{
+  CREATE_AUTORELEASE_POOL(pool);
+  double	mb = [d length] * (double)iterations / (1024.0 * 1024.0);
+  NSString	*s = nil;
+  NSDate	*start;
+  NSTimeInterval	t;
+  unsigned	i;
+
+  start = [NSDate date];
+  for (i = 0; i < iterations; i++)
+    {
+      [s release];
+      s = [[NSString alloc] initWithBytes: [d bytes]
+				   length: [d length]
+				 encoding: NSUTF8StringEncoding];
+    }
+  t = [[NSDate date] timeIntervalSinceDate: start];
+  printf("%-6s decode %8.1f MB/s\n", name, mb / t);
+
+  start = [NSDate date];
+  for (i = 0; i < iterations; i++)
+    {
+      CREATE_AUTORELEASE_POOL(inner);
+      if ([[s dataUsingEncoding: NSUTF8StringEncoding] isEqual: d] == NO)
+	{
+	  printf("%s: round trip failed\n", name);
+	}
+      DESTROY(inner);
+    }
+  t = [[NSDate date] timeIntervalSinceDate: start];
+  printf("%-6s encode %8.1f MB/s\n", name, mb / t);
+  [s release];
+  DESTROY(pool);
+}
+
+int
+main(int argc, char **argv)
+{
+  CREATE_AUTORELEASE_POOL(pool);
+  unsigned	iterations = (argc > 1) ? (unsigned)atol(argv[1]) : 100;
+  NSUInteger	size = 1024 * 1024;
+
+  run("ascii", corpus("The quick brown fox jumps over the lazy dog. "
+    "Pack my box with five dozen liquor jugs!\n", size), iterations);
+  run("latin", corpus("Der Gr\xc3\xb6\xc3\x9f" "e nach: caf\xc3\xa9, "
+    "na\xc3\xafve, se\xc3\xb1or, \xc3\xa5r och \xc3\xb8l sind "
+    "\xc3\xbc" "blich.\n", size), iterations);
+  run("cjk", corpus("\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e\xe3\x81\xae"
+    "\xe6\x96\x87\xe7\xab\xa0\xe3\x81\xa7\xe3\x81\x99\xe3\x80\x82\n",
+    size), iterations);
+  DESTROY(pool);
+  exit(0);
+}
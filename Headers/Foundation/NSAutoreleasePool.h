@@ -36,6 +36,8 @@ extern "C" {
 @class NSThread;
 
 
+struct autorelease_page;
+
 /**
  * Each thread has its own copy of these variables.
  <example>
@@ -45,6 +47,13 @@ extern "C" {
   id *pool_cache;                  // cache of previously-allocated pools,
   int pool_cache_size;             //  used internally for recycling
   int pool_cache_count;
+  struct autorelease_page *stack_page; // stack of autoreleased objects
+  id *stack_top;
+  id *stack_limit;
+  unsigned depth;                  // number of pools in use
+  unsigned peak_depth;             // statistics
+  NSUInteger drain_count;
+  NSUInteger drained_objects;
 }
  </example>
 */
@@ -65,6 +74,20 @@ typedef struct autorelease_thread_vars
   __unsafe_unretained id *pool_cache;
   int pool_cache_size;
   int pool_cache_count;
+
+  /* The objects autoreleased in the thread are kept in a single stack
+     (made of a list of pages), with each pool owning the part of the
+     stack from the point where it was created.  Adding an object is
+     just a matter of storing it at the top of the stack. */
+  struct autorelease_page *stack_page;
+  __unsafe_unretained id *stack_top;
+  __unsafe_unretained id *stack_limit;
+
+  /* The number of pools in use, and statistics about their use. */
+  unsigned depth;
+  unsigned peak_depth;
+  NSUInteger drain_count;
+  NSUInteger drained_objects;
 } thread_vars_struct;
 
 /* Initialize an autorelease_thread_vars structure for a new thread.
@@ -74,28 +97,28 @@ typedef struct autorelease_thread_vars
 memset (TV, 0, sizeof (__typeof__ (*TV)))
 
 
-
+
 /**
- *  Each pool holds its objects-to-be-released in a linked-list of 
-    these structures.
+ *  The stack of autoreleased objects in a thread is held in a
+    linked-list of these structures.
     <example>
 {
-  struct autorelease_array_list *next;
-  unsigned size;
-  unsigned count;
+  struct autorelease_page *prev;
+  struct autorelease_page *next;
+  id *limit;
   id objects[0];
 }
     </example>
  */
-typedef struct autorelease_array_list
+typedef struct autorelease_page
 {
-  struct autorelease_array_list *next;
-  unsigned size;
-  unsigned count;
+  struct autorelease_page *prev;
+  struct autorelease_page *next;
+  __unsafe_unretained id *limit;
   __unsafe_unretained id objects[0];
-} array_list_struct;
+} autorelease_page_struct;
+
 
-
 
 /**
  * <p>
@@ -187,11 +210,11 @@ NS_AUTOMATED_REFCOUNT_UNAVAILABLE
   /* This pointer to our child pool is  necessary for co-existing
      with exceptions. */
   NSAutoreleasePool *_child;
-  /* A collection of the objects to be released. */
-  struct autorelease_array_list *_released;
-  struct autorelease_array_list *_released_head;
-  /* The total number of objects autoreleased in this pool. */
-  unsigned _released_count;
+  /* The variables of the thread owning the pool. */
+  struct autorelease_thread_vars *_vars;
+  /* The position in the thread's stack where this pool's objects start. */
+  struct autorelease_page *_page;
+  __unsafe_unretained id *_start;
   /* The method to add an object to this pool */
   void 	(*_addImp)(id, SEL, id);
 #endif
@@ -222,7 +245,10 @@ NS_AUTOMATED_REFCOUNT_UNAVAILABLE
 + (id) allocWithZone: (NSZone*)zone;
 
 /**
- * Adds anObj to this autorelease pool.
+ * Adds anObj to this autorelease pool.<br />
+ * The object is actually placed on the top of the stack of objects
+ * autoreleased in the current thread, so if the receiver is not the
+ * current pool, the object is released when the current pool is.
  */
 - (void) addObject: (id)anObj;
 
@@ -309,6 +335,34 @@ NS_AUTOMATED_REFCOUNT_UNAVAILABLE
  */
 + (void) setPoolCountThreshhold: (unsigned)c;
 
+/**
+ * Returns the number of times that autorelease pools in the current
+ * thread have been emptied (drained, released or sent -emptyPool)
+ * since the thread started or +resetStatistics was last called.
+ */
++ (NSUInteger) drainCount;
+
+/**
+ * Returns the total number of objects released by the autorelease pools
+ * in the current thread since the thread started or +resetStatistics was
+ * last called.  Dividing this by the +drainCount gives the average number
+ * of objects per drain.
+ */
++ (NSUInteger) drainedObjectCount;
+
+/**
+ * Returns the greatest number of autorelease pools which have been in
+ * use at once in the current thread since the thread started or
+ * +resetStatistics was last called.
+ */
++ (unsigned) peakPoolDepth;
+
+/**
+ * Resets the statistics (+drainCount, +drainedObjectCount and
+ * +peakPoolDepth) for the current thread.
+ */
++ (void) resetStatistics;
+
 /**
  * Return the number of objects in this pool.
  */
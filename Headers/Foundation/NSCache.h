@@ -56,12 +56,16 @@ extern "C" {
   NSString *_name;
   /** The mapping from names to objects in this cache. */
   NSMutableDictionary *_objects;
-  /** LRU ordering of all potentially-evictable objects in this cache. */
+  /** Unused; retained for binary compatibility. */
   NSMutableArray *_accesses;
-  /** Total number of accesses to objects */
+  /** Unused; retained for binary compatibility. */
   int64_t _totalAccesses;
 #endif
 #if     GS_NONFRAGILE
+#  if	defined(GS_NSCache_IVARS)
+@public
+GS_NSCache_IVARS;
+#  endif
 #else
   /* Pointer to private additional data used to avoid breaking ABI
    * when we don't have the non-fragile ABI available.
@@ -76,6 +80,25 @@ extern "C" {
  */
 - (NSUInteger) countLimit;
 
+#if GS_API_VERSION(GS_API_NONE, GS_API_NONE)
+/** <em>GNUstep extension</em><br />
+ * Returns the number of objects which have been removed from the cache
+ * (or have had their contents discarded) in order to keep it within its
+ * count and cost limits.
+ */
+- (NSUInteger) evictionCount;
+
+/** <em>GNUstep extension</em><br />
+ * Returns the number of calls to -objectForKey: which found an object.
+ */
+- (NSUInteger) hitCount;
+
+/** <em>GNUstep extension</em><br />
+ * Returns the number of calls to -objectForKey: which found no object.
+ */
+- (NSUInteger) missCount;
+#endif
+
 /**
  * Returns the cache's delegate.
  */
@@ -134,8 +157,13 @@ extern "C" {
 
 /**
  * Adds an object and its associated cost.  The cache will endeavor to keep the
- * total cost below the value set with -setTotalCostLimit: by discarding the
- * contents of objects which implement the NSDiscardableContent protocol.
+ * total cost below the value set with -setTotalCostLimit: and the number of
+ * objects below the value set with -setCountLimit: by removing the least
+ * recently used objects.  Objects which implement the NSDiscardableContent
+ * protocol have their contents discarded instead, and are only removed if
+ * -evictsObjectsWithDiscardedContent is YES.<br />
+ * NSCache is thread-safe; objects may be added, looked up and removed from
+ * any thread without additional locking.
  */
 - (void) setObject: (id)obj forKey: (id)key cost: (NSUInteger)num;
 
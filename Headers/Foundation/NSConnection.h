@@ -160,6 +160,15 @@ GS_NSConnection_IVARS;
 - (NSDictionary*) statistics;
 @end
 
+#if GS_API_VERSION(GS_API_NONE, GS_API_NONE)
+@interface NSConnection (GNUstepExtensions)
+- (void) addSignaturesFromProtocol: (Protocol*)aProtocol;
+- (void) flushRequests;
+- (BOOL) pipelinesRequests;
+- (void) setPipelinesRequests: (BOOL)flag;
+@end
+#endif
+
 
 /**
  * This category represents an informal protocol to which NSConnection
@@ -206,6 +206,8 @@ GS_EXPORT NSString * const NSFileHandleOperationException;
 - (NSString*) socketLocalService;
 - (NSString*) socketService;
 - (NSString*) socketProtocol;
+- (unsigned long long) transferFromFileHandle: (NSFileHandle*)source
+				       length: (unsigned long long)length;
 - (BOOL) useCompression;
 - (void) writeInBackgroundAndNotify: (NSData*)item forModes: (NSArray*)modes;
 - (void) writeInBackgroundAndNotify: (NSData*)item;
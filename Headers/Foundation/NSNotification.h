@@ -32,6 +32,7 @@
 
 #import	<Foundation/NSObject.h>
 #import	<Foundation/NSMapTable.h>
+#import <GNUstepBase/GSBlocks.h>
 
 #if	defined(__cplusplus)
 extern "C" {
@@ -40,6 +41,7 @@ extern "C" {
 @class NSString;
 @class NSDictionary;
 @class NSLock;
+@class NSOperationQueue;
 
 @interface NSNotification : NSObject <NSCopying, NSCoding>
 
@@ -60,6 +62,9 @@ extern "C" {
 @end
 
 
+#if OS_API_VERSION(100600, GS_API_LATEST)
+DEFINE_BLOCK_TYPE(GSNotificationBlock, void, NSNotification*);
+#endif
 
 @interface NSNotificationCenter : NSObject
 {
@@ -76,6 +81,13 @@ extern "C" {
                 name: (NSString*)name
               object: (id)object;
 
+#if OS_API_VERSION(100600, GS_API_LATEST)
+- (id) addObserverForName: (NSString*)name
+                   object: (id)object
+                    queue: (NSOperationQueue*)queue
+               usingBlock: (GSNotificationBlock)block;
+#endif
+
 - (void) removeObserver: (id)observer;
 - (void) removeObserver: (id)observer
                    name: (NSString*)name
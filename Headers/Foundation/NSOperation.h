@@ -275,6 +275,22 @@ enum {
  * and removed from the queue).
  */
 - (void) waitUntilAllOperationsAreFinished;
+
+#if	GS_API_VERSION(GS_API_NONE, GS_API_NONE)
+/** Returns the number of seconds for which an idle thread in the pool
+ * used to run non-concurrent operations is kept before it exits.<br />
+ * The default is five seconds.<br />
+ * This is a GNUstep extension.
+ */
+- (NSTimeInterval) idleTimeout;
+
+/** Sets the number of seconds for which an idle thread in the pool used
+ * to run non-concurrent operations is retained before it exits.  Using a
+ * larger value avoids repeatedly creating threads under bursty load.<br />
+ * This is a GNUstep extension.
+ */
+- (void) setIdleTimeout: (NSTimeInterval)seconds;
+#endif
 @end
 
 #if	defined(__cplusplus)
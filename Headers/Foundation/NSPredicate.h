@@ -36,6 +36,8 @@
 extern "C" {
 #endif
 
+@class NSOperationQueue;
+
 @interface NSPredicate : NSObject <NSCoding, NSCopying>
 
 + (NSPredicate *) predicateWithFormat: (NSString *)format, ...;
@@ -56,6 +58,23 @@ extern "C" {
  * return an array containing all the objects which evaluate to YES.
  */
 - (NSArray *) filteredArrayUsingPredicate: (NSPredicate *)predicate;
+#if	OS_API_VERSION(GS_API_NONE, GS_API_NONE)
+/** Like -filteredArrayUsingPredicate: but evaluates the predicate with
+ * ranges of chunkSize objects concurrently, as operations on queue (or
+ * on a private queue with one thread per processor if queue is nil).
+ * The objects in the result are in the same order as in the receiver.<br />
+ * If chunkSize is zero, a size giving a few ranges for each processor
+ * is used.  The predicate must be safe to evaluate in several threads
+ * at once.<br />
+ * The calling thread evaluates any ranges which the queue has not yet
+ * started rather than waiting for them, so this may be called from an
+ * operation running on queue even if queue runs only one operation at a
+ * time (though then all the ranges are evaluated by the calling thread).
+ */
+- (NSArray *) filteredArrayUsingPredicate: (NSPredicate *)predicate
+				chunkSize: (NSUInteger)chunkSize
+				    queue: (NSOperationQueue *)queue;
+#endif
 @end
 
 @interface NSMutableArray (NSPredicate)
@@ -70,6 +89,14 @@ extern "C" {
  * return an set containing all the objects which evaluate to YES.
  */
 - (NSSet *) filteredSetUsingPredicate: (NSPredicate *)predicate;
+#if	OS_API_VERSION(GS_API_NONE, GS_API_NONE)
+/** Like -filteredSetUsingPredicate: but evaluates the predicate
+ * concurrently, as -filteredArrayUsingPredicate:chunkSize:queue: does.
+ */
+- (NSSet *) filteredSetUsingPredicate: (NSPredicate *)predicate
+			    chunkSize: (NSUInteger)chunkSize
+				queue: (NSOperationQueue *)queue;
+#endif
 @end
 
 @interface NSMutableSet (NSPredicate)
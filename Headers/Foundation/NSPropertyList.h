@@ -56,6 +56,21 @@ enum {
  */
 typedef NSUInteger NSPropertyListMutabilityOptions;
 
+#if GS_API_VERSION(GS_API_NONE, GS_API_NONE)
+/**
+ * <em>GNUstep extension</em><br />
+ * A read option which may be combined with NSPropertyListImmutable when
+ * reading a binary property list.  Arrays and dictionaries in the list
+ * are then not decoded until they are used, and their members are each
+ * decoded (once) when first accessed, so opening a large property list
+ * costs almost nothing and only the parts actually used are read.<br />
+ * The option is ignored for other formats and mutability options.
+ */
+enum {
+  NSPropertyListReadLazily = (1 << 8)
+};
+#endif
+
 enum {
   NSPropertyListOpenStepFormat = 1,
   NSPropertyListXMLFormat_v1_0 = 100,
@@ -281,6 +296,21 @@ typedef NSUInteger NSPropertyListFormat;
                           error: (out NSError**)error;
 #endif
 
+#if GS_API_VERSION(GS_API_NONE, GS_API_NONE)
+/**
+ * <em>GNUstep extension</em><br />
+ * Reads a property list from the file at path, mapping the file into
+ * memory (where the system supports it) rather than reading it.<br />
+ * Combined with the NSPropertyListReadLazily option, this allows a large
+ * binary property list to be opened in constant time, with only the
+ * pages holding the objects used ever being read from disk.
+ */
++ (id) propertyListWithContentsOfFile: (NSString*)path
+                              options: (NSPropertyListReadOptions)anOption
+                               format: (NSPropertyListFormat*)aFormat
+                                error: (out NSError**)error;
+#endif
+
 @end
 
 #endif	/* GS_API_MACOSX */
@@ -32,6 +32,7 @@
 
 #import	<GNUstepBase/GSBlocks.h>
 #import	<GNUstepBase/GSFunctions.h>
+#import	<GNUstepBase/GSJSONReader.h>
 #import	<GNUstepBase/GSLocale.h>
 #import	<GNUstepBase/GSLock.h>
 #import	<GNUstepBase/GSMime.h>
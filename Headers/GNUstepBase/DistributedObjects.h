@@ -60,7 +60,8 @@ enum {
  METHODTYPE_REPLY,
  PROXY_RELEASE,
  PROXY_RETAIN,
- RETAIN_REPLY
+ RETAIN_REPLY,
+ METHOD_BATCH		/* Several oneway method requests in one message */
 };
 
 
@@ -79,6 +80,8 @@ enum {
 - (void) forwardInvocation: (NSInvocation *)inv 
 		  forProxy: (NSDistantObject*)object;
 - (const char *) typeForSelector: (SEL)sel remoteTarget: (unsigned)target;
+- (NSMethodSignature*) _signatureForSelector: (SEL)sel;
+- (void) _setSignature: (NSMethodSignature*)sig forSelector: (SEL)sel;
 @end
 
 @interface NSPort (Internal)
@@ -109,13 +109,25 @@ extern "C" {
  *
  *      GSI_MAP_ZEROED()
  *              Define this macro to check whether a map uses keys which may
- *              be zeroed weak pointers.  
+ *              be zeroed weak pointers.
+ *
+ *	GSI_MAP_OPEN
+ *		Define this to a non-zero integer value to use an open
+ *		addressing table (with cached hash values) rather than
+ *		chained buckets.  This makes lookups in large maps much
+ *		more cache friendly.  See the description below.
+ *		If GSI_MAP_TABLE_T is also defined, the table structure
+ *		must contain a 'deletedCount' member.
  */
 
 #ifndef	GSI_MAP_HAS_VALUE
 #define	GSI_MAP_HAS_VALUE	1
 #endif
 
+#ifndef	GSI_MAP_OPEN
+#define	GSI_MAP_OPEN	0
+#endif
+
 #ifndef	GSI_MAP_RETAIN_KEY
 #define	GSI_MAP_RETAIN_KEY(M, X)	[(X).obj retain]
 #endif
@@ -330,6 +342,24 @@ extern "C" {
  *  member variable.
  *  If nodeCount is bigger than the "increment" it will allocate chunks
  *  of size "increment".
+ *
+ *  Open addressing (GSI_MAP_OPEN)
+ *  ------------------------------
+ *  When GSI_MAP_OPEN is non-zero the memory management view is unchanged
+ *  (nodes are still allocated in chunks and never move, so a node pointer
+ *  remains valid until the node is removed), but the buckets array is
+ *  replaced by a power of two sized array of slots, each holding the
+ *  cached hash of a key and a pointer to its node (in firstNode).
+ *  Lookups use linear probing, comparing the cached hash values held in
+ *  contiguous memory and only following a node pointer when the hash
+ *  matches, so a miss touches no nodes at all and resizing never needs
+ *  to call the hash function again.
+ *  A slot is empty if its firstNode and hash are both zero, and is a
+ *  deleted slot (which does not terminate a probe) if firstNode is zero
+ *  but the hash is GSI_MAP_DELETED.  Deleted slots are counted in
+ *  deletedCount and discarded when the table is resized.
+ *  Removing a node never moves any other node, so the enumeration
+ *  guarantees described below still hold.
  */
 
 #if	!defined(GSI_MAP_TABLE_T)
@@ -348,10 +378,17 @@ struct	_GSIMapNode {
 #endif
 };
 
+#if	GSI_MAP_OPEN
+struct	_GSIMapBucket {
+  uintptr_t	hash;		/* Cached hash of key in slot.	*/
+  GSIMapNode	firstNode;	/* The node in this slot.	*/
+};
+#else
 struct	_GSIMapBucket {
   uintptr_t	nodeCount;	/* Number of nodes in bucket.	*/
   GSIMapNode	firstNode;	/* The linked list of nodes.	*/
 };
+#endif
 
 #if	defined(GSI_MAP_TABLE_T)
 typedef GSI_MAP_TABLE_T	*GSIMapTable;
@@ -368,6 +405,9 @@ struct	_GSIMapTable {
   uintptr_t	chunkCount;	/* Number of chunks in array.	*/
   GSIMapNode	*nodeChunks;	/* Chunks of allocated memory.	*/
   uintptr_t	increment;
+#if	GSI_MAP_OPEN
+  uintptr_t	deletedCount;	/* Number of deleted slots.	*/
+#endif
 #ifdef	GSI_MAP_EXTRA
   GSI_MAP_EXTRA	extra;
 #endif
@@ -387,6 +427,102 @@ typedef struct _GSIMapEnumerator GSIMapEnumerator_t;
 #endif
 typedef GSIMapEnumerator_t	*GSIMapEnumerator;
 
+#if	GSI_MAP_OPEN
+
+/* The hash value marking a slot whose node has been removed.
+ */
+#define	GSI_MAP_DELETED	((uintptr_t)1)
+
+/* Spread the bits of a hash value so that masking it with a power of two
+ * table size gives a good distribution even for poor hash functions (eg.
+ * those based on aligned pointers).
+ */
+static INLINE uintptr_t
+GSIMapMixHash(uintptr_t hash)
+{
+#if	GS_SIZEOF_VOIDP == 8
+  hash ^= hash >> 32;
+#endif
+  hash ^= hash >> 16;
+  hash *= 0x45d9f3b;
+  hash ^= hash >> 16;
+  return hash;
+}
+
+static INLINE GSIMapBucket
+GSIMapPickBucket(uintptr_t hash, GSIMapBucket buckets, uintptr_t bucketCount)
+{
+  return buckets + (GSIMapMixHash(hash) & (bucketCount - 1));
+}
+
+static INLINE GSIMapBucket
+GSIMapNextBucket(GSIMapTable map, GSIMapBucket bucket)
+{
+  return map->buckets + ((bucket - map->buckets + 1) & (map->bucketCount - 1));
+}
+
+static INLINE GSIMapBucket
+GSIMapBucketForKey(GSIMapTable map, GSIMapKey key)
+{
+  return GSIMapPickBucket(GSI_MAP_HASH(map, key),
+    map->buckets, map->bucketCount);
+}
+
+/* Places a node in the first free slot of its probe sequence.
+ * The caller must ensure the table has room (see GSIMapRightSizeMap()).
+ */
+static INLINE void
+GSIMapAddNodeToMap(GSIMapTable map, GSIMapNode node)
+{
+  uintptr_t	hash = GSI_MAP_HASH(map, node->key);
+  GSIMapBucket	bucket;
+
+  bucket = GSIMapPickBucket(hash, map->buckets, map->bucketCount);
+  while (bucket->firstNode != 0)
+    {
+      bucket = GSIMapNextBucket(map, bucket);
+    }
+  if (bucket->hash == GSI_MAP_DELETED)
+    {
+      map->deletedCount--;
+    }
+  bucket->hash = hash;
+  bucket->firstNode = node;
+  node->nextInBucket = 0;
+  map->nodeCount++;
+}
+
+/* Removes a node from the map.  The bucket may be the slot containing
+ * the node or any slot earlier in the same probe sequence (eg. the one
+ * returned by GSIMapBucketForKey()).
+ */
+static INLINE void
+GSIMapRemoveNodeFromMap(GSIMapTable map, GSIMapBucket bkt, GSIMapNode node)
+{
+  while (bkt->firstNode != node)
+    {
+      bkt = GSIMapNextBucket(map, bkt);
+    }
+  bkt->firstNode = 0;
+  /* If the next slot is empty no probe sequence can continue through
+   * this one, so it can be marked as empty rather than deleted.
+   */
+  if (GSIMapNextBucket(map, bkt)->firstNode == 0
+    && GSIMapNextBucket(map, bkt)->hash == 0)
+    {
+      bkt->hash = 0;
+    }
+  else
+    {
+      bkt->hash = GSI_MAP_DELETED;
+      map->deletedCount++;
+    }
+  node->nextInBucket = 0;
+  map->nodeCount--;
+}
+
+#else	/* GSI_MAP_OPEN */
+
 static INLINE GSIMapBucket
 GSIMapPickBucket(unsigned hash, GSIMapBucket buckets, uintptr_t bucketCount)
 {
@@ -458,6 +594,8 @@ GSIMapRemoveNodeFromMap(GSIMapTable map, GSIMapBucket bkt, GSIMapNode node)
   GSIMapRemoveNodeFromBucket(bkt, node);
 }
 
+#endif	/* GSI_MAP_OPEN */
+
 static INLINE void
 GSIMapFreeNode(GSIMapTable map, GSIMapNode node)
 {
@@ -472,6 +610,32 @@ GSIMapFreeNode(GSIMapTable map, GSIMapNode node)
   map->freeNodes = node;
 }
 
+#if	GSI_MAP_OPEN
+
+static INLINE void
+GSIMapRemoveWeak(GSIMapTable map)
+{
+  if (GSI_MAP_ZEROED(map))
+    {
+      uintptr_t		bucketCount = map->bucketCount;
+      GSIMapBucket	bucket = map->buckets;
+
+      while (bucketCount-- > 0)
+	{
+	  GSIMapNode	node = bucket->firstNode;
+
+	  if (node != 0 && GSI_MAP_NODE_IS_EMPTY(map, node))
+	    {
+	      GSIMapRemoveNodeFromMap(map, bucket, node);
+	      GSIMapFreeNode(map, node);
+	    }
+	  bucket++;
+	}
+    }
+}
+
+#else	/* GSI_MAP_OPEN */
+
 static INLINE GSIMapNode
 GSIMapRemoveAndFreeNode(GSIMapTable map, uintptr_t bkt, GSIMapNode node)
 {
@@ -557,6 +721,8 @@ GSIMapRemangleBuckets(GSIMapTable map,
     }
 }
 
+#endif	/* GSI_MAP_OPEN */
+
 static INLINE void
 GSIMapMoreNodes(GSIMapTable map, unsigned required)
 {
@@ -620,6 +786,239 @@ GSIMapMoreNodes(GSIMapTable map, unsigned required)
     }
 }
 
+#if	GSI_MAP_OPEN
+
+/* Probes from bucket for a node whose key has the specified hash and is
+ * equal to key.  Nodes are only examined if their cached hash matches.
+ */
+static INLINE GSIMapNode
+GSIMapNodeForKeyWithHash(GSIMapTable map, GSIMapBucket bucket,
+  uintptr_t hash, GSIMapKey key)
+{
+  while (1)
+    {
+      GSIMapNode	node = bucket->firstNode;
+
+      if (node == 0)
+	{
+	  if (bucket->hash != GSI_MAP_DELETED)
+	    {
+	      return 0;		// Empty slot terminates the probe.
+	    }
+	}
+      else if (GSI_MAP_ZEROED(map) && GSI_MAP_NODE_IS_EMPTY(map, node))
+	{
+	  GSIMapRemoveNodeFromMap(map, bucket, node);
+	  GSIMapFreeNode(map, node);
+	  if (bucket->hash == 0)
+	    {
+	      return 0;		// Slot was the end of the probe sequence.
+	    }
+	}
+      else if (bucket->hash == hash
+	&& GSI_MAP_EQUAL(map, GSI_MAP_READ_KEY(map, &node->key), key))
+	{
+	  return node;
+	}
+      bucket = GSIMapNextBucket(map, bucket);
+    }
+}
+
+static INLINE GSIMapNode
+GSIMapNodeForKeyInBucket(GSIMapTable map, GSIMapBucket bucket, GSIMapKey key)
+{
+  return GSIMapNodeForKeyWithHash(map, bucket, GSI_MAP_HASH(map, key), key);
+}
+
+static INLINE GSIMapNode
+GSIMapNodeForKey(GSIMapTable map, GSIMapKey key)
+{
+  uintptr_t	hash;
+
+  if (map->nodeCount == 0)
+    {
+      return 0;
+    }
+  hash = GSI_MAP_HASH(map, key);
+  return GSIMapNodeForKeyWithHash(map,
+    GSIMapPickBucket(hash, map->buckets, map->bucketCount), hash, key);
+}
+
+/* Returns the index of the first slot at or after bucket which contains
+ * a node (or bucketCount if there is none), freeing any zeroed nodes
+ * found on the way.
+ */
+static INLINE uintptr_t
+GSIMapNextUsedBucket(GSIMapTable map, uintptr_t bucket)
+{
+  while (bucket < map->bucketCount)
+    {
+      GSIMapNode	node = map->buckets[bucket].firstNode;
+
+      if (node != 0)
+	{
+	  if (!GSI_MAP_ZEROED(map)
+	    || GSI_MAP_READ_KEY(map, &node->key).addr != 0)
+	    {
+	      break;
+	    }
+	  GSIMapRemoveNodeFromMap(map, &map->buckets[bucket], node);
+	  GSIMapFreeNode(map, node);
+	}
+      bucket++;
+    }
+  return bucket;
+}
+
+static INLINE GSIMapNode
+GSIMapFirstNode(GSIMapTable map)
+{
+  if (map->nodeCount > 0)
+    {
+      uintptr_t	bucket = GSIMapNextUsedBucket(map, 0);
+
+      if (bucket < map->bucketCount)
+	{
+	  return map->buckets[bucket].firstNode;
+	}
+    }
+  return 0;
+}
+
+#if     (GSI_MAP_KTYPES & GSUNION_INT)
+/*
+ * Specialized lookup for the case where keys are known to be simple integer
+ * or pointer values that are their own hash values (when converted to unsigned
+ * integers) and can be compared with a test for integer equality.
+ */
+static INLINE GSIMapNode
+GSIMapNodeForSimpleKey(GSIMapTable map, GSIMapKey key)
+{
+  uintptr_t	hash;
+  GSIMapBucket	bucket;
+
+  if (map->nodeCount == 0)
+    {
+      return 0;
+    }
+  hash = GSI_MAP_HASH(map, key);
+  bucket = GSIMapPickBucket(hash, map->buckets, map->bucketCount);
+  while (1)
+    {
+      GSIMapNode	node = bucket->firstNode;
+
+      if (node == 0)
+	{
+	  if (bucket->hash != GSI_MAP_DELETED)
+	    {
+	      return 0;
+	    }
+	}
+      else if (GSI_MAP_ZEROED(map) && GSI_MAP_NODE_IS_EMPTY(map, node))
+	{
+	  GSIMapRemoveNodeFromMap(map, bucket, node);
+	  GSIMapFreeNode(map, node);
+	  if (bucket->hash == 0)
+	    {
+	      return 0;
+	    }
+	}
+      else if (GSI_MAP_READ_KEY(map, &node->key).addr == key.addr)
+	{
+	  return node;
+	}
+      bucket = GSIMapNextBucket(map, bucket);
+    }
+}
+#endif
+
+static INLINE void
+GSIMapResize(GSIMapTable map, uintptr_t new_capacity)
+{
+  GSIMapBucket	new_buckets;
+  uintptr_t	size = 8;
+
+  /*
+   *	Find the next power of two which keeps the table (including
+   *	deleted slots) no more than three quarters full, so that every
+   *	probe sequence is guaranteed to reach an empty slot.
+   */
+  while (3 * size < 4 * new_capacity)
+    {
+      size <<= 1;
+    }
+
+#if     GS_WITH_GC
+  new_buckets = (GSIMapBucket)NSAllocateCollectable
+    (size * sizeof(GSIMapBucket_t), 0);
+#else
+  new_buckets = (GSIMapBucket)NSZoneCalloc(map->zone, size,
+    sizeof(GSIMapBucket_t));
+#endif
+
+  if (new_buckets != 0)
+    {
+      GSIMapBucket	old_buckets = map->buckets;
+      GSIMapBucket	old = old_buckets;
+      uintptr_t		count = map->bucketCount;
+      uintptr_t		mask = size - 1;
+
+      /* Rehashing uses the cached hash values, so the hash function
+       * is not called again for any key.
+       */
+      while (count-- > 0)
+	{
+	  GSIMapNode	node = old->firstNode;
+
+	  if (node != 0)
+	    {
+	      if (GSI_MAP_ZEROED(map) && GSI_MAP_NODE_IS_EMPTY(map, node))
+		{
+		  map->nodeCount--;
+		  GSIMapFreeNode(map, node);
+		}
+	      else
+		{
+		  GSIMapBucket	bkt;
+
+		  bkt = GSIMapPickBucket(old->hash, new_buckets, size);
+		  while (bkt->firstNode != 0)
+		    {
+		      bkt = new_buckets + ((bkt - new_buckets + 1) & mask);
+		    }
+		  bkt->hash = old->hash;
+		  bkt->firstNode = node;
+		}
+	    }
+	  old++;
+	}
+#if     !GS_WITH_GC
+      if (old_buckets != 0)
+	{
+	  NSZoneFree(map->zone, old_buckets);
+	}
+#endif
+      map->buckets = new_buckets;
+      map->bucketCount = size;
+      map->deletedCount = 0;
+    }
+}
+
+static INLINE void
+GSIMapRightSizeMap(GSIMapTable map, uintptr_t capacity)
+{
+  /* Make sure there is room for one node more than the capacity
+   * without the table (including deleted slots) becoming more than
+   * three quarters full.
+   */
+  if (4 * (capacity + map->deletedCount + 1) > 3 * map->bucketCount)
+    {
+      GSIMapResize(map, capacity + 1);
+    }
+}
+
+#else	/* GSI_MAP_OPEN */
+
 static INLINE GSIMapNode 
 GSIMapNodeForKeyInBucket(GSIMapTable map, GSIMapBucket bucket, GSIMapKey key)
 {
@@ -816,6 +1215,8 @@ GSIMapRightSizeMap(GSIMapTable map, uintptr_t capacity)
     }
 }
 
+#endif	/* GSI_MAP_OPEN */
+
 /** Enumerating **/
 
 /* IMPORTANT WARNING: Enumerators have a wonderous property.
@@ -844,6 +1245,13 @@ GSIMapEnumeratorForMap(GSIMapTable map)
   enumerator.map = map;
   enumerator.node = 0;
   enumerator.bucket = 0;
+#if	GSI_MAP_OPEN
+  enumerator.bucket = GSIMapNextUsedBucket(map, 0);
+  if (enumerator.bucket < map->bucketCount)
+    {
+      enumerator.node = map->buckets[enumerator.bucket].firstNode;
+    }
+#else
   /*
    * Locate next bucket and node to be returned.
    */
@@ -873,6 +1281,7 @@ GSIMapEnumeratorForMap(GSIMapTable map)
 	}
       enumerator.bucket++;
     }
+#endif
 
   return enumerator;
 }
@@ -915,6 +1324,33 @@ GSIMapEnumeratorNextNode(GSIMapEnumerator enumerator)
   GSIMapNode	node = ((_GSIE)enumerator)->node;
   GSIMapTable	map = ((_GSIE)enumerator)->map;
 
+#if	GSI_MAP_OPEN
+  if (node != 0)
+    {
+      uintptr_t	bucket = ((_GSIE)enumerator)->bucket;
+
+      /* If the node we were going to return has been zeroed, skip
+       * to the next available one.
+       */
+      if (GSI_MAP_ZEROED(map) && GSI_MAP_READ_KEY(map, &node->key).addr == 0)
+	{
+	  bucket = GSIMapNextUsedBucket(map, bucket);
+	  node = (bucket < map->bucketCount)
+	    ? map->buckets[bucket].firstNode : 0;
+	}
+      if (node != 0)
+	{
+	  bucket = GSIMapNextUsedBucket(map, bucket + 1);
+	  ((_GSIE)enumerator)->node = (bucket < map->bucketCount)
+	    ? map->buckets[bucket].firstNode : 0;
+	}
+      else
+	{
+	  ((_GSIE)enumerator)->node = 0;
+	}
+      ((_GSIE)enumerator)->bucket = bucket;
+    }
+#else
   /* Find the frst available non-zeroed node.
    */
   if (node != 0 && GSI_MAP_ZEROED(map) && GSI_MAP_READ_KEY(map, &node->key).addr == 0)
@@ -979,6 +1415,7 @@ GSIMapEnumeratorNextNode(GSIMapEnumerator enumerator)
 	}
       ((_GSIE)enumerator)->node = next;
     }
+#endif
   return node;
 }
 
@@ -1144,10 +1581,19 @@ GSIMapAddKey(GSIMapTable map, GSIMapKey key)
 static INLINE BOOL
 GSIMapRemoveKey(GSIMapTable map, GSIMapKey key)
 {
+#if	GSI_MAP_OPEN
+  uintptr_t	hash = GSI_MAP_HASH(map, key);
+  GSIMapBucket	bucket;
+  GSIMapNode	node;
+
+  bucket = GSIMapPickBucket(hash, map->buckets, map->bucketCount);
+  node = GSIMapNodeForKeyWithHash(map, bucket, hash, key);
+#else
   GSIMapBucket	bucket = GSIMapBucketForKey(map, key);
   GSIMapNode	node;
   
   node = GSIMapNodeForKeyInBucket(map, bucket, key);
+#endif
   if (node != 0)
     {
       GSIMapRemoveNodeFromMap(map, bucket, node);
@@ -1157,6 +1603,32 @@ GSIMapRemoveKey(GSIMapTable map, GSIMapKey key)
   return NO;
 }
 
+#if	GSI_MAP_OPEN
+static INLINE void
+GSIMapCleanMap(GSIMapTable map)
+{
+  if (map->nodeCount > 0 || map->deletedCount > 0)
+    {
+      GSIMapBucket	bucket = map->buckets;
+      uintptr_t		i;
+
+      map->nodeCount = 0;
+      map->deletedCount = 0;
+      for (i = 0; i < map->bucketCount; i++)
+	{
+	  GSIMapNode	node = bucket->firstNode;
+
+	  bucket->hash = 0;
+	  bucket->firstNode = 0;
+	  if (node != 0)
+	    {
+	      GSIMapFreeNode(map, node);
+	    }
+	  bucket++;
+	}
+    }
+}
+#else
 static INLINE void
 GSIMapCleanMap(GSIMapTable map)
 {
@@ -1201,6 +1673,7 @@ GSIMapCleanMap(GSIMapTable map)
       map->freeNodes = startNode;
     }
 }
+#endif
 
 static INLINE void
 GSIMapEmptyMap(GSIMapTable map)
@@ -1240,6 +1713,9 @@ GSIMapEmptyMap(GSIMapTable map)
       map->nodeChunks = 0;
     }
   map->freeNodes = 0;
+#if	GSI_MAP_OPEN
+  map->deletedCount = 0;
+#endif
   map->zone = 0;
 }
 
@@ -1254,6 +1730,9 @@ GSIMapInitWithZoneAndCapacity(GSIMapTable map, NSZone *zone, uintptr_t capacity)
   map->freeNodes = 0;
   map->chunkCount = 0;
   map->increment = 300000;   // choosen so the chunksize will be less than 4Mb
+#if	GSI_MAP_OPEN
+  map->deletedCount = 0;
+#endif
   GSIMapRightSizeMap(map, capacity);
   GSIMapMoreNodes(map, capacity);
 }
@@ -0,0 +1,147 @@
+/** Interface for incremental JSON reader
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of the GNUstep Base Library.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free
+   Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02111 USA.
+
+   AutogsdocSource: Additions/GSJSONReader.m
+*/
+
+#ifndef __GSJSONReader_h_GNUSTEP_BASE_INCLUDE
+#define __GSJSONReader_h_GNUSTEP_BASE_INCLUDE
+#import <GNUstepBase/GSVersionMacros.h>
+
+#if	OS_API_VERSION(GS_API_NONE,GS_API_LATEST)
+
+#ifdef NeXT_Foundation_LIBRARY
+#import <Foundation/Foundation.h>
+#else
+#import	<Foundation/NSObject.h>
+#endif
+
+#if	defined(__cplusplus)
+extern "C" {
+#endif
+
+@class	NSData;
+@class	NSError;
+@class	NSInputStream;
+@class	NSString;
+
+/**
+ * An event driven (SAX style) reader for JSON text encoded as UTF-8.<br />
+ * Unlike NSJSONSerialization, the reader never builds an object graph;
+ * instead it tells its delegate about each part of the JSON text as it
+ * is found, and the data may be supplied in chunks of any size as it
+ * arrives.  The memory used depends only on the nesting depth of the
+ * JSON and the size of the largest single string or number, so very
+ * large documents can be processed with bounded memory.<br />
+ * The input may contain any number of JSON values one after another
+ * (separated by whitespace), as found in log files which have one JSON
+ * object per line.
+ */
+@interface	GSJSONReader : NSObject
+{
+#if	GS_EXPOSE(GSJSONReader)
+@private
+  id		_delegate;
+  void		*_state;
+#endif
+}
+
+/**
+ * Returns the delegate which is informed of the contents of the JSON.
+ */
+- (id) delegate;
+
+/**
+ * Returns the error which stopped parsing, or nil if there has not
+ * been one.
+ */
+- (NSError*) error;
+
+/**
+ * Returns YES if the data parsed so far ends with a complete JSON value
+ * (ie. the reader is not part way through a value).
+ */
+- (BOOL) isComplete;
+
+/**
+ * Parses a chunk of data, informing the delegate of everything found in
+ * it, and returns YES if the data was valid (so far) or NO if an error
+ * has been found.  Once an error has been found, all further data is
+ * ignored and the method returns NO.<br />
+ * Calling this method with nil or empty data marks the end of the input;
+ * any partial value at that point is an error.
+ */
+- (BOOL) parse: (NSData*)data;
+
+/**
+ * Reads the stream (opening it if necessary) until it ends, passing the
+ * data to -parse: as it is read, then marks the end of input.<br />
+ * Returns YES if the stream contained valid JSON, NO otherwise.
+ */
+- (BOOL) parseStream: (NSInputStream*)stream;
+
+/**
+ * Sets the delegate to which the reader reports what it finds.
+ * The delegate is not retained.
+ */
+- (void) setDelegate: (id)aDelegate;
+@end
+
+/**
+ * Methods implemented by the delegate of a GSJSONReader.  All of these
+ * are optional.
+ */
+@interface	NSObject (GSJSONReaderDelegate)
+/** Called when a JSON array starts (at its '[').
+ */
+- (void) readerDidStartArray: (GSJSONReader*)reader;
+
+/** Called when a JSON array ends (at its ']').
+ */
+- (void) readerDidEndArray: (GSJSONReader*)reader;
+
+/** Called when a JSON object starts (at its '{').
+ */
+- (void) readerDidStartObject: (GSJSONReader*)reader;
+
+/** Called when a JSON object ends (at its '}').
+ */
+- (void) readerDidEndObject: (GSJSONReader*)reader;
+
+/** Called with each key within a JSON object, before its value.
+ */
+- (void) reader: (GSJSONReader*)reader foundKey: (NSString*)key;
+
+/** Called with each string, number, boolean or null value.  These are
+ * represented by NSString, NSNumber and NSNull instances as for the
+ * NSJSONSerialization class, except that numbers with no fractional part
+ * or exponent are represented as integers if they are small enough.
+ */
+- (void) reader: (GSJSONReader*)reader foundValue: (id)value;
+@end
+
+#if	defined(__cplusplus)
+}
+#endif
+
+#endif	/* OS_API_VERSION(GS_API_NONE,GS_API_LATEST) */
+
+#endif	/* __GSJSONReader_h_GNUSTEP_BASE_INCLUDE */
@@ -0,0 +1,778 @@
+/** Implementation for incremental JSON reader
+
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of the GNUstep Base Library.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free
+   Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02111 USA.
+
+   <title>GSJSONReader class reference</title>
+*/
+
+#import "common.h"
+#define	EXPOSE_GSJSONReader_IVARS	1
+#import "Foundation/NSData.h"
+#import "Foundation/NSDictionary.h"
+#import "Foundation/NSError.h"
+#import "Foundation/NSNull.h"
+#import "Foundation/NSStream.h"
+#import "Foundation/NSValue.h"
+#import "GNUstepBase/GSJSONReader.h"
+
+/*
+ * What the reader expects to find next (outside a string, number or
+ * literal token).
+ */
+typedef enum {
+  E_VALUE,		// A value (top level, or after ':').
+  E_VALUE_OR_END,	// A value or ']' (after '[' or ',' in an array).
+  E_KEY_OR_END,		// A key or '}' (after '{' or ',' in an object).
+  E_COLON,		// The ':' after a key.
+  E_COMMA_OR_END	// A ',' or the end of the enclosing container.
+} Expect;
+
+/*
+ * The token (if any) which the reader is part way through.
+ */
+typedef enum {
+  T_NONE,
+  T_STRING,
+  T_NUMBER,
+  T_LITERAL
+} Token;
+
+typedef void (*EventIMP)(id, SEL, GSJSONReader*);
+typedef void (*FoundIMP)(id, SEL, GSJSONReader*, id);
+
+typedef struct {
+  uint8_t		*stack;		// '[' or '{' for each open container.
+  NSUInteger		depth;
+  NSUInteger		stackSize;
+  Expect		expect;
+  Token			token;
+  BOOL			isKey;		// The string being read is a key.
+  BOOL			nonASCII;	// The token buffer has non-ASCII.
+  BOOL			ended;		// End of input has been seen.
+  unsigned		escape;		// 0, 1 after '\', 2-5 in \u digits.
+  unsigned		hex;		// Value of \u digits so far.
+  unsigned		high;		// Unpaired high surrogate in string.
+  unsigned		bom;		// Bytes of UTF-8 BOM seen.
+  uint8_t		*buf;		// Token buffer.
+  NSUInteger		length;
+  NSUInteger		capacity;
+  unsigned long long	offset;		// Bytes parsed before this chunk.
+  NSError		*error;
+  EventIMP		startArray;
+  EventIMP		endArray;
+  EventIMP		startObject;
+  EventIMP		endObject;
+  FoundIMP		foundKey;
+  FoundIMP		foundValue;
+} GSJSONReaderState;
+
+#define	STATE	((GSJSONReaderState*)_state)
+
+static SEL	startArraySel;
+static SEL	endArraySel;
+static SEL	startObjectSel;
+static SEL	endObjectSel;
+static SEL	foundKeySel;
+static SEL	foundValueSel;
+
+/*
+ * Word at a time scanning, as in NSJSONSerialization.m.  hasZero() is
+ * non-zero if any byte in the word is zero.
+ */
+#define	ONES		((uintptr_t)-1 / 0xff)
+#define	HIGHS		(ONES * 0x80)
+#define	hasZero(X)	(((X) - ONES) & ~(X) & HIGHS)
+
+/* Returns a pointer to the first '"' or '\' in the range (or to the end),
+ * noting whether any of the bytes before it are non-ASCII.
+ */
+static inline const uint8_t *
+scanString(const uint8_t *p, const uint8_t *e, BOOL *nonASCII)
+{
+  uintptr_t	high = 0;
+  uintptr_t	w;
+
+  while (e - p >= (ptrdiff_t)sizeof(w))
+    {
+      memcpy(&w, p, sizeof(w));
+      if (hasZero(w ^ (ONES * '"')) || hasZero(w ^ (ONES * '\\')))
+	{
+	  break;
+	}
+      high |= w;
+      p += sizeof(w);
+    }
+  while (p < e && *p != '"' && *p != '\\')
+    {
+      high |= *p++;
+    }
+  if (high & HIGHS)
+    {
+      *nonASCII = YES;
+    }
+  return p;
+}
+
+static void
+append(GSJSONReaderState *s, const uint8_t *bytes, NSUInteger len)
+{
+  if (s->length + len + 1 > s->capacity)
+    {
+      NSUInteger	capacity = (s->capacity == 0) ? 64 : s->capacity * 2;
+
+      while (capacity < s->length + len + 1)
+	{
+	  capacity *= 2;
+	}
+      s->buf = NSZoneRealloc(NSDefaultMallocZone(), s->buf, capacity);
+      s->capacity = capacity;
+    }
+  memcpy(s->buf + s->length, bytes, len);
+  s->length += len;
+}
+
+static void
+appendCharacter(GSJSONReaderState *s, unsigned u)
+{
+  uint8_t	utf[4];
+  NSUInteger	n;
+
+  if (u < 0x80)
+    {
+      utf[0] = u;
+      n = 1;
+    }
+  else if (u < 0x800)
+    {
+      utf[0] = 0xc0 | (u >> 6);
+      utf[1] = 0x80 | (u & 0x3f);
+      n = 2;
+    }
+  else if (u < 0x10000)
+    {
+      utf[0] = 0xe0 | (u >> 12);
+      utf[1] = 0x80 | ((u >> 6) & 0x3f);
+      utf[2] = 0x80 | (u & 0x3f);
+      n = 3;
+    }
+  else
+    {
+      utf[0] = 0xf0 | (u >> 18);
+      utf[1] = 0x80 | ((u >> 12) & 0x3f);
+      utf[2] = 0x80 | ((u >> 6) & 0x3f);
+      utf[3] = 0x80 | (u & 0x3f);
+      n = 4;
+    }
+  if (n > 1)
+    {
+      s->nonASCII = YES;
+    }
+  append(s, utf, n);
+}
+
+/* A high surrogate not followed by a low one is replaced by U+FFFD.
+ */
+static inline void
+flushSurrogate(GSJSONReaderState *s)
+{
+  if (s->high != 0)
+    {
+      s->high = 0;
+      appendCharacter(s, 0xfffd);
+    }
+}
+
+/* Handle the UTF-16 code unit from a \u escape.
+ */
+static void
+appendCodeUnit(GSJSONReaderState *s, unsigned u)
+{
+  if (u >= 0xd800 && u < 0xdc00)
+    {
+      flushSurrogate(s);
+      s->high = u;
+    }
+  else if (u >= 0xdc00 && u < 0xe000)
+    {
+      if (s->high != 0)
+	{
+	  u = 0x10000 + ((s->high - 0xd800) << 10) + (u - 0xdc00);
+	  s->high = 0;
+	  appendCharacter(s, u);
+	}
+      else
+	{
+	  appendCharacter(s, 0xfffd);
+	}
+    }
+  else
+    {
+      flushSurrogate(s);
+      appendCharacter(s, u);
+    }
+}
+
+@implementation	GSJSONReader
+
++ (void) initialize
+{
+  if (self == [GSJSONReader class])
+    {
+      startArraySel = @selector(readerDidStartArray:);
+      endArraySel = @selector(readerDidEndArray:);
+      startObjectSel = @selector(readerDidStartObject:);
+      endObjectSel = @selector(readerDidEndObject:);
+      foundKeySel = @selector(reader:foundKey:);
+      foundValueSel = @selector(reader:foundValue:);
+    }
+}
+
+- (void) dealloc
+{
+  if (_state != 0)
+    {
+      if (STATE->stack != 0)
+	{
+	  NSZoneFree(NSDefaultMallocZone(), STATE->stack);
+	}
+      if (STATE->buf != 0)
+	{
+	  NSZoneFree(NSDefaultMallocZone(), STATE->buf);
+	}
+      RELEASE(STATE->error);
+      NSZoneFree(NSDefaultMallocZone(), _state);
+    }
+  [super dealloc];
+}
+
+- (id) delegate
+{
+  return _delegate;
+}
+
+- (NSError*) error
+{
+  return STATE->error;
+}
+
+- (id) init
+{
+  if (nil != (self = [super init]))
+    {
+      _state = NSZoneCalloc(NSDefaultMallocZone(), 1,
+	sizeof(GSJSONReaderState));
+    }
+  return self;
+}
+
+- (BOOL) isComplete
+{
+  return (STATE->token == T_NONE && STATE->depth == 0) ? YES : NO;
+}
+
+- (void) _fail: (NSString*)reason at: (const uint8_t*)p from: (const uint8_t*)b
+{
+  GSJSONReaderState	*s = STATE;
+  NSDictionary		*userInfo;
+
+  if (nil != s->error)
+    {
+      return;
+    }
+  if (nil == reason)
+    {
+      reason = [NSString stringWithFormat:
+	@"Unexpected character %c at index %llu",
+	(char)*p, s->offset + (p - b)];
+    }
+  userInfo = [[NSDictionary alloc] initWithObjectsAndKeys:
+    _(@"JSON Parse error"), NSLocalizedDescriptionKey,
+    reason, NSLocalizedFailureReasonErrorKey,
+    nil];
+  s->error = [[NSError alloc] initWithDomain: NSCocoaErrorDomain
+					code: 0
+				    userInfo: userInfo];
+  [userInfo release];
+}
+
+/* Called when a complete value (or container) has been read.
+ */
+static inline void
+valueDone(GSJSONReaderState *s)
+{
+  s->expect = (s->depth == 0) ? E_VALUE : E_COMMA_OR_END;
+}
+
+- (void) _push: (uint8_t)type
+{
+  GSJSONReaderState	*s = STATE;
+
+  if (s->depth >= s->stackSize)
+    {
+      s->stackSize = (s->stackSize == 0) ? 32 : s->stackSize * 2;
+      s->stack = NSZoneRealloc(NSDefaultMallocZone(), s->stack,
+	s->stackSize);
+    }
+  s->stack[s->depth++] = type;
+  if ('[' == type)
+    {
+      s->expect = E_VALUE_OR_END;
+      if (s->startArray != 0)
+	{
+	  (*s->startArray)(_delegate, startArraySel, self);
+	}
+    }
+  else
+    {
+      s->expect = E_KEY_OR_END;
+      if (s->startObject != 0)
+	{
+	  (*s->startObject)(_delegate, startObjectSel, self);
+	}
+    }
+}
+
+- (void) _pop
+{
+  GSJSONReaderState	*s = STATE;
+
+  if ('[' == s->stack[--s->depth])
+    {
+      if (s->endArray != 0)
+	{
+	  (*s->endArray)(_delegate, endArraySel, self);
+	}
+    }
+  else
+    {
+      if (s->endObject != 0)
+	{
+	  (*s->endObject)(_delegate, endObjectSel, self);
+	}
+    }
+  valueDone(s);
+}
+
+/* Make a string from the bytes and pass it to the delegate as a key or
+ * a value.
+ */
+- (BOOL) _string: (const uint8_t*)bytes length: (NSUInteger)length
+{
+  GSJSONReaderState	*s = STATE;
+  FoundIMP		imp = s->isKey ? s->foundKey : s->foundValue;
+
+  if (imp != 0)
+    {
+      NSString	*str;
+
+      str = [[NSString alloc] initWithBytes: bytes
+				     length: length
+				   encoding: s->nonASCII
+	? NSUTF8StringEncoding : NSASCIIStringEncoding];
+      if (nil == str)
+	{
+	  return NO;
+	}
+      (*imp)(_delegate, s->isKey ? foundKeySel : foundValueSel, self, str);
+      [str release];
+    }
+  s->token = T_NONE;
+  s->length = 0;
+  s->nonASCII = NO;
+  if (YES == s->isKey)
+    {
+      s->expect = E_COLON;
+    }
+  else
+    {
+      valueDone(s);
+    }
+  return YES;
+}
+
+/* Finish a number or literal token.
+ */
+- (BOOL) _scalar
+{
+  GSJSONReaderState	*s = STATE;
+  const char		*b = (const char*)s->buf;
+  id			value = nil;
+
+  s->buf[s->length] = '\0';
+  if (T_LITERAL == s->token)
+    {
+      if (strcmp(b, "true") == 0)
+	value = [NSNumber numberWithBool: YES];
+      else if (strcmp(b, "false") == 0)
+	value = [NSNumber numberWithBool: NO];
+      else if (strcmp(b, "null") == 0)
+	value = [NSNull null];
+    }
+  else if (('-' == b[0] && isdigit(b[1])) || isdigit(b[0]))
+    {
+      char	*end;
+
+      if (strpbrk(b, ".eE") == 0)
+	{
+	  long long	ll;
+
+	  errno = 0;
+	  ll = strtoll(b, &end, 10);
+	  if ('\0' == *end && 0 == errno)
+	    {
+	      value = [NSNumber numberWithLongLong: ll];
+	    }
+	}
+      if (nil == value)
+	{
+	  double	d = strtod(b, &end);
+
+	  if ('\0' == *end)
+	    {
+	      value = [NSNumber numberWithDouble: d];
+	    }
+	}
+    }
+  if (nil == value)
+    {
+      return NO;
+    }
+  if (s->foundValue != 0)
+    {
+      (*s->foundValue)(_delegate, foundValueSel, self, value);
+    }
+  s->token = T_NONE;
+  s->length = 0;
+  valueDone(s);
+  return YES;
+}
+
+/* Read (part of) a string, returning a pointer to the first byte after
+ * what has been consumed, or 0 on error.
+ */
+- (const uint8_t*) _readString: (const uint8_t*)p
+			    to: (const uint8_t*)e
+			  from: (const uint8_t*)b
+{
+  GSJSONReaderState	*s = STATE;
+
+  while (p < e)
+    {
+      if (0 == s->escape)
+	{
+	  const uint8_t	*run = p;
+
+	  p = scanString(p, e, &s->nonASCII);
+	  if (p < e && '"' == *p && 0 == s->length && 0 == s->high)
+	    {
+	      // The whole string is in this chunk; no need to copy it.
+	      if (NO == [self _string: run length: p - run])
+		{
+		  [self _fail: @"Invalid UTF-8 in string" at: p from: b];
+		  return 0;
+		}
+	      return p + 1;
+	    }
+	  if (p > run)
+	    {
+	      flushSurrogate(s);
+	      append(s, run, p - run);
+	    }
+	  if (p == e)
+	    {
+	      break;
+	    }
+	  if ('"' == *p)
+	    {
+	      flushSurrogate(s);
+	      if (NO == [self _string: s->buf length: s->length])
+		{
+		  [self _fail: @"Invalid UTF-8 in string" at: p from: b];
+		  return 0;
+		}
+	      return p + 1;
+	    }
+	  s->escape = 1;	// Backslash
+	  p++;
+	}
+      else if (1 == s->escape)
+	{
+	  uint8_t	c = *p++;
+
+	  s->escape = 0;
+	  switch (c)
+	    {
+	      case 'b': c = '\b'; break;
+	      case 'f': c = '\f'; break;
+	      case 'n': c = '\n'; break;
+	      case 'r': c = '\r'; break;
+	      case 't': c = '\t'; break;
+	      case 'u': s->escape = 2; s->hex = 0; continue;
+	      default: if (c & 0x80) s->nonASCII = YES; break;
+	    }
+	  flushSurrogate(s);
+	  append(s, &c, 1);
+	}
+      else
+	{
+	  uint8_t	c = *p;
+
+	  if (c >= '0' && c <= '9')
+	    s->hex = (s->hex << 4) | (c - '0');
+	  else if (c >= 'a' && c <= 'f')
+	    s->hex = (s->hex << 4) | (c - 'a' + 10);
+	  else if (c >= 'A' && c <= 'F')
+	    s->hex = (s->hex << 4) | (c - 'A' + 10);
+	  else
+	    {
+	      [self _fail: nil at: p from: b];
+	      return 0;
+	    }
+	  p++;
+	  if (++s->escape == 6)
+	    {
+	      s->escape = 0;
+	      appendCodeUnit(s, s->hex);
+	    }
+	}
+    }
+  return p;
+}
+
+static inline BOOL
+isNumberByte(uint8_t c)
+{
+  return (isdigit(c) || '-' == c || '+' == c || '.' == c
+    || 'e' == c || 'E' == c) ? YES : NO;
+}
+
+- (BOOL) _parseBytes: (const uint8_t*)b length: (NSUInteger)length
+{
+  GSJSONReaderState	*s = STATE;
+  const uint8_t		*p = b;
+  const uint8_t		*e = b + length;
+
+  while (p < e)
+    {
+      uint8_t	c;
+
+      if (T_STRING == s->token)
+	{
+	  if (0 == (p = [self _readString: p to: e from: b]))
+	    {
+	      return NO;
+	    }
+	  continue;
+	}
+      c = *p;
+      if (T_NUMBER == s->token || T_LITERAL == s->token)
+	{
+	  if ((T_NUMBER == s->token) ? isNumberByte(c) : islower(c))
+	    {
+	      append(s, p++, 1);
+	      continue;
+	    }
+	  if (NO == [self _scalar])
+	    {
+	      [self _fail: nil at: p from: b];
+	      return NO;
+	    }
+	}
+      if (' ' == c || '\n' == c || '\r' == c || '\t' == c)
+	{
+	  p++;
+	  continue;
+	}
+      if (s->offset + (p - b) < 3 && s->bom == s->offset + (p - b)
+	&& c == "\xef\xbb\xbf"[s->bom])
+	{
+	  s->bom++;	// Skip byte order mark
+	  p++;
+	  continue;
+	}
+      switch (s->expect)
+	{
+	  case E_VALUE_OR_END:
+	    if (']' == c)
+	      {
+		[self _pop];
+		break;
+	      }
+	    /* Fall through */
+	  case E_VALUE:
+	    if ('"' == c)
+	      {
+		s->token = T_STRING;
+		s->isKey = NO;
+	      }
+	    else if ('[' == c || '{' == c)
+	      {
+		[self _push: c];
+	      }
+	    else if ('-' == c || isdigit(c))
+	      {
+		s->token = T_NUMBER;
+		append(s, p, 1);
+	      }
+	    else if (islower(c))
+	      {
+		s->token = T_LITERAL;
+		append(s, p, 1);
+	      }
+	    else
+	      {
+		[self _fail: nil at: p from: b];
+		return NO;
+	      }
+	    break;
+
+	  case E_KEY_OR_END:
+	    if ('"' == c)
+	      {
+		s->token = T_STRING;
+		s->isKey = YES;
+	      }
+	    else if ('}' == c)
+	      {
+		[self _pop];
+	      }
+	    else
+	      {
+		[self _fail: nil at: p from: b];
+		return NO;
+	      }
+	    break;
+
+	  case E_COLON:
+	    if (':' != c)
+	      {
+		[self _fail: nil at: p from: b];
+		return NO;
+	      }
+	    s->expect = E_VALUE;
+	    break;
+
+	  case E_COMMA_OR_END:
+	    if (',' == c)
+	      {
+		s->expect = ('[' == s->stack[s->depth - 1])
+		  ? E_VALUE_OR_END : E_KEY_OR_END;
+	      }
+	    else if ((']' == c && '[' == s->stack[s->depth - 1])
+	      || ('}' == c && '{' == s->stack[s->depth - 1]))
+	      {
+		[self _pop];
+	      }
+	    else
+	      {
+		[self _fail: nil at: p from: b];
+		return NO;
+	      }
+	    break;
+	}
+      p++;
+    }
+  s->offset += length;
+  return YES;
+}
+
+- (BOOL) parse: (NSData*)data
+{
+  GSJSONReaderState	*s = STATE;
+  NSUInteger		length = [data length];
+
+  if (nil != s->error || YES == s->ended)
+    {
+      return NO;
+    }
+  if (length > 0)
+    {
+      return [self _parseBytes: [data bytes] length: length];
+    }
+
+  /* End of input ... a number or literal may be ended by it, but
+   * anything else incomplete is an error.
+   */
+  s->ended = YES;
+  if ((T_NUMBER == s->token || T_LITERAL == s->token) && NO == [self _scalar])
+    {
+      [self _fail: @"Invalid number or literal at end of data"
+	       at: 0
+	     from: 0];
+      return NO;
+    }
+  if (NO == [self isComplete])
+    {
+      [self _fail: @"Unexpected end of data" at: 0 from: 0];
+      return NO;
+    }
+  return YES;
+}
+
+- (BOOL) parseStream: (NSInputStream*)stream
+{
+  uint8_t	buf[16384];
+  NSInteger	length;
+
+  if ([stream streamStatus] == NSStreamStatusNotOpen)
+    {
+      [stream open];
+    }
+  while ((length = [stream read: buf maxLength: sizeof(buf)]) > 0)
+    {
+      if (nil != STATE->error
+	|| NO == [self _parseBytes: buf length: (NSUInteger)length])
+	{
+	  return NO;
+	}
+    }
+  if (length < 0)
+    {
+      if (nil == STATE->error)
+	{
+	  STATE->error = RETAIN([stream streamError]);
+	}
+      if (nil == STATE->error)
+	{
+	  [self _fail: @"Unable to read from stream" at: 0 from: 0];
+	}
+      return NO;
+    }
+  return [self parse: nil];
+}
+
+- (void) setDelegate: (id)aDelegate
+{
+  GSJSONReaderState	*s = STATE;
+
+  _delegate = aDelegate;
+#define	LOOKUP(field, sel, type) \
+  s->field = [_delegate respondsToSelector: sel] \
+    ? (type)[_delegate methodForSelector: sel] : 0
+  LOOKUP(startArray, startArraySel, EventIMP);
+  LOOKUP(endArray, endArraySel, EventIMP);
+  LOOKUP(startObject, startObjectSel, EventIMP);
+  LOOKUP(endObject, endObjectSel, EventIMP);
+  LOOKUP(foundKey, foundKeySel, FoundIMP);
+  LOOKUP(foundValue, foundValueSel, FoundIMP);
+#undef	LOOKUP
+}
+
+@end
@@ -572,6 +572,9 @@ GSObjCAddMethods(Class cls, Method *list, BOOL replace)
           BDBGPrintf("    skipped %c%s\n", c, sel_getName(n));
 	}
     }
+#if	defined(GNUSTEP_BASE_LIBRARY)
+  GSPrivateKVCCacheFlush();
+#endif
 }
 
 GSMethod
@@ -49,6 +49,16 @@
 #include <stdio.h>
 #include <string.h>
 
+#if	defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if	defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if	defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #if HAVE_LANGINFO_CODESET
 #include <langinfo.h>
 #endif
@@ -770,6 +780,157 @@ GSUnicode(const unichar *chars, unsigned length,
   return i;
 }
 
+/* Vectorised helpers for the common case of text which is mostly (or
+ * entirely) ASCII.  Each processes a block of characters at a time using
+ * SSE2 (AVX2 if the compiler is targetting it) or NEON where available,
+ * and finishes with a simple loop for the remainder or when a non-ASCII
+ * character is found.
+ */
+NSUInteger
+GSPrivateASCIILength(const uint8_t *p, NSUInteger l)
+{
+  NSUInteger	i = 0;
+
+#if	defined(__AVX2__)
+  while (i + 32 <= l)
+    {
+      __m256i	v = _mm256_loadu_si256((const __m256i*)(p + i));
+      unsigned	m = (unsigned)_mm256_movemask_epi8(v);
+
+      if (m != 0)
+	{
+	  return i + __builtin_ctz(m);
+	}
+      i += 32;
+    }
+#endif
+#if	defined(__SSE2__)
+  while (i + 16 <= l)
+    {
+      __m128i	v = _mm_loadu_si128((const __m128i*)(p + i));
+      unsigned	m = (unsigned)_mm_movemask_epi8(v);
+
+      if (m != 0)
+	{
+	  return i + __builtin_ctz(m);
+	}
+      i += 16;
+    }
+#elif	defined(__aarch64__) && defined(__ARM_NEON)
+  while (i + 16 <= l)
+    {
+      if (vmaxvq_u8(vld1q_u8(p + i)) >= 0x80)
+	{
+	  break;
+	}
+      i += 16;
+    }
+#else
+  while (i + sizeof(uint64_t) <= l)
+    {
+      uint64_t	w;
+
+      memcpy(&w, p + i, sizeof(w));
+      if (w & 0x8080808080808080ULL)
+	{
+	  break;
+	}
+      i += sizeof(w);
+    }
+#endif
+  while (i < l && p[i] < 0x80)
+    {
+      i++;
+    }
+  return i;
+}
+
+NSUInteger
+GSPrivateWidenASCII(unichar *d, const uint8_t *s, NSUInteger l)
+{
+  NSUInteger	i = 0;
+
+#if	defined(__SSE2__)
+  const __m128i	zero = _mm_setzero_si128();
+
+  while (i + 16 <= l)
+    {
+      __m128i	v = _mm_loadu_si128((const __m128i*)(s + i));
+
+      if (_mm_movemask_epi8(v) != 0)
+	{
+	  break;
+	}
+      _mm_storeu_si128((__m128i*)(d + i), _mm_unpacklo_epi8(v, zero));
+      _mm_storeu_si128((__m128i*)(d + i + 8), _mm_unpackhi_epi8(v, zero));
+      i += 16;
+    }
+#elif	defined(__aarch64__) && defined(__ARM_NEON)
+  while (i + 16 <= l)
+    {
+      uint8x16_t	v = vld1q_u8(s + i);
+
+      if (vmaxvq_u8(v) >= 0x80)
+	{
+	  break;
+	}
+      vst1q_u16(d + i, vmovl_u8(vget_low_u8(v)));
+      vst1q_u16(d + i + 8, vmovl_high_u8(v));
+      i += 16;
+    }
+#endif
+  while (i < l && s[i] < 0x80)
+    {
+      d[i] = s[i];
+      i++;
+    }
+  return i;
+}
+
+NSUInteger
+GSPrivateNarrowASCII(uint8_t *d, const unichar *s, NSUInteger l)
+{
+  NSUInteger	i = 0;
+
+#if	defined(__SSE2__)
+  const __m128i	zero = _mm_setzero_si128();
+  const __m128i	high = _mm_set1_epi16((short)0xff80);
+
+  while (i + 16 <= l)
+    {
+      __m128i	a = _mm_loadu_si128((const __m128i*)(s + i));
+      __m128i	b = _mm_loadu_si128((const __m128i*)(s + i + 8));
+      __m128i	h = _mm_and_si128(_mm_or_si128(a, b), high);
+
+      if (_mm_movemask_epi8(_mm_cmpeq_epi16(h, zero)) != 0xffff)
+	{
+	  break;
+	}
+      _mm_storeu_si128((__m128i*)(d + i), _mm_packus_epi16(a, b));
+      i += 16;
+    }
+#elif	defined(__aarch64__) && defined(__ARM_NEON)
+  while (i + 16 <= l)
+    {
+      uint16x8_t	a = vld1q_u16(s + i);
+      uint16x8_t	b = vld1q_u16(s + i + 8);
+
+      if (vmaxvq_u16(vorrq_u16(a, b)) >= 0x80)
+	{
+	  break;
+	}
+      vst1q_u8(d + i, vcombine_u8(vmovn_u16(a), vmovn_u16(b)));
+      i += 16;
+    }
+#endif
+  while (i < l && s[i] < 0x80)
+    {
+      d[i] = (uint8_t)s[i];
+      i++;
+    }
+  return i;
+}
+
 #if	GS_WITH_GC
 
 #define	GROW() \
@@ -984,7 +1145,28 @@ GSToUnicode(unichar **dst, unsigned int *size, const unsigned char *src,
 	      unsigned char	c = src[spos];
 	      unsigned long	u = c;
 
-	      if (c > 0x7f)
+	      if (c < 0x80)
+		{
+		  unsigned	n;
+
+		  /* Copy a run of ASCII characters in one go, as far as
+		   * the space left in the destination buffer allows.
+		   */
+		  if (dpos >= bsize)
+		    {
+		      GROW();
+		    }
+		  n = slen - spos;
+		  if (n > bsize - dpos)
+		    {
+		      n = bsize - dpos;
+		    }
+		  n = GSPrivateWidenASCII(ptr + dpos, src + spos, n);
+		  spos += n;
+		  dpos += n;
+		  continue;
+		}
+	      else
                 {
                   int i, sle = 0;
 
@@ -1040,10 +1222,6 @@ GSToUnicode(unichar **dst, unsigned int *size, const unsigned char *src,
 		      goto done;
 		    }
                 }
-              else
-		{
-		  spos++;
-		}
 
 	      /*
 	       * Add codepoint as either a single unichar for BMP
@@ -1128,16 +1306,12 @@ GSToUnicode(unichar **dst, unsigned int *size, const unsigned char *src,
 		    bsize = grow / sizeof(unichar);
 		  }
 	      }
-	    while (spos < slen)
+	    spos = GSPrivateWidenASCII(ptr + dpos, src, slen);
+	    dpos += spos;
+	    if (spos < slen)
 	      {
-		unichar	c = (unichar)((unc)src[spos++]);
-
-		if (c > 127)
-		  {
-		    result = NO;	// Non-ascii data found in input.
-		    goto done;
-		  }
-		ptr[dpos++] = c;
+		result = NO;	// Non-ascii data found in input.
+		goto done;
 	      }
 	  }
 	break;
@@ -1912,20 +2086,31 @@ GSFromUnicode(unsigned char **dst, unsigned int *size, const unichar *src,
 		  int		i;
 
 		  /* get first unichar */
-		  u1 = src[spos++];
+		  u1 = src[spos];
 
 		  /* Fast track ... if this is actually an ascii character
-		   * it just converts straight to utf-8
+		   * it just converts straight to utf-8, and so does any
+		   * run of ascii following it.
 		   */
 		  if (u1 <= 0x7f)
 		    {
+		      unsigned	n;
+
 		      if (dpos >= bsize)
 			{
 			  GROW();
 			}
-		      ptr[dpos++] = (unsigned char)u1;
+		      n = slen - spos;
+		      if (n > bsize - dpos)
+			{
+			  n = bsize - dpos;
+			}
+		      n = GSPrivateNarrowASCII(ptr + dpos, src + spos, n);
+		      spos += n;
+		      dpos += n;
 		      continue;
 		    }
+		  spos++;
 
 		  // 0xfeff is a zero-width-no-break-space inside text
 		  if (u1 == 0xfffe			// unexpected BOM
@@ -794,78 +794,19 @@ static Class	GSInlineArrayClass;
 - (void) sortUsingFunction: (NSComparisonResult(*)(id,id,void*))compare
 		   context: (void*)context
 {
-  /* Shell sort algorithm taken from SortingInAction - a NeXT example */
-#define STRIDE_FACTOR 3	// good value for stride factor is not well-understood
-                        // 3 is a fairly good choice (Sedgewick)
-  NSUInteger	c;
-  NSUInteger	d;
-  NSUInteger	stride = 1;
-  BOOL		found;
-  NSUInteger	count = _count;
-#ifdef	GSWARN
-  BOOL		badComparison = NO;
-#endif
-
   _version++;
-  while (stride <= count)
-    {
-      stride = stride * STRIDE_FACTOR + 1;
-    }
-
-  while (stride > (STRIDE_FACTOR - 1))
-    {
-      // loop to sort for each value of stride
-      stride = stride / STRIDE_FACTOR;
-      for (c = stride; c < count; c++)
-	{
-	  found = NO;
-	  if (stride > c)
-	    {
-	      break;
-	    }
-	  d = c - stride;
-	  while (!found)	/* move to left until correct place */
-	    {
-	      id			a = _contents_array[d + stride];
-	      id			b = _contents_array[d];
-	      NSComparisonResult	r;
-
-	      r = (*compare)(a, b, context);
-	      if (r < 0)
-		{
-#ifdef	GSWARN
-		  if (r != NSOrderedAscending)
-		    {
-		      badComparison = YES;
-		    }
-#endif
-		  _contents_array[d+stride] = b;
-		  _contents_array[d] = a;
-		  if (stride > d)
-		    {
-		      break;
-		    }
-		  d -= stride;		// jump by stride factor
-		}
-	      else
-		{
-#ifdef	GSWARN
-		  if (r != NSOrderedDescending && r != NSOrderedSame)
-		    {
-		      badComparison = YES;
-		    }
-#endif
-		  found = YES;
-		}
-	    }
-	}
-    }
-#ifdef	GSWARN
-  if (badComparison == YES)
+  if (_count > 1)
     {
-      NSWarnMLog(@"Detected bad return value from comparison");
+      /* Sort a copy of the contents so that, if the comparison raises an
+       * exception, the array still holds each of its objects once.
+       */
+      GS_BEGINIDBUF(objects, _count);
+
+      memcpy(objects, _contents_array, _count * sizeof(id));
+      GSPrivateSort(objects, _count, compare, context);
+      memcpy(_contents_array, objects, _count * sizeof(id));
+      GS_ENDIDBUF();
     }
-#endif
   _version++;
 }
 
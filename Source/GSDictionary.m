@@ -38,6 +38,7 @@
  *	The 'Fastmap' stuff provides an inline implementation of a mapping
  *	table - for maximum performance.
  */
+#define	GSI_MAP_OPEN		1
 #define	GSI_MAP_KTYPES		GSUNION_OBJ
 #define	GSI_MAP_VTYPES		GSUNION_OBJ
 #define	GSI_MAP_HASH(M, X)		[X.obj hash]
@@ -69,6 +69,11 @@
 #include <sys/filio.h>
 #endif
 #include <netdb.h>
+#include <sys/uio.h>
+
+#if	defined(__linux__)
+#include <sys/sendfile.h>
+#endif
 
 #include <string.h>
 
@@ -97,6 +102,15 @@
 #define	NETBUF_SIZE	4096
 #define	READ_SIZE	NETBUF_SIZE*10
 
+// Largest read done for a background read, as the data read grows.
+#define	READ_MAX	(1024*1024*4)
+
+// Largest amount passed to a single system call.
+#define	IO_MAX		(1024*1024*1024)
+
+// Most buffers gathered for a single writev() call.
+#define	WRITEVECS	16
+
 static GSFileHandle*	fh_stdin = nil;
 static GSFileHandle*	fh_stdout = nil;
 static GSFileHandle*	fh_stderr = nil;
@@ -105,12 +119,27 @@ static GSFileHandle*	fh_stderr = nil;
 static NSString*	NotificationKey = @"NSFileHandleNotificationKey";
 
 @interface GSFileHandle(private)
+- (NSMutableData*) _readLength: (NSUInteger)max expect: (NSUInteger)expect;
+- (NSUInteger) _remainingLength;
+- (BOOL) _usesSystemIO;
 - (void) receivedEventRead;
 - (void) receivedEventWrite;
 @end
 
 @implementation GSFileHandle
 
+static IMP	systemRead = 0;
+static IMP	systemWrite = 0;
+
++ (void) initialize
+{
+  if (self == [GSFileHandle class])
+    {
+      systemRead = [self instanceMethodForSelector: @selector(read:length:)];
+      systemWrite = [self instanceMethodForSelector: @selector(write:length:)];
+    }
+}
+
 /**
  * Encapsulates low level read operation to get data from the operating
  * system.
@@ -171,6 +200,120 @@ static NSString*	NotificationKey = @"NSFileHandleNotificationKey";
   return result;
 }
 
+/* Reads into a buffer until end of file, or until max bytes have been
+ * read if max is not zero.  The buffer starts at the size we expect to
+ * need (if known) and doubles each time it fills, so large amounts of
+ * data are read with few system calls and the data is not repeatedly
+ * copied into a growing data object.
+ * Returns nil if a read fails.
+ */
+- (NSMutableData*) _readLength: (NSUInteger)max expect: (NSUInteger)expect
+{
+  NSZone	*z = NSDefaultMallocZone();
+  NSUInteger	cap;
+  NSUInteger	len = 0;
+  NSInteger	got = 0;
+  uint8_t	*buf;
+
+  /* If we know how much there is to read, allow an extra byte so that
+   * the read which finds the end of file does not need a bigger buffer.
+   */
+  cap = (expect > 0) ? expect + 1 : READ_SIZE;
+  if (max > 0 && cap > max)
+    {
+      cap = max;
+    }
+  buf = NSZoneMalloc(z, cap);
+  for (;;)
+    {
+      NSUInteger	want;
+
+      if (len == cap)
+	{
+	  if (max > 0 && len == max)
+	    {
+	      break;
+	    }
+	  cap *= 2;
+	  if (max > 0 && cap > max)
+	    {
+	      cap = max;
+	    }
+	  buf = NSZoneRealloc(z, buf, cap);
+	}
+      want = cap - len;
+      if (want > IO_MAX)
+	{
+	  want = IO_MAX;
+	}
+      got = [self read: buf + len length: want];
+      if (got <= 0)
+	{
+	  break;
+	}
+      len += got;
+    }
+  if (got < 0)
+    {
+      NSZoneFree(z, buf);
+      return nil;
+    }
+  if (len < cap)
+    {
+      buf = NSZoneRealloc(z, buf, len > 0 ? len : 1);
+    }
+  return AUTORELEASE([[NSMutableData alloc] initWithBytesNoCopy: buf
+							 length: len]);
+}
+
+/* Returns the number of bytes between the current position and the end
+ * of a regular file, or zero if that is not known.
+ */
+- (NSUInteger) _remainingLength
+{
+  struct stat	sbuf;
+  off_t		pos;
+
+#if	USE_ZLIB
+  if (gzDescriptor != 0)
+    {
+      return 0;
+    }
+#endif
+  if (isStandardFile == NO || fstat(descriptor, &sbuf) < 0)
+    {
+      return 0;
+    }
+  pos = lseek(descriptor, 0, SEEK_CUR);
+  if (pos < 0 || sbuf.st_size <= pos
+    || (unsigned long long)(sbuf.st_size - pos) > NSUIntegerMax / 2)
+    {
+      return 0;
+    }
+  return (NSUInteger)(sbuf.st_size - pos);
+}
+
+/* Returns YES if data is transferred by -read:length: and -write:length:
+ * as implemented in this class, so it is safe to use other system calls
+ * on the descriptor.  Subclasses (eg for SSL) and compressed handles
+ * must have all their data go through those methods.
+ */
+- (BOOL) _usesSystemIO
+{
+#if	USE_ZLIB
+  if (gzDescriptor != 0)
+    {
+      return NO;
+    }
+#endif
+  if ([self methodForSelector: @selector(read:length:)] != systemRead
+    || [self methodForSelector: @selector(write:length:)] != systemWrite)
+    {
+      return NO;
+    }
+  return YES;
+}
+
 + (id) allocWithZone: (NSZone*)z
 {
   return NSAllocateObject ([self class], 0, z);
@@ -1214,20 +1357,18 @@ NSString * const GSSOCKSRecvAddr = @"GSSOCKSRecvAddr";
   int			len;
 
   [self checkRead];
-  d = [NSMutableData dataWithCapacity: 0];
   if (isStandardFile)
     {
       if (isNonBlocking == YES)
 	{
 	  [self setNonBlocking: NO];
 	}
-      while ((len = [self read: buf length: sizeof(buf)]) > 0)
-        {
-	  [d appendBytes: buf length: len];
-        }
+      d = [self _readLength: 0 expect: [self _remainingLength]];
+      len = (d == nil) ? -1 : 0;
     }
   else
     {
+      d = [NSMutableData dataWithCapacity: 0];
       if (isNonBlocking == NO)
 	{
 	  [self setNonBlocking: YES];
@@ -1278,21 +1419,15 @@ NSString * const GSSOCKSRecvAddr = @"GSSOCKSRecvAddr";
 
 - (NSData*) readDataToEndOfFile
 {
-  char			buf[READ_SIZE];
   NSMutableData*	d;
-  int			len;
 
   [self checkRead];
   if (isNonBlocking == YES)
     {
       [self setNonBlocking: NO];
     }
-  d = [NSMutableData dataWithCapacity: 0];
-  while ((len = [self read: buf length: sizeof(buf)]) > 0)
-    {
-      [d appendBytes: buf length: len];
-    }
-  if (len < 0)
+  d = [self _readLength: 0 expect: [self _remainingLength]];
+  if (d == nil)
     {
       [NSException raise: NSFileHandleOperationException
                   format: @"unable to read from descriptor - %@",
@@ -1304,35 +1439,37 @@ NSString * const GSSOCKSRecvAddr = @"GSSOCKSRecvAddr";
 - (NSData*) readDataOfLength: (unsigned)len
 {
   NSMutableData	*d;
-  int		got;
-  char		buf[READ_SIZE];
+  NSUInteger	expect;
 
   [self checkRead];
   if (isNonBlocking == YES)
     {
       [self setNonBlocking: NO];
     }
-
-  d = [NSMutableData dataWithCapacity: len < READ_SIZE ? len : READ_SIZE];
-  do
+  if (len == 0)
     {
-      int	chunk = len > sizeof(buf) ? sizeof(buf) : len;
-
-      got = [self read: buf length: chunk];
-      if (got > 0)
-	{
-	  [d appendBytes: buf length: got];
-	  len -= got;
-	}
-      else if (got < 0)
-	{
-	  [NSException raise: NSFileHandleOperationException
-		      format: @"unable to read from descriptor - %@",
-		      [NSError _last]];
-	}
+      return [NSMutableData dataWithCapacity: 0];
     }
-  while (len > 0 && got > 0);
 
+  /* For a regular file we know how much we can read, otherwise start
+   * with a moderate buffer and let it grow if there is more data.
+   */
+  expect = [self _remainingLength];
+  if (expect > len)
+    {
+      expect = len;
+    }
+  else if (expect == 0)
+    {
+      expect = (len < READ_SIZE) ? len : READ_SIZE;
+    }
+  d = [self _readLength: len expect: expect];
+  if (d == nil)
+    {
+      [NSException raise: NSFileHandleOperationException
+		  format: @"unable to read from descriptor - %@",
+		  [NSError _last]];
+    }
   return d;
 }
 
@@ -1340,8 +1477,8 @@ NSString * const GSSOCKSRecvAddr = @"GSSOCKSRecvAddr";
 {
   int		rval = 0;
   const void*	ptr = [item bytes];
-  unsigned int	len = [item length];
-  unsigned int	pos = 0;
+  NSUInteger	len = [item length];
+  NSUInteger	pos = 0;
 
   [self checkWrite];
   if (isNonBlocking == YES)
@@ -1350,11 +1487,14 @@ NSString * const GSSOCKSRecvAddr = @"GSSOCKSRecvAddr";
     }
   while (pos < len)
     {
-      int	toWrite = len - pos;
+      NSUInteger	toWrite = len - pos;
 
-      if (toWrite > NETBUF_SIZE)
+      /* Write as much as possible at once ... the system will write as
+       * much as it can and tell us how much that was.
+       */
+      if (toWrite > IO_MAX)
 	{
-	  toWrite = NETBUF_SIZE;
+	  toWrite = IO_MAX;
 	}
       rval = [self write: (char*)ptr+pos length: toWrite];
       if (rval < 0)
@@ -1899,28 +2039,55 @@ NSString * const GSSOCKSRecvAddr = @"GSSOCKSRecvAddr";
   else
     {
       NSMutableData	*item;
-      int		length;
-      int		received = 0;
-      char		buf[READ_SIZE];
+      NSUInteger	have;
+      NSUInteger	length;
+      NSInteger		received = 0;
 
       item = [readInfo objectForKey: NSFileHandleNotificationDataItem];
+      have = [item length];
+
       /*
-       * We may have a maximum data size set...
+       * Read straight into the end of the data item rather than through
+       * a fixed size buffer on the stack.  The amount we try to read grows
+       * with the amount we have already received, so a large transfer
+       * needs few system calls and little copying.
        */
-      if (readMax > 0)
-        {
-          length = (unsigned int)readMax - [item length];
-          if (length > (int)sizeof(buf))
-            {
-	      length = sizeof(buf);
+      length = (have > READ_SIZE) ? have : READ_SIZE;
+#if	defined(FIONREAD)
+      /*
+       * If the system can tell us how much data is waiting, we read just
+       * that, so the item is not extended (and the extension cleared) for
+       * data which has not arrived.  If nothing is waiting we read a
+       * little in order to see the end of file.
+       */
+#if	USE_ZLIB
+      if (gzDescriptor == 0)
+#endif
+	{
+	  int	avail = 0;
+
+	  if (ioctl(descriptor, FIONREAD, &avail) == 0)
+	    {
+	      length = (avail > 0) ? (NSUInteger)avail : NETBUF_SIZE;
 	    }
 	}
-      else
+#endif
+      if (length > READ_MAX)
 	{
-	  length = sizeof(buf);
+	  length = READ_MAX;
+	}
+      /*
+       * We may have a maximum data size set...
+       */
+      if (readMax > 0 && length > (NSUInteger)readMax - have)
+        {
+          length = (NSUInteger)readMax - have;
 	}
 
-      received = [self read: buf length: length];
+      [item setLength: have + length];
+      received = [self read: (char*)[item mutableBytes] + have
+		     length: length];
+      [item setLength: have + (received > 0 ? received : 0)];
       if (received == 0)
         { // Read up to end of file.
           [self postReadNotification];
@@ -1939,7 +2106,6 @@ NSString * const GSSOCKSRecvAddr = @"GSSOCKSRecvAddr";
 	}
       else
 	{
-	  [item appendBytes: buf length: received];
 	  if (readMax < 0 || (readMax > 0 && (int)[item length] == readMax))
 	    {
 	      // Read a single chunk of data
@@ -1990,40 +2156,124 @@ NSString * const GSSOCKSRecvAddr = @"GSSOCKSRecvAddr";
     }
   else
     {
-      NSData	*item;
-      int		length;
-      const void	*ptr;
+      if ([self _usesSystemIO] == YES && [writeInfo count] > 1)
+	{
+	  struct iovec	iov[WRITEVECS];
+	  NSUInteger	count = [writeInfo count];
+	  NSUInteger	pos = writePos;
+	  NSUInteger	vecs = 0;
+	  NSUInteger	index;
+	  ssize_t	written;
 
-      item = [info objectForKey: NSFileHandleNotificationDataItem];
-      length = [item length];
-      ptr = [item bytes];
-      if (writePos < length)
-        {
-          int	written;
+	  /*
+	   * Gather consecutive queued writes into a single writev() so that
+	   * many small items don't need a system call each.  Only plain
+	   * write operations can be merged; anything else (eg. a SOCKS
+	   * negotiation step) ends the batch.
+	   */
+	  for (index = 0; index < count && vecs < WRITEVECS; index++)
+	    {
+	      NSDictionary	*d = [writeInfo objectAtIndex: index];
+	      NSData		*item;
 
-          written = [self write: (char*)ptr+writePos
-    		     length: length-writePos];
-          if (written <= 0)
-            {
-	      if (written < 0 && errno != EAGAIN && errno != EINTR)
-	        {
-	          NSString	*s;
-
-	          s = [NSString stringWithFormat:
-		    @"Write attempt failed - %@", [NSError _last]];
-	          [info setObject: s forKey: GSFileHandleNotificationError];
-	          [self postWriteNotification];
-	        }
+	      if ([d objectForKey: NotificationKey]
+		!= GSFileHandleWriteCompletionNotification)
+		{
+		  break;
+		}
+	      item = [d objectForKey: NSFileHandleNotificationDataItem];
+	      if ([item length] > pos)
+		{
+		  iov[vecs].iov_base = (char*)[item bytes] + pos;
+		  iov[vecs].iov_len = [item length] - pos;
+		  vecs++;
+		}
+	      pos = 0;
 	    }
-	  else
-            {
-	      writePos += written;
+	  if (vecs > 1)
+	    {
+	      written = writev(descriptor, iov, vecs);
+	      if (written < 0)
+		{
+		  if (errno != EAGAIN && errno != EINTR)
+		    {
+		      NSString	*s;
+
+		      s = [NSString stringWithFormat:
+			@"Write attempt failed - %@", [NSError _last]];
+		      [info setObject: s forKey: GSFileHandleNotificationError];
+		      [self postWriteNotification];
+		    }
+		  return;
+		}
+	      /*
+	       * Post a notification for each item written completely, and
+	       * leave the position in any partially written item so that
+	       * the next write continues from there.
+	       */
+	      while ([writeInfo count] > 0)
+		{
+		  NSUInteger	length;
+
+		  info = [writeInfo objectAtIndex: 0];
+		  if ([info objectForKey: NotificationKey]
+		    != GSFileHandleWriteCompletionNotification)
+		    {
+		      break;
+		    }
+		  length = [[info objectForKey: NSFileHandleNotificationDataItem]
+		    length];
+		  if ((NSUInteger)written < length - writePos)
+		    {
+		      writePos += written;
+		      break;
+		    }
+		  written -= (length - writePos);
+		  [self postWriteNotification];
+		  if (written == 0)
+		    {
+		      break;
+		    }
+		}
+	      return;
 	    }
 	}
-      if (writePos >= length)
-        { // Write operation completed.
-          [self postWriteNotification];
-        }
+      {
+	NSData		*item;
+	NSUInteger	length;
+	const void	*ptr;
+
+	item = [info objectForKey: NSFileHandleNotificationDataItem];
+	length = [item length];
+	ptr = [item bytes];
+	if (writePos < length)
+	  {
+	    NSInteger	written;
+
+	    written = [self write: (char*)ptr+writePos
+			   length: length-writePos];
+	    if (written <= 0)
+	      {
+		if (written < 0 && errno != EAGAIN && errno != EINTR)
+		  {
+		    NSString	*s;
+
+		    s = [NSString stringWithFormat:
+		      @"Write attempt failed - %@", [NSError _last]];
+		    [info setObject: s forKey: GSFileHandleNotificationError];
+		    [self postWriteNotification];
+		  }
+	      }
+	    else
+	      {
+		writePos += written;
+	      }
+	  }
+	if (writePos >= length)
+	  { // Write operation completed.
+	    [self postWriteNotification];
+	  }
+      }
     }
 }
 
@@ -2153,6 +2403,88 @@ NSString * const GSSOCKSRecvAddr = @"GSSOCKSRecvAddr";
   return service;
 }
 
+- (unsigned long long) transferFromFileHandle: (NSFileHandle*)source
+				       length: (unsigned long long)length
+{
+#if	defined(__linux__)
+  if ([source isKindOfClass: [GSFileHandle class]] == YES
+    && [self _usesSystemIO] == YES
+    && [(GSFileHandle*)source _usesSystemIO] == YES)
+    {
+      GSFileHandle		*src = (GSFileHandle*)source;
+      unsigned long long	done = 0;
+      struct stat		sbuf;
+      BOOL			fromPipe;
+
+      [src checkRead];
+      [self checkWrite];
+      if (fstat(src->descriptor, &sbuf) == 0
+	&& (S_ISREG(sbuf.st_mode) || S_ISFIFO(sbuf.st_mode)))
+	{
+	  fromPipe = S_ISFIFO(sbuf.st_mode) ? YES : NO;
+	  if (src->isNonBlocking == YES)
+	    {
+	      [src setNonBlocking: NO];
+	    }
+	  if (isNonBlocking == YES)
+	    {
+	      [self setNonBlocking: NO];
+	    }
+
+	  /*
+	   * Let the kernel move the data directly ... sendfile() copies
+	   * from a file to anything, while splice() copies from a pipe.
+	   * If the kernel refuses the descriptors before anything has been
+	   * copied, we fall back to copying through user space.
+	   */
+	  while (length == 0 || done < length)
+	    {
+	      size_t	want = IO_MAX;
+	      ssize_t	n;
+
+	      if (length > 0 && length - done < want)
+		{
+		  want = (size_t)(length - done);
+		}
+	      if (fromPipe == YES)
+		{
+		  n = splice(src->descriptor, NULL, descriptor, NULL, want,
+		    SPLICE_F_MOVE | SPLICE_F_MORE);
+		}
+	      else
+		{
+		  n = sendfile(descriptor, src->descriptor, NULL, want);
+		}
+	      if (n < 0)
+		{
+		  if (errno == EINTR || errno == EAGAIN)
+		    {
+		      continue;
+		    }
+		  if (done == 0 && (errno == EINVAL || errno == ENOSYS))
+		    {
+		      break;
+		    }
+		  [NSException raise: NSFileHandleOperationException
+			      format: @"unable to transfer data - %@",
+			      [NSError _last]];
+		}
+	      if (n == 0)
+		{
+		  return done;
+		}
+	      done += n;
+	    }
+	  if (done > 0)
+	    {
+	      return done;
+	    }
+	}
+    }
+#endif
+  return [super transferFromFileHandle: source length: length];
+}
+
 - (BOOL) useCompression
 {
 #if	USE_ZLIB
@@ -307,6 +307,11 @@ typedef enum {
 GSRunLoopThreadInfo *
 GSRunLoopInfoForThread(NSThread *aThread) GS_ATTRIB_PRIVATE;
 
+/* Return the number of leading bytes in p (of length l) which are ASCII.
+ */
+NSUInteger
+GSPrivateASCIILength(const uint8_t *p, NSUInteger l) GS_ATTRIB_PRIVATE;
+
 /* Used by NSException uncaught exception handler - must not call any
  * methods/functions which might cause a recursive exception.
  */
@@ -411,6 +416,45 @@ GSPrivateLoadModule(NSString *filename, FILE *errorStream,
   void (*loadCallback)(Class, struct objc_category *),
   void **header, NSString *debugFilename) GS_ATTRIB_PRIVATE;
 
+/* Flush the cache of accessors found by key-value coding (called when
+ * methods may have been added to classes).
+ */
+void
+GSPrivateKVCCacheFlush(void) GS_ATTRIB_PRIVATE;
+
+/* Get the value for key (a UTF-8 string of size bytes) as NSObject's
+ * implementation of -valueForKey: would, without creating a string.
+ */
+id
+GSPrivateValueForKey(id self, const char *key, unsigned size) GS_ATTRIB_PRIVATE;
+
+/* Function used to compare objects when sorting.
+ */
+typedef NSComparisonResult (*GSSortFunction)(id, id, void*);
+
+/* Sort the count objects in buffer using compare, without retaining or
+ * releasing them (an introsort, which is not stable).  If compare raises
+ * an exception the buffer may be left with objects duplicated or lost,
+ * so callers for whom that matters should sort a copy.
+ */
+void
+GSPrivateSort(id *buffer, NSUInteger count,
+  GSSortFunction compare, void *context) GS_ATTRIB_PRIVATE;
+
+/* As GSPrivateSort() but using a timsort, which keeps objects that
+ * compare as equal in their original order.
+ */
+void
+GSPrivateSortStable(id *buffer, NSUInteger count,
+  GSSortFunction compare, void *context) GS_ATTRIB_PRIVATE;
+
+/* Copy the leading ASCII characters of s (of length l) into d as bytes,
+ * returning the number of characters copied.
+ */
+NSUInteger
+GSPrivateNarrowASCII(uint8_t *d, const unichar *s, NSUInteger l)
+  GS_ATTRIB_PRIVATE;
+
 /* Get the native C-string encoding as used by locale specific code in the
  * operating system.  This may differ from the default C-string encoding
  * if the latter has bewen set via an environment variable.
@@ -513,6 +557,13 @@ GSPrivateSymbolPath (Class theClass, Category *theCategory) GS_ATTRIB_PRIVATE;
 unsigned char
 GSPrivateUniCop(unichar u) GS_ATTRIB_PRIVATE;
 
+/* Copy the leading ASCII bytes of s (of length l) into d as unichars,
+ * returning the number of characters copied.
+ */
+NSUInteger
+GSPrivateWidenASCII(unichar *d, const uint8_t *s, NSUInteger l)
+  GS_ATTRIB_PRIVATE;
+
 /* unload a module from the runtime (not implemented)
  */
 long
@@ -85,6 +85,16 @@ typedef struct{
   unsigned int	pollfds_count;
   struct pollfd	*pollfds;
 #endif
+#ifdef	HAVE_EPOLL
+  int			epollfd;	// Persistent kernel interest set.
+  unsigned int		epollGeneration;// Incremented on each poll.
+  unsigned int		epollLimit;	// Size of epollInfo (max fd + 1).
+  struct GSEpollInfo	*epollInfo;	// Registration state by descriptor.
+  unsigned int		epollCount;	// Descriptors in epollActive.
+  unsigned int		epollCapacity;	// Capacity of epollActive/events.
+  int			*epollActive;	// Descriptors we are interested in.
+  struct epoll_event	*epollEvents;	// Results from epoll_wait().
+#endif
 }
 /* Check to see of the thread has been awakened, blocking until it
  * does get awakened or until the limit date has been reached.
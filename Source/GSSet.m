@@ -36,6 +36,7 @@
 #import "GSPrivate.h"
 
 #define	GSI_MAP_HAS_VALUE	0
+#define	GSI_MAP_OPEN		1
 #define	GSI_MAP_KTYPES		GSUNION_OBJ
 #if	GS_WITH_GC
 #include	<gc/gc_typed.h>
@@ -0,0 +1,664 @@
+/** Sorting of arrays of objects
+   Copyright (C) 2026 Free Software Foundation, Inc.
+
+   This file is part of the GNUstep Base Library.
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Library General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with this library; if not, write to the Free
+   Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+   Boston, MA 02111 USA.
+   */
+
+#import "common.h"
+#import "GSPrivate.h"
+
+/* These functions sort a C array of objects directly, without retaining
+ * or releasing anything, calling the comparison function only.
+ *
+ * GSPrivateSort() is a pattern-defeating quicksort: median of three (or
+ * of nine for large ranges) pivots, insertion sort for small ranges, a
+ * check for ranges which are already sorted, a special partition for
+ * ranges with many equal objects, and a fallback to heapsort if too many
+ * partitions are badly unbalanced, so it is O(n log n) in the worst case
+ * and O(n) for sorted input.
+ *
+ * GSPrivateSortStable() is a timsort: it finds ascending or descending
+ * runs in the data, extends short ones to a minimum length by binary
+ * insertion, and merges them so that objects which compare as equal keep
+ * their original order.
+ *
+ * All the loops are bounded by the range being sorted, so a comparison
+ * function which gives inconsistent results produces an unsorted array
+ * rather than a crash.
+ */
+
+#define	LESS(A, B)	((*compare)((A), (B), context) < 0)
+#define	SWAP(I, J)	do { id _t = a[I]; a[I] = a[J]; a[J] = _t; } while (0)
+
+#define	INSERTION_THRESHOLD	24
+#define	NINTHER_THRESHOLD	128
+#define	PARTIAL_INSERTION_LIMIT	8
+
+static void
+insertionSort(id *a, NSUInteger begin, NSUInteger end,
+  GSSortFunction compare, void *context)
+{
+  NSUInteger	cur;
+
+  for (cur = begin + 1; cur < end; cur++)
+    {
+      if (LESS(a[cur], a[cur - 1]))
+	{
+	  id		tmp = a[cur];
+	  NSUInteger	sift = cur;
+
+	  do
+	    {
+	      a[sift] = a[sift - 1];
+	      sift--;
+	    }
+	  while (sift > begin && LESS(tmp, a[sift - 1]));
+	  a[sift] = tmp;
+	}
+    }
+}
+
+/* Insertion sort which gives up (returning NO) once more than a few
+ * objects have been moved, used where the range is probably sorted.
+ */
+static BOOL
+partialInsertionSort(id *a, NSUInteger begin, NSUInteger end,
+  GSSortFunction compare, void *context)
+{
+  NSUInteger	limit = 0;
+  NSUInteger	cur;
+
+  for (cur = begin + 1; cur < end; cur++)
+    {
+      if (LESS(a[cur], a[cur - 1]))
+	{
+	  id		tmp = a[cur];
+	  NSUInteger	sift = cur;
+
+	  do
+	    {
+	      a[sift] = a[sift - 1];
+	      sift--;
+	    }
+	  while (sift > begin && LESS(tmp, a[sift - 1]));
+	  a[sift] = tmp;
+	  limit += cur - sift;
+	}
+      if (limit > PARTIAL_INSERTION_LIMIT)
+	{
+	  return NO;
+	}
+    }
+  return YES;
+}
+
+static inline void
+sort2(id *a, NSUInteger i, NSUInteger j,
+  GSSortFunction compare, void *context)
+{
+  if (LESS(a[j], a[i]))
+    {
+      SWAP(i, j);
+    }
+}
+
+static inline void
+sort3(id *a, NSUInteger i, NSUInteger j, NSUInteger k,
+  GSSortFunction compare, void *context)
+{
+  sort2(a, i, j, compare, context);
+  sort2(a, j, k, compare, context);
+  sort2(a, i, j, compare, context);
+}
+
+static void
+siftDown(id *a, NSUInteger base, NSUInteger root, NSUInteger size,
+  GSSortFunction compare, void *context)
+{
+  for (;;)
+    {
+      NSUInteger	child = 2 * root + 1;
+
+      if (child >= size)
+	{
+	  return;
+	}
+      if (child + 1 < size && LESS(a[base + child], a[base + child + 1]))
+	{
+	  child++;
+	}
+      if (!LESS(a[base + root], a[base + child]))
+	{
+	  return;
+	}
+      SWAP(base + root, base + child);
+      root = child;
+    }
+}
+
+static void
+heapSort(id *a, NSUInteger begin, NSUInteger end,
+  GSSortFunction compare, void *context)
+{
+  NSUInteger	size = end - begin;
+  NSUInteger	i;
+
+  for (i = size / 2; i-- > 0; )
+    {
+      siftDown(a, begin, i, size, compare, context);
+    }
+  for (i = size; i-- > 1; )
+    {
+      SWAP(begin, begin + i);
+      siftDown(a, begin, 0, i, compare, context);
+    }
+}
+
+/* Partition around the pivot at a[begin], putting objects equal to the
+ * pivot on the right.  Returns the final position of the pivot and sets
+ * *partitioned to say whether no objects needed to be moved.
+ */
+static NSUInteger
+partitionRight(id *a, NSUInteger begin, NSUInteger end, BOOL *partitioned,
+  GSSortFunction compare, void *context)
+{
+  id		pivot = a[begin];
+  NSUInteger	first = begin;
+  NSUInteger	last = end;
+  NSUInteger	pos;
+
+  while (++first < end && LESS(a[first], pivot))
+    ;
+  while (--last > begin && last >= first && !LESS(a[last], pivot))
+    ;
+  *partitioned = (first >= last) ? YES : NO;
+  while (first < last)
+    {
+      SWAP(first, last);
+      while (++first < end && LESS(a[first], pivot))
+	;
+      while (--last > begin && !LESS(a[last], pivot))
+	;
+    }
+  pos = first - 1;
+  a[begin] = a[pos];
+  a[pos] = pivot;
+  return pos;
+}
+
+/* Partition around the pivot at a[begin], putting objects equal to the
+ * pivot on the left.  Used when the pivot is equal to the object before
+ * the range, so all the objects on the left are equal and need no more
+ * sorting.
+ */
+static NSUInteger
+partitionLeft(id *a, NSUInteger begin, NSUInteger end,
+  GSSortFunction compare, void *context)
+{
+  id		pivot = a[begin];
+  NSUInteger	first = begin;
+  NSUInteger	last = end;
+
+  while (--last > begin && LESS(pivot, a[last]))
+    ;
+  while (++first < end && first <= last && !LESS(pivot, a[first]))
+    ;
+  while (first < last)
+    {
+      SWAP(first, last);
+      while (--last > begin && LESS(pivot, a[last]))
+	;
+      while (++first < end && !LESS(pivot, a[first]))
+	;
+    }
+  a[begin] = a[last];
+  a[last] = pivot;
+  return last;
+}
+
+/* Swap some objects to break up patterns which gave a bad partition.
+ */
+static void
+breakPatterns(id *a, NSUInteger begin, NSUInteger end)
+{
+  NSUInteger	size = end - begin;
+  NSUInteger	q = size / 4;
+
+  if (size < INSERTION_THRESHOLD)
+    {
+      return;
+    }
+  SWAP(begin, begin + q);
+  SWAP(end - 1, end - q);
+  if (size > NINTHER_THRESHOLD)
+    {
+      SWAP(begin + 1, begin + q + 1);
+      SWAP(begin + 2, begin + q + 2);
+      SWAP(end - 2, end - q - 1);
+      SWAP(end - 3, end - q - 2);
+    }
+}
+
+static void
+pdqSort(id *a, NSUInteger begin, NSUInteger end, unsigned badAllowed,
+  BOOL leftmost, GSSortFunction compare, void *context)
+{
+  for (;;)
+    {
+      NSUInteger	size = end - begin;
+      NSUInteger	half = size / 2;
+      NSUInteger	pos;
+      NSUInteger	lsize;
+      NSUInteger	rsize;
+      BOOL		partitioned;
+
+      if (size < INSERTION_THRESHOLD)
+	{
+	  insertionSort(a, begin, end, compare, context);
+	  return;
+	}
+
+      /* Move the median of three (or of three medians of three) to the
+       * start of the range to use as the pivot.
+       */
+      if (size > NINTHER_THRESHOLD)
+	{
+	  sort3(a, begin, begin + half, end - 1, compare, context);
+	  sort3(a, begin + 1, begin + half - 1, end - 2, compare, context);
+	  sort3(a, begin + 2, begin + half + 1, end - 3, compare, context);
+	  sort3(a, begin + half - 1, begin + half, begin + half + 1,
+	    compare, context);
+	  SWAP(begin, begin + half);
+	}
+      else
+	{
+	  sort3(a, begin + half, begin, end - 1, compare, context);
+	}
+
+      /* If the pivot equals the object before this range, everything
+       * equal to it can be put on the left and left alone.
+       */
+      if (leftmost == NO && !LESS(a[begin - 1], a[begin]))
+	{
+	  begin = partitionLeft(a, begin, end, compare, context) + 1;
+	  continue;
+	}
+
+      pos = partitionRight(a, begin, end, &partitioned, compare, context);
+      lsize = pos - begin;
+      rsize = end - (pos + 1);
+      if (lsize < size / 8 || rsize < size / 8)
+	{
+	  if (--badAllowed == 0)
+	    {
+	      heapSort(a, begin, end, compare, context);
+	      return;
+	    }
+	  breakPatterns(a, begin, pos);
+	  breakPatterns(a, pos + 1, end);
+	}
+      else if (partitioned == YES
+	&& partialInsertionSort(a, begin, pos, compare, context) == YES
+	&& partialInsertionSort(a, pos + 1, end, compare, context) == YES)
+	{
+	  return;
+	}
+
+      /* Recurse into the smaller part and loop for the larger one, so
+       * that the stack depth is logarithmic.
+       */
+      if (lsize < rsize)
+	{
+	  pdqSort(a, begin, pos, badAllowed, leftmost, compare, context);
+	  begin = pos + 1;
+	  leftmost = NO;
+	}
+      else
+	{
+	  pdqSort(a, pos + 1, end, badAllowed, NO, compare, context);
+	  end = pos;
+	}
+    }
+}
+
+void
+GSPrivateSort(id *buffer, NSUInteger count,
+  GSSortFunction compare, void *context)
+{
+  unsigned	bad = 0;
+  NSUInteger	n = count;
+
+  if (count < 2)
+    {
+      return;
+    }
+  while (n > 1)
+    {
+      bad++;
+      n >>= 1;
+    }
+  pdqSort(buffer, 0, count, bad, YES, compare, context);
+}
+
+
+#define	MIN_MERGE	64
+#define	MAX_RUNS	128
+
+typedef struct {
+  NSUInteger	base;
+  NSUInteger	len;
+} GSSortRun;
+
+typedef struct {
+  id		*a;
+  id		*tmp;
+  GSSortFunction compare;
+  void		*context;
+  GSSortRun	runs[MAX_RUNS];
+  unsigned	count;
+} GSMergeState;
+
+static NSUInteger
+minRunLength(NSUInteger n)
+{
+  NSUInteger	r = 0;
+
+  while (n >= MIN_MERGE)
+    {
+      r |= (n & 1);
+      n >>= 1;
+    }
+  return n + r;
+}
+
+/* Return the length of the run starting at lo, reversing it if it is
+ * strictly descending (strictly, so that reversing keeps the sort stable).
+ */
+static NSUInteger
+countRun(id *a, NSUInteger lo, NSUInteger hi,
+  GSSortFunction compare, void *context)
+{
+  NSUInteger	runHi = lo + 1;
+
+  if (runHi == hi)
+    {
+      return 1;
+    }
+  if (LESS(a[runHi], a[lo]))
+    {
+      NSUInteger	i;
+      NSUInteger	j;
+
+      runHi++;
+      while (runHi < hi && LESS(a[runHi], a[runHi - 1]))
+	{
+	  runHi++;
+	}
+      for (i = lo, j = runHi - 1; i < j; i++, j--)
+	{
+	  SWAP(i, j);
+	}
+    }
+  else
+    {
+      runHi++;
+      while (runHi < hi && !LESS(a[runHi], a[runHi - 1]))
+	{
+	  runHi++;
+	}
+    }
+  return runHi - lo;
+}
+
+/* Sort a[lo..hi) by binary insertion, given that a[lo..start) is sorted.
+ * Objects are inserted after any equal to them, keeping the sort stable.
+ */
+static void
+binaryInsertionSort(id *a, NSUInteger lo, NSUInteger hi, NSUInteger start,
+  GSSortFunction compare, void *context)
+{
+  for (; start < hi; start++)
+    {
+      id		pivot = a[start];
+      NSUInteger	left = lo;
+      NSUInteger	right = start;
+
+      while (left < right)
+	{
+	  NSUInteger	mid = left + (right - left) / 2;
+
+	  if (LESS(pivot, a[mid]))
+	    {
+	      right = mid;
+	    }
+	  else
+	    {
+	      left = mid + 1;
+	    }
+	}
+      memmove(&a[left + 1], &a[left], (start - left) * sizeof(id));
+      a[left] = pivot;
+    }
+}
+
+/* Return the number of objects in a[base..base+len) which are less than
+ * or equal to key (if after is YES) or strictly less than key.
+ */
+static NSUInteger
+searchRun(id key, id *a, NSUInteger base, NSUInteger len, BOOL after,
+  GSSortFunction compare, void *context)
+{
+  NSUInteger	left = 0;
+  NSUInteger	right = len;
+
+  while (left < right)
+    {
+      NSUInteger	mid = left + (right - left) / 2;
+      BOOL		goLeft;
+
+      if (after == YES)
+	{
+	  goLeft = LESS(key, a[base + mid]);
+	}
+      else
+	{
+	  goLeft = !LESS(a[base + mid], key);
+	}
+      if (goLeft)
+	{
+	  right = mid;
+	}
+      else
+	{
+	  left = mid + 1;
+	}
+    }
+  return left;
+}
+
+static void
+mergeAt(GSMergeState *s, unsigned i)
+{
+  id		*a = s->a;
+  id		*tmp = s->tmp;
+  GSSortFunction compare = s->compare;
+  void		*context = s->context;
+  NSUInteger	baseA = s->runs[i].base;
+  NSUInteger	lenA = s->runs[i].len;
+  NSUInteger	baseB = s->runs[i + 1].base;
+  NSUInteger	lenB = s->runs[i + 1].len;
+  NSUInteger	k;
+
+  s->runs[i].len = lenA + lenB;
+  if (i == s->count - 3)
+    {
+      s->runs[i + 1] = s->runs[i + 2];
+    }
+  s->count--;
+
+  /* Objects at the start of A which are no greater than the first in B,
+   * and at the end of B which are less than the last in A, are already
+   * in place.
+   */
+  k = searchRun(a[baseB], a, baseA, lenA, YES, compare, context);
+  baseA += k;
+  lenA -= k;
+  if (lenA == 0)
+    {
+      return;
+    }
+  lenB = searchRun(a[baseA + lenA - 1], a, baseB, lenB, NO, compare, context);
+  if (lenB == 0)
+    {
+      return;
+    }
+
+  if (lenA <= lenB)
+    {
+      NSUInteger	i = 0;
+      NSUInteger	j = baseB;
+      NSUInteger	end = baseB + lenB;
+      NSUInteger	dest = baseA;
+
+      memcpy(tmp, &a[baseA], lenA * sizeof(id));
+      while (i < lenA && j < end)
+	{
+	  if (LESS(a[j], tmp[i]))
+	    {
+	      a[dest++] = a[j++];
+	    }
+	  else
+	    {
+	      a[dest++] = tmp[i++];
+	    }
+	}
+      memcpy(&a[dest], &tmp[i], (lenA - i) * sizeof(id));
+    }
+  else
+    {
+      NSUInteger	i = baseA + lenA;	// One past next from A
+      NSUInteger	j = lenB;		// One past next from B
+      NSUInteger	dest = baseB + lenB;
+
+      memcpy(tmp, &a[baseB], lenB * sizeof(id));
+      while (i > baseA && j > 0)
+	{
+	  if (LESS(tmp[j - 1], a[i - 1]))
+	    {
+	      a[--dest] = a[--i];
+	    }
+	  else
+	    {
+	      a[--dest] = tmp[--j];
+	    }
+	}
+      memcpy(&a[dest - j], tmp, j * sizeof(id));
+    }
+}
+
+/* Merge runs until the lengths on the stack satisfy the timsort
+ * invariants (each run longer than the sum of the next two), which
+ * keeps merges balanced and the stack small.
+ */
+static void
+mergeCollapse(GSMergeState *s)
+{
+  while (s->count > 1)
+    {
+      unsigned	n = s->count - 2;
+
+      if ((n > 0 && s->runs[n - 1].len <= s->runs[n].len + s->runs[n + 1].len)
+	|| (n > 1 && s->runs[n - 2].len <= s->runs[n - 1].len + s->runs[n].len))
+	{
+	  if (s->runs[n - 1].len < s->runs[n + 1].len)
+	    {
+	      n--;
+	    }
+	}
+      else if (s->runs[n].len > s->runs[n + 1].len)
+	{
+	  break;
+	}
+      mergeAt(s, n);
+    }
+}
+
+static void
+mergeForceCollapse(GSMergeState *s)
+{
+  while (s->count > 1)
+    {
+      unsigned	n = s->count - 2;
+
+      if (n > 0 && s->runs[n - 1].len < s->runs[n + 1].len)
+	{
+	  n--;
+	}
+      mergeAt(s, n);
+    }
+}
+
+void
+GSPrivateSortStable(id *buffer, NSUInteger count,
+  GSSortFunction compare, void *context)
+{
+  id		*a = buffer;
+  GSMergeState	state;
+  NSUInteger	minRun;
+  NSUInteger	lo;
+
+  if (count < 2)
+    {
+      return;
+    }
+  if (count < MIN_MERGE)
+    {
+      NSUInteger	run = countRun(a, 0, count, compare, context);
+
+      binaryInsertionSort(a, 0, count, run, compare, context);
+      return;
+    }
+
+  minRun = minRunLength(count);
+  state.a = a;
+  state.compare = compare;
+  state.context = context;
+  state.count = 0;
+  GS_BEGINITEMBUF(tmp, count / 2 + 1, id)
+  state.tmp = tmp;
+  lo = 0;
+  while (lo < count)
+    {
+      NSUInteger	run = countRun(a, lo, count, compare, context);
+
+      if (run < minRun)
+	{
+	  NSUInteger	force = (count - lo < minRun) ? count - lo : minRun;
+
+	  binaryInsertionSort(a, lo, lo + force, lo + run, compare, context);
+	  run = force;
+	}
+      state.runs[state.count].base = lo;
+      state.runs[state.count].len = run;
+      state.count++;
+      mergeCollapse(&state);
+      lo += run;
+    }
+  mergeForceCollapse(&state);
+  GS_ENDITEMBUF()
+}
@@ -89,7 +89,15 @@ lengthUTF8(const uint8_t *p, unsigned l, BOOL *ascii, BOOL *latin1)
       uint8_t	c = *p;
       uint32_t	u = c;
 
-      if (c > 0x7f)
+      if (c < 0x80)
+	{
+	  NSUInteger	n = GSPrivateASCIILength(p, e - p);
+
+	  p += n;
+	  l += n;
+	  continue;
+	}
+      else
 	{
 	  int i, sle = 0;
 
@@ -146,10 +154,6 @@ lengthUTF8(const uint8_t *p, unsigned l, BOOL *ascii, BOOL *latin1)
 			  format: @"Bad surrogate pair in constant string"];
 	    }
 	}
-      else
-	{
-	  p++;
-	}
 
       /*
        * Add codepoint as either a single unichar for BMP
@@ -553,6 +557,30 @@ instance.
 }
 @end
 
+/*
+GSRopeString, concrete mutable string which holds its characters in a
+rope (a balanced tree of small buffers) rather than one buffer, so that
+they can be inserted or deleted anywhere without moving the rest.
+A GSMutableString changes to this class when it is large and is changed
+other than at its end, and changes back if it becomes small again, so
+the instance variables must be laid out as in GSMutableString.
+*/
+@interface GSRopeString : NSMutableString
+{
+@public
+  struct GSRopeNodeStruct	*_root;
+  unsigned int	_count;
+  struct {
+    unsigned int	wide: 1;
+    unsigned int	owned: 1;
+    unsigned int	unused: 2;
+    unsigned int	hash: 28;
+  } _flags;
+  unsigned int	_capacity;
+  NSZone	*_zone;
+}
+@end
+
 /*
  *	Include sequence handling code with instructions to generate search
  *	and compare functions for NSString objects.
@@ -610,6 +638,7 @@ static Class GSUnicodeBufferStringClass = 0;
 static Class GSUnicodeSubStringClass = 0;
 static Class GSUnicodeInlineStringClass = 0;
 static Class GSMutableStringClass = 0;
+static Class GSRopeStringClass = 0;
 static Class NSConstantStringClass = 0;
 
 static SEL	cMemberSel;
@@ -663,6 +692,7 @@ setup(BOOL rerun)
       GSCSubStringClass = [GSCSubString class];
       GSUnicodeSubStringClass = [GSUnicodeSubString class];
       GSMutableStringClass = [GSMutableString class];
+      GSRopeStringClass = [GSRopeString class];
       NSConstantStringClass = [NXConstantString class];
 
       /*
@@ -824,6 +854,157 @@ createTinyString(const char *str, int length)
     }
   return (id)s;
 }
+
+#define TINY6_STRING_MASK 5
+static BOOL useTiny6Strings;
+/**
+ * A GSTiny6String is used on 64-bit platforms to store strings of 9 or 10
+ * characters (too long for a GSTinyString) which use only letters, digits,
+ * '.' and '_' (as is common for dictionary keys and identifiers).  Each
+ * character is stored in six bits.
+ * The layout of a tiny6 string is as follows:
+  struct
+  {
+    uintptr_t char0  :6;
+    ...
+    uintptr_t char9  :6;
+    uintptr_t ten    :1;
+    uintptr_t tag    :3;
+  };
+ * where the 'ten' bit is set if the string is 10 characters long
+ * (otherwise it is 9 characters and char9 is zero).
+ */
+static const char tiny6Chars[64]
+  = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz._";
+#define TINY6_STRING_CHAR(s, x) (tiny6Chars[((s) >> (58 - ((x)*6))) & 0x3f])
+#define TINY6_STRING_LENGTH(s) \
+  ((((s) >> OBJC_SMALL_OBJECT_SHIFT) & 1) ? 10 : 9)
+
+@interface GSTiny6String : NSString
+@end
+
+@implementation GSTiny6String
+- (NSUInteger) length
+{
+  return TINY6_STRING_LENGTH((uintptr_t)self);
+}
+
+- (unichar) characterAtIndex: (NSUInteger)anIndex
+{
+  uintptr_t s = (uintptr_t)self;
+
+  if (anIndex >= TINY6_STRING_LENGTH(s))
+    {
+      [NSException raise: NSInvalidArgumentException
+                  format: @"-characterAtIndex: index out of range"];
+    }
+  return TINY6_STRING_CHAR(s, anIndex);
+}
+
+- (void) getCharacters: (unichar*)buffer range: (NSRange)aRange
+{
+  uintptr_t	s = (uintptr_t)self;
+  NSUInteger	i;
+
+  GS_RANGE_CHECK(aRange, TINY6_STRING_LENGTH(s));
+  for (i = 0; i < aRange.length; i++)
+    {
+      buffer[i] = TINY6_STRING_CHAR(s, aRange.location + i);
+    }
+}
+
++ (void) load
+{
+  useTiny6Strings = objc_registerSmallObjectClass_np(self, TINY6_STRING_MASK);
+}
+
++ (id) alloc
+{
+  return (id)TINY6_STRING_MASK;
+}
+
++ (id) allocWithZone: (NSZone*)aZone
+{
+  return (id)TINY6_STRING_MASK;
+}
+
+- (id) copy
+{
+  return self;
+}
+
+- (id) copyWithZone: (NSZone*)aZone
+{
+  return self;
+}
+
+- (id) retain
+{
+  return self;
+}
+
+- (id) autorelease
+{
+  return self;
+}
+
+- (oneway void) release
+{
+  return;
+}
+@end
+
+/**
+ * Constructs a tiny6 string, or returns nil if the string is not 9 or 10
+ * characters long or contains characters which can't be stored.
+ */
+static id
+createTiny6String(const char *str, int length)
+{
+  uintptr_t	s = TINY6_STRING_MASK;
+  int		i;
+
+  if (!useTiny6Strings || length < 9 || length > 10)
+    {
+      return nil;
+    }
+  if (length == 10)
+    {
+      s |= 1 << OBJC_SMALL_OBJECT_SHIFT;
+    }
+  for (i = 0; i < length; i++)
+    {
+      unsigned char	c = str[i];
+      uintptr_t		v;
+
+      if (c >= '0' && c <= '9')
+	{
+	  v = c - '0';
+	}
+      else if (c >= 'A' && c <= 'Z')
+	{
+	  v = c - 'A' + 10;
+	}
+      else if (c >= 'a' && c <= 'z')
+	{
+	  v = c - 'a' + 36;
+	}
+      else if (c == '.')
+	{
+	  v = 62;
+	}
+      else if (c == '_')
+	{
+	  v = 63;
+	}
+      else
+	{
+	  return nil;
+	}
+      s |= v << (58 - (i*6));
+    }
+  return (id)s;
+}
 #endif
 /*
  * The GSPlaceholderString class is used by the abstract cluster root
@@ -987,6 +1168,19 @@ fixBOM(unsigned char **bytes, NSUInteger*length, BOOL *owned,
             {
               id tinyString = createTinyString(bytes, length);
 
+              if (tinyString)
+                {
+                  return tinyString;
+                }
+            }
+          if ((NSASCIIStringEncoding == encoding
+            || NSUTF8StringEncoding == encoding) && length >= 9)
+            {
+              /* Only characters in the ASCII range are accepted, so
+               * the string is the same in either encoding.
+               */
+              id tinyString = createTiny6String(bytes, length);
+
               if (tinyString)
                 {
                   return tinyString;
@@ -1079,16 +1273,7 @@ fixBOM(unsigned char **bytes, NSUInteger*length, BOOL *owned,
 
   if (encoding == NSUTF8StringEncoding)
     {
-      unsigned i;
-
-      for (i = 0; i < length; i++)
-        {
-	  if ((chars.c)[i] > 127)
-	    {
-	      break;
-	    }
-        }
-      if (i == length)
+      if (GSPrivateASCIILength(chars.c, length) == length)
 	{
 	  /*
 	   * This is actually ASCII data ... so we can just store it as if
@@ -1099,23 +1284,16 @@ fixBOM(unsigned char **bytes, NSUInteger*length, BOOL *owned,
     }
   else if (encoding != internalEncoding && isByteEncoding(encoding) == YES)
     {
-      unsigned i;
+      NSUInteger	i = GSPrivateASCIILength(chars.c, length);
 
-      for (i = 0; i < length; i++)
-        {
-	  if ((chars.c)[i] > 127)
+      if (i < length && encoding == NSASCIIStringEncoding)
+	{
+	  if (flag == YES && chars.c != 0)
 	    {
-	      if (encoding == NSASCIIStringEncoding)
-		{
-		  if (flag == YES && chars.c != 0)
-		    {
-		      NSZoneFree(NSZoneFromPointer(chars.c), chars.c);
-		    }
-		  return nil;	// Invalid data
-		}
-	      break;
+	      NSZoneFree(NSZoneFromPointer(chars.c), chars.c);
 	    }
-        }
+	  return nil;	// Invalid data
+	}
       if (i == length)
 	{
 	  /*
@@ -1967,9 +2145,14 @@ dataUsingEncoding_c(GSStr self, NSStringEncoding encoding, BOOL lossy)
       return [NSDataClass data];
     }
 
+  /* If the content is ASCII (either because that's our internal encoding
+   * or because the bytes are all in the ASCII range) it can be copied
+   * unchanged into UTF-8 or any other byte encoding.
+   */
   if ((encoding == internalEncoding)
-    || ((internalEncoding == NSASCIIStringEncoding)
-      && (encoding == NSUTF8StringEncoding || isByteEncoding(encoding))))
+    || ((encoding == NSUTF8StringEncoding || isByteEncoding(encoding))
+      && ((internalEncoding == NSASCIIStringEncoding)
+	|| GSPrivateASCIILength(self->_contents.c, len) == len)))
     {
       unsigned char *buff;
 
@@ -4228,6 +4411,583 @@ agree, create a new GSUnicodeInlineString otherwise.
 
 
 
+/*
+ * A large mutable string which is edited other than at its end is held
+ * as a rope: a tree whose nodes each hold a leaf of up to ROPE_LEAF
+ * characters (8-bit latin1 or unichar, independently for each leaf), in
+ * order left subtree, leaf, right subtree.  The tree is a treap, kept
+ * balanced by giving each node a pseudo-random priority, so finding a
+ * position and inserting or deleting characters there costs O(log n)
+ * rather than moving all the characters after it.
+ */
+#define	ROPE_LEAF	1024		// Maximum characters in a leaf.
+#define	ROPE_MIN	(32 * 1024)	// Length at which to use a rope.
+
+typedef struct GSRopeNodeStruct {
+  struct GSRopeNodeStruct	*left;
+  struct GSRopeNodeStruct	*right;
+  unsigned			total;		// Characters in subtree.
+  unsigned			priority;
+  unsigned			count;		// Characters in leaf.
+  BOOL				wide;
+  GSCharPtr			chars;
+} GSRopeNode;
+
+static inline unsigned
+ropeTotal(GSRopeNode *n)
+{
+  return (n == 0) ? 0 : n->total;
+}
+
+static inline void
+ropeFix(GSRopeNode *n)
+{
+  n->total = ropeTotal(n->left) + n->count + ropeTotal(n->right);
+}
+
+static GSRopeNode *
+ropeLeaf(NSZone *z, BOOL wide)
+{
+  GSRopeNode	*n = NSZoneMalloc(z, sizeof(GSRopeNode));
+  unsigned	h = (unsigned)(((uintptr_t)n) >> 3);
+
+  /* Mix the bits of the address to make a pseudo-random priority.
+   */
+  h ^= h >> 16;
+  h *= 0x7feb352d;
+  h ^= h >> 15;
+  h *= 0x846ca68b;
+  h ^= h >> 16;
+  n->left = 0;
+  n->right = 0;
+  n->total = 0;
+  n->priority = h;
+  n->count = 0;
+  n->wide = wide;
+  n->chars.c = NSZoneMalloc(z,
+    wide ? ROPE_LEAF * sizeof(unichar) : ROPE_LEAF);
+  return n;
+}
+
+static void
+ropeFree(NSZone *z, GSRopeNode *n)
+{
+  while (n != 0)
+    {
+      GSRopeNode	*r = n->right;
+
+      ropeFree(z, n->left);
+      NSZoneFree(z, n->chars.c);
+      NSZoneFree(z, n);
+      n = r;
+    }
+}
+
+static void
+ropeWidenLeaf(NSZone *z, GSRopeNode *n)
+{
+  unichar	*u = NSZoneMalloc(z, ROPE_LEAF * sizeof(unichar));
+  unsigned	i;
+
+  for (i = 0; i < n->count; i++)
+    {
+      u[i] = n->chars.c[i];
+    }
+  NSZoneFree(z, n->chars.c);
+  n->chars.u = u;
+  n->wide = YES;
+}
+
+/* Return YES if any of the characters will not fit in an 8-bit leaf.
+ */
+static BOOL
+ropeIsWide(const unichar *u, unsigned len)
+{
+  while (len-- > 0)
+    {
+      if (*u++ > 255)
+	{
+	  return YES;
+	}
+    }
+  return NO;
+}
+
+/* Store len characters at offset pos in the leaf (which must have room
+ * and be wide if any of the characters need it).
+ */
+static void
+ropeStore(GSRopeNode *n, unsigned pos, const unichar *u, unsigned len)
+{
+  if (n->wide == YES)
+    {
+      memcpy(n->chars.u + pos, u, len * sizeof(unichar));
+    }
+  else
+    {
+      unsigned char	*c = n->chars.c + pos;
+
+      while (len-- > 0)
+	{
+	  *c++ = (unsigned char)*u++;
+	}
+    }
+}
+
+/* Join two trees, all of whose characters in a come before those in b.
+ */
+static GSRopeNode *
+ropeMerge(GSRopeNode *a, GSRopeNode *b)
+{
+  if (a == 0)
+    {
+      return b;
+    }
+  if (b == 0)
+    {
+      return a;
+    }
+  if (a->priority > b->priority)
+    {
+      a->right = ropeMerge(a->right, b);
+      ropeFix(a);
+      return a;
+    }
+  b->left = ropeMerge(a, b->left);
+  ropeFix(b);
+  return b;
+}
+
+/* If pos is within a leaf (rather than at the start or end of one)
+ * cut the leaf there, returning a new leaf holding the characters after
+ * pos, which are removed from the tree.
+ */
+static GSRopeNode *
+ropeCut(NSZone *z, GSRopeNode *n, unsigned pos)
+{
+  GSRopeNode	*m;
+  unsigned	lt;
+
+  if (n == 0)
+    {
+      return 0;
+    }
+  lt = ropeTotal(n->left);
+  if (pos < lt)
+    {
+      m = ropeCut(z, n->left, pos);
+    }
+  else if (pos > lt + n->count)
+    {
+      m = ropeCut(z, n->right, pos - lt - n->count);
+    }
+  else if (pos == lt || pos == lt + n->count)
+    {
+      return 0;
+    }
+  else
+    {
+      unsigned	off = pos - lt;
+
+      m = ropeLeaf(z, n->wide);
+      m->count = n->count - off;
+      if (n->wide == YES)
+	{
+	  memcpy(m->chars.u, n->chars.u + off, m->count * sizeof(unichar));
+	}
+      else
+	{
+	  memcpy(m->chars.c, n->chars.c + off, m->count);
+	}
+      ropeFix(m);
+      n->count = off;
+    }
+  if (m != 0)
+    {
+      n->total -= m->count;
+    }
+  return m;
+}
+
+/* Split a tree at a position which is at the start or end of a leaf.
+ */
+static void
+ropeDivide(GSRopeNode *n, unsigned pos, GSRopeNode **l, GSRopeNode **r)
+{
+  if (n == 0)
+    {
+      *l = *r = 0;
+    }
+  else if (pos <= ropeTotal(n->left))
+    {
+      ropeDivide(n->left, pos, l, &n->left);
+      ropeFix(n);
+      *r = n;
+    }
+  else
+    {
+      ropeDivide(n->right, pos - ropeTotal(n->left) - n->count, &n->right, r);
+      ropeFix(n);
+      *l = n;
+    }
+}
+
+/* Split a tree into one holding the first pos characters and one holding
+ * the rest.
+ */
+static void
+ropeSplit(NSZone *z, GSRopeNode *n, unsigned pos,
+  GSRopeNode **l, GSRopeNode **r)
+{
+  GSRopeNode	*m = ropeCut(z, n, pos);
+
+  ropeDivide(n, pos, l, r);
+  if (m != 0)
+    {
+      *r = ropeMerge(m, *r);
+    }
+}
+
+/* Build a tree from either unichar or latin1 characters, using leaves
+ * only half full so that there is room for later insertions.
+ */
+static GSRopeNode *
+ropeBuild(NSZone *z, const unichar *u, const unsigned char *c, unsigned len)
+{
+  GSRopeNode	*root = 0;
+
+  while (len > 0)
+    {
+      unsigned		l = (len > ROPE_LEAF / 2) ? ROPE_LEAF / 2 : len;
+      GSRopeNode	*n;
+
+      if (u == 0)
+	{
+	  n = ropeLeaf(z, NO);
+	  memcpy(n->chars.c, c, l);
+	  c += l;
+	}
+      else
+	{
+	  n = ropeLeaf(z, ropeIsWide(u, l));
+	  ropeStore(n, 0, u, l);
+	  u += l;
+	}
+      n->count = l;
+      ropeFix(n);
+      root = ropeMerge(root, n);
+      len -= l;
+    }
+  return root;
+}
+
+/* Insert characters into an existing leaf if there is one with room at
+ * the position.  Returns NO (and changes nothing) if there isn't.
+ */
+static BOOL
+ropeInsert(NSZone *z, GSRopeNode *n, unsigned pos,
+  const unichar *u, unsigned len, BOOL wide)
+{
+  unsigned	lt;
+  BOOL		done;
+
+  if (n == 0)
+    {
+      return NO;
+    }
+  lt = ropeTotal(n->left);
+  if (pos <= lt && n->left != 0)
+    {
+      done = ropeInsert(z, n->left, pos, u, len, wide);
+    }
+  else if (pos <= lt + n->count)
+    {
+      if (n->count + len > ROPE_LEAF)
+	{
+	  return NO;
+	}
+      if (wide == YES && n->wide == NO)
+	{
+	  ropeWidenLeaf(z, n);
+	}
+      pos -= lt;
+      if (n->wide == YES)
+	{
+	  memmove(n->chars.u + pos + len, n->chars.u + pos,
+	    (n->count - pos) * sizeof(unichar));
+	}
+      else
+	{
+	  memmove(n->chars.c + pos + len, n->chars.c + pos, n->count - pos);
+	}
+      ropeStore(n, pos, u, len);
+      n->count += len;
+      done = YES;
+    }
+  else
+    {
+      done = ropeInsert(z, n->right, pos - lt - n->count, u, len, wide);
+    }
+  if (done == YES)
+    {
+      n->total += len;
+    }
+  return done;
+}
+
+/* Delete characters from within a single leaf if they are all in one
+ * and it would not be left empty.  Returns NO (and changes nothing)
+ * otherwise.
+ */
+static BOOL
+ropeDelete(GSRopeNode *n, unsigned pos, unsigned len)
+{
+  unsigned	lt;
+  BOOL		done;
+
+  if (n == 0)
+    {
+      return NO;
+    }
+  lt = ropeTotal(n->left);
+  if (pos < lt)
+    {
+      if (pos + len > lt)
+	{
+	  return NO;
+	}
+      done = ropeDelete(n->left, pos, len);
+    }
+  else if (pos < lt + n->count)
+    {
+      pos -= lt;
+      if (pos + len > n->count || len == n->count)
+	{
+	  return NO;
+	}
+      if (n->wide == YES)
+	{
+	  memmove(n->chars.u + pos, n->chars.u + pos + len,
+	    (n->count - pos - len) * sizeof(unichar));
+	}
+      else
+	{
+	  memmove(n->chars.c + pos, n->chars.c + pos + len,
+	    n->count - pos - len);
+	}
+      n->count -= len;
+      done = YES;
+    }
+  else
+    {
+      done = ropeDelete(n->right, pos - lt - n->count, len);
+    }
+  if (done == YES)
+    {
+      n->total -= len;
+    }
+  return done;
+}
+
+static unichar
+ropeCharacterAtIndex(GSRopeNode *n, unsigned pos)
+{
+  for (;;)
+    {
+      unsigned	lt = ropeTotal(n->left);
+
+      if (pos < lt)
+	{
+	  n = n->left;
+	}
+      else if (pos < lt + n->count)
+	{
+	  pos -= lt;
+	  return (n->wide == YES) ? n->chars.u[pos] : n->chars.c[pos];
+	}
+      else
+	{
+	  pos -= lt + n->count;
+	  n = n->right;
+	}
+    }
+}
+
+/* Copy len characters starting at pos into buf.
+ */
+static void
+ropeGetCharacters(GSRopeNode *n, unichar *buf, unsigned pos, unsigned len)
+{
+  while (n != 0 && len > 0)
+    {
+      unsigned	lt = ropeTotal(n->left);
+      unsigned	l;
+
+      if (pos < lt)
+	{
+	  l = (len < lt - pos) ? len : lt - pos;
+	  ropeGetCharacters(n->left, buf, pos, l);
+	  buf += l;
+	  len -= l;
+	  pos = lt;
+	}
+      pos -= lt;
+      if (len > 0 && pos < n->count)
+	{
+	  l = (len < n->count - pos) ? len : n->count - pos;
+	  if (n->wide == YES)
+	    {
+	      memcpy(buf, n->chars.u + pos, l * sizeof(unichar));
+	    }
+	  else
+	    {
+	      unsigned	i;
+
+	      for (i = 0; i < l; i++)
+		{
+		  buf[i] = n->chars.c[pos + i];
+		}
+	    }
+	  buf += l;
+	  len -= l;
+	  pos += l;
+	}
+      pos -= n->count;
+      n = n->right;
+    }
+}
+
+/* Return YES if any leaf in the tree holds unichar data.
+ */
+static BOOL
+ropeHasWide(GSRopeNode *n)
+{
+  while (n != 0)
+    {
+      if (n->wide == YES || ropeHasWide(n->left) == YES)
+	{
+	  return YES;
+	}
+      n = n->right;
+    }
+  return NO;
+}
+
+/* Copy all the characters of the tree into a contiguous buffer, which is
+ * unichar if wide is YES and latin1 otherwise.  Returns the position after
+ * the last character copied.
+ */
+static unsigned
+ropeFlatten(GSRopeNode *n, GSCharPtr dst, unsigned pos, BOOL wide)
+{
+  while (n != 0)
+    {
+      pos = ropeFlatten(n->left, dst, pos, wide);
+      if (wide == NO)
+	{
+	  memcpy(dst.c + pos, n->chars.c, n->count);
+	}
+      else if (n->wide == YES)
+	{
+	  memcpy(dst.u + pos, n->chars.u, n->count * sizeof(unichar));
+	}
+      else
+	{
+	  unsigned	i;
+
+	  for (i = 0; i < n->count; i++)
+	    {
+	      dst.u[pos + i] = n->chars.c[i];
+	    }
+	}
+      pos += n->count;
+      n = n->right;
+    }
+  return pos;
+}
+
+/* Replace the characters in range r of the tree with len characters from
+ * u, returning the new root.
+ */
+static GSRopeNode *
+ropeReplace(NSZone *z, GSRopeNode *root, NSRange r,
+  const unichar *u, unsigned len)
+{
+  GSRopeNode	*a;
+  GSRopeNode	*b;
+  GSRopeNode	*c;
+
+  ropeSplit(z, root, r.location, &a, &b);
+  ropeSplit(z, b, r.length, &b, &c);
+  ropeFree(z, b);
+  return ropeMerge(ropeMerge(a, ropeBuild(z, u, 0, len)), c);
+}
+
+/* Change a GSMutableString into a GSRopeString holding the same characters.
+ */
+static void
+GSStrToRope(GSStr s)
+{
+  GSRopeNode	*root;
+
+  if (s->_zone == 0)
+    {
+#if	GS_WITH_GC
+      s->_zone = GSAtomicMallocZone();
+#else
+      s->_zone = [(NSString*)s zone];
+#endif
+    }
+  if (s->_flags.wide == 0
+    && internalEncoding != NSISOLatin1StringEncoding
+    && internalEncoding != NSASCIIStringEncoding)
+    {
+      GSStrWiden(s);
+    }
+  if (s->_flags.wide == 1)
+    {
+      root = ropeBuild(s->_zone, s->_contents.u, 0, s->_count);
+    }
+  else
+    {
+      root = ropeBuild(s->_zone, 0, s->_contents.c, s->_count);
+    }
+  if (s->_flags.owned == 1)
+    {
+      NSZoneFree(s->_zone, s->_contents.c);
+    }
+  ((GSRopeString*)s)->_root = root;
+  s->_capacity = 0;
+  s->_flags.wide = 0;
+  s->_flags.owned = 0;
+  s->_flags.hash = 0;
+  GSClassSwizzle(s, GSRopeStringClass);
+}
+
+/* Change a GSRopeString back into a GSMutableString with a single buffer.
+ */
+static void
+GSRopeToStr(GSRopeString *r)
+{
+  GSRopeNode	*root = r->_root;
+  GSStr		s = (GSStr)r;
+  BOOL		wide;
+  GSCharPtr	p;
+
+  wide = (internalEncoding != NSISOLatin1StringEncoding
+    || ropeHasWide(root) == YES) ? YES : NO;
+  s->_capacity = s->_count + 1;
+  p.c = NSZoneMalloc(s->_zone,
+    wide ? s->_capacity * sizeof(unichar) : s->_capacity);
+  ropeFlatten(root, p, 0, wide);
+  ropeFree(s->_zone, root);
+  s->_contents = p;
+  s->_flags.wide = wide;
+  s->_flags.owned = 1;
+  s->_flags.hash = 0;
+  GSClassSwizzle(s, GSMutableStringClass);
+}
+
 /*
  * The GSMutableString class shares a common initial ivar layout with
  * the GSString class, but adds a few of its own.  It uses _flags.wide
@@ -4410,6 +5170,12 @@ NSAssert(_flags.owned == 1 && _zone != 0, NSInternalInconsistencyException);
 - (void) deleteCharactersInRange: (NSRange)range
 {
   GS_RANGE_CHECK(range, _count);
+  if (_count >= ROPE_MIN && NSMaxRange(range) < _count)
+    {
+      GSStrToRope((GSStr)self);
+      [self deleteCharactersInRange: range];
+      return;
+    }
   if (range.length > 0)
     {
       fillHole((GSStr)self, range.location, range.length);
@@ -4969,6 +5735,17 @@ NSAssert(_flags.owned == 1 && _zone != 0, NSInternalInconsistencyException);
   unsigned	length = 0;
 
   GS_RANGE_CHECK(aRange, _count);
+
+  /*
+   * If a large string is changed other than at its end, switch to
+   * holding it as a rope so that the rest of it need not be moved.
+   */
+  if (_count >= ROPE_MIN && NSMaxRange(aRange) < _count)
+    {
+      GSStrToRope((GSStr)self);
+      [self replaceCharactersInRange: aRange withString: aString];
+      return;
+    }
   if (aString != nil)
     {
       if (GSObjCIsInstance(aString) == NO)
@@ -5282,6 +6059,98 @@ NSAssert(_flags.owned == 1 && _zone != 0, NSInternalInconsistencyException);
 
 @end
 
+@implementation GSRopeString
+
++ (void) initialize
+{
+  setup(NO);
+}
+
+- (unichar) characterAtIndex: (NSUInteger)index
+{
+  if (index >= _count)
+    [NSException raise: NSRangeException format: @"Invalid index."];
+  return ropeCharacterAtIndex(_root, index);
+}
+
+- (void) dealloc
+{
+  ropeFree(_zone, _root);
+  _root = 0;
+  [super dealloc];
+}
+
+- (void) getCharacters: (unichar*)buffer range: (NSRange)aRange
+{
+  GS_RANGE_CHECK(aRange, _count);
+  ropeGetCharacters(_root, buffer, aRange.location, aRange.length);
+}
+
+- (NSUInteger) length
+{
+  return _count;
+}
+
+- (void) replaceCharactersInRange: (NSRange)aRange
+		       withString: (NSString*)aString
+{
+  unichar	buf[1024];
+  unichar	*u = buf;
+  unsigned	length = 0;
+
+  GS_RANGE_CHECK(aRange, _count);
+  if (aString != nil)
+    {
+      if (GSObjCIsInstance(aString) == NO)
+	{
+	  [NSException raise: NSInvalidArgumentException
+		      format: @"replace characters with non-string"];
+	}
+      length = [aString length];
+    }
+  if (length > sizeof(buf) / sizeof(unichar))
+    {
+      u = NSZoneMalloc(NSDefaultMallocZone(), length * sizeof(unichar));
+    }
+  [aString getCharacters: u range: NSMakeRange(0, length)];
+
+  /*
+   * Insertions and deletions within a single leaf are done in place,
+   * anything else by splitting the rope and joining the parts again.
+   */
+  if (aRange.length == 0)
+    {
+      if (length > 0 && ropeInsert(_zone, _root, aRange.location,
+	u, length, ropeIsWide(u, length)) == NO)
+	{
+	  _root = ropeReplace(_zone, _root, aRange, u, length);
+	}
+    }
+  else if (length > 0
+    || ropeDelete(_root, aRange.location, aRange.length) == NO)
+    {
+      _root = ropeReplace(_zone, _root, aRange, u, length);
+    }
+  _count += length - aRange.length;
+  _flags.hash = 0;
+  if (u != buf)
+    {
+      NSZoneFree(NSDefaultMallocZone(), u);
+    }
+  if (_count < ROPE_MIN / 2)
+    {
+      GSRopeToStr(self);
+    }
+}
+
+- (void) setString: (NSString*)aString
+{
+  GSRopeToStr(self);
+  [self setString: aString];
+}
+
+@end
+
 
 
 static BOOL
@@ -2341,79 +2341,23 @@ compare(id elem1, id elem2, void* context)
 - (void) sortUsingFunction: (NSComparisonResult (*)(id,id,void*))compare
 		   context: (void*)context
 {
-  /* Shell sort algorithm taken from SortingInAction - a NeXT example */
-#define STRIDE_FACTOR 3	// good value for stride factor is not well-understood
-                        // 3 is a fairly good choice (Sedgewick)
-  unsigned int	c;
-  unsigned int	d;
-  unsigned int	stride = 1;
-  BOOL		found;
-  unsigned int	count = [self count];
-#ifdef	GSWARN
-  BOOL		badComparison = NO;
-#endif
+  NSUInteger	count = [self count];
 
-  while (stride <= count)
+  /* Sort a buffer of the objects and then put them back all at once,
+   * rather than moving objects around in the array.
+   */
+  if (count > 1)
     {
-      stride = stride * STRIDE_FACTOR + 1;
-    }
+      NSArray	*a;
+      GS_BEGINIDBUF(objects, count);
 
-  while (stride > (STRIDE_FACTOR - 1))
-    {
-      // loop to sort for each value of stride
-      stride = stride / STRIDE_FACTOR;
-      for (c = stride; c < count; c++)
-	{
-	  found = NO;
-	  if (stride > c)
-	    {
-	      break;
-	    }
-	  d = c - stride;
-	  while (!found)	/* move to left until correct place */
-	    {
-	      id			a = [self objectAtIndex: d + stride];
-	      id			b = [self objectAtIndex: d];
-	      NSComparisonResult	r;
-
-	      r = (*compare)(a, b, context);
-	      if (r < 0)
-		{
-#ifdef	GSWARN
-		  if (r != NSOrderedAscending)
-		    {
-		      badComparison = YES;
-		    }
-#endif
-		  IF_NO_GC(RETAIN(a));
-		  [self replaceObjectAtIndex: d + stride withObject: b];
-		  [self replaceObjectAtIndex: d withObject: a];
-		  RELEASE(a);
-		  if (stride > d)
-		    {
-		      break;
-		    }
-		  d -= stride;		// jump by stride factor
-		}
-	      else
-		{
-#ifdef	GSWARN
-		  if (r != NSOrderedDescending && r != NSOrderedSame)
-		    {
-		      badComparison = YES;
-		    }
-#endif
-		  found = YES;
-		}
-	    }
-	}
-    }
-#ifdef	GSWARN
-  if (badComparison == YES)
-    {
-      NSWarnMLog(@"Detected bad return value from comparison");
+      [self getObjects: objects];
+      GSPrivateSort(objects, count, compare, context);
+      a = [[NSArray alloc] initWithObjects: objects count: count];
+      [self setArray: a];
+      RELEASE(a);
+      GS_ENDIDBUF();
     }
-#endif
 }
 
 /**
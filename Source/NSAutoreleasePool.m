@@ -185,6 +185,16 @@ static Class PoolClass;
   return;
 }
 
++ (NSUInteger) drainCount
+{
+  return 0;
+}
+
++ (NSUInteger) drainedObjectCount
+{
+  return 0;
+}
+
 + (void) enableRelease: (BOOL)enable
 {
   return;
@@ -195,6 +205,16 @@ static Class PoolClass;
   return;
 }
 
++ (unsigned) peakPoolDepth
+{
+  return 0;
+}
+
++ (void) resetStatistics
+{
+  return;
+}
+
 + (void) setPoolCountThreshhold: (unsigned)c
 {
   return;
@@ -216,16 +236,20 @@ static Class PoolClass;
    Thus memory for objects use grows, and grows, and... */
 static BOOL autorelease_enabled = YES;
 
-/* When the _released_count of a pool gets over this value, we raise
+/* When the number of objects in a pool gets over this value, we raise
    an exception.  This can be adjusted with +setPoolCountThreshhold */
 static unsigned pool_count_warning_threshhold = UINT_MAX;
 
+/* Set when either of the above is changed from its default, so that
+   adding an object needs to check them. */
+static BOOL check_additions = NO;
+
 /* When the number of pools in a thread gets over this value, we raise
    an exception.  This can be adjusted with +setPoolNumberThreshhold */
 static unsigned pool_number_warning_threshhold = 10000;
 
-/* The size of the first _released array. */
-#define BEGINNING_POOL_SIZE 32
+/* The size (in bytes) of each page of the autorelease stack. */
+#define ARP_PAGE_SIZE 4096
 
 /* Easy access to the thread variables belonging to NSAutoreleasePool. */
 #define ARP_THREAD_VARS (&((GSCurrentThread())->_autorelease_vars))
@@ -236,7 +260,7 @@ static unsigned pool_number_warning_threshhold = 10000;
 - (void) _reallyDealloc;
 @end
 
-
+
 /* Functions for managing a per-thread cache of NSAutoreleasedPool's
    already alloc'ed.  The cache is kept in the autorelease_thread_var
    structure, which is an ivar of NSThread. */
@@ -292,7 +316,124 @@ pop_pool_from_cache (struct autorelease_thread_vars *tv)
   return tv->pool_cache[--(tv->pool_cache_count)];
 }
 
-
+
+/* Functions for managing the per-thread stack of autoreleased objects.
+   The stack is a doubly linked list of fixed size pages, and pages
+   above the top of the stack are kept for re-use until the pool cache
+   is freed. */
+
+/* Moves the top of the stack to the start of the next page (allocating
+   it if necessary).  Called when the current page is full. */
+static void
+grow_stack (struct autorelease_thread_vars *tv)
+{
+  struct autorelease_page	*page = tv->stack_page;
+  struct autorelease_page	*next;
+
+  if (page != 0 && page->next != 0)
+    {
+      next = page->next;
+    }
+  else
+    {
+      next = (struct autorelease_page*)
+	NSZoneMalloc(NSDefaultMallocZone(), ARP_PAGE_SIZE);
+      next->prev = page;
+      next->next = 0;
+      next->limit = (id*)((char*)next + ARP_PAGE_SIZE);
+      if (page != 0)
+	{
+	  page->next = next;
+	}
+    }
+  tv->stack_page = next;
+  tv->stack_top = next->objects;
+  tv->stack_limit = next->limit;
+}
+
+/* Frees the pages above the one currently at the top of the stack. */
+static void
+free_spare_pages (struct autorelease_thread_vars *tv)
+{
+  struct autorelease_page	*page = tv->stack_page;
+
+  if (page != 0)
+    {
+      struct autorelease_page	*next = page->next;
+
+      page->next = 0;
+      while (next != 0)
+	{
+	  page = next;
+	  next = page->next;
+	  NSZoneFree(NSDefaultMallocZone(), page);
+	}
+    }
+}
+
+/* Frees all the pages of the stack. */
+static void
+free_stack (struct autorelease_thread_vars *tv)
+{
+  struct autorelease_page	*page = tv->stack_page;
+
+  if (page != 0)
+    {
+      free_spare_pages(tv);
+      while (page != 0)
+	{
+	  struct autorelease_page	*prev = page->prev;
+
+	  NSZoneFree(NSDefaultMallocZone(), page);
+	  page = prev;
+	}
+      tv->stack_page = 0;
+      tv->stack_top = 0;
+      tv->stack_limit = 0;
+    }
+}
+
+/* Counts the objects on the stack from the position (page, start) up to
+   the position (endPage, end), counting only those equal to anObject
+   if that is not nil. */
+static unsigned
+count_objects (struct autorelease_page *page, id *start,
+  struct autorelease_page *endPage, id *end, id anObject)
+{
+  unsigned	count = 0;
+
+  while (page != 0)
+    {
+      id	*limit = (page == endPage) ? end : page->limit;
+
+      if (nil == anObject)
+	{
+	  count += limit - start;
+	}
+      else
+	{
+	  while (start < limit)
+	    {
+	      if (*start++ == anObject)
+		{
+		  count++;
+		}
+	    }
+	}
+      if (page == endPage)
+	{
+	  break;
+	}
+      page = page->next;
+      if (page != 0)
+	{
+	  start = page->objects;
+	}
+    }
+  return count;
+}
+
+
 #if __OBJC_GC__
 @implementation GSAutoreleasePool
 #else
@@ -335,85 +476,74 @@ pop_pool_from_cache (struct autorelease_thread_vars *tv)
 
 - (id) init
 {
-  if (!_released_head)
+  struct autorelease_thread_vars *tv = ARP_THREAD_VARS;
+
+  if (0 == _addImp)
     {
       _addImp = (void (*)(id, SEL, id))
 	[self methodForSelector: @selector(addObject:)];
-      /* Allocate the array that will be the new head of the list of arrays. */
-      _released = (struct autorelease_array_list*)
-	NSZoneMalloc(NSDefaultMallocZone(),
-	sizeof(struct autorelease_array_list)
-	+ (BEGINNING_POOL_SIZE * sizeof(id)));
-      /* Currently no NEXT array in the list, so NEXT == NULL. */
-      _released->next = NULL;
-      _released->size = BEGINNING_POOL_SIZE;
-      _released->count = 0;
-      _released_head = _released;
-      _released_count = 0;
     }
-  else
-    /* Already initialized; (it came from autorelease_pool_cache);
-       we don't have to allocate new array list memory. */
+
+  /* Our objects start at the current top of the thread's stack.
+   */
+  if (0 == tv->stack_page)
     {
-      _released = _released_head;
+      grow_stack(tv);
     }
+  _vars = tv;
+  _page = tv->stack_page;
+  _start = tv->stack_top;
 
   /* Install ourselves as the current pool.
    * The only other place where the parent/child linked list is modified
    * should be in -dealloc
    */
-  {
-    struct autorelease_thread_vars *tv = ARP_THREAD_VARS;
-    unsigned	level = 0;
-    _parent = tv->current_pool;
-    if (_parent)
-      {
-	NSAutoreleasePool	*pool = _parent;
-
-	while (nil != pool)
-	  {
-	    level++;
-	    pool = pool->_parent;
-	  }
-        _parent->_child = self;
-      }
-    tv->current_pool = self;
-    if (level > pool_number_warning_threshhold)
-      {
-	[NSException raise: NSGenericException
-	  format: @"Too many (%u) autorelease pools ... leaking them?", level];
-      }
-  }
+  _parent = tv->current_pool;
+  if (_parent)
+    {
+      _parent->_child = self;
+    }
+  tv->current_pool = self;
+  if (++tv->depth > tv->peak_depth)
+    {
+      tv->peak_depth = tv->depth;
+    }
+  if (tv->depth > pool_number_warning_threshhold)
+    {
+      [NSException raise: NSGenericException
+	format: @"Too many (%u) autorelease pools ... leaking them?",
+	tv->depth];
+    }
 
   return self;
 }
 
 - (unsigned) autoreleaseCount
 {
-  unsigned count = 0;
-  struct autorelease_array_list *released = _released_head;
-  while (released != 0)
+  struct autorelease_thread_vars *tv = _vars;
+
+  if (nil != _child)
     {
-      count += released->count;
-      released = released->next;
+      return count_objects(_page, _start, _child->_page, _child->_start, nil);
     }
-  return count;
+  return count_objects(_page, _start, tv->stack_page, tv->stack_top, nil);
 }
 
 - (unsigned) autoreleaseCountForObject: (id)anObject
 {
-  unsigned count = 0;
-  struct autorelease_array_list *released = _released_head;
-  unsigned int i;
+  struct autorelease_thread_vars *tv = _vars;
 
-  while (released != 0)
+  if (nil == anObject)
     {
-      for (i = 0; i < released->count; i++)
-	if (released->objects[i] == anObject)
-	  count++;
-      released = released->next;
+      return 0;
     }
-  return count;
+  if (nil != _child)
+    {
+      return count_objects(_page, _start,
+	_child->_page, _child->_start, anObject);
+    }
+  return count_objects(_page, _start,
+    tv->stack_page, tv->stack_top, anObject);
 }
 
 + (unsigned) autoreleaseCountForObject: (id)anObject
@@ -470,46 +600,28 @@ pop_pool_from_cache (struct autorelease_thread_vars *tv)
 
 - (void) addObject: (id)anObj
 {
-  /* If the global, static variable AUTORELEASE_ENABLED is not set,
-     do nothing, just return. */
-  if (!autorelease_enabled)
-    return;
+  struct autorelease_thread_vars *tv = _vars;
 
-  if (_released_count >= pool_count_warning_threshhold)
-    [NSException raise: NSGenericException
-		 format: @"AutoreleasePool count threshhold exceeded."];
-
-  /* Get a new array for the list, if the current one is full. */
-  while (_released->count == _released->size)
+  if (check_additions)
     {
-      if (_released->next)
-	{
-	  /* There is an already-allocated one in the chain; use it. */
-	  _released = _released->next;
-	}
-      else
-	{
-	  /* We are at the end of the chain, and need to allocate a new one. */
-	  struct autorelease_array_list *new_released;
-	  unsigned new_size = _released->size * 2;
-	
-	  new_released = (struct autorelease_array_list*)
-	    NSZoneMalloc(NSDefaultMallocZone(),
-	    sizeof(struct autorelease_array_list) + (new_size * sizeof(id)));
-	  new_released->next = NULL;
-	  new_released->size = new_size;
-	  new_released->count = 0;
-	  _released->next = new_released;
-	  _released = new_released;
-	}
+      /* If the global, static variable AUTORELEASE_ENABLED is not set,
+	 do nothing, just return. */
+      if (!autorelease_enabled)
+	return;
+
+      if ([tv->current_pool autoreleaseCount] >= pool_count_warning_threshhold)
+	[NSException raise: NSGenericException
+		     format: @"AutoreleasePool count threshhold exceeded."];
     }
 
-  /* Put the object at the end of the list. */
-  _released->objects[_released->count] = anObj;
-  (_released->count)++;
+  /* Get a new page for the stack, if the current one is full. */
+  if (tv->stack_top == tv->stack_limit)
+    {
+      grow_stack(tv);
+    }
 
-  /* Keep track of the total number of objects autoreleased in this pool */
-  _released_count++;
+  /* Put the object on the top of the stack. */
+  *tv->stack_top++ = anObj;
 }
 
 - (void) drain
@@ -533,7 +645,7 @@ pop_pool_from_cache (struct autorelease_thread_vars *tv)
 
 - (void) dealloc
 {
-  struct autorelease_thread_vars *tv = ARP_THREAD_VARS;
+  struct autorelease_thread_vars *tv = _vars;
 
   [self emptyPool];
 
@@ -552,6 +664,7 @@ pop_pool_from_cache (struct autorelease_thread_vars *tv)
       _parent->_child = nil;
       _parent = nil;
     }
+  tv->depth--;
 
   /* Don't deallocate ourself, just save us for later use. */
   push_pool_to_cache (tv, self);
@@ -560,9 +673,13 @@ pop_pool_from_cache (struct autorelease_thread_vars *tv)
 
 - (void) emptyPool
 {
-  unsigned	i;
-  Class		classes[16];
-  IMP	 	imps[16];
+  struct autorelease_thread_vars *tv = _vars;
+  struct autorelease_page	*page;
+  id				*pos;
+  NSUInteger			count = 0;
+  unsigned			i;
+  Class				classes[16];
+  IMP	 			imps[16];
 
   for (i = 0; i < 16; i++)
     {
@@ -570,108 +687,112 @@ pop_pool_from_cache (struct autorelease_thread_vars *tv)
       imps[i] = 0;
     }
 
-  /*
-   * Loop throught the deallocation code repeatedly ... since we deallocate
-   * objects in the receiver while the receiver remains set as the current
-   * autorelease pool ... so if any object which is being deallocated adds
-   * any object to the current autorelease pool, we may need to release it
-   * again.
+  /* If there are NSAutoreleasePool below us in the list of
+   * NSAutoreleasePools, then deallocate them also.
+   * The (only) way we could get in this situation (in correctly
+   * written programs, that don't release NSAutoreleasePools in
+   * weird ways), is if an exception threw us up the stack.
+   * However, if a program has leaked pools we may be deallocating
+   * a pool with LOTS of children. To avoid stack overflow we
+   * therefore deallocate children starting with the youngest first.
    */
-  while (_child != nil || _released_count > 0)
-    {
-      volatile struct autorelease_array_list *released;
-
-      /* If there are NSAutoreleasePool below us in the list of
-       * NSAutoreleasePools, then deallocate them also.
-       * The (only) way we could get in this situation (in correctly
-       * written programs, that don't release NSAutoreleasePools in
-       * weird ways), is if an exception threw us up the stack.
-       * However, if a program has leaked pools we may be deallocating
-       * a pool with LOTS of children. To avoid stack overflow we
-       * therefore deallocate children starting with the oldest first.
+  if (nil != _child)
+    {
+      NSAutoreleasePool	*pool = _child;
+
+      /* Find other end of linked list ... youngest child.
+       */
+      while (nil != pool->_child)
+	{
+	  pool = pool->_child;
+	}
+      /* Deallocate the children in the list.
        */
-      if (nil != _child)
+      while (pool != self)
 	{
-	  NSAutoreleasePool	*pool = _child;
+	  pool = pool->_parent;
+	  [pool->_child dealloc];
+	}
+    }
 
-	  /* Find other end of linked list ... oldest child.
-	   */
-	  while (nil != pool->_child)
-	    {
-	      pool = pool->_child;
-	    }
-	  /* Deallocate the children in the list.
-	   */
-          while (pool != self)
+  /*
+   * Release our objects in the order they were added, taking each off the
+   * stack just before releasing it, so if we are doing
+   * "double_release_check"ing, then autoreleaseCountForObject: won't find
+   * the object we are currently releasing.
+   * Releasing an object may add other objects to the top of the stack
+   * (which may move on to later pages), so we check for the end of the
+   * stack each time round the outer loop, and stop when we reach it.
+   */
+  page = _page;
+  pos = _start;
+  for (;;)
+    {
+      id	*end;
+
+      end = (page == tv->stack_page) ? tv->stack_top : page->limit;
+      if (pos == end)
+	{
+	  if (page == tv->stack_page)
 	    {
-	      pool = pool->_parent;
-	      [pool->_child dealloc];
+	      break;
 	    }
+	  page = page->next;
+	  pos = page->objects;
+	  continue;
 	}
-
-      /* Take the object out of the released list just before releasing it,
-       * so if we are doing "double_release_check"ing, then
-       * autoreleaseCountForObject: won't find the object we are currently
-       * releasing. */
-      released = _released_head;
-      while (released != 0)
+      count += end - pos;
+      while (pos < end)
 	{
-	  id	*objects = (id*)(released->objects);
+	  id		anObject = *pos;
+	  Class		c;
+	  unsigned	hash;
 
-	  for (i = 0; i < released->count; i++)
+	  *pos++ = nil;
+	  if (anObject == nil)
 	    {
-	      id	anObject;
-	      Class	c;
-	      unsigned	hash;
-
-	      anObject = objects[i];
-	      objects[i] = nil;
-              if (anObject == nil)
-                {
-                  fprintf(stderr,
-                    "nil object encountered in autorelease pool\n");
-                  continue;
-                }
-	      c = object_getClass(anObject);
-              if (c == 0)
-                {
-                  [NSException raise: NSInternalInconsistencyException
-                    format: @"nul class for object in autorelease pool"];
-                }
-	      hash = (((unsigned)(uintptr_t)c) >> 3) & 0x0f;
-	      if (classes[hash] != c)
-		{
-                  /* If anObject was an instance, c is it's class.
-                   * If anObject was a class, c is its metaclass.
-                   * Either way, we should get the appropriate pointer.
-                   * If anObject is a proxy to something,
-                   * the +instanceMethodForSelector: and -methodForSelector:
-                   * methods may not exist, but this will return the
-                   * address of the forwarding method if necessary.
-                   */
-		  imps[hash]
-		    = class_getMethodImplementation(c, @selector(release));
-		  classes[hash] = c;
-		}
-	      (imps[hash])(anObject, @selector(release));
+	      fprintf(stderr,
+		"nil object encountered in autorelease pool\n");
+	      continue;
+	    }
+	  c = object_getClass(anObject);
+	  if (c == 0)
+	    {
+	      [NSException raise: NSInternalInconsistencyException
+		format: @"nul class for object in autorelease pool"];
 	    }
-	  _released_count -= released->count;
-	  released->count = 0;
-	  released = released->next;
+	  hash = (((unsigned)(uintptr_t)c) >> 3) & 0x0f;
+	  if (classes[hash] != c)
+	    {
+	      /* If anObject was an instance, c is it's class.
+	       * If anObject was a class, c is its metaclass.
+	       * Either way, we should get the appropriate pointer.
+	       * If anObject is a proxy to something,
+	       * the +instanceMethodForSelector: and -methodForSelector:
+	       * methods may not exist, but this will return the
+	       * address of the forwarding method if necessary.
+	       */
+	      imps[hash]
+		= class_getMethodImplementation(c, @selector(release));
+	      classes[hash] = c;
+	    }
+	  (imps[hash])(anObject, @selector(release));
 	}
     }
+
+  /* Everything from our start position is now gone from the stack.
+   */
+  tv->stack_page = _page;
+  tv->stack_top = _start;
+  tv->stack_limit = _page->limit;
+  tv->drain_count++;
+  tv->drained_objects += count;
 }
 
 - (void) _reallyDealloc
 {
-  struct autorelease_array_list *a;
-  for (a = _released_head; a;)
-    {
-      void *n = a->next;
-      NSZoneFree(NSDefaultMallocZone(), a);
-      a = n;
-    }
-  _released = _released_head = 0;
+  _page = 0;
+  _start = 0;
   [super dealloc];
 }
 
@@ -710,23 +831,64 @@ pop_pool_from_cache (struct autorelease_thread_vars *tv)
       [pool _reallyDealloc];
       pool = p;
     }
+  tv->current_pool = nil;
+  tv->depth = 0;
 
   free_pool_cache(tv);
+  free_stack(tv);
+}
+
++ (NSUInteger) drainCount
+{
+  return ARP_THREAD_VARS->drain_count;
+}
+
++ (NSUInteger) drainedObjectCount
+{
+  return ARP_THREAD_VARS->drained_objects;
 }
 
 + (void) enableRelease: (BOOL)enable
 {
   autorelease_enabled = enable;
+  check_additions = (autorelease_enabled == NO
+    || pool_count_warning_threshhold != UINT_MAX) ? YES : NO;
 }
 
 + (void) freeCache
 {
-  free_pool_cache(ARP_THREAD_VARS);
+  struct autorelease_thread_vars *tv = ARP_THREAD_VARS;
+
+  free_pool_cache(tv);
+  if (nil == tv->current_pool)
+    {
+      free_stack(tv);
+    }
+  else
+    {
+      free_spare_pages(tv);
+    }
+}
+
++ (unsigned) peakPoolDepth
+{
+  return ARP_THREAD_VARS->peak_depth;
+}
+
++ (void) resetStatistics
+{
+  struct autorelease_thread_vars *tv = ARP_THREAD_VARS;
+
+  tv->peak_depth = tv->depth;
+  tv->drain_count = 0;
+  tv->drained_objects = 0;
 }
 
 + (void) setPoolCountThreshhold: (unsigned)c
 {
   pool_count_warning_threshhold = c;
+  check_additions = (autorelease_enabled == NO
+    || pool_count_warning_threshhold != UINT_MAX) ? YES : NO;
 }
 
 + (void) setPoolNumberThreshhold: (unsigned)c
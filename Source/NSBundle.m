@@ -1746,6 +1746,7 @@ IF_NO_GC(
 	  [load_lock unlock];
 	  return NO;
 	}
+      GSPrivateKVCCacheFlush();
 
       /* We now construct the list of bundles from frameworks linked with
 	 this one */
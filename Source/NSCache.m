@@ -22,37 +22,129 @@
    Boston, MA 02111 USA.
    */ 
 
+#define	GS_NSCache_IVARS \
+  pthread_mutex_t	_lock; \
+  _GSCachedObject	*_mostRecent; \
+  _GSCachedObject	*_leastRecent; \
+  NSUInteger		_hits; \
+  NSUInteger		_misses; \
+  NSUInteger		_evictions
+
 #import "common.h"
 
 #define	EXPOSE_NSCache_IVARS	1
 
+@class	_GSCachedObject;
+
+#import "GSPThread.h"
 #import "Foundation/NSArray.h"
 #import "Foundation/NSCache.h"
 #import "Foundation/NSDictionary.h"
 #import "Foundation/NSEnumerator.h"
 
+#define	GSInternal		NSCacheInternal
+#include	"GSInternal.h"
+GS_PRIVATE_INTERNAL(NSCache)
+
 /**
  * _GSCachedObject is effectively used as a structure containing the various
  * things that need to be associated with objects stored in an NSCache.  It is
  * an NSObject subclass so that it can be used with OpenStep collection
- * classes.
+ * classes.<br />
+ * The prev and next pointers link every object in the cache into a doubly
+ * linked list in order of use (most recently used first), so that lookup,
+ * removal and eviction of the least recently used object are all O(1).
+ * The links are not retained; the _objects dictionary owns the entries.
  */
 @interface _GSCachedObject : NSObject
 {
   @public
   id object;
   NSString *key;
-  int accessCount;
   NSUInteger cost;
+  _GSCachedObject *prev;
+  _GSCachedObject *next;
+  BOOL isDiscardable;
   BOOL isEvictable;
 }
 @end
 
 @interface NSCache (EvictionPolicy)
 /** The method controlling eviction policy in an NSCache. */
-- (void) _evictObjectsToMakeSpaceForObjectWithCost: (NSUInteger)cost;
+- (void) _evictObjectsToMakeSpaceForObjectWithCost: (NSUInteger)cost
+				       evicted: (NSMutableArray*)evicted;
 @end
 
+/* Add an object at the most recently used end of the list.
+ */
+static inline void
+lruAdd(_GSCachedObject **mru, _GSCachedObject **lru, _GSCachedObject *o)
+{
+  o->prev = nil;
+  o->next = *mru;
+  if (nil == *mru)
+    {
+      *lru = o;
+    }
+  else
+    {
+      (*mru)->prev = o;
+    }
+  *mru = o;
+}
+
+/* Unlink an object from the list.
+ */
+static inline void
+lruRemove(_GSCachedObject **mru, _GSCachedObject **lru, _GSCachedObject *o)
+{
+  if (nil == o->prev)
+    {
+      *mru = o->next;
+    }
+  else
+    {
+      o->prev->next = o->next;
+    }
+  if (nil == o->next)
+    {
+      *lru = o->prev;
+    }
+  else
+    {
+      o->next->prev = o->prev;
+    }
+  o->prev = nil;
+  o->next = nil;
+}
+
+#define	LRU_ADD(o)	\
+  lruAdd(&internal->_mostRecent, &internal->_leastRecent, (o))
+#define	LRU_REMOVE(o)	\
+  lruRemove(&internal->_mostRecent, &internal->_leastRecent, (o))
+
+/* Tell the delegate about objects which have been taken out of the cache.
+ * This is done once the lock has been released, so the delegate is free
+ * to use the cache from within its callback.
+ */
+static void
+notifyDelegate(NSCache *cache, id delegate, NSArray *evicted)
+{
+  NSUInteger	count = [evicted count];
+
+  if (count > 0 && nil != delegate)
+    {
+      NSUInteger	i;
+
+      for (i = 0; i < count; i++)
+	{
+	  _GSCachedObject	*o = [evicted objectAtIndex: i];
+
+	  [delegate cache: cache willEvictObject: o->object];
+	}
+    }
+}
+
 @implementation NSCache
 - (id) init
 {
@@ -60,8 +152,9 @@
     {
       return nil;
     }
+  GS_CREATE_INTERNAL(NSCache)
+  GS_INIT_RECURSIVE_MUTEX(internal->_lock);
   _objects = [NSMutableDictionary new];
-  _accesses = [NSMutableArray new];
   return self;
 }
 
@@ -75,11 +168,26 @@
   return _delegate;
 }
 
+- (NSUInteger) evictionCount
+{
+  return internal->_evictions;
+}
+
 - (BOOL) evictsObjectsWithDiscardedContent
 {
   return _evictsObjectsWithDiscardedContent;
 }
 
+- (NSUInteger) hitCount
+{
+  return internal->_hits;
+}
+
+- (NSUInteger) missCount
+{
+  return internal->_misses;
+}
+
 - (NSString*) name
 {
   return _name;
@@ -87,47 +195,64 @@
 
 - (id) objectForKey: (id)key
 {
-  _GSCachedObject *obj = [_objects objectForKey: key];
+  _GSCachedObject	*obj;
+  id			result = nil;
 
+  pthread_mutex_lock(&internal->_lock);
+  obj = [_objects objectForKey: key];
   if (nil == obj)
     {
-      return nil;
+      internal->_misses++;
     }
-  if (obj->isEvictable)
+  else
     {
-      // Move the object to the end of the access list.
-      [_accesses removeObjectIdenticalTo: obj];
-      [_accesses addObject: obj];
+      internal->_hits++;
+      if (obj != internal->_mostRecent)
+	{
+	  LRU_REMOVE(obj);
+	  LRU_ADD(obj);
+	}
+      /* Retain the result before unlocking so that another thread
+       * evicting the object can't destroy it under our caller.
+       */
+      result = RETAIN(obj->object);
     }
-  obj->accessCount++;
-  _totalAccesses++;
-  return obj->object;
+  pthread_mutex_unlock(&internal->_lock);
+  return AUTORELEASE(result);
 }
 
 - (void) removeAllObjects
 {
-  NSEnumerator *e = [_objects objectEnumerator];
-  _GSCachedObject *obj;
+  NSArray	*evicted;
 
-  while (nil != (obj = [e nextObject]))
-    {
-      [_delegate cache: self willEvictObject: obj->object];
-    }
+  pthread_mutex_lock(&internal->_lock);
+  evicted = [_objects allValues];
   [_objects removeAllObjects];
-  [_accesses removeAllObjects];
-  _totalAccesses = 0;
+  internal->_mostRecent = nil;
+  internal->_leastRecent = nil;
+  _totalCost = 0;
+  pthread_mutex_unlock(&internal->_lock);
+  notifyDelegate(self, _delegate, evicted);
 }
 
 - (void) removeObjectForKey: (id)key
 {
-  _GSCachedObject *obj = [_objects objectForKey: key];
+  _GSCachedObject	*obj;
 
+  pthread_mutex_lock(&internal->_lock);
+  obj = [_objects objectForKey: key];
   if (nil != obj)
     {
-      [_delegate cache: self willEvictObject: obj->object];
-      _totalAccesses -= obj->accessCount;
+      RETAIN(obj);
+      LRU_REMOVE(obj);
+      _totalCost -= obj->cost;
       [_objects removeObjectForKey: key];
-      [_accesses removeObjectIdenticalTo: obj];
+    }
+  pthread_mutex_unlock(&internal->_lock);
+  if (nil != obj)
+    {
+      [_delegate cache: self willEvictObject: obj->object];
+      RELEASE(obj);
     }
 }
 
@@ -153,14 +278,20 @@
 
 - (void) setObject: (id)obj forKey: (id)key cost: (NSUInteger)num
 {
-  _GSCachedObject *oldObject = [_objects objectForKey: key];
-  _GSCachedObject *newObject;
+  NSMutableArray	*evicted = [NSMutableArray array];
+  _GSCachedObject	*oldObject;
+  _GSCachedObject	*newObject;
 
+  pthread_mutex_lock(&internal->_lock);
+  oldObject = [_objects objectForKey: key];
   if (nil != oldObject)
     {
-      [self removeObjectForKey: oldObject->key];
+      [evicted addObject: oldObject];
+      LRU_REMOVE(oldObject);
+      _totalCost -= oldObject->cost;
+      [_objects removeObjectForKey: key];
     }
-  [self _evictObjectsToMakeSpaceForObjectWithCost: num];
+  [self _evictObjectsToMakeSpaceForObjectWithCost: num evicted: evicted];
   newObject = [_GSCachedObject new];
   // Retained here, released when obj is dealloc'd
   newObject->object = RETAIN(obj);
@@ -168,12 +299,15 @@
   newObject->cost = num;
   if ([obj conformsToProtocol: @protocol(NSDiscardableContent)])
     {
+      newObject->isDiscardable = YES;
       newObject->isEvictable = YES;
-      [_accesses addObject: newObject];
     }
   [_objects setObject: newObject forKey: key];
+  LRU_ADD(newObject);
   RELEASE(newObject);
   _totalCost += num;
+  pthread_mutex_unlock(&internal->_lock);
+  notifyDelegate(self, _delegate, evicted);
 }
 
 - (void) setObject: (id)obj forKey: (id)key
@@ -193,75 +327,69 @@
 
 /**
  * This method is the one that handles the eviction policy.  This
- * implementation uses a relatively simple LRU/LFU hybrid.  The NSCache
- * documentation from Apple makes it clear that the policy may change, so we
- * could in future have a class cluster with pluggable policies for different
- * caches or some other mechanism.
+ * implementation uses a simple LRU policy, walking from the least recently
+ * used end of the list until both the count and cost limits are satisfied.
+ * Objects implementing NSDiscardableContent are first asked to discard their
+ * contents, and are only removed if that succeeds and the cache evicts
+ * objects with discarded content.  Objects whose contents cannot be
+ * discarded (because they are in use) are skipped.<br />
+ * Removed objects are added to the evicted array so that the caller can
+ * notify the delegate once the lock has been released.<br />
+ * The NSCache documentation from Apple makes it clear that the policy may
+ * change, so we could in future have a class cluster with pluggable policies
+ * for different caches or some other mechanism.
  */
 - (void)_evictObjectsToMakeSpaceForObjectWithCost: (NSUInteger)cost
+					  evicted: (NSMutableArray*)evicted
 {
-  NSUInteger spaceNeeded = 0;
-  NSUInteger count = [_objects count];
-
-  if (_costLimit > 0 && _totalCost + cost > _costLimit)
-    {
-      spaceNeeded = _totalCost + cost - _costLimit;
-    }
+  _GSCachedObject	*obj = internal->_leastRecent;
 
-  // Only evict if we need the space.
-  if (count > 0 && (spaceNeeded > 0 || count >= _countLimit))
+  while (nil != obj)
     {
-      NSMutableArray *evictedKeys = nil;
-      // Round up slightly.
-      NSUInteger averageAccesses = (_totalAccesses / count * 0.2) + 1;
-      NSEnumerator *e = [_accesses objectEnumerator];
-      _GSCachedObject *obj;
+      _GSCachedObject	*prev = obj->prev;
+      NSUInteger	count = [_objects count];
+      BOOL		remove = NO;
 
-      if (_evictsObjectsWithDiscardedContent)
+      if ((0 == _costLimit || _totalCost + cost <= _costLimit)
+	&& (0 == _countLimit || count < _countLimit))
+	{
+	  break;	// Enough space now.
+	}
+      if (NO == obj->isDiscardable)
 	{
-	  evictedKeys = [[NSMutableArray alloc] init];
+	  remove = YES;
 	}
-      while (nil != (obj = [e nextObject]))
+      else if (YES == obj->isEvictable)
 	{
-	  // Don't evict frequently accessed objects.
-	  if (obj->accessCount < averageAccesses && obj->isEvictable)
+	  [obj->object discardContentIfPossible];
+	  if ([obj->object isContentDiscarded])
 	    {
-	      [obj->object discardContentIfPossible];
-	      if ([obj->object isContentDiscarded])
-		{
-		  NSUInteger cost = obj->cost;
-
-		  // Evicted objects have no cost.
-		  obj->cost = 0;
-		  // Don't try evicting this again in future; it's gone already.
-		  obj->isEvictable = NO;
-		  // Remove this object as well as its contents if required
-		  if (_evictsObjectsWithDiscardedContent)
-		    {
-		      [evictedKeys addObject: obj->key];
-		    }
-		  _totalCost -= cost;
-		  // If we've freed enough space, give up
-		  if (cost > spaceNeeded)
-		    {
-		      break;
-		    }
-		  spaceNeeded -= cost;
-		}
+	      // Evicted objects have no cost.
+	      _totalCost -= obj->cost;
+	      obj->cost = 0;
+	      // Don't try evicting this again in future; it's gone already.
+	      obj->isEvictable = NO;
+	      internal->_evictions++;
+	      // Remove this object as well as its contents if required
+	      remove = _evictsObjectsWithDiscardedContent;
 	    }
 	}
-      // Evict all of the objects whose content we have discarded if required
-      if (_evictsObjectsWithDiscardedContent)
+      else if (YES == _evictsObjectsWithDiscardedContent)
 	{
-	  NSString *key;
-
-	  e = [evictedKeys objectEnumerator];
-	  while (nil != (key = [e nextObject]))
+	  remove = YES;
+	}
+      if (YES == remove)
+	{
+	  if (NO == obj->isDiscardable)
 	    {
-	      [self removeObjectForKey: key];
+	      internal->_evictions++;
 	    }
+	  [evicted addObject: obj];
+	  LRU_REMOVE(obj);
+	  _totalCost -= obj->cost;
+	  [_objects removeObjectForKey: obj->key];
 	}
-    [evictedKeys release];
+      obj = prev;
     }
 }
 
@@ -269,7 +397,11 @@
 {
   [_name release];
   [_objects release];
-  [_accesses release];
+  if (GS_EXISTS_INTERNAL)
+    {
+      pthread_mutex_destroy(&internal->_lock);
+      GS_DESTROY_INTERNAL(NSCache)
+    }
   [super dealloc];
 }
 @end
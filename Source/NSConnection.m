@@ -44,6 +44,7 @@
   BOOL			_shuttingDown; \
   BOOL			_useKeepalive; \
   BOOL			_keepaliveWait; \
+  BOOL			_pipelining; \
   NSPort		*_receivePort; \
   NSPort		*_sendPort; \
   unsigned		_requestDepth; \
@@ -68,6 +69,13 @@
   NSString		*_remoteName; \
   NSString		*_registeredName; \
   NSPortNameServer	*_nameServer; \
+  NSMutableArray	*_onewayBatch; \
+  NSMutableData		*_onewayCounts; \
+  unsigned		_onewayCount; \
+  int			*_pending; \
+  unsigned		_pendingCount; \
+  unsigned		_pendingSize; \
+  GSIMapTable		_signatures; \
   int			_lastKeepalive
 
 #define	EXPOSE_NSDistantObject_IVARS	1
@@ -139,6 +147,7 @@ static GC_descr	nodeDesc;	// Type descriptor for map node.
 #import "Foundation/NSLock.h"
 #import "Foundation/NSThread.h"
 #import "Foundation/NSPort.h"
+#import "Foundation/NSByteOrder.h"
 #import "Foundation/NSPortMessage.h"
 #import "Foundation/NSPortNameServer.h"
 #import "Foundation/NSNotification.h"
@@ -176,6 +185,8 @@ GSRunLoopForThread(NSThread *aThread)
 - (void) forwardInvocation: (NSInvocation *)inv 
 		  forProxy: (NSDistantObject*)object;
 - (const char *) typeForSelector: (SEL)sel remoteTarget: (unsigned)target;
+- (NSMethodSignature*) _signatureForSelector: (SEL)sel;
+- (void) _setSignature: (NSMethodSignature*)sig forSelector: (SEL)sel;
 @end
 
 #define GS_F_LOCK(X) \
@@ -232,6 +243,8 @@ stringFromMsgType(int type)
 	return @"proxy retain";
       case RETAIN_REPLY:
 	return @"retain replay";
+      case METHOD_BATCH:
+	return @"method batch";
       default:
 	return @"unknown operation type!";
     }
@@ -302,6 +315,7 @@ GS_PRIVATE_INTERNAL(NSConnection)
 #define	IshuttingDown		(internal->_shuttingDown)
 #define	IuseKeepalive		(internal->_useKeepalive)
 #define	IkeepaliveWait		(internal->_keepaliveWait)
+#define	Ipipelining		(internal->_pipelining)
 #define	IreceivePort		(internal->_receivePort)
 #define	IsendPort		(internal->_sendPort)
 #define	IrequestDepth		(internal->_requestDepth)
@@ -327,6 +341,13 @@ GS_PRIVATE_INTERNAL(NSConnection)
 #define	IregisteredName		(internal->_registeredName)
 #define	InameServer		(internal->_nameServer)
 #define	IlastKeepalive		(internal->_lastKeepalive)
+#define	IonewayBatch		(internal->_onewayBatch)
+#define	IonewayCounts		(internal->_onewayCounts)
+#define	IonewayCount		(internal->_onewayCount)
+#define	Ipending		(internal->_pending)
+#define	IpendingCount		(internal->_pendingCount)
+#define	IpendingSize		(internal->_pendingSize)
+#define	Isignatures		(internal->_signatures)
 
 /** </ignore> */
 
@@ -336,6 +357,9 @@ GS_PRIVATE_INTERNAL(NSConnection)
 - (void) _runInNewThread;
 + (void) setDebug: (int)val;
 - (void) _enableKeepalive;
+- (void) _flushOneway;
+- (void) _getPendingReplies;
+- (void) _queueOutRmc: (NSPortCoder*)c;
 
 - (void) addLocalObject: (NSDistantObject*)anObj;
 - (void) removeLocalObject: (NSDistantObject*)anObj;
@@ -366,8 +390,38 @@ GS_PRIVATE_INTERNAL(NSConnection)
 static NSTimer		*timer = nil;
 
 static BOOL cacheCoders = NO;
+
+/* The maximum number of oneway messages sent in a single batch, and of
+ * pipelined requests which may be awaiting replies, when pipelining.
+ */
+#define	MAX_BATCH	64
+#define	MAX_PENDING	64
+
 static int debug_connection = 0;
 
+/* Release the method signatures cached for a connection and free the map.
+ */
+static void
+freeSignatures(GSIMapTable *map)
+{
+  if (*map != 0)
+    {
+      GSIMapEnumerator_t	enumerator;
+      GSIMapNode 		node;
+
+      enumerator = GSIMapEnumeratorForMap(*map);
+      node = GSIMapEnumeratorNextNode(&enumerator);
+      while (node != 0)
+	{
+	  RELEASE(node->value.obj);
+	  node = GSIMapEnumeratorNextNode(&enumerator);
+	}
+      GSIMapEmptyMap(*map);
+      NSZoneFree((*map)->zone, (void*)*map);
+      *map = 0;
+    }
+}
+
 static NSHashTable	*connection_table;
 static GSLazyRecursiveLock		*connection_table_gate = nil;
 
@@ -1246,6 +1300,18 @@ static NSLock	*cached_proxies_gate = nil;
  */
 - (void) invalidate
 {
+  if (IisValid == YES && IonewayBatch != nil)
+    {
+      NS_DURING
+	{
+	  [self _flushOneway];
+	}
+      NS_HANDLER
+	{
+	  NSLog(@"Exception sending batched messages - %@", localException);
+	}
+      NS_ENDHANDLER
+    }
   GS_M_LOCK(IrefGate);
   if (IisValid == NO)
     {
@@ -1358,6 +1424,7 @@ static NSLock	*cached_proxies_gate = nil;
       NSZoneFree(IremoteProxies->zone, (void*)IremoteProxies);
       IremoteProxies = 0;
     }
+  freeSignatures(&Isignatures);
   if (IlocalObjects != 0)
     {
       GSIMapEnumerator_t	enumerator;
@@ -1953,6 +2020,14 @@ static NSLock	*cached_proxies_gate = nil;
 
   DESTROY(IcachedDecoders);
   DESTROY(IcachedEncoders);
+  DESTROY(IonewayBatch);
+  DESTROY(IonewayCounts);
+  if (Ipending != 0)
+    {
+      NSZoneFree(NSDefaultMallocZone(), Ipending);
+      Ipending = 0;
+    }
+  freeSignatures(&Isignatures);
 
   DESTROY(IremoteName);
 
@@ -1961,6 +2036,20 @@ static NSLock	*cached_proxies_gate = nil;
   [arp drain];
 }
 
+/**
+ * <em>GNUstep extension</em><br />
+ * Sends any oneway messages which have been batched up, then waits for
+ * the replies to any pipelined requests still outstanding.  If any of
+ * those requests raised an exception in the remote process, the first
+ * such exception is raised here.<br />
+ * Does nothing unless the connection is pipelining requests.
+ */
+- (void) flushRequests
+{
+  [self _flushOneway];
+  [self _getPendingReplies];
+}
+
 /*
  * NSDistantObject's -forwardInvocation: method calls this to send the message
  * over the wire.
@@ -2038,7 +2127,14 @@ static NSLock	*cached_proxies_gate = nil;
 	}
     }
 
-  [self _sendOutRmc: op type: METHOD_REQUEST];
+  if (needsResponse == NO && Ipipelining == YES)
+    {
+      [self _queueOutRmc: op];
+    }
+  else
+    {
+      [self _sendOutRmc: op type: METHOD_REQUEST];
+    }
   NSDebugMLLog(@"NSConnection", @"Sent message %s RMC %d to 0x%x",
     sel_getName([inv selector]), seq, (uintptr_t)self);
 
@@ -2069,6 +2165,29 @@ static NSLock	*cached_proxies_gate = nil;
       GSIMapRemoveKey(IreplyMap, (GSIMapKey)(NSUInteger)seq);
       GSM_UNLOCK(IrefGate);
     }
+  else if (Ipipelining == YES && outParams == NO
+    && *objc_skip_type_qualifiers(type) == _C_VOID)
+    {
+      BOOL	wait;
+
+      /*
+       * No result is needed, so the reply can be collected later.
+       */
+      GS_M_LOCK(IrefGate);
+      if (IpendingCount == IpendingSize)
+	{
+	  IpendingSize = (IpendingSize == 0) ? MAX_PENDING : IpendingSize * 2;
+	  Ipending = NSZoneRealloc(NSDefaultMallocZone(), Ipending,
+	    IpendingSize * sizeof(int));
+	}
+      Ipending[IpendingCount++] = seq;
+      wait = (IpendingCount >= MAX_PENDING) ? YES : NO;
+      GSM_UNLOCK(IrefGate);
+      if (wait == YES)
+	{
+	  [self _getPendingReplies];
+	}
+    }
   else
     {
       int		argnum;
@@ -2083,6 +2202,10 @@ static NSLock	*cached_proxies_gate = nil;
 	  [NSException raise: NSGenericException
 	    format: @"connection waiting for request was shut down"];
 	}
+      if (IpendingCount > 0)
+	{
+	  [self _getPendingReplies];
+	}
       aRmc = [self _getReplyRmc: seq];
  
       /*
@@ -2192,6 +2315,174 @@ static NSLock	*cached_proxies_gate = nil;
     }
 }
 
+/**
+ * <em>GNUstep extension</em><br />
+ * Returns YES if the connection is pipelining requests (see
+ * -setPipelinesRequests:), NO otherwise.
+ */
+- (BOOL) pipelinesRequests
+{
+  return Ipipelining;
+}
+
+/**
+ * <em>GNUstep extension</em><br />
+ * Sets whether the connection pipelines the requests it sends.<br />
+ * Normally every message sent through a connection waits for its reply
+ * from the remote process before returning.  When pipelining:
+ * <list>
+ *   <item>Messages which return void and have no pass-by-reference
+ *   arguments are sent without waiting for the reply.  The replies are
+ *   collected before the next message which needs a result is sent,
+ *   when more than a few are outstanding, or when -flushRequests is
+ *   called, and an exception raised by such a message in the remote
+ *   process is raised at that point rather than by the message itself.
+ *   </item>
+ *   <item>oneway void messages are batched and sent as a single port
+ *   message, either at the end of the current run loop iteration, when
+ *   another message is sent, or when -flushRequests is called.</item>
+ * </list>
+ * This greatly increases the rate at which bursts of small messages can
+ * be sent, but the process at the other end of the connection must be
+ * using a version of GNUstep which understands batched messages.<br />
+ * Turning pipelining off flushes any outstanding requests.
+ */
+- (void) setPipelinesRequests: (BOOL)flag
+{
+  if (NO == flag && YES == Ipipelining)
+    {
+      Ipipelining = NO;
+      [self flushRequests];
+    }
+  Ipipelining = flag;
+}
+
+/**
+ * <em>GNUstep extension</em><br />
+ * Adds the method signatures of all the methods in aProtocol (and in
+ * the protocols it adopts) to the cache of signatures shared by the
+ * proxies using the receiver, so that those proxies need not ask the
+ * remote process for the signatures when the methods are first used.
+ * <br />
+ * Unlike -[NSDistantObject setProtocolForProxy:] this affects every
+ * proxy for an object in the remote process, including proxies which
+ * have not yet been created.
+ */
+- (void) addSignaturesFromProtocol: (Protocol*)aProtocol
+{
+  Protocol	**list;
+  unsigned int	count;
+  int		pass;
+
+  if (aProtocol == nil)
+    {
+      return;
+    }
+  for (pass = 0; pass < 4; pass++)
+    {
+      struct objc_method_description	*desc;
+      BOOL				isRequired = (pass & 1) ? NO : YES;
+      BOOL				isInstance = (pass & 2) ? NO : YES;
+
+      desc = protocol_copyMethodDescriptionList(aProtocol,
+	isRequired, isInstance, &count);
+      if (desc != NULL)
+	{
+	  unsigned int	i;
+
+	  for (i = 0; i < count; i++)
+	    {
+	      if (desc[i].name != 0 && desc[i].types != 0)
+		{
+		  NSMethodSignature	*sig;
+
+		  sig = [NSMethodSignature signatureWithObjCTypes:
+		    desc[i].types];
+		  [self _setSignature: sig forSelector: desc[i].name];
+		}
+	    }
+	  free(desc);
+	}
+    }
+  list = protocol_copyProtocolList(aProtocol, &count);
+  if (list != NULL)
+    {
+      unsigned int	i;
+
+      for (i = 0; i < count; i++)
+	{
+	  [self addSignaturesFromProtocol: list[i]];
+	}
+      free(list);
+    }
+}
+
+/* Returns the method signature cached for sel, or nil if there is none.
+ * The signatures are shared by all the proxies using the connection, so
+ * a signature fetched from the remote process for one proxy serves for
+ * all the others.
+ */
+- (NSMethodSignature*) _signatureForSelector: (SEL)sel
+{
+  NSMethodSignature	*sig = nil;
+
+  if (sel == 0 || Isignatures == 0)
+    {
+      return nil;
+    }
+  GS_M_LOCK(IrefGate);
+  if (Isignatures != 0)
+    {
+      GSIMapNode	node;
+
+      node = GSIMapNodeForKey(Isignatures, (GSIMapKey)(void*)sel);
+      if (node != 0)
+	{
+	  sig = AUTORELEASE(RETAIN(node->value.obj));
+	}
+    }
+  GSM_UNLOCK(IrefGate);
+  return sig;
+}
+
+/* Caches sig as the method signature for sel.  Nothing is cached once
+ * the connection has been invalidated.
+ */
+- (void) _setSignature: (NSMethodSignature*)sig forSelector: (SEL)sel
+{
+  GSIMapNode	node;
+
+  if (sel == 0 || sig == nil)
+    {
+      return;
+    }
+  GS_M_LOCK(IrefGate);
+  if (IisValid == NO)
+    {
+      GSM_UNLOCK(IrefGate);
+      return;
+    }
+  if (Isignatures == 0)
+    {
+      NSZone	*z = NSDefaultMallocZone();
+
+      Isignatures = (GSIMapTable)NSZoneMalloc(z, sizeof(GSIMapTable_t));
+      GSIMapInitWithZoneAndCapacity(Isignatures, z, 16);
+    }
+  node = GSIMapNodeForKey(Isignatures, (GSIMapKey)(void*)sel);
+  if (node == 0)
+    {
+      GSIMapAddPair(Isignatures, (GSIMapKey)(void*)sel,
+	(GSIMapVal)(id)RETAIN(sig));
+    }
+  else if (node->value.obj != sig)
+    {
+      RELEASE(node->value.obj);
+      node->value.obj = RETAIN(sig);
+    }
+  GSM_UNLOCK(IrefGate);
+}
+
 - (const char *) typeForSelector: (SEL)sel remoteTarget: (unsigned)target
 {
   id op, ip;
@@ -2287,6 +2578,57 @@ static NSLock	*cached_proxies_gate = nil;
       NSLog(@"  connection is %@", conn);
     }
 
+  if (type == METHOD_BATCH)
+    {
+      NSData		*d = [components objectAtIndex: 0];
+      const uint8_t	*counts = [d bytes];
+      unsigned		total = [components count];
+      unsigned		batch = [d length] / sizeof(uint32_t);
+      unsigned		pos = 1;
+      unsigned		i;
+
+      /* The first component holds the number of components in each of
+       * the requests which follow it.  Handle each of them as a normal
+       * method request.
+       */
+      RETAIN(msg);
+      for (i = 0; i < batch; i++)
+	{
+	  NSPortMessage	*m;
+	  NSArray	*a;
+	  uint32_t	count;
+
+	  memcpy(&count, counts + i * sizeof(uint32_t), sizeof(uint32_t));
+	  count = GSSwapBigI32ToHost(count);
+	  if (count == 0 || count > total - pos)
+	    {
+	      RELEASE(msg);
+	      [NSException raise: NSGenericException
+			  format: @"bad method batch"];
+	    }
+	  a = [components subarrayWithRange: NSMakeRange(pos, count)];
+	  pos += count;
+	  m = [[NSPortMessage alloc] initWithSendPort: sp
+					  receivePort: rp
+					   components: a];
+	  [m setMsgid: METHOD_REQUEST];
+	  NS_DURING
+	    {
+	      [self handlePortMessage: m];
+	    }
+	  NS_HANDLER
+	    {
+	      RELEASE(m);
+	      RELEASE(msg);
+	      [localException raise];
+	    }
+	  NS_ENDHANDLER
+	  RELEASE(m);
+	}
+      RELEASE(msg);
+      return;
+    }
+
   if (GSIVar(conn, _authenticateIn) == YES
     && (type == METHOD_REQUEST || type == METHOD_REPLY))
     {
@@ -2492,6 +2834,160 @@ static NSLock	*cached_proxies_gate = nil;
 }
 
 
+/*
+ * Sends any batched oneway requests as a single METHOD_BATCH message.
+ */
+- (void) _flushOneway
+{
+  NSMutableArray	*batch;
+  NSMutableData		*counts;
+  unsigned		count;
+  NSDate		*limit;
+  BOOL			sent;
+
+  GS_M_LOCK(IrefGate);
+  batch = IonewayBatch;
+  counts = IonewayCounts;
+  count = IonewayCount;
+  IonewayBatch = nil;
+  IonewayCounts = nil;
+  IonewayCount = 0;
+  GSM_UNLOCK(IrefGate);
+  if (batch == nil)
+    {
+      return;
+    }
+
+  [batch insertObject: counts atIndex: 0];
+  limit = [dateClass dateWithTimeIntervalSinceNow: IrequestTimeout];
+  sent = [IsendPort sendBeforeDate: limit
+			     msgid: METHOD_BATCH
+			components: batch
+			      from: IreceivePort
+			  reserved: [IsendPort reservedSpaceLength]];
+  RELEASE(batch);
+  RELEASE(counts);
+  if (sent == NO)
+    {
+      NSLog(@"Port operation timed out - %@ of %u requests",
+	stringFromMsgType(METHOD_BATCH), count);
+    }
+  else
+    {
+      GS_M_LOCK(IrefGate);
+      IreqOutCount += count;
+      GSM_UNLOCK(IrefGate);
+    }
+}
+
+/*
+ * Waits for the replies to any pipelined requests, raising the first
+ * exception (if any) which those requests produced.
+ */
+- (void) _getPendingReplies
+{
+  id	exception = nil;
+
+  for (;;)
+    {
+      NSPortCoder	*rmc;
+      BOOL		is_exception = NO;
+      int		seq;
+
+      GS_M_LOCK(IrefGate);
+      if (IpendingCount == 0)
+	{
+	  GSM_UNLOCK(IrefGate);
+	  break;
+	}
+      seq = Ipending[0];
+      IpendingCount--;
+      memmove(Ipending, Ipending + 1, IpendingCount * sizeof(int));
+      GSM_UNLOCK(IrefGate);
+
+      rmc = [self _getReplyRmc: seq];
+      [rmc decodeValueOfObjCType: @encode(BOOL) at: &is_exception];
+      if (is_exception == YES && exception == nil)
+	{
+	  exception = [rmc decodeObject];
+	}
+      [self _doneInReply: rmc];
+    }
+  if (exception != nil)
+    {
+      [exception raise];
+    }
+}
+
+/*
+ * Adds a oneway request to the batch to be sent at the end of the
+ * current run loop iteration.
+ */
+- (void) _queueOutRmc: (NSPortCoder*)c
+{
+  NSMutableArray	*components = [c _components];
+  NSData		*d = [components objectAtIndex: 0];
+  unsigned		rl = [IsendPort reservedSpaceLength];
+  unsigned		count = [components count];
+  uint32_t		n;
+  BOOL			schedule;
+  BOOL			flush;
+
+  if (IauthenticateOut == YES)
+    {
+      NSData	*a;
+
+      a = [[self delegate] authenticationDataForComponents: components];
+      if (a == nil)
+	{
+	  RELEASE(c);
+	  [NSException raise: NSGenericException
+		      format: @"Bad authentication data provided by delegate"];
+	}
+      [components addObject: a];
+      count++;
+    }
+
+  GS_M_LOCK(IrefGate);
+  schedule = (IonewayBatch == nil) ? YES : NO;
+  if (schedule == YES)
+    {
+      IonewayBatch = [NSMutableArray new];
+      IonewayCounts = [[NSMutableData alloc] initWithLength: rl];
+    }
+  /* The coder re-uses its data, so we copy it (without the space which
+   * the port reserved for its header) into the batch.
+   */
+  d = [d subdataWithRange: NSMakeRange(rl, [d length] - rl)];
+  [IonewayBatch addObject: d];
+  [components removeObjectAtIndex: 0];
+  [IonewayBatch addObjectsFromArray: components];
+  n = GSSwapHostI32ToBig(count);
+  [IonewayCounts appendBytes: &n length: sizeof(n)];
+  flush = (++IonewayCount >= MAX_BATCH) ? YES : NO;
+
+  if (cacheCoders == YES && IcachedEncoders != nil)
+    {
+      [IcachedEncoders addObject: c];
+    }
+  [c dispatch];	/* Tell NSPortCoder to release the connection.	*/
+  RELEASE(c);
+  GSM_UNLOCK(IrefGate);
+
+  if (flush == YES)
+    {
+      [self _flushOneway];
+    }
+  else if (schedule == YES)
+    {
+      [GSRunLoopForThread(nil) performSelector: @selector(_flushOneway)
+					target: self
+				      argument: nil
+					 order: 0
+					 modes: IrequestModes];
+    }
+}
+
 /* NSConnection calls this to service the incoming method request. */
 - (void) _service_forwardForProxy: (NSPortCoder*)aRmc
 {
@@ -3384,6 +3880,14 @@ static NSLock	*cached_proxies_gate = nil;
   BOOL			raiseException = NO;
   NSMutableArray	*components = [c _components];
 
+  /* Batched oneway messages must be sent before anything which follows
+   * them.
+   */
+  if (IonewayBatch != nil)
+    {
+      [self _flushOneway];
+    }
+
   if (IauthenticateOut == YES
     && (msgid == METHOD_REQUEST || msgid == METHOD_REPLY))
     {
@@ -81,6 +81,55 @@ static Class	calendarClass = nil;
 static id _distantPast = nil;
 static id _distantFuture = nil;
 
+#if defined(OBJC_SMALL_OBJECT_SHIFT) && (OBJC_SMALL_OBJECT_SHIFT == 3)
+/* On 64-bit systems, dates whose time interval can be stored in the
+ * pointer are small objects of the GSSmallDate class rather than being
+ * allocated on the heap.  The time interval is stored as for an
+ * NSSmallExtendedDouble, ie. a double whose three low bits are all the
+ * same as the fourth lowest bit.
+ */
+#define SMALL_DATE_MASK 6
+static BOOL useSmallDate;
+
+union BoxedTime
+{
+  id		obj;
+  uintptr_t	bits;
+  NSTimeInterval t;
+};
+
+@interface	GSSmallDate : NSDate
+@end
+
+static inline NSTimeInterval
+unboxSmallDate(uintptr_t boxed)
+{
+  uintptr_t		mask = boxed & 8;
+  union BoxedTime	ret;
+
+  boxed &= ~7;
+  ret.bits = boxed | (mask >> 1) | (mask >> 2) | (mask >> 3);
+  return ret.t;
+}
+
+/* Returns a small date for the time interval, or nil if it can't be
+ * stored in a pointer.
+ */
+static inline id
+boxSmallDate(NSTimeInterval t)
+{
+  union BoxedTime	b = {.t = t};
+
+  if (unboxSmallDate(b.bits) != t)
+    {
+      return nil;
+    }
+  b.bits &= ~OBJC_SMALL_OBJECT_MASK;
+  b.bits |= SMALL_DATE_MASK;
+  return b.obj;
+}
+#endif
+
 
 static NSString*
 findInArray(NSArray *array, unsigned pos, NSString *str)
@@ -106,6 +155,10 @@ otherTime(NSDate* other)
 
   if (other == nil)
     [NSException raise: NSInvalidArgumentException format: @"other time nil"];
+#ifdef SMALL_DATE_MASK
+  if (((uintptr_t)other & OBJC_SMALL_OBJECT_MASK) == SMALL_DATE_MASK)
+    return unboxSmallDate((uintptr_t)other);
+#endif
   if (GSObjCIsInstance(other) == NO)
     [NSException raise: NSInvalidArgumentException format: @"other time bad"];
   c = object_getClass(other);
@@ -139,7 +192,16 @@ otherTime(NSDate* other)
 + (id) alloc
 {
   if (self == abstractClass)
-    return NSAllocateObject(concreteClass, 0, NSDefaultMallocZone());
+    {
+#ifdef SMALL_DATE_MASK
+      /* Return a placeholder which produces a small date when initialised
+       * if it can, or a heap allocated one if not.
+       */
+      if (useSmallDate)
+	return (id)SMALL_DATE_MASK;
+#endif
+      return NSAllocateObject(concreteClass, 0, NSDefaultMallocZone());
+    }
   else
     return NSAllocateObject(self, 0, NSDefaultMallocZone());
 }
@@ -147,7 +209,13 @@ otherTime(NSDate* other)
 + (id) allocWithZone: (NSZone*)z
 {
   if (self == abstractClass)
-    return NSAllocateObject(concreteClass, 0, z);
+    {
+#ifdef SMALL_DATE_MASK
+      if (useSmallDate && (z == 0 || z == NSDefaultMallocZone()))
+	return (id)SMALL_DATE_MASK;
+#endif
+      return NSAllocateObject(concreteClass, 0, z);
+    }
   else
     return NSAllocateObject(self, 0, z);
 }
@@ -166,8 +234,7 @@ otherTime(NSDate* other)
  */
 + (id) date
 {
-  return AUTORELEASE([[self allocWithZone: NSDefaultMallocZone()]
-	initWithTimeIntervalSinceReferenceDate: GSPrivateTimeNow()]);
+  return AUTORELEASE([[self allocWithZone: NSDefaultMallocZone()] init]);
 }
 
 /**
@@ -1046,7 +1113,7 @@ otherTime(NSDate* other)
     }
   else
     {
-      o = [concreteClass allocWithZone: NSDefaultMallocZone()];
+      o = [abstractClass allocWithZone: NSDefaultMallocZone()];
       o = [o initWithTimeIntervalSinceReferenceDate: interval];
     }
   DESTROY(self);
@@ -1603,4 +1670,85 @@ otherTime(NSDate* other)
 
 @end
 
+#ifdef SMALL_DATE_MASK
+@implementation	GSSmallDate
+
++ (void) load
+{
+  useSmallDate = objc_registerSmallObjectClass_np(self, SMALL_DATE_MASK);
+}
 
++ (id) alloc
+{
+  return (id)SMALL_DATE_MASK;
+}
+
++ (id) allocWithZone: (NSZone*)z
+{
+  return (id)SMALL_DATE_MASK;
+}
+
+- (id) copy
+{
+  return self;
+}
+
+- (id) copyWithZone: (NSZone*)z
+{
+  return self;
+}
+
+- (id) init
+{
+  union BoxedTime	b;
+
+  /* The current time is not known to better than about a microsecond,
+   * so we can drop the low bits of the mantissa (less than that) in
+   * order to be able to store it in a small date.
+   */
+  b.t = GSPrivateTimeNow();
+  b.bits &= ~(uintptr_t)15;
+  return [self initWithTimeIntervalSinceReferenceDate: b.t];
+}
+
+- (id) initWithTimeIntervalSinceReferenceDate: (NSTimeInterval)secs
+{
+  id	o;
+
+  if (isnan(secs))
+    {
+      [NSException raise: NSInvalidArgumentException
+	          format: @"[%@-%@] interval is not a number",
+	NSStringFromClass([self class]), NSStringFromSelector(_cmd)];
+    }
+  o = boxSmallDate(secs);
+  if (o == nil)
+    {
+      o = [concreteClass allocWithZone: NSDefaultMallocZone()];
+      o = [o initWithTimeIntervalSinceReferenceDate: secs];
+    }
+  return o;
+}
+
+- (id) autorelease
+{
+  return self;
+}
+
+- (oneway void) release
+{
+  return;
+}
+
+- (id) retain
+{
+  return self;
+}
+
+- (NSTimeInterval) timeIntervalSinceReferenceDate
+{
+  return unboxSmallDate((uintptr_t)self);
+}
+
+@end
+#endif
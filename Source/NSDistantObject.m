@@ -725,20 +725,19 @@ enum proxyLocation
 	    return [NSMethodSignature signatureWithObjCTypes: mth.types];
 	}
 
-      if (_sigs != 0)
-	{
-	  NSMutableDictionary	*d = (NSMutableDictionary*)_sigs;
-	  NSString		*s = NSStringFromSelector(aSelector);
-	  NSMethodSignature	*m = [d objectForKey: s];
-
-	  if (m != nil) return m;
-	}
-
+      /* Signatures already fetched from the remote process are cached
+       * by the connection, so that proxies for other objects in that
+       * process can use them too.
+       */
 	{
-	  id		m = nil;
+	  id		m = [_connection _signatureForSelector: aSelector];
 	  id		inv;
 	  id		sig;
 
+	  if (m != nil)
+	    {
+	      return m;
+	    }
 	  DO_FORWARD_INVOCATION(methodSignatureForSelector:, aSelector);
 
 	  if ([m isProxy] == YES)
@@ -752,15 +751,7 @@ enum proxyLocation
 	    }
 	  if (m != nil)
 	    {
-	      NSMutableDictionary	*d = (NSMutableDictionary*)_sigs;
-	      NSString			*s = NSStringFromSelector(aSelector);
-
-	      if (d == nil)
-		{
-		  d = [NSMutableDictionary new];
-		  _sigs = (void*)d;
-		}
-	      [d setObject: m forKey: s];
+	      [_connection _setSignature: m forSelector: aSelector];
 	    }
 	  return m;
 	}
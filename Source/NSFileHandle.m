@@ -674,6 +674,49 @@ NSString * const NSFileHandleOperationException
   return NO;
 }
 
+/**
+ * Copies up to length bytes (or everything up to end of file if length
+ * is zero) from the current position in source to the receiver, and
+ * returns the number of bytes actually copied.<br />
+ * The data is copied in chunks so that large files do not need to be
+ * held in memory.  Where the system supports it, the copy is done
+ * within the kernel without the data passing through the process at all
+ * (eg. when sending a file down a network connection).<br />
+ * Raises an exception if either handle is closed or if a read or write
+ * fails.
+ */
+- (unsigned long long) transferFromFileHandle: (NSFileHandle*)source
+				       length: (unsigned long long)length
+{
+  unsigned long long	done = 0;
+
+  while (length == 0 || done < length)
+    {
+      CREATE_AUTORELEASE_POOL(pool);
+      unsigned		want = 1024*1024;
+      NSData		*d;
+      NSUInteger	got;
+
+      if (length > 0 && length - done < want)
+	{
+	  want = (unsigned)(length - done);
+	}
+      d = [source readDataOfLength: want];
+      got = [d length];
+      if (got > 0)
+	{
+	  [self writeData: d];
+	  done += got;
+	}
+      RELEASE(pool);
+      if (got == 0)
+	{
+	  break;
+	}
+    }
+  return done;
+}
+
 /**
  * Call -writeInBackgroundAndNotify:forModes: with nil modes.
  */
@@ -5,11 +5,15 @@
  * The parser is implemented as a simple recursive parser.  The JSON is
  * unambiguous, so this requires no read-ahead or backtracking.  The source of
  * data for the parse can be either a static JSON string or some JSON data.
+ * UTF-8 data (by far the most common case) is parsed directly from its
+ * bytes by a separate set of functions, avoiding converting it to unicode
+ * characters first.
  */
 
 #import <Foundation/Foundation.h>
 #import <GNUstepBase/NSObject+GNUstepBase.h>
 #import "GSFastEnumeration.h"
+#include <math.h>
 
 /**
  * The number of (unicode) characters to fetch from the source at once.
@@ -250,10 +254,10 @@ consumeSpace(ParserState *state)
 }
 
 /**
- * Sets an error state.
+ * Returns an error for an unexpected character at the specified index.
  */
-static void
-parseError(ParserState *state)
+static NSError*
+makeParseError(unichar c, NSInteger index)
 {
   /* TODO: Work out what stuff should go in this and probably add them to
    * parameters for this function.
@@ -261,13 +265,23 @@ parseError(ParserState *state)
   NSDictionary *userInfo = [[NSDictionary alloc] initWithObjectsAndKeys:
     _(@"JSON Parse error"), NSLocalizedDescriptionKey,
     _(([NSString stringWithFormat: @"Unexpected character %c at index %d",
-        (char)currentChar(state), state->sourceIndex])), 
+        (char)c, (int)index])), 
       NSLocalizedFailureReasonErrorKey,
     nil];
-  state->error = [NSError errorWithDomain: NSCocoaErrorDomain
-                                     code: 0
-                                 userInfo: userInfo];
+  NSError *error = [NSError errorWithDomain: NSCocoaErrorDomain
+                                       code: 0
+                                   userInfo: userInfo];
   [userInfo release];
+  return error;
+}
+
+/**
+ * Sets an error state.
+ */
+static void
+parseError(ParserState *state)
+{
+  state->error = makeParseError(currentChar(state), state->sourceIndex);
 }
 
 
@@ -636,242 +650,1200 @@ parseValue(ParserState *state)
 }
 
 /**
- * We have to autodetect the string encoding.  We know that it is some
- * unicode encoding, which may or may not contain a BOM.  If it contains a
- * BOM, then we need to skip that.  If it doesn't, then we need to work out
- * the encoding from the position of the NULLs.  The first two characters are
- * guaranteed to be ASCII in a JSON stream, so we can work out the encoding
- * from the pattern of NULLs.
+ * Structure for storing the internal state of the parser used for UTF-8
+ * data.  This parses the bytes of the data directly, rather than converting
+ * them to unicode characters first, and creates strings straight from the
+ * byte ranges which contain them.
  */
-static void
-getEncoding(const uint8_t BOM[4], ParserState *state)
+typedef struct UTF8ParserStateStruct
 {
-  NSStringEncoding enc = NSUTF8StringEncoding;
-  int BOMLength = 0;
+  /**
+   * The start of the data (used to report the position of errors).
+   */
+  const uint8_t *start;
+  /**
+   * The current position of the parser within the data.
+   */
+  const uint8_t *cur;
+  /**
+   * The end of the data.
+   */
+  const uint8_t *end;
+  /**
+   * Should the parser construct mutable string objects?
+   */
+  BOOL mutableStrings;
+  /**
+   * Should the parser construct mutable containers?
+   */
+  BOOL mutableContainers;
+  /**
+   * Error value, if this parser is currently in an error state, nil otherwise.
+   */
+  NSError *error;
+} UTF8ParserState;
 
-  if ((BOM[0] == 0xEF) && (BOM[1] == 0xBB) && (BOM[2] == 0xBF))
-    {
-      BOMLength = 3;
-    }
-  else if ((BOM[0] == 0xFE) && (BOM[1] == 0xFF))
-    {
-      BOMLength = 2;
-      enc = NSUTF16BigEndianStringEncoding;
-    }
-  else if ((BOM[0] == 0xFF) && (BOM[1] == 0xFE))
-    {
-      if ((BOM[2] == 0) && (BOM[3] == 0))
-        {
-          BOMLength = 4;
-          enc = NSUTF32LittleEndianStringEncoding;
-        }
-      else
-        {
-          BOMLength = 2;
-          enc = NSUTF16LittleEndianStringEncoding;
-        }
-    }
-  else if ((BOM[0] == 0)
-    && (BOM[1] == 0)
-    && (BOM[2] == 0xFE)
-    && (BOM[3] == 0xFF))
-    {
-      BOMLength = 4;
-      enc = NSUTF32BigEndianStringEncoding;
-    }
-  else if (BOM[0] == 0)
+/*
+ * Word at a time scanning.  Each byte of ONES is 0x01 and each byte of
+ * HIGHS is 0x80, so hasZero() is non-zero if (and only if) any byte in
+ * the word is zero.  XORing a word with a byte repeated in every position
+ * lets us look for that byte in sizeof(uintptr_t) bytes at once.
+ */
+#define	ONES		((uintptr_t)-1 / 0xff)
+#define	HIGHS		(ONES * 0x80)
+#define	hasZero(X)	(((X) - ONES) & ~(X) & HIGHS)
+
+/**
+ * Returns the current byte, or 0 if we're past the end of the input.
+ */
+static inline uint8_t
+currentByte(UTF8ParserState *state)
+{
+  return (state->cur < state->end) ? *state->cur : 0;
+}
+
+/**
+ * Consumes a byte and returns the next one.
+ */
+static inline uint8_t
+consumeByte(UTF8ParserState *state)
+{
+  if (state->cur < state->end)
     {
-      // TODO: Throw an error if this doesn't match one of the patterns
-      // described in section 3 of RFC4627
-      if (BOM[1] == 0)
-        {
-          enc = NSUTF32BigEndianStringEncoding;
-        }
-      else
-        {
-          enc = NSUTF16BigEndianStringEncoding;
-        }
+      state->cur++;
     }
-  else if (BOM[1] == 0)
+  return currentByte(state);
+}
+
+/**
+ * Consumes all whitespace and returns the first non-space byte.
+ * Indentation in pretty printed data is skipped a word at a time.
+ */
+static inline uint8_t
+consumeSpaceBytes(UTF8ParserState *state)
+{
+  const uint8_t	*p = state->cur;
+  const uint8_t	*e = state->end;
+
+  while (p < e)
     {
-      if (BOM[2] == 0)
-        {
-          enc = NSUTF32LittleEndianStringEncoding;
-        }
+      uint8_t	c = *p;
+
+      if (' ' == c)
+	{
+	  uintptr_t	w;
+
+	  while (e - p >= (ptrdiff_t)sizeof(w))
+	    {
+	      memcpy(&w, p, sizeof(w));
+	      if (w != ONES * ' ')
+		{
+		  break;
+		}
+	      p += sizeof(w);
+	    }
+	  if (p < e && ' ' == *p)
+	    {
+	      p++;
+	    }
+	}
+      else if ('\n' == c || '\r' == c || '\t' == c
+	|| '\v' == c || '\f' == c)
+	{
+	  p++;
+	}
       else
-        {
-          enc = NSUTF16LittleEndianStringEncoding;
-        }
+	{
+	  break;
+	}
     }
-  state->enc = enc;
-  state->BOMLength = BOMLength;
+  state->cur = p;
+  return currentByte(state);
+}
+
+static void
+utf8ParseError(UTF8ParserState *state)
+{
+  state->error = makeParseError((unichar)currentByte(state),
+    (NSInteger)(state->cur - state->start));
 }
 
 /**
- * Classes that are permitted to be written.  
+ * Appends len bytes to a buffer which starts out on the stack and is moved
+ * to the heap if it needs to grow.
  */
-static Class NSNullClass, NSArrayClass, NSStringClass, NSDictionaryClass,
-             NSNumberClass;
-
-static NSCharacterSet *escapeSet;
-
 static inline void
-writeTabs(NSMutableString *output, NSInteger tabs)
+appendBytes(uint8_t **buf, NSUInteger *length, NSUInteger *capacity,
+  uint8_t *stackBuf, const uint8_t *bytes, NSUInteger len)
 {
-  NSInteger i;
-
-  for (i = 0 ; i < tabs ; i++)
+  if (*length + len > *capacity)
     {
-      [output appendString: @"\t"];
+      NSUInteger	newCapacity = *capacity * 2;
+
+      while (newCapacity < *length + len)
+	{
+	  newCapacity *= 2;
+	}
+      if (*buf == stackBuf)
+	{
+	  *buf = malloc(newCapacity);
+	  memcpy(*buf, stackBuf, *length);
+	}
+      else
+	{
+	  *buf = realloc(*buf, newCapacity);
+	}
+      *capacity = newCapacity;
     }
+  memcpy(*buf + *length, bytes, len);
+  *length += len;
 }
 
-static inline void
-writeNewline(NSMutableString *output, NSInteger tabs)
+/**
+ * Reads four hex digits at the current position, returning -1 if they
+ * are not all valid.
+ */
+static inline int
+parseHex4(UTF8ParserState *state)
 {
-  if (tabs >= 0)
+  int		value = 0;
+  unsigned	i;
+
+  for (i = 0; i < 4; i++)
     {
-      [output appendString: @"\n"];
+      uint8_t	c = consumeByte(state);
+
+      value <<= 4;
+      if (c >= '0' && c <= '9')
+	value |= c - '0';
+      else if (c >= 'a' && c <= 'f')
+	value |= c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F')
+	value |= c - 'A' + 10;
+      else
+	return -1;
     }
+  return value;
 }
 
-static BOOL
-writeObject(id obj, NSMutableString *output, NSInteger tabs)
+/**
+ * Parse a string, as defined by RFC4627, section 2.5.  The common case of
+ * a string with no escapes is found by scanning a word at a time for the
+ * closing quote or a backslash, and the string is created directly from
+ * the bytes in the data.  Strings with escapes are decoded into a buffer.
+ */
+NS_RETURNS_RETAINED static NSString*
+parseUTF8String(UTF8ParserState *state)
 {
-  if ([obj isKindOfClass: NSArrayClass])
+  uint8_t	stackBuf[BUFFER_SIZE * 4];
+  uint8_t	*buf = stackBuf;
+  NSUInteger	length = 0;
+  NSUInteger	capacity = sizeof(stackBuf);
+  const uint8_t	*run;
+  const uint8_t	*p;
+  const uint8_t	*e = state->end;
+  uintptr_t	high = 0;
+  BOOL		escaped = NO;
+  NSString	*val;
+
+  if (state->error)
     {
-      BOOL writeComma = NO;
-      [output appendString: @"["];
-      FOR_IN(id, o, obj)
-        if (writeComma)
-          {
-            [output appendString: @","];
-          }
-        writeComma = YES;
-        writeNewline(output, tabs);
-        writeTabs(output, tabs);
-        writeObject(o, output, tabs + 1);
-      END_FOR_IN(obj)
-      writeNewline(output, tabs);
-      writeTabs(output, tabs);
-      [output appendString: @"]"];
+      return nil;
     }
-  else if ([obj isKindOfClass: NSDictionaryClass])
+  if (currentByte(state) != '"')
     {
-      BOOL writeComma = NO;
-      [output appendString: @"{"];
-      FOR_IN(id, o, obj)
-        // Keys in dictionaries must be strings
-        if (![o isKindOfClass: NSStringClass]) { return NO; }
-        if (writeComma)
-          {
-            [output appendString: @","];
-          }
-        writeComma = YES;
-        writeNewline(output, tabs);
-        writeTabs(output, tabs);
-        writeObject(o, output, tabs + 1);
-        [output appendString: @": "];
-        writeObject([obj objectForKey: o], output, tabs + 1);
-      END_FOR_IN(obj)
-      writeNewline(output, tabs);
-      writeTabs(output, tabs);
-      [output appendString: @"}"];
+      utf8ParseError(state);
+      return nil;
     }
-  else if ([obj isKindOfClass: NSStringClass])
+  run = p = state->cur + 1;
+  for (;;)
     {
-      NSRange r = [obj rangeOfCharacterFromSet: escapeSet];
-      if (r.location != NSNotFound)
-        {
-          NSMutableString *str = [obj mutableCopy];
-          NSCharacterSet *controlSet = [NSCharacterSet controlCharacterSet];
-          [str replaceOccurrencesOfString: @"\\"
-                               withString: @"\\\\"
-                                  options: 0
-                                    range: NSMakeRange(0, [str length])];
-          [str replaceOccurrencesOfString: @"\""
-                               withString: @"\\\""
-                                  options: 0
-                                    range: NSMakeRange(0, [str length])];
-          r = [str rangeOfCharacterFromSet: controlSet];
-          while (r.location != NSNotFound)
-            {
-              unichar control = [str characterAtIndex: r.location];
-              NSString *escaped;
-
-              escaped = [[NSString alloc] initWithFormat: @"\\u%.4d",
-		(int)control];
-              [str replaceCharactersInRange: r
-                                 withString: escaped];
-              [escaped release];
-              r = [str rangeOfCharacterFromSet: controlSet];
-            }
-          [output appendFormat: @"\"%@\"", str];
-          [str release];
-        }
-      else
-        {
-          [output appendFormat: @"\"%@\"", obj];
-        }
+      uintptr_t	w;
+
+      while (e - p >= (ptrdiff_t)sizeof(w))
+	{
+	  memcpy(&w, p, sizeof(w));
+	  if (hasZero(w ^ (ONES * '"')) || hasZero(w ^ (ONES * '\\')))
+	    {
+	      break;
+	    }
+	  high |= w;
+	  p += sizeof(w);
+	}
+      while (p < e && *p != '"' && *p != '\\')
+	{
+	  high |= *p++;
+	}
+      if (p >= e)
+	{
+	  // Unexpected end of data
+	  state->cur = e;
+	  if (buf != stackBuf)
+	    {
+	      free(buf);
+	    }
+	  utf8ParseError(state);
+	  return nil;
+	}
+      if ('"' == *p)
+	{
+	  break;
+	}
+
+      /* We have an escape sequence; copy what we have so far into the
+       * buffer, then decode the escape.
+       */
+      escaped = YES;
+      appendBytes(&buf, &length, &capacity, stackBuf, run, p - run);
+      state->cur = p + 1;
+      switch (currentByte(state))
+	{
+	  case 'b': appendBytes(&buf, &length, &capacity, stackBuf,
+	    (const uint8_t*)"\b", 1); break;
+	  case 'f': appendBytes(&buf, &length, &capacity, stackBuf,
+	    (const uint8_t*)"\f", 1); break;
+	  case 'n': appendBytes(&buf, &length, &capacity, stackBuf,
+	    (const uint8_t*)"\n", 1); break;
+	  case 'r': appendBytes(&buf, &length, &capacity, stackBuf,
+	    (const uint8_t*)"\r", 1); break;
+	  case 't': appendBytes(&buf, &length, &capacity, stackBuf,
+	    (const uint8_t*)"\t", 1); break;
+	  case 'u':
+	    {
+	      int	u = parseHex4(state);
+	      uint8_t	utf[4];
+	      NSUInteger	n;
+
+	      if (u < 0)
+		{
+		  if (buf != stackBuf)
+		    {
+		      free(buf);
+		    }
+		  utf8ParseError(state);
+		  return nil;
+		}
+	      if (u >= 0xd800 && u < 0xdc00)
+		{
+		  const uint8_t	*save = state->cur;
+		  int		l = -1;
+
+		  /* A high surrogate should be followed by an escaped low
+		   * surrogate, the two making up a single character.
+		   */
+		  if (e - state->cur > 2 && '\\' == state->cur[1]
+		    && 'u' == state->cur[2])
+		    {
+		      state->cur += 2;
+		      l = parseHex4(state);
+		    }
+		  if (l >= 0xdc00 && l < 0xe000)
+		    {
+		      u = 0x10000 + ((u - 0xd800) << 10) + (l - 0xdc00);
+		    }
+		  else
+		    {
+		      state->cur = save;
+		      u = 0xfffd;
+		    }
+		}
+	      else if (u >= 0xdc00 && u < 0xe000)
+		{
+		  u = 0xfffd;
+		}
+	      if (u < 0x80)
+		{
+		  utf[0] = u;
+		  n = 1;
+		}
+	      else if (u < 0x800)
+		{
+		  utf[0] = 0xc0 | (u >> 6);
+		  utf[1] = 0x80 | (u & 0x3f);
+		  n = 2;
+		}
+	      else if (u < 0x10000)
+		{
+		  utf[0] = 0xe0 | (u >> 12);
+		  utf[1] = 0x80 | ((u >> 6) & 0x3f);
+		  utf[2] = 0x80 | (u & 0x3f);
+		  n = 3;
+		}
+	      else
+		{
+		  utf[0] = 0xf0 | (u >> 18);
+		  utf[1] = 0x80 | ((u >> 12) & 0x3f);
+		  utf[2] = 0x80 | ((u >> 6) & 0x3f);
+		  utf[3] = 0x80 | (u & 0x3f);
+		  n = 4;
+		}
+	      high |= utf[0];
+	      appendBytes(&buf, &length, &capacity, stackBuf, utf, n);
+	    }
+	    break;
+	  default:
+	    // Simple escapes ('"', '\\', '/'), just ignore the leading '\'
+	    if (state->cur >= e)
+	      {
+		if (buf != stackBuf)
+		  {
+		    free(buf);
+		  }
+		utf8ParseError(state);
+		return nil;
+	      }
+	    high |= *state->cur;
+	    appendBytes(&buf, &length, &capacity, stackBuf, state->cur, 1);
+	    break;
+	}
+      run = p = state->cur + 1;
     }
-  else if ([obj isKindOfClass: NSNumberClass])
+
+  if (YES == escaped)
     {
-      if ([obj objCType][0] == @encode(BOOL)[0])
-        {
-          if ([obj boolValue])
-            {
-              [output appendString: @"true"];
-            }
-          else
-            {
-              [output appendString: @"false"];
-            }
-        }
-      else
-        {
-          [output appendFormat: @"%f", [obj doubleValue]];
-        }
+      appendBytes(&buf, &length, &capacity, stackBuf, run, p - run);
+      run = buf;
     }
-  else if ([obj isKindOfClass: NSNullClass])
+  else
     {
-      [output appendString: @"null"];
+      length = p - run;
     }
-  else
+  val = [(state->mutableStrings ? [NSMutableString class] : [NSString class])
+    alloc];
+  val = [val initWithBytes: run
+		    length: length
+		  encoding: (high & HIGHS)
+		    ? NSUTF8StringEncoding : NSASCIIStringEncoding];
+  if (buf != stackBuf)
     {
-      return NO;
+      free(buf);
     }
-  return YES;
+  if (nil == val)
+    {
+      // Not valid UTF-8
+      state->cur = p;
+      utf8ParseError(state);
+      return nil;
+    }
+  // Consume the trailing "
+  state->cur = p + 1;
+  return val;
 }
 
-@implementation NSJSONSerialization
-+ (void) initialize
+/**
+ * Parses a number, as defined by section 2.4 of the JSON specification.
+ * Integers of up to 15 digits are converted directly, everything else is
+ * passed to strtod().
+ */
+NS_RETURNS_RETAINED static NSNumber*
+parseUTF8Number(UTF8ParserState *state)
 {
-  NSNullClass = [NSNull class];
-  NSArrayClass = [NSArray class];
-  NSStringClass = [NSString class];
-  NSDictionaryClass = [NSDictionary class];
-  NSNumberClass = [NSNumber class];
-  escapeSet
-    = [[NSCharacterSet characterSetWithCharactersInString: @"\"\\"] retain];
+  const uint8_t	*p = state->cur;
+  const uint8_t	*e = state->end;
+  const uint8_t	*digits;
+  BOOL		negative = NO;
+  BOOL		simple = YES;
+  double	num;
 
-}
-
-+ (NSData*) dataWithJSONObject: (id)obj
-                       options: (NSJSONWritingOptions)opt
-                         error: (NSError **)error
+  // JSON numbers must start with a - or a digit
+  if (p < e && '-' == *p)
+    {
+      negative = YES;
+      p++;
+    }
+  digits = p;
+  if (p >= e || !isdigit(*p))
+    {
+      state->cur = p;
+      utf8ParseError(state);
+      return nil;
+    }
+  // Read as many digits as we see
+  while (p < e && isdigit(*p))
+    {
+      p++;
+    }
+  // Parse the fractional component, if there is one
+  if (p < e && '.' == *p)
+    {
+      simple = NO;
+      p++;
+      while (p < e && isdigit(*p))
+	{
+	  p++;
+	}
+    }
+  // parse the exponent if there is one
+  if (p < e && ('e' == *p || 'E' == *p))
+    {
+      simple = NO;
+      p++;
+      if (p < e && ('-' == *p || '+' == *p))
+	{
+	  p++;
+	}
+      while (p < e && isdigit(*p))
+	{
+	  p++;
+	}
+    }
+
+  if (YES == simple && p - digits <= 15)
+    {
+      const uint8_t	*d = digits;
+      long long		v = 0;
+
+      // Fits in a double without any loss of precision.
+      while (d < p)
+	{
+	  v = v * 10 + (*d++ - '0');
+	}
+      num = (double)(negative ? -v : v);
+    }
+  else
+    {
+      char	numberBuffer[128];
+      char	*number = numberBuffer;
+      NSUInteger	len = p - state->cur;
+
+      // strtod() needs a nul terminated string.
+      if (len >= sizeof(numberBuffer))
+	{
+	  number = malloc(len + 1);
+	}
+      memcpy(number, state->cur, len);
+      number[len] = '\0';
+      num = strtod(number, 0);
+      if (number != numberBuffer)
+	{
+	  free(number);
+	}
+    }
+  state->cur = p;
+  return [[NSNumber alloc] initWithDouble: num];
+}
+
+NS_RETURNS_RETAINED static id parseUTF8Value(UTF8ParserState *state);
+
+/**
+ * Parse an array, as described by section 2.3 of RFC 4627.
+ */
+NS_RETURNS_RETAINED static NSArray*
+parseUTF8Array(UTF8ParserState *state)
 {
-  /* Temporary string: allocate more space than we are likely to use so we just
-   * quickly claim a page and then give it back later
+  NSMutableArray	*array;
+  uint8_t		c;
+
+  // Eat the [
+  consumeByte(state);
+  array = [NSMutableArray new];
+  c = consumeSpaceBytes(state);
+  while (c != ']')
+    {
+      // If this fails, it will already set the error, so we don't have to.
+      id obj = parseUTF8Value(state);
+
+      if (nil == obj)
+	{
+	  [array release];
+	  return nil;
+	}
+      [array addObject: obj];
+      [obj release];
+      c = consumeSpaceBytes(state);
+      if (c == ',')
+	{
+	  consumeByte(state);
+	  c = consumeSpaceBytes(state);
+	}
+    }
+  // Eat the trailing ]
+  consumeByte(state);
+  if (!state->mutableContainers)
+    {
+      array = [array makeImmutableCopyOnFail: YES];
+    }
+  return array;
+}
+
+NS_RETURNS_RETAINED static NSDictionary*
+parseUTF8Object(UTF8ParserState *state)
+{
+  NSMutableDictionary	*dict;
+  uint8_t		c;
+
+  // Eat the {
+  consumeByte(state);
+  dict = [NSMutableDictionary new];
+  c = consumeSpaceBytes(state);
+  while (c != '}')
+    {
+      id key = parseUTF8String(state);
+      id obj;
+
+      if (nil == key)
+	{
+	  [dict release];
+	  return nil;
+	}
+      c = consumeSpaceBytes(state);
+      if (':' != c)
+	{
+	  [key release];
+	  [dict release];
+	  utf8ParseError(state);
+	  return nil;
+	}
+      // Eat the :
+      consumeByte(state);
+      obj = parseUTF8Value(state);
+      if (nil == obj)
+	{
+	  [key release];
+	  [dict release];
+	  return nil;
+	}
+      [dict setObject: obj forKey: key];
+      [key release];
+      [obj release];
+      c = consumeSpaceBytes(state);
+      if (c == ',')
+	{
+	  consumeByte(state);
+	}
+      c = consumeSpaceBytes(state);
+    }
+  // Eat the trailing }
+  consumeByte(state);
+  if (!state->mutableContainers)
+    {
+      dict = [dict makeImmutableCopyOnFail: YES];
+    }
+  return dict;
+}
+
+/**
+ * Parses a JSON value, as defined by RFC4627, section 2.1.
+ */
+NS_RETURNS_RETAINED static id
+parseUTF8Value(UTF8ParserState *state)
+{
+  const uint8_t	*p;
+  NSUInteger	left;
+
+  if (state->error) { return nil; };
+  switch (consumeSpaceBytes(state))
+    {
+      case '"':
+	return parseUTF8String(state);
+      case '[':
+	return parseUTF8Array(state);
+      case '{':
+	return parseUTF8Object(state);
+      case '-':
+      case '0' ... '9':
+	return parseUTF8Number(state);
+    }
+  p = state->cur;
+  left = state->end - p;
+  if (left >= 4 && memcmp(p, "null", 4) == 0)
+    {
+      state->cur += 4;
+      return [[NSNull null] retain];
+    }
+  if (left >= 4 && memcmp(p, "true", 4) == 0)
+    {
+      state->cur += 4;
+      return [[NSNumber alloc] initWithBool: YES];
+    }
+  if (left >= 5 && memcmp(p, "false", 5) == 0)
+    {
+      state->cur += 5;
+      return [[NSNumber alloc] initWithBool: NO];
+    }
+  utf8ParseError(state);
+  return nil;
+}
+
+/**
+ * We have to autodetect the string encoding.  We know that it is some
+ * unicode encoding, which may or may not contain a BOM.  If it contains a
+ * BOM, then we need to skip that.  If it doesn't, then we need to work out
+ * the encoding from the position of the NULLs.  The first two characters are
+ * guaranteed to be ASCII in a JSON stream, so we can work out the encoding
+ * from the pattern of NULLs.
+ */
+static void
+getEncoding(const uint8_t BOM[4], ParserState *state)
+{
+  NSStringEncoding enc = NSUTF8StringEncoding;
+  int BOMLength = 0;
+
+  if ((BOM[0] == 0xEF) && (BOM[1] == 0xBB) && (BOM[2] == 0xBF))
+    {
+      BOMLength = 3;
+    }
+  else if ((BOM[0] == 0xFE) && (BOM[1] == 0xFF))
+    {
+      BOMLength = 2;
+      enc = NSUTF16BigEndianStringEncoding;
+    }
+  else if ((BOM[0] == 0xFF) && (BOM[1] == 0xFE))
+    {
+      if ((BOM[2] == 0) && (BOM[3] == 0))
+        {
+          BOMLength = 4;
+          enc = NSUTF32LittleEndianStringEncoding;
+        }
+      else
+        {
+          BOMLength = 2;
+          enc = NSUTF16LittleEndianStringEncoding;
+        }
+    }
+  else if ((BOM[0] == 0)
+    && (BOM[1] == 0)
+    && (BOM[2] == 0xFE)
+    && (BOM[3] == 0xFF))
+    {
+      BOMLength = 4;
+      enc = NSUTF32BigEndianStringEncoding;
+    }
+  else if (BOM[0] == 0)
+    {
+      // TODO: Throw an error if this doesn't match one of the patterns
+      // described in section 3 of RFC4627
+      if (BOM[1] == 0)
+        {
+          enc = NSUTF32BigEndianStringEncoding;
+        }
+      else
+        {
+          enc = NSUTF16BigEndianStringEncoding;
+        }
+    }
+  else if (BOM[1] == 0)
+    {
+      if (BOM[2] == 0)
+        {
+          enc = NSUTF32LittleEndianStringEncoding;
+        }
+      else
+        {
+          enc = NSUTF16LittleEndianStringEncoding;
+        }
+    }
+  state->enc = enc;
+  state->BOMLength = BOMLength;
+}
+
+/**
+ * Classes that are permitted to be written.  
+ */
+static Class NSNullClass, NSArrayClass, NSStringClass, NSDictionaryClass,
+             NSNumberClass;
+
+/**
+ * The boolean NSNumber instances, written as true and false.
+ */
+static NSNumber *boolYes, *boolNo;
+
+/**
+ * Escapes for the ASCII characters.  Zero means the character is written
+ * as it is, 'u' means a \u escape, anything else is the character to
+ * write after a backslash.
+ */
+static char escapes[128];
+
+/**
+ * Structure for storing the state of the writer.  Output is written as
+ * UTF-8 directly into a byte buffer, which grows as required or (if
+ * there is an output stream) is written to the stream when full.
+ */
+typedef struct
+{
+  /**
+   * The output buffer.
    */
-  NSMutableString *str = [[NSMutableString alloc] initWithCapacity: 4096];
+  uint8_t *buf;
+  /**
+   * The number of bytes in the buffer.
+   */
+  NSUInteger length;
+  /**
+   * The size of the buffer.
+   */
+  NSUInteger capacity;
+  /**
+   * Stream to write the output to, or nil.
+   */
+  NSOutputStream *stream;
+  /**
+   * The number of bytes written to the stream so far.
+   */
+  NSUInteger written;
+  /**
+   * Error from the stream, if writing to it failed.
+   */
+  NSError *error;
+  /**
+   * If YES, the writer only checks that objects may be written, and
+   * produces no output.
+   */
+  BOOL validate;
+} WriterState;
+
+/**
+ * Writes the buffered bytes to the stream.
+ */
+static BOOL
+flushOutput(WriterState *w)
+{
+  NSUInteger	done = 0;
+
+  while (done < w->length && nil == w->error)
+    {
+      NSInteger	wrote;
+
+      wrote = [w->stream write: w->buf + done maxLength: w->length - done];
+      if (wrote <= 0)
+	{
+	  w->error = [w->stream streamError];
+	  if (nil == w->error)
+	    {
+	      w->error = [NSError errorWithDomain: NSCocoaErrorDomain
+					     code: 0
+					 userInfo: nil];
+	    }
+	  return NO;
+	}
+      done += wrote;
+      w->written += wrote;
+    }
+  w->length = 0;
+  return (nil == w->error) ? YES : NO;
+}
+
+static void
+writeBytes(WriterState *w, const void *bytes, NSUInteger len)
+{
+  if (w->validate || nil != w->error)
+    {
+      return;
+    }
+  if (w->length + len > w->capacity)
+    {
+      if (nil != w->stream)
+	{
+	  if (NO == flushOutput(w))
+	    {
+	      return;
+	    }
+	  if (len > w->capacity)
+	    {
+	      /* Too big to buffer; write it straight to the stream.
+	       */
+	      uint8_t	*saved = w->buf;
+
+	      w->buf = (uint8_t*)bytes;
+	      w->length = len;
+	      flushOutput(w);
+	      w->buf = saved;
+	      return;
+	    }
+	}
+      else
+	{
+	  while (w->length + len > w->capacity)
+	    {
+	      w->capacity *= 2;
+	    }
+	  w->buf = NSZoneRealloc(NSDefaultMallocZone(), w->buf, w->capacity);
+	}
+    }
+  memcpy(w->buf + w->length, bytes, len);
+  w->length += len;
+}
+
+static inline void
+writeByte(WriterState *w, uint8_t c)
+{
+  if (w->length < w->capacity && NO == w->validate)
+    {
+      w->buf[w->length++] = c;
+    }
+  else
+    {
+      writeBytes(w, &c, 1);
+    }
+}
+
+static inline void
+writeTabs(WriterState *w, NSInteger tabs)
+{
+  NSInteger i;
+
+  for (i = 0 ; i < tabs ; i++)
+    {
+      writeByte(w, '\t');
+    }
+}
+
+static inline void
+writeNewline(WriterState *w, NSInteger tabs)
+{
+  if (tabs >= 0)
+    {
+      writeByte(w, '\n');
+    }
+}
+
+static inline uint8_t*
+escapeUnit(uint8_t *o, unichar c)
+{
+  static const char	hex[] = "0123456789abcdef";
+
+  *o++ = '\\';
+  *o++ = 'u';
+  *o++ = hex[(c >> 12) & 0xf];
+  *o++ = hex[(c >> 8) & 0xf];
+  *o++ = hex[(c >> 4) & 0xf];
+  *o++ = hex[c & 0xf];
+  return o;
+}
+
+/**
+ * Writes a string, converting it to UTF-8 and escaping it as required by
+ * RFC4627 section 2.5 as we go.  Unpaired surrogates, which can't be
+ * represented in UTF-8, are written as \u escapes.
+ */
+static void
+writeString(WriterState *w, NSString *str)
+{
+  unichar	chars[BUFFER_SIZE];
+  uint8_t	out[BUFFER_SIZE * 6 + 6];
+  NSUInteger	length = [str length];
+  NSUInteger	pos = 0;
+  unichar	high = 0;
+
+  if (w->validate)
+    {
+      return;
+    }
+  writeByte(w, '"');
+  while (pos < length)
+    {
+      NSUInteger	count = length - pos;
+      NSUInteger	i;
+      uint8_t		*o = out;
+
+      if (count > BUFFER_SIZE)
+	{
+	  count = BUFFER_SIZE;
+	}
+      [str getCharacters: chars range: NSMakeRange(pos, count)];
+      pos += count;
+      for (i = 0; i < count; i++)
+	{
+	  unichar	c = chars[i];
+
+	  if (high != 0)
+	    {
+	      if (c >= 0xdc00 && c < 0xe000)
+		{
+		  uint32_t	u;
+
+		  u = 0x10000 + ((high - 0xd800) << 10) + (c - 0xdc00);
+		  *o++ = 0xf0 | (u >> 18);
+		  *o++ = 0x80 | ((u >> 12) & 0x3f);
+		  *o++ = 0x80 | ((u >> 6) & 0x3f);
+		  *o++ = 0x80 | (u & 0x3f);
+		  high = 0;
+		  continue;
+		}
+	      o = escapeUnit(o, high);
+	      high = 0;
+	    }
+	  if (c < 0x80)
+	    {
+	      char	e = escapes[c];
+
+	      if (0 == e)
+		{
+		  *o++ = c;
+		}
+	      else if ('u' == e)
+		{
+		  o = escapeUnit(o, c);
+		}
+	      else
+		{
+		  *o++ = '\\';
+		  *o++ = e;
+		}
+	    }
+	  else if (c < 0x800)
+	    {
+	      *o++ = 0xc0 | (c >> 6);
+	      *o++ = 0x80 | (c & 0x3f);
+	    }
+	  else if (c >= 0xd800 && c < 0xdc00)
+	    {
+	      high = c;
+	    }
+	  else if (c >= 0xdc00 && c < 0xe000)
+	    {
+	      o = escapeUnit(o, c);
+	    }
+	  else
+	    {
+	      *o++ = 0xe0 | (c >> 12);
+	      *o++ = 0x80 | ((c >> 6) & 0x3f);
+	      *o++ = 0x80 | (c & 0x3f);
+	    }
+	}
+      writeBytes(w, out, o - out);
+    }
+  if (high != 0)
+    {
+      uint8_t	*o = escapeUnit(out, high);
+
+      writeBytes(w, out, o - out);
+    }
+  writeByte(w, '"');
+}
+
+static void
+writeInteger(WriterState *w, unsigned long long v, BOOL negative)
+{
+  char	digits[24];
+  char	*p = digits + sizeof(digits);
+
+  do
+    {
+      *--p = '0' + (v % 10);
+      v /= 10;
+    }
+  while (v != 0);
+  if (negative)
+    {
+      *--p = '-';
+    }
+  writeBytes(w, p, digits + sizeof(digits) - p);
+}
+
+/**
+ * Writes a number.  Integers are written exactly, and other values using
+ * the shortest representation which reads back as the same double.
+ * Infinities and NaNs can't be represented in JSON.
+ */
+static BOOL
+writeNumber(WriterState *w, NSNumber *obj)
+{
+  const char	*t = [obj objCType];
+
+  if (boolYes == obj || boolNo == obj || @encode(BOOL)[0] == t[0])
+    {
+      if ([obj boolValue])
+	{
+	  writeBytes(w, "true", 4);
+	}
+      else
+	{
+	  writeBytes(w, "false", 5);
+	}
+      return YES;
+    }
+  switch (t[0])
+    {
+      case 'c': case 's': case 'i': case 'l': case 'q':
+	{
+	  long long	v = [obj longLongValue];
+
+	  if (v < 0)
+	    {
+	      writeInteger(w, -(unsigned long long)v, YES);
+	    }
+	  else
+	    {
+	      writeInteger(w, (unsigned long long)v, NO);
+	    }
+	  return YES;
+	}
+      case 'C': case 'S': case 'I': case 'L': case 'Q':
+	writeInteger(w, [obj unsignedLongLongValue], NO);
+	return YES;
+      default:
+	{
+	  double	d = [obj doubleValue];
+	  char		buf[32];
+	  char		*p;
+
+	  if (isnan(d) || isinf(d))
+	    {
+	      return NO;
+	    }
+	  if (d == floor(d) && fabs(d) < 1e15)
+	    {
+	      if (d < 0)
+		{
+		  writeInteger(w, (unsigned long long)-d, YES);
+		}
+	      else
+		{
+		  writeInteger(w, (unsigned long long)d, NO);
+		}
+	      return YES;
+	    }
+	  snprintf(buf, sizeof(buf), "%.15g", d);
+	  if (strtod(buf, 0) != d)
+	    {
+	      snprintf(buf, sizeof(buf), "%.17g", d);
+	    }
+	  /* The decimal separator depends on the locale, but JSON
+	   * always uses a point.
+	   */
+	  if ((p = strchr(buf, ',')) != 0)
+	    {
+	      *p = '.';
+	    }
+	  writeBytes(w, buf, strlen(buf));
+	  return YES;
+	}
+    }
+}
+
+static BOOL
+writeObject(id obj, WriterState *w, NSInteger tabs)
+{
+  if (nil != w->error)
+    {
+      return NO;
+    }
+  if ([obj isKindOfClass: NSArrayClass])
+    {
+      BOOL writeComma = NO;
+      writeByte(w, '[');
+      FOR_IN(id, o, obj)
+        if (writeComma)
+          {
+            writeByte(w, ',');
+          }
+        writeComma = YES;
+        writeNewline(w, tabs);
+        writeTabs(w, tabs);
+        if (NO == writeObject(o, w, tabs + 1)) { return NO; }
+      END_FOR_IN(obj)
+      writeNewline(w, tabs);
+      writeTabs(w, tabs);
+      writeByte(w, ']');
+    }
+  else if ([obj isKindOfClass: NSDictionaryClass])
+    {
+      BOOL writeComma = NO;
+      writeByte(w, '{');
+      FOR_IN(id, o, obj)
+        // Keys in dictionaries must be strings
+        if (![o isKindOfClass: NSStringClass]) { return NO; }
+        if (writeComma)
+          {
+            writeByte(w, ',');
+          }
+        writeComma = YES;
+        writeNewline(w, tabs);
+        writeTabs(w, tabs);
+        writeString(w, o);
+        writeBytes(w, ": ", 2);
+        if (NO == writeObject([obj objectForKey: o], w, tabs + 1))
+          {
+            return NO;
+          }
+      END_FOR_IN(obj)
+      writeNewline(w, tabs);
+      writeTabs(w, tabs);
+      writeByte(w, '}');
+    }
+  else if ([obj isKindOfClass: NSStringClass])
+    {
+      writeString(w, obj);
+    }
+  else if ([obj isKindOfClass: NSNumberClass])
+    {
+      return writeNumber(w, obj);
+    }
+  else if ([obj isKindOfClass: NSNullClass])
+    {
+      writeBytes(w, "null", 4);
+    }
+  else
+    {
+      return NO;
+    }
+  return (nil == w->error) ? YES : NO;
+}
+
+static NSError *
+writeError(void)
+{
+  NSDictionary	*userInfo;
+  NSError	*error;
+
+  userInfo = [[NSDictionary alloc] initWithObjectsAndKeys:
+    _(@"JSON writing error"), NSLocalizedDescriptionKey,
+    nil];
+  error = [NSError errorWithDomain: NSCocoaErrorDomain
+			      code: 0
+			  userInfo: userInfo];
+  [userInfo release];
+  return error;
+}
+
+@implementation NSJSONSerialization
++ (void) initialize
+{
+  unsigned	c;
+
+  NSNullClass = [NSNull class];
+  NSArrayClass = [NSArray class];
+  NSStringClass = [NSString class];
+  NSDictionaryClass = [NSDictionary class];
+  NSNumberClass = [NSNumber class];
+  boolYes = [[NSNumber numberWithBool: YES] retain];
+  boolNo = [[NSNumber numberWithBool: NO] retain];
+  for (c = 0; c < 0x20; c++)
+    {
+      escapes[c] = 'u';
+    }
+  escapes['\b'] = 'b';
+  escapes['\f'] = 'f';
+  escapes['\n'] = 'n';
+  escapes['\r'] = 'r';
+  escapes['\t'] = 't';
+  escapes['"'] = '"';
+  escapes['\\'] = '\\';
+}
+
++ (NSData*) dataWithJSONObject: (id)obj
+                       options: (NSJSONWritingOptions)opt
+                         error: (NSError **)error
+{
+  WriterState w = { 0 };
   NSData *data = nil;
-  NSUInteger tabs;
+  NSInteger tabs;
 
+  /* Output buffer: allocate more space than we are likely to use so we just
+   * quickly claim a page and then give it back later
+   */
+  w.capacity = 4096;
+  w.buf = NSZoneMalloc(NSDefaultMallocZone(), w.capacity);
   tabs = ((opt & NSJSONWritingPrettyPrinted) == NSJSONWritingPrettyPrinted) ?
     0 : NSIntegerMin;
-  if (writeObject(obj, str, tabs))
+  if (writeObject(obj, &w, tabs))
     {
-      data = [str dataUsingEncoding: NSUTF8StringEncoding];
+      w.buf = NSZoneRealloc(NSDefaultMallocZone(), w.buf, w.length);
+      data = [NSData dataWithBytesNoCopy: w.buf
+				  length: w.length
+			    freeWhenDone: YES];
       if (NULL != error)
         {
           *error = nil;
@@ -879,35 +1851,54 @@ writeObject(id obj, NSMutableString *output, NSInteger tabs)
     }
   else
     {
+      NSZoneFree(NSDefaultMallocZone(), w.buf);
       if (NULL != error)
 	{
-	  NSDictionary *userInfo = [[NSDictionary alloc] initWithObjectsAndKeys:
-	    _(@"JSON writing error"), NSLocalizedDescriptionKey,
-	    nil];
-	  *error = [NSError errorWithDomain: NSCocoaErrorDomain
-				       code: 0
-				   userInfo: userInfo];
+	  *error = writeError();
 	}
     }
-  [str release];
   return data;
 }
 
 + (BOOL) isValidJSONObject: (id)obj
 {
-  return writeObject(obj, nil, NSIntegerMin);
+  WriterState w = { 0 };
+
+  w.validate = YES;
+  return writeObject(obj, &w, NSIntegerMin);
 }
 
 + (id) JSONObjectWithData: (NSData *)data
                   options: (NSJSONReadingOptions)opt
                     error: (NSError **)error
 {
-  uint8_t BOM[4];
+  uint8_t BOM[4] = { 0 };
   ParserState p = { 0 };
+  NSUInteger length = [data length];
   id obj;
 
-  [data getBytes: BOM length: 4];
+  [data getBytes: BOM length: (length < 4) ? length : 4];
   getEncoding(BOM, &p);
+  if (NSUTF8StringEncoding == p.enc)
+    {
+      UTF8ParserState u = { 0 };
+
+      /* Parse directly from the bytes rather than making a string.
+       */
+      u.start = [data bytes];
+      u.cur = u.start + p.BOMLength;
+      u.end = u.start + length;
+      u.mutableContainers = (opt & NSJSONReadingMutableContainers)
+	== NSJSONReadingMutableContainers;
+      u.mutableStrings
+	= (opt & NSJSONReadingMutableLeaves) == NSJSONReadingMutableLeaves;
+      obj = parseUTF8Value(&u);
+      if (NULL != error)
+	{
+	  *error = u.error;
+	}
+      return [obj autorelease];
+    }
   p.source = [[NSString alloc] initWithData: data encoding: p.enc];
   p.updateBuffer = updateStringBuffer;
   p.mutableContainers
@@ -967,28 +1958,38 @@ writeObject(id obj, NSMutableString *output, NSInteger tabs)
                       options: (NSJSONWritingOptions)opt
                         error: (NSError **)error
 {
-  NSData *data = [self dataWithJSONObject: obj options: opt error: error];
+  WriterState w = { 0 };
+  uint8_t buf[4096];
+  NSInteger tabs;
 
-  if (nil != data)
+  /* Check the object first, so that we don't write partial output
+   * to the stream.
+   */
+  if (NO == [self isValidJSONObject: obj])
     {
-      const char *bytes = [data bytes];
-      NSUInteger toWrite = [data length];
-
-      while (toWrite > 0)
-        {
-          NSInteger wrote = [stream write: (uint8_t*)bytes maxLength: toWrite];
-          bytes += wrote;
-          toWrite -= wrote;
-          if (0 == wrote)
-            {
-              if (NULL != error)
-                {
-                  *error = [stream streamError];
-                }
-              return 0;
-            }
-        }
+      if (NULL != error)
+	{
+	  *error = writeError();
+	}
+      return 0;
+    }
+  w.buf = buf;
+  w.capacity = sizeof(buf);
+  w.stream = stream;
+  tabs = ((opt & NSJSONWritingPrettyPrinted) == NSJSONWritingPrettyPrinted) ?
+    0 : NSIntegerMin;
+  if (NO == writeObject(obj, &w, tabs) || NO == flushOutput(&w))
+    {
+      if (NULL != error)
+	{
+	  *error = (nil == w.error) ? writeError() : w.error;
+	}
+      return 0;
+    }
+  if (NULL != error)
+    {
+      *error = nil;
     }
-  return [data length];
+  return w.written;
 }
 @end
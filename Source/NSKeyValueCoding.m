@@ -30,11 +30,15 @@
 #import "Foundation/NSDictionary.h"
 #import "Foundation/NSEnumerator.h"
 #import "Foundation/NSException.h"
+#import "Foundation/NSHashTable.h"
 #import "Foundation/NSKeyValueCoding.h"
 #import "Foundation/NSMethodSignature.h"
 #import "Foundation/NSNull.h"
 #import "Foundation/NSSet.h"
 #import "Foundation/NSValue.h"
+#import "GSPrivate.h"
+
+#include <pthread.h>
 
 /* For the NSKeyValueMutableArray and NSKeyValueMutableSet classes
  */
@@ -77,8 +81,266 @@ static inline void setupCompat()
 
 #endif
 
+/* Cache of the accessor method or instance variable found for each key
+ * in each class, so that -valueForKey: and -setValue:forKey: need not
+ * search for it every time.  An entry for a method records the method
+ * implementation found, and is ignored if the class no longer has that
+ * implementation (eg. because key-value observing has replaced a setter).
+ * An entry for an instance variable (or for nothing found) records the
+ * accessor methods which were looked for, and is ignored if the class has
+ * since gained one of them (eg. by class_addMethod() or a category).
+ * The whole cache is flushed when methods are added to classes by
+ * behaviors or when code is loaded from a bundle.  Lookups only take a
+ * read lock, so that many threads may use key-value coding at once.
+ */
+typedef struct {
+  Class		cls;
+  const char	*key;
+  unsigned	len;
+  BOOL		set;		// For setting rather than getting a value.
+  SEL		sel;
+  IMP		imp;
+  char		kind;		// Method return or argument type.
+  const char	*type;		// Instance variable type.
+  unsigned	size;
+  int		off;
+  unsigned	nMissing;
+  SEL		missing[5];	// Accessors not found.
+} GSKVCEntry;
+
+static NSHashTable	*kvcCache = 0;
+static pthread_rwlock_t	kvcLock = PTHREAD_RWLOCK_INITIALIZER;
+static IMP		respondsImp = 0;
+
+static NSUInteger
+kvcHash(NSHashTable *t, const void *p)
+{
+  const GSKVCEntry	*e = (const GSKVCEntry*)p;
+  NSUInteger		h = ((NSUInteger)(uintptr_t)e->cls >> 3) + e->set;
+  unsigned		i;
+
+  for (i = 0; i < e->len; i++)
+    {
+      h = (h << 5) + h + (unsigned char)e->key[i];
+    }
+  return h;
+}
+
+static BOOL
+kvcEqual(NSHashTable *t, const void *p1, const void *p2)
+{
+  const GSKVCEntry	*e1 = (const GSKVCEntry*)p1;
+  const GSKVCEntry	*e2 = (const GSKVCEntry*)p2;
+
+  return (e1->cls == e2->cls && e1->set == e2->set && e1->len == e2->len
+    && memcmp(e1->key, e2->key, e1->len) == 0) ? YES : NO;
+}
+
 static void
-SetValueForKey(NSObject *self, id anObject, const char *key, unsigned size)
+kvcRelease(NSHashTable *t, void *p)
+{
+  NSZoneFree(NSDefaultMallocZone(), p);
+}
+
+static const NSHashTableCallBacks kvcCallBacks = {
+  kvcHash, kvcEqual, 0, kvcRelease, 0
+};
+
+/* Look up the cached entry for getting or setting key in instances of
+ * the class of self, copying it to e.  Returns NO if there is none.
+ */
+static BOOL
+kvcLookup(NSObject *self, const char *key, unsigned len, BOOL set,
+  GSKVCEntry *e)
+{
+  GSKVCEntry	probe;
+  GSKVCEntry	*found = 0;
+
+  probe.cls = object_getClass(self);
+  probe.key = key;
+  probe.len = len;
+  probe.set = set;
+  pthread_rwlock_rdlock(&kvcLock);
+  if (kvcCache != 0)
+    {
+      found = (GSKVCEntry*)NSHashGet(kvcCache, &probe);
+      if (found != 0)
+	{
+	  *e = *found;
+	}
+    }
+  pthread_rwlock_unlock(&kvcLock);
+  if (found == 0)
+    {
+      return NO;
+    }
+  if (e->sel != 0)
+    {
+      if (class_getMethodImplementation(probe.cls, e->sel) != e->imp)
+	{
+	  return NO;
+	}
+    }
+  else
+    {
+      unsigned	i;
+
+      for (i = 0; i < e->nMissing; i++)
+	{
+	  if (class_respondsToSelector(probe.cls, e->missing[i]) == YES)
+	    {
+	      return NO;
+	    }
+	}
+    }
+  return YES;
+}
+
+/* Record in e the selectors of the accessor methods which FindGetter()
+ * or FindSetter() looked for in vain, so that kvcLookup() can tell if
+ * one of them has been added to the class since.
+ */
+static void
+kvcNoteMissing(NSObject *self, const char *key, unsigned len, BOOL set,
+  GSKVCEntry *e)
+{
+  char		buf[len + 6];
+  char		lo;
+  char		hi;
+  unsigned	n = 0;
+
+  e->nMissing = 0;
+  if (len == 0)
+    {
+      return;
+    }
+  memcpy(&buf[4], key, len);
+  lo = buf[4];
+  hi = islower(lo) ? toupper(lo) : lo;
+  if (set == YES)
+    {
+      memcpy(buf, "_set", 4);
+      buf[4] = hi;
+      buf[len + 4] = ':';
+      buf[len + 5] = '\0';
+      e->missing[n++] = sel_registerName(&buf[1]);	// setKey:
+      e->missing[n++] = sel_registerName(buf);		// _setKey:
+    }
+  else
+    {
+      memcpy(buf, "_get", 4);
+      buf[4] = hi;
+      buf[len + 4] = '\0';
+      e->missing[n++] = sel_registerName(&buf[1]);	// getKey
+      if ([[self class] accessInstanceVariablesDirectly] == YES)
+	{
+	  e->missing[n++] = sel_registerName(buf);	// _getKey
+	}
+      buf[4] = lo;
+      e->missing[n++] = sel_registerName(&buf[4]);	// key
+      if ([[self class] accessInstanceVariablesDirectly] == YES)
+	{
+	  buf[3] = '_';
+	  e->missing[n++] = sel_registerName(&buf[3]);	// _key
+	}
+      buf[4] = hi;
+      buf[3] = 's';
+      buf[2] = 'i';
+      e->missing[n++] = sel_registerName(&buf[2]);	// isKey
+    }
+  e->nMissing = n;
+}
+
+/* Complete the entry e found for getting or setting key in self and add
+ * it to the cache.  The method implementation and type are only filled
+ * in (to allow it to be called directly) if the class uses the standard
+ * -respondsToSelector: and the method has the right number of arguments,
+ * and only those entries are cached.
+ */
+static void
+kvcStore(NSObject *self, const char *key, unsigned len, BOOL set,
+  GSKVCEntry *e)
+{
+  Class		c = object_getClass(self);
+  GSKVCEntry	*n;
+
+  e->cls = c;
+  e->imp = 0;
+  e->kind = 0;
+  e->nMissing = 0;
+  if (respondsImp == 0)
+    {
+      respondsImp = [NSObject instanceMethodForSelector:
+	@selector(respondsToSelector:)];
+    }
+  if (class_getMethodImplementation(c, @selector(respondsToSelector:))
+    != respondsImp)
+    {
+      return;
+    }
+  if (e->sel == 0)
+    {
+      kvcNoteMissing(self, key, len, set, e);
+    }
+  else
+    {
+      NSMethodSignature	*sig = [self methodSignatureForSelector: e->sel];
+
+      if (sig == nil || [sig numberOfArguments] != (set ? 3 : 2))
+	{
+	  return;
+	}
+      e->kind = set ? *[sig getArgumentTypeAtIndex: 2]
+	: *[sig methodReturnType];
+      e->imp = class_getMethodImplementation(c, e->sel);
+    }
+
+  if (kvcCache == 0)
+    {
+      NSHashTable	*t = NSCreateHashTable(kvcCallBacks, 64);
+
+      pthread_rwlock_wrlock(&kvcLock);
+      if (kvcCache == 0)
+	{
+	  kvcCache = t;
+	  t = 0;
+	}
+      pthread_rwlock_unlock(&kvcLock);
+      if (t != 0)
+	{
+	  NSFreeHashTable(t);
+	}
+    }
+
+  /* The entry and a copy of the key are allocated together, so that
+   * both are freed when the entry is removed from the cache.
+   */
+  n = (GSKVCEntry*)NSZoneMalloc(NSDefaultMallocZone(),
+    sizeof(GSKVCEntry) + len + 1);
+  *n = *e;
+  n->key = (const char*)&n[1];
+  n->len = len;
+  n->set = set;
+  memcpy((char*)&n[1], key, len);
+  ((char*)&n[1])[len] = '\0';
+  pthread_rwlock_wrlock(&kvcLock);
+  NSHashInsert(kvcCache, n);
+  pthread_rwlock_unlock(&kvcLock);
+}
+
+void
+GSPrivateKVCCacheFlush(void)
+{
+  pthread_rwlock_wrlock(&kvcLock);
+  if (kvcCache != 0)
+    {
+      NSResetHashTable(kvcCache);
+    }
+  pthread_rwlock_unlock(&kvcLock);
+}
+
+static void
+FindSetter(NSObject *self, const char *key, unsigned size, GSKVCEntry *e)
 {
   SEL		sel = 0;
   const char	*type = 0;
@@ -147,10 +409,40 @@ SetValueForKey(NSObject *self, id anObject, const char *key, unsigned size)
 	    }
 	}
     }
-  GSObjCSetVal(self, key, anObject, sel, type, size, off);
+  e->sel = sel;
+  e->type = type;
+  e->size = size;
+  e->off = off;
 }
 
-static id ValueForKey(NSObject *self, const char *key, unsigned size)
+static void
+SetValueForKey(NSObject *self, id anObject, const char *key, unsigned size)
+{
+  GSKVCEntry	e;
+
+  if (kvcLookup(self, key, size, YES, &e) == NO)
+    {
+      FindSetter(self, key, size, &e);
+      kvcStore(self, key, size, YES, &e);
+    }
+  if (e.sel != 0)
+    {
+      if (e.kind == _C_ID || e.kind == _C_CLASS)
+	{
+	  (*(void (*)(id, SEL, id))e.imp)(self, e.sel, anObject);
+	  return;
+	}
+    }
+  else if (e.type != 0 && (*e.type == _C_ID || *e.type == _C_CLASS))
+    {
+      ASSIGN(*(id*)((char*)self + e.off), anObject);
+      return;
+    }
+  GSObjCSetVal(self, key, anObject, e.sel, e.type, e.size, e.off);
+}
+
+static void
+FindGetter(NSObject *self, const char *key, unsigned size, GSKVCEntry *e)
 {
   SEL		sel = 0;
   int		off = 0;
@@ -233,7 +525,40 @@ static id ValueForKey(NSObject *self, const char *key, unsigned size)
 	    }
 	}
     }
-  return GSObjCGetVal(self, key, sel, type, size, off);
+  e->sel = sel;
+  e->type = type;
+  e->size = size;
+  e->off = off;
+}
+
+static id
+ValueForKey(NSObject *self, const char *key, unsigned size)
+{
+  GSKVCEntry	e;
+
+  if (kvcLookup(self, key, size, NO, &e) == NO)
+    {
+      FindGetter(self, key, size, &e);
+      kvcStore(self, key, size, NO, &e);
+    }
+  if (e.sel != 0)
+    {
+      if (e.kind == _C_ID || e.kind == _C_CLASS)
+	{
+	  return (*(id (*)(id, SEL))e.imp)(self, e.sel);
+	}
+    }
+  else if (e.type != 0 && (*e.type == _C_ID || *e.type == _C_CLASS))
+    {
+      return *(id*)((char*)self + e.off);
+    }
+  return GSObjCGetVal(self, key, e.sel, e.type, e.size, e.off);
+}
+
+id
+GSPrivateValueForKey(id self, const char *key, unsigned size)
+{
+  return ValueForKey(self, key, size);
 }
 
 
@@ -34,6 +34,7 @@
 #import "Foundation/NSNotification.h"
 #import "Foundation/NSException.h"
 #import "Foundation/NSLock.h"
+#import "Foundation/NSOperation.h"
 #import "Foundation/NSThread.h"
 #import "GNUstepBase/GSLock.h"
 #import "GNUstepBase/NSObject+GNUstepBase.h"
@@ -118,6 +119,103 @@ static Class concrete = 0;
 @end
 
 
+/*
+ * The observer created by -addObserverForName:object:queue:usingBlock:
+ * to call a block when it receives a notification.  The notification
+ * center owns the observer, and releases it when it is removed.
+ */
+@interface	GSNotificationObserver : NSObject
+{
+  GSNotificationBlock	block;
+  NSOperationQueue	*queue;
+}
+- (void) didReceiveNotification: (NSNotification*)notification;
+- (id) initWithQueue: (NSOperationQueue*)q block: (GSNotificationBlock)b;
+@end
+
+/*
+ * An operation to call an observer's block with a notification.
+ */
+@interface	GSNotificationBlockOperation : NSOperation
+{
+  NSNotification	*notification;
+  GSNotificationBlock	block;
+}
+- (id) initWithNotification: (NSNotification*)n
+		      block: (GSNotificationBlock)b;
+@end
+
+@implementation	GSNotificationObserver
+
+- (void) dealloc
+{
+  RELEASE((id)block);
+  TEST_RELEASE(queue);
+  [super dealloc];
+}
+
+- (void) didReceiveNotification: (NSNotification*)notification
+{
+  if (queue == nil)
+    {
+      CALL_BLOCK(block, notification);
+    }
+  else
+    {
+      GSNotificationBlockOperation	*op;
+
+      op = [[GSNotificationBlockOperation alloc]
+	initWithNotification: notification block: block];
+      [queue addOperation: op];
+      RELEASE(op);
+    }
+}
+
+- (id) initWithQueue: (NSOperationQueue*)q block: (GSNotificationBlock)b
+{
+  if ((self = [super init]) != nil)
+    {
+      block = (GSNotificationBlock)[(id)b copy];
+      queue = RETAIN(q);
+    }
+  return self;
+}
+
+@end
+
+@implementation	GSNotificationBlockOperation
+
+- (void) dealloc
+{
+  RELEASE(notification);
+  RELEASE((id)block);
+  [super dealloc];
+}
+
+- (id) initWithNotification: (NSNotification*)n
+		      block: (GSNotificationBlock)b
+{
+  if ((self = [super init]) != nil)
+    {
+      notification = RETAIN(n);
+      block = (GSNotificationBlock)RETAIN((id)b);
+    }
+  return self;
+}
+
+- (void) main
+{
+  CALL_BLOCK(block, notification);
+}
+
+@end
+
+/* The method used by GSNotificationObserver to receive notifications.
+ * Observations using it belong to an observer owned by the center.
+ */
+static IMP	blockObserverIMP = 0;
+
+
 /*
  * Garbage collection considerations -
  * The notification center is not supposed to retain any notification
@@ -305,11 +403,25 @@ typedef struct NCTbl {
   unsigned short	cacheIndex;
 } NCTable;
 
-#define	TABLE		((NCTable*)_table)
-#define	WILDCARD	(TABLE->wildcard)
-#define	NAMELESS	(TABLE->nameless)
-#define	NAMED		(TABLE->named)
-#define	LOCKCOUNT	(TABLE->lockCount)
+/*
+ * Rather than a single table, a notification center has a number of
+ * tables, each with its own lock, so that threads posting notifications
+ * with different names (or adding observers for them) do not all contend
+ * for the same lock.  Observations for a particular name are all kept in
+ * the table chosen by the hash of that name, while observations with no
+ * name (which match notifications of any name) are kept in a table of
+ * their own.  Each table only uses the parts of the NCTable structure it
+ * needs ... the wildcard and nameless lists for the unnamed table, and
+ * the named map for the others.
+ */
+#define	SHARDS		16
+typedef struct {
+  NCTable		*unnamed;	/* Observations without names.	*/
+  NCTable		*named[SHARDS];	/* Named observations by hash.	*/
+} NCShards;
+
+#define	TABLES		((NCShards*)_table)
+#define	UNNAMED		(TABLES->unnamed)
 
 static Observation *
 obsNew(NCTable *t, SEL s, IMP m, id o)
@@ -488,12 +600,48 @@ static NCTable *newNCTable(void)
   t->nameless = NSAllocateCollectable(sizeof(GSIMapTable_t), NSScannedOption);
   t->named = NSAllocateCollectable(sizeof(GSIMapTable_t), NSScannedOption);
   GSIMapInitWithZoneAndCapacity(t->nameless, _zone, 16);
-  GSIMapInitWithZoneAndCapacity(t->named, _zone, 128);
+  GSIMapInitWithZoneAndCapacity(t->named, _zone, 16);
 
   t->_lock = [NSRecursiveLock new];
   return t;
 }
 
+static NCShards *newNCShards(void)
+{
+  NCShards	*s;
+  unsigned	i;
+
+  s = (NCShards*)NSAllocateCollectable(sizeof(NCShards), NSScannedOption);
+  s->unnamed = newNCTable();
+  for (i = 0; i < SHARDS; i++)
+    {
+      s->named[i] = newNCTable();
+    }
+  return s;
+}
+
+static void endNCShards(NCShards *s)
+{
+  unsigned	i;
+
+  endNCTable(s->unnamed);
+  for (i = 0; i < SHARDS; i++)
+    {
+      endNCTable(s->named[i]);
+    }
+  NSZoneFree(NSDefaultMallocZone(), s);
+}
+
+/*
+ * Returns the table holding the observations for the named notification.
+ */
+static inline NCTable *tableForName(NCShards *s, NSString *name)
+{
+  unsigned	h = doHash(name);
+
+  return s->named[(h ^ (h >> 8) ^ (h >> 16)) & (SHARDS - 1)];
+}
+
 static inline void lockNCTable(NCTable* t)
 {
   [t->_lock lock];
@@ -514,6 +662,14 @@ static void obsFree(Observation *o)
     {
       NCTable	*t = o->link;
 
+      if (o->method == blockObserverIMP)
+	{
+	  /* The observer was created for a block and belongs to us.
+	   * We autorelease it rather than releasing it, so that it
+	   * (and its block) are not deallocated while a table is locked.
+	   */
+	  AUTORELEASE(o->observer);
+	}
 #if	GS_WITH_GC
       GSAssignZeroingWeakPointer((void**)&o->observer, 0);
 #endif
@@ -711,6 +867,8 @@ static NSNotificationCenter *default_center = nil;
 	{
 	  concrete = [GSNotification class];
 	}
+      blockObserverIMP = [GSNotificationObserver instanceMethodForSelector:
+	@selector(didReceiveNotification:)];
       /*
        * Do alloc and init separately so the default center can refer to
        * the 'default_center' variable during initialisation.
@@ -738,7 +896,7 @@ static NSNotificationCenter *default_center = nil;
 {
   if ((self = [super init]) != nil)
     {
-      _table = newNCTable();
+      _table = newNCShards();
     }
   return self;
 }
@@ -760,7 +918,7 @@ static NSNotificationCenter *default_center = nil;
   /*
    * Release all memory used to store Observations etc.
    */
-  endNCTable(TABLE);
+  endNCShards(TABLES);
 }
 
 
@@ -795,6 +953,7 @@ static NSNotificationCenter *default_center = nil;
 	      object: (id)object
 {
   IMP		method;
+  NCTable	*t;
   Observation	*list;
   Observation	*o;
   GSIMapTable	m;
@@ -819,9 +978,10 @@ static NSNotificationCenter *default_center = nil;
     [NSException raise: NSInvalidArgumentException
 		format: @"Observer can not handle specified selector"];
 
-  lockNCTable(TABLE);
+  t = (name == nil) ? UNNAMED : tableForName(TABLES, name);
+  lockNCTable(t);
 
-  o = obsNew(TABLE, selector, method, observer);
+  o = obsNew(t, selector, method, observer);
 
   if (object != nil)
     {
@@ -841,16 +1001,16 @@ static NSNotificationCenter *default_center = nil;
       /*
        * Locate the map table for this name - create it if not present.
        */
-      n = GSIMapNodeForKey(NAMED, (GSIMapKey)(id)name);
+      n = GSIMapNodeForKey(t->named, (GSIMapKey)(id)name);
       if (n == 0)
 	{
-	  m = mapNew(TABLE);
+	  m = mapNew(t);
 	  /*
 	   * As this is the first observation for the given name, we take a
 	   * copy of the name so it cannot be mutated while in the map.
 	   */
 	  name = [name copyWithZone: NSDefaultMallocZone()];
-	  GSIMapAddPair(NAMED, (GSIMapKey)(id)name, (GSIMapVal)(void*)m);
+	  GSIMapAddPair(t->named, (GSIMapKey)(id)name, (GSIMapVal)(void*)m);
 	  GS_CONSUMED(name)
 	}
       else
@@ -876,11 +1036,11 @@ static NSNotificationCenter *default_center = nil;
     }
   else if (object)
     {
-      n = GSIMapNodeForSimpleKey(NAMELESS, (GSIMapKey)object);
+      n = GSIMapNodeForSimpleKey(t->nameless, (GSIMapKey)object);
       if (n == 0)
 	{
 	  o->next = ENDOBS;
-	  GSIMapAddPair(NAMELESS, (GSIMapKey)object, (GSIMapVal)o);
+	  GSIMapAddPair(t->nameless, (GSIMapKey)object, (GSIMapVal)o);
 	}
       else
 	{
@@ -891,11 +1051,51 @@ static NSNotificationCenter *default_center = nil;
     }
   else
     {
-      o->next = WILDCARD;
-      WILDCARD = o;
+      o->next = t->wildcard;
+      t->wildcard = o;
     }
 
-  unlockNCTable(TABLE);
+  unlockNCTable(t);
+}
+
+/**
+ * <p>Registers block to be called with each notification matching name
+ * and/or object (as for -addObserver:selector:name:object:) and returns
+ * the observer object created to call it.  The receiver retains the
+ * observer until you remove it by passing it to -removeObserver: or
+ * -removeObserver:name:object:, which you must do to stop the block from
+ * being called.
+ * </p>
+ * <p>If queue is nil, the block is called synchronously in the thread
+ * which posts the notification.  Otherwise an operation which calls the
+ * block is added to queue, so the block may be called later and in
+ * another thread (the poster does not wait for it).
+ * </p>
+ * <p>The method used to call the block is looked up once, when the
+ * observer is added, so calling a block costs the same as sending any
+ * other observer its message.
+ * </p>
+ */
+- (id) addObserverForName: (NSString*)name
+                   object: (id)object
+                    queue: (NSOperationQueue*)queue
+               usingBlock: (GSNotificationBlock)block
+{
+  GSNotificationObserver	*observer;
+
+  if (block == 0)
+    [NSException raise: NSInvalidArgumentException
+		format: @"Nil block passed to addObserverForName ..."];
+
+  /* The observer is released by the receiver when it is removed.
+   */
+  observer = [[GSNotificationObserver alloc] initWithQueue: queue
+						    block: block];
+  [self addObserver: observer
+	   selector: @selector(didReceiveNotification:)
+	       name: name
+	     object: object];
+  return observer;
 }
 
 /**
@@ -919,115 +1119,123 @@ static NSNotificationCenter *default_center = nil;
    *	the entry returned by the enumerator.
    */
 
-  lockNCTable(TABLE);
-
   if (object != nil)
     {
       object = CHEATGC(object);
     }
 
-  if (name == nil && object == nil)
-    {
-      WILDCARD = listPurge(WILDCARD, observer);
-    }
-
   if (name == nil)
     {
+      NCTable		*t;
       GSIMapEnumerator_t	e0;
       GSIMapNode		n0;
+      unsigned			i;
 
       /*
        * First try removing all named items set for this object.
+       * These may be in any of the tables for named observations.
        */
-      e0 = GSIMapEnumeratorForMap(NAMED);
-      n0 = GSIMapEnumeratorNextNode(&e0);
-      while (n0 != 0)
+      for (i = 0; i < SHARDS; i++)
 	{
-	  GSIMapTable		m = (GSIMapTable)n0->value.ptr;
-	  NSString		*thisName = (NSString*)n0->key.obj;
-
+	  t = TABLES->named[i];
+	  lockNCTable(t);
+	  e0 = GSIMapEnumeratorForMap(t->named);
 	  n0 = GSIMapEnumeratorNextNode(&e0);
-	  if (object == nil)
+	  while (n0 != 0)
 	    {
-	      GSIMapEnumerator_t	e1 = GSIMapEnumeratorForMap(m);
-	      GSIMapNode		n1 = GSIMapEnumeratorNextNode(&e1);
+	      GSIMapTable		m = (GSIMapTable)n0->value.ptr;
+	      NSString		*thisName = (NSString*)n0->key.obj;
 
-	      /*
-	       * Nil object and nil name, so we step through all the maps
-	       * keyed under the current name and remove all the objects
-	       * that match the observer.
-	       */
-	      while (n1 != 0)
+	      n0 = GSIMapEnumeratorNextNode(&e0);
+	      if (object == nil)
 		{
-		  GSIMapNode	next = GSIMapEnumeratorNextNode(&e1);
+		  GSIMapEnumerator_t	e1 = GSIMapEnumeratorForMap(m);
+		  GSIMapNode		n1 = GSIMapEnumeratorNextNode(&e1);
+
+		  /*
+		   * Nil object and nil name, so we step through all the maps
+		   * keyed under the current name and remove all the objects
+		   * that match the observer.
+		   */
+		  while (n1 != 0)
+		    {
+		      GSIMapNode	next = GSIMapEnumeratorNextNode(&e1);
 
-		  purgeMapNode(m, n1, observer);
-		  n1 = next;
+		      purgeMapNode(m, n1, observer);
+		      n1 = next;
+		    }
+		}
+	      else
+		{
+		  GSIMapNode	n1;
+
+		  /*
+		   * Nil name, but non-nil object - we locate the map for the
+		   * specified object, and remove all the items that match
+		   * the observer.
+		   */
+		  n1 = GSIMapNodeForSimpleKey(m, (GSIMapKey)object);
+		  if (n1 != 0)
+		    {
+		      purgeMapNode(m, n1, observer);
+		    }
 		}
-	    }
-	  else
-	    {
-	      GSIMapNode	n1;
-
 	      /*
-	       * Nil name, but non-nil object - we locate the map for the
-	       * specified object, and remove all the items that match
-	       * the observer.
+	       * If we removed all the observations keyed under this name, we
+	       * must remove the map table too.
 	       */
-	      n1 = GSIMapNodeForSimpleKey(m, (GSIMapKey)object);
-	      if (n1 != 0)
+	      if (m->nodeCount == 0)
 		{
-		  purgeMapNode(m, n1, observer);
+		  mapFree(t, m);
+		  GSIMapRemoveKey(t->named, (GSIMapKey)(id)thisName);
 		}
 	    }
-	  /*
-	   * If we removed all the observations keyed under this name, we
-	   * must remove the map table too.
-	   */
-	  if (m->nodeCount == 0)
-	    {
-	      mapFree(TABLE, m);
-	      GSIMapRemoveKey(NAMED, (GSIMapKey)(id)thisName);
-	    }
+	  unlockNCTable(t);
 	}
 
       /*
        * Now remove unnamed items
        */
+      t = UNNAMED;
+      lockNCTable(t);
       if (object == nil)
 	{
-	  e0 = GSIMapEnumeratorForMap(NAMELESS);
+	  t->wildcard = listPurge(t->wildcard, observer);
+	  e0 = GSIMapEnumeratorForMap(t->nameless);
 	  n0 = GSIMapEnumeratorNextNode(&e0);
 	  while (n0 != 0)
 	    {
 	      GSIMapNode	next = GSIMapEnumeratorNextNode(&e0);
 
-	      purgeMapNode(NAMELESS, n0, observer);
+	      purgeMapNode(t->nameless, n0, observer);
 	      n0 = next;
 	    }
 	}
       else
 	{
-	  n0 = GSIMapNodeForSimpleKey(NAMELESS, (GSIMapKey)object);
+	  n0 = GSIMapNodeForSimpleKey(t->nameless, (GSIMapKey)object);
 	  if (n0 != 0)
 	    {
-	      purgeMapNode(NAMELESS, n0, observer);
+	      purgeMapNode(t->nameless, n0, observer);
 	    }
 	}
+      unlockNCTable(t);
     }
   else
     {
+      NCTable		*t = tableForName(TABLES, name);
       GSIMapTable		m;
       GSIMapEnumerator_t	e0;
       GSIMapNode		n0;
 
+      lockNCTable(t);
       /*
        * Locate the map table for this name.
        */
-      n0 = GSIMapNodeForKey(NAMED, (GSIMapKey)((id)name));
+      n0 = GSIMapNodeForKey(t->named, (GSIMapKey)((id)name));
       if (n0 == 0)
 	{
-	  unlockNCTable(TABLE);
+	  unlockNCTable(t);
 	  return;		/* Nothing to do.	*/
 	}
       m = (GSIMapTable)n0->value.ptr;
@@ -1055,11 +1263,11 @@ static NSNotificationCenter *default_center = nil;
 	}
       if (m->nodeCount == 0)
 	{
-	  mapFree(TABLE, m);
-	  GSIMapRemoveKey(NAMED, (GSIMapKey)((id)name));
+	  mapFree(t, m);
+	  GSIMapRemoveKey(t->named, (GSIMapKey)((id)name));
 	}
+      unlockNCTable(t);
     }
-  unlockNCTable(TABLE);
 }
 
 /**
@@ -1084,8 +1292,10 @@ static NSNotificationCenter *default_center = nil;
 {
   Observation	*o;
   unsigned	count;
+  unsigned	unnamedCount = 0;
   NSString	*name = [notification name];
   id		object;
+  NCTable	*t;
   GSIMapNode	n;
   GSIMapTable	m;
   GSIArrayItem	i[64];
@@ -1108,7 +1318,7 @@ static NSNotificationCenter *default_center = nil;
     }
 
   /*
-   * Lock the table of observations while we traverse it.
+   * Lock each table of observations while we traverse it.
    *
    * The table of observations contains weak pointers which are zeroed when
    * the observers get garbage collected.  So to avoid consistency problems
@@ -1122,54 +1332,85 @@ static NSNotificationCenter *default_center = nil;
 #else
   GSIArrayInitWithZoneAndStaticCapacity(a, _zone, 64, i);
 #endif
-  lockNCTable(TABLE);
 
   /*
-   * Find all the observers that specified neither NAME nor OBJECT.
+   * Most notifications are only observed by name, so we check (without
+   * locking) whether there are any observations without a name before
+   * locking their table.  If an observation is being added at the same
+   * time, it does not matter whether or not it sees this notification.
    */
-  for (o = WILDCARD = purgeCollected(WILDCARD); o != ENDOBS; o = o->next)
+  t = UNNAMED;
+  if (t->wildcard != ENDOBS || t->nameless->nodeCount > 0)
     {
-      GSIArrayAddItem(a, (GSIArrayItem)o);
-    }
+      lockNCTable(t);
 
-  /*
-   * Find the observers that specified OBJECT, but didn't specify NAME.
-   */
-  if (object)
-    {
-      n = GSIMapNodeForSimpleKey(NAMELESS, (GSIMapKey)object);
-      if (n != 0)
+      /*
+       * Find all the observers that specified neither NAME nor OBJECT.
+       */
+      for (o = t->wildcard = purgeCollected(t->wildcard); o != ENDOBS;
+	o = o->next)
 	{
-	  o = purgeCollectedFromMapNode(NAMELESS, n);
-	  while (o != ENDOBS)
+	  GSIArrayAddItem(a, (GSIArrayItem)o);
+	}
+
+      /*
+       * Find the observers that specified OBJECT, but didn't specify NAME.
+       */
+      if (object)
+	{
+	  n = GSIMapNodeForSimpleKey(t->nameless, (GSIMapKey)object);
+	  if (n != 0)
 	    {
-	      GSIArrayAddItem(a, (GSIArrayItem)o);
-	      o = o->next;
+	      o = purgeCollectedFromMapNode(t->nameless, n);
+	      while (o != ENDOBS)
+		{
+		  GSIArrayAddItem(a, (GSIArrayItem)o);
+		  o = o->next;
+		}
 	    }
 	}
+
+      unlockNCTable(t);
+      unnamedCount = GSIArrayCount(a);
     }
 
   /*
    * Find the observers of NAME, except those observers with a non-nil OBJECT
    * that doesn't match the notification's OBJECT).
    */
-  if (name)
+  t = tableForName(TABLES, name);
+  lockNCTable(t);
+  n = GSIMapNodeForKey(t->named, (GSIMapKey)((id)name));
+  if (n)
     {
-      n = GSIMapNodeForKey(NAMED, (GSIMapKey)((id)name));
-      if (n)
-	{
-	  m = (GSIMapTable)n->value.ptr;
-	}
-      else
+      m = (GSIMapTable)n->value.ptr;
+    }
+  else
+    {
+      m = 0;
+    }
+  if (m != 0)
+    {
+      /*
+       * First, observers with a matching object.
+       */
+      n = GSIMapNodeForSimpleKey(m, (GSIMapKey)object);
+      if (n != 0)
 	{
-	  m = 0;
+	  o = purgeCollectedFromMapNode(m, n);
+	  while (o != ENDOBS)
+	    {
+	      GSIArrayAddItem(a, (GSIArrayItem)o);
+	      o = o->next;
+	    }
 	}
-      if (m != 0)
+
+      if (object != nil)
 	{
 	  /*
-	   * First, observers with a matching object.
+	   * Now observers with a nil object.
 	   */
-	  n = GSIMapNodeForSimpleKey(m, (GSIMapKey)object);
+	  n = GSIMapNodeForSimpleKey(m, (GSIMapKey)nil);
 	  if (n != 0)
 	    {
 	      o = purgeCollectedFromMapNode(m, n);
@@ -1179,32 +1420,15 @@ static NSNotificationCenter *default_center = nil;
 		  o = o->next;
 		}
 	    }
-
-	  if (object != nil)
-	    {
-	      /*
-	       * Now observers with a nil object.
-	       */
-	      n = GSIMapNodeForSimpleKey(m, (GSIMapKey)nil);
-	      if (n != 0)
-		{
-	          o = purgeCollectedFromMapNode(m, n);
-		  while (o != ENDOBS)
-		    {
-		      GSIArrayAddItem(a, (GSIArrayItem)o);
-		      o = o->next;
-		    }
-		}
-	    }
 	}
     }
 
   /*
-   * Finished with the table ... we can unlock it and re-enable garbage
+   * Finished with the tables ... we can unlock them and re-enable garbage
    * collection, safe in the knowledge that the observers we will be
    * notifying won't get collected prematurely.
    */
-  unlockNCTable(TABLE);
+  unlockNCTable(t);
 #if	GS_WITH_GC
   [collector enable];
 #endif
@@ -1229,9 +1453,25 @@ static NSNotificationCenter *default_center = nil;
           NS_ENDHANDLER
 	}
     }
-  lockNCTable(TABLE);
+
+  /*
+   * Release the observations, each while holding the lock for the
+   * table it belongs to.
+   */
+  if (GSIArrayCount(a) > unnamedCount)
+    {
+      lockNCTable(t);
+      GSIArrayRemoveItemsFromIndex(a, unnamedCount);
+      unlockNCTable(t);
+    }
+  if (unnamedCount > 0)
+    {
+      t = UNNAMED;
+      lockNCTable(t);
+      GSIArrayRemoveAllItems(a);
+      unlockNCTable(t);
+    }
   GSIArrayEmpty(a);
-  unlockNCTable(TABLE);
 
   RELEASE(notification);
 }
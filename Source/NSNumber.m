@@ -827,6 +827,19 @@ if (aValue >= -1 && aValue <= 12)\
     {
       return [self numberWithInt: (int) aValue];
     }
+#if OBJC_SMALL_OBJECT_SHIFT == 3
+  /* On 64-bit systems a small int can hold up to 61 bits, which covers
+   * most values which don't fit in an int (eg. file sizes, times in
+   * milliseconds, database keys).
+   */
+  if (useSmallInt
+    && (aValue < (LLONG_MAX>>OBJC_SMALL_OBJECT_SHIFT))
+    && (aValue > -(LLONG_MAX>>OBJC_SMALL_OBJECT_SHIFT)))
+    {
+      return (id)(((uintptr_t)aValue << OBJC_SMALL_OBJECT_SHIFT)
+	| SMALL_INT_MASK);
+    }
+#endif
   n = NSAllocateObject (NSLongLongNumberClass, 0, 0);
   n->value = aValue;
   return AUTORELEASE(n);
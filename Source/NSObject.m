@@ -202,8 +202,34 @@ static void GSLogZombie(id o, SEL sel)
 #undef	GSATOMICREAD
 #endif
 
+#if	defined(USE_C11_ATOMICS)
+#include <stdatomic.h>
+#endif
+
+#if	defined(USE_C11_ATOMICS) && (ATOMIC_INT_LOCK_FREE == 2)
+/* Use C11 atomics where configure found them (the default).
+ * An increment needs no ordering since the caller already owns a
+ * reference, so the object can't be deallocated during the increment.
+ * A decrement must make this thread's changes to the object visible
+ * before the count drops (release), and the thread which finds the count
+ * was zero must see all those changes before it deallocates the object,
+ * hence the acquire fence in GSAtomicAcquire().
+ * These operations are cheap enough that we use them all the time rather
+ * than only once the process becomes multi-threaded.
+ */
+typedef _Atomic(int32_t) *gsatomic_t;
+
+#define	GSATOMICREAD(X)	atomic_load_explicit(X, memory_order_relaxed)
 
-#if	defined(__MINGW__)
+#define	GSAtomicIncrement(X)	\
+  (atomic_fetch_add_explicit(X, 1, memory_order_relaxed) + 1)
+#define	GSAtomicDecrement(X)	\
+  (atomic_fetch_sub_explicit(X, 1, memory_order_release) - 1)
+#define	GSAtomicAcquire()	atomic_thread_fence(memory_order_acquire)
+#define	GSATOMICALWAYS	1
+
+
+#elif	defined(__MINGW__)
 #ifndef _WIN64
 #undef InterlockedIncrement
 #undef InterlockedDecrement
@@ -369,6 +395,22 @@ GSAtomicDecrement(gsatomic_t X)
 }
 #endif
 
+/* The older atomic operations are all full barriers, so they need
+ * nothing extra to order a decrement to zero with deallocation.
+ */
+#if	defined(GSATOMICREAD) && !defined(GSAtomicAcquire)
+#define	GSAtomicAcquire()
+#endif
+
+/* Reference counts need atomic (or locked) updates once the process has
+ * become multi-threaded, or all the time if atomic operations are cheap.
+ */
+#if	defined(GSATOMICALWAYS)
+#define	GSREFCOUNTSHARED()	1
+#else
+#define	GSREFCOUNTSHARED()	(allocationLock != 0)
+#endif
+
 #if	!defined(GSATOMICREAD)
 
 /*
@@ -468,7 +510,7 @@ NSDecrementExtraRefCountWasZero(id anObject)
         [NSException raise: NSGenericException
 		    format: @"Release would release object too many times."];
     }
-  if (allocationLock != 0)
+  if (GSREFCOUNTSHARED())
     {
 #if	defined(GSATOMICREAD)
       int	result;
@@ -488,6 +530,7 @@ NSDecrementExtraRefCountWasZero(id anObject)
 	   * thread accessing the object (or its reference count would
 	   * have been greater than zero)
 	   */
+	  GSAtomicAcquire();
 	  (((obj)anObject)[-1].retained) = 0;
 	  return YES;
 	}
@@ -577,7 +620,7 @@ NSIncrementExtraRefCount(id anObject)
 #if	GS_WITH_GC || __OBJC_GC__
   return;
 #else	/* GS_WITH_GC */
-  if (allocationLock != 0)
+  if (GSREFCOUNTSHARED())
     {
 #if	defined(GSATOMICREAD)
       /* I've seen comments saying that some platforms only support up to
@@ -30,6 +30,38 @@
 
 #import "Foundation/NSLock.h"
 
+#include <pthread.h>
+#include <sys/time.h>
+#include <errno.h>
+
+/* The number of distinct operation priorities.
+ */
+#define	PRIORITIES	5
+
+/* A circular buffer used as a FIFO queue of ready operations.
+ * The queue keeps one of these per priority, so the next operation to
+ * run can be found in constant time rather than by sorting.
+ */
+typedef struct {
+  id		*items;
+  NSUInteger	head;
+  NSUInteger	count;
+  NSUInteger	size;
+} GSOperationFIFO;
+
+/* A worker thread in the pool of a queue.  Each worker has its own queue
+ * of operations to run (protected by its own lock), so workers do not
+ * contend with each other when picking up work.  A worker which runs out
+ * of operations tries to steal from other workers before going idle.
+ */
+typedef struct {
+  pthread_mutex_t	lock;
+  pthread_cond_t	cond;		/* Signalled when work is added.  */
+  GSOperationFIFO	ops;		/* Operations waiting to start.	*/
+  BOOL			running;	/* There is a thread for worker.  */
+  BOOL			idle;		/* Thread is waiting for work.	*/
+} GSOperationWorker;
+
 #define	GS_NSOperation_IVARS \
   NSRecursiveLock *lock; \
   NSConditionLock *cond; \
@@ -45,14 +77,15 @@
 
 #define	GS_NSOperationQueue_IVARS \
   NSRecursiveLock	*lock; \
-  NSConditionLock	*cond; \
   NSMutableArray	*operations; \
-  NSMutableArray	*waiting; \
-  NSMutableArray	*starting; \
+  GSOperationFIFO	waiting[PRIORITIES]; \
+  GSOperationWorker	*workers; \
+  NSUInteger		workerCount; \
+  NSUInteger		nextWorker; \
+  NSTimeInterval	idleTimeout; \
   NSString		*name; \
   BOOL			suspended; \
   NSInteger		executing; \
-  NSInteger		threadCount; \
   NSInteger		count;
 
 #import "Foundation/NSOperation.h"
@@ -62,14 +95,17 @@
 #import "Foundation/NSEnumerator.h"
 #import "Foundation/NSException.h"
 #import "Foundation/NSKeyValueObserving.h"
+#import "Foundation/NSProcessInfo.h"
 #import "Foundation/NSThread.h"
+#import "Foundation/NSValue.h"
 #import "GSPrivate.h"
 
 #define	GSInternal	NSOperationInternal
 #include	"GSInternal.h"
 GS_PRIVATE_INTERNAL(NSOperation)
 
-/* The pool of threads for 'non-concurrent' operations in a queue.
+/* The minimum size of the pool of threads for 'non-concurrent' operations
+ * in a queue (the pool is larger on machines with more processors).
  */
 #define	POOL	8
 
@@ -540,7 +576,7 @@ GS_PRIVATE_INTERNAL(NSOperationQueue)
 @interface	NSOperationQueue (Private)
 + (void) _mainQueue;
 - (void) _execute;
-- (void) _thread;
+- (void) _thread: (NSNumber*)slot;
 - (void) observeValueForKeyPath: (NSString *)keyPath
 		       ofObject: (id)object
                          change: (NSDictionary *)change
@@ -549,15 +585,154 @@ GS_PRIVATE_INTERNAL(NSOperationQueue)
 
 static NSInteger	maxConcurrent = 200;	// Thread pool size
 
-static NSComparisonResult
-sortFunc(id o1, id o2, void *ctxt)
+/* Return the index of the waiting queue for an operation priority,
+ * from zero for the lowest to PRIORITIES-1 for the highest.
+ */
+static inline NSUInteger
+priorityIndex(NSOperationQueuePriority pri)
+{
+  if (pri <= NSOperationQueuePriorityVeryLow) return 0;
+  if (pri <= NSOperationQueuePriorityLow) return 1;
+  if (pri < NSOperationQueuePriorityHigh) return 2;
+  if (pri < NSOperationQueuePriorityVeryHigh) return 3;
+  return 4;
+}
+
+/* Append an operation (retained) to the end of a FIFO queue.
+ */
+static void
+pushOperation(GSOperationFIFO *fifo, NSOperation *op)
+{
+  if (fifo->count == fifo->size)
+    {
+      NSUInteger	size = (0 == fifo->size) ? 16 : fifo->size * 2;
+      id		*items;
+      NSUInteger	i;
+
+      items = NSZoneMalloc(NSDefaultMallocZone(), size * sizeof(id));
+      for (i = 0; i < fifo->count; i++)
+	{
+	  items[i] = fifo->items[(fifo->head + i) & (fifo->size - 1)];
+	}
+      if (fifo->items != 0)
+	{
+	  NSZoneFree(NSDefaultMallocZone(), fifo->items);
+	}
+      fifo->items = items;
+      fifo->head = 0;
+      fifo->size = size;
+    }
+  fifo->items[(fifo->head + fifo->count) & (fifo->size - 1)] = RETAIN(op);
+  fifo->count++;
+}
+
+/* Remove the operation at the start of a FIFO queue and return it.
+ * The caller is responsible for releasing the returned operation.
+ */
+static NSOperation *
+popOperation(GSOperationFIFO *fifo)
+{
+  NSOperation	*op;
+
+  if (0 == fifo->count)
+    {
+      return nil;
+    }
+  op = fifo->items[fifo->head];
+  fifo->head = (fifo->head + 1) & (fifo->size - 1);
+  fifo->count--;
+  return op;
+}
+
+/* Remove a specific operation from a FIFO queue, preserving the order
+ * of the remaining operations.  Returns YES if the operation was found.
+ */
+static BOOL
+removeOperation(GSOperationFIFO *fifo, NSOperation *op)
 {
-  NSOperationQueuePriority p1 = [o1 queuePriority];
-  NSOperationQueuePriority p2 = [o2 queuePriority];
-  
-  if (p1 < p2) return NSOrderedDescending;
-  if (p1 > p2) return NSOrderedAscending;
-  return NSOrderedSame;
+  NSUInteger	mask = fifo->size - 1;
+  NSUInteger	i;
+
+  for (i = 0; i < fifo->count; i++)
+    {
+      if (fifo->items[(fifo->head + i) & mask] == op)
+	{
+	  fifo->count--;
+	  while (i < fifo->count)
+	    {
+	      fifo->items[(fifo->head + i) & mask]
+		= fifo->items[(fifo->head + i + 1) & mask];
+	      i++;
+	    }
+	  RELEASE(op);
+	  return YES;
+	}
+    }
+  return NO;
+}
+
+/* Take an operation from the queue of another worker.  If wait is NO
+ * any worker which is busy with its lock is skipped, otherwise we wait
+ * for the lock so that no queued operation can be missed.
+ * Returns nil if there is no operation available to steal.
+ */
+static NSOperation *
+stealOperation(GSOperationWorker *workers, NSUInteger count, NSUInteger me,
+  BOOL wait)
+{
+  NSUInteger	i;
+
+  for (i = 1; i < count; i++)
+    {
+      GSOperationWorker	*worker = &workers[(me + i) % count];
+      NSOperation	*op;
+
+      if (YES == wait)
+	{
+	  pthread_mutex_lock(&worker->lock);
+	}
+      else if (0 != pthread_mutex_trylock(&worker->lock))
+	{
+	  continue;
+	}
+      op = popOperation(&worker->ops);
+      pthread_mutex_unlock(&worker->lock);
+      if (nil != op)
+	{
+	  return op;
+	}
+    }
+  return nil;
+}
+
+/* Returns the index of a worker whose thread is waiting for work, or
+ * count if there is none.  If wake is YES the worker is woken up (so it
+ * will look for operations to steal) and is no longer counted as idle.
+ */
+static NSUInteger
+idleWorker(GSOperationWorker *workers, NSUInteger count, BOOL wake)
+{
+  NSUInteger	i;
+
+  for (i = 0; i < count; i++)
+    {
+      GSOperationWorker	*worker = &workers[i];
+      BOOL		idle;
+
+      pthread_mutex_lock(&worker->lock);
+      idle = worker->idle;
+      if (YES == idle && YES == wake)
+	{
+	  worker->idle = NO;
+	  pthread_cond_signal(&worker->cond);
+	}
+      pthread_mutex_unlock(&worker->lock);
+      if (YES == idle)
+	{
+	  return i;
+	}
+    }
+  return count;
 }
 
 static NSString	*threadKey = @"NSOperationQueue";
@@ -721,28 +896,76 @@ static NSOperationQueue *mainQueue = nil;
 
 - (void) dealloc
 {
+  NSUInteger	i;
+
   [internal->operations release];
-  [internal->starting release];
-  [internal->waiting release];
+  for (i = 0; i < PRIORITIES; i++)
+    {
+      GSOperationFIFO	*fifo = &internal->waiting[i];
+      NSOperation	*op;
+
+      while ((op = popOperation(fifo)) != nil)
+	{
+	  [op removeObserver: self
+		  forKeyPath: @"queuePriority"];
+	  RELEASE(op);
+	}
+      if (fifo->items != 0)
+	{
+	  NSZoneFree(NSDefaultMallocZone(), fifo->items);
+	}
+    }
+  for (i = 0; i < internal->workerCount; i++)
+    {
+      GSOperationWorker	*worker = &internal->workers[i];
+
+      pthread_mutex_destroy(&worker->lock);
+      pthread_cond_destroy(&worker->cond);
+      if (worker->ops.items != 0)
+	{
+	  NSZoneFree(NSDefaultMallocZone(), worker->ops.items);
+	}
+    }
+  if (internal->workers != 0)
+    {
+      NSZoneFree(NSDefaultMallocZone(), internal->workers);
+    }
   [internal->name release];
-  [internal->cond release];
   [internal->lock release];
   GS_DESTROY_INTERNAL(NSOperationQueue);
   [super dealloc];
 }
 
+- (NSTimeInterval) idleTimeout
+{
+  return internal->idleTimeout;
+}
+
 - (id) init
 {
   if ((self = [super init]) != nil)
     {
+      NSUInteger	i;
+
       GS_CREATE_INTERNAL(NSOperationQueue);
       internal->suspended = NO;
       internal->count = NSOperationQueueDefaultMaxConcurrentOperationCount;
       internal->operations = [NSMutableArray new];
-      internal->starting = [NSMutableArray new];
-      internal->waiting = [NSMutableArray new];
       internal->lock = [NSRecursiveLock new];
-      internal->cond = [[NSConditionLock alloc] initWithCondition: 0];
+      internal->idleTimeout = 5.0;
+      internal->workerCount
+	= [[NSProcessInfo processInfo] activeProcessorCount];
+      if (internal->workerCount < POOL)
+	{
+	  internal->workerCount = POOL;
+	}
+      internal->workers = NSZoneCalloc(NSDefaultMallocZone(),
+	internal->workerCount, sizeof(GSOperationWorker));
+      for (i = 0; i < internal->workerCount; i++)
+	{
+	  pthread_mutex_init(&internal->workers[i].lock, NULL);
+	  pthread_cond_init(&internal->workers[i].cond, NULL);
+	}
     }
   return self;
 }
@@ -812,6 +1035,15 @@ static NSOperationQueue *mainQueue = nil;
   [self _execute];
 }
 
+- (void) setIdleTimeout: (NSTimeInterval)seconds
+{
+  if (seconds < 0.0)
+    {
+      seconds = 0.0;
+    }
+  internal->idleTimeout = seconds;
+}
+
 - (void) setName: (NSString*)s
 {
   if (s == nil) s = @"";
@@ -874,6 +1106,25 @@ static NSOperationQueue *mainQueue = nil;
                         context: (void *)context
 {
   [internal->lock lock];
+  if (YES == [keyPath isEqualToString: @"queuePriority"])
+    {
+      NSUInteger	i;
+
+      /* An operation waiting to execute has changed priority, so we
+       * must move it to the end of the queue for its new priority.
+       */
+      for (i = 0; i < PRIORITIES; i++)
+	{
+	  if (YES == removeOperation(&internal->waiting[i], object))
+	    {
+	      pushOperation(&internal->waiting[priorityIndex(
+		[object queuePriority])], object);
+	      break;
+	    }
+	}
+      [internal->lock unlock];
+      return;
+    }
   if (YES == [object isFinished])
     {
       internal->executing--;
@@ -889,77 +1140,116 @@ static NSOperationQueue *mainQueue = nil;
     {
       [object removeObserver: self
 		  forKeyPath: @"isReady"];
-      [internal->waiting addObject: object];
+      pushOperation(&internal->waiting[priorityIndex([object queuePriority])],
+	object);
+      [object addObserver: self
+	       forKeyPath: @"queuePriority"
+		  options: NSKeyValueObservingOptionNew
+		  context: NULL];
     }
   [internal->lock unlock];
   [self _execute];
 }
 
-- (void) _thread
+- (void) _thread: (NSNumber*)slot
 {
   NSAutoreleasePool	*pool = [NSAutoreleasePool new];
+  NSUInteger		index = [slot unsignedIntegerValue];
+  GSOperationWorker	*worker = &internal->workers[index];
 
   for (;;)
     {
       NSOperation	*op;
-      NSDate		*when;
-      BOOL		found;
 
-      when = [[NSDate alloc] initWithTimeIntervalSinceNow: 5.0];
-      found = [internal->cond lockWhenCondition: 1 beforeDate: when];
-      [when release];
-      if (NO == found)
-	{
-	  break;	// Idle for 5 seconds ... exit thread.
-	}
+      pthread_mutex_lock(&worker->lock);
+      op = popOperation(&worker->ops);
+      pthread_mutex_unlock(&worker->lock);
 
-      if ([internal->starting count] > 0)
+      if (nil == op)
 	{
-          op = [internal->starting objectAtIndex: 0];
-	  [internal->starting removeObjectAtIndex: 0];
-	}
-      else
-	{
-	  op = nil;
+	  op = stealOperation(internal->workers, internal->workerCount, index,
+	    NO);
 	}
 
-      if ([internal->starting count] > 0)
+      if (nil == op)
 	{
-	  // Signal any other idle threads,
-          [internal->cond unlockWithCondition: 1];
+	  /* Mark ourselves idle before looking again, so that any operation
+	   * queued after this point is either handed to us or causes us to
+	   * be woken, and any queued before it is found by stealing.
+	   */
+	  pthread_mutex_lock(&worker->lock);
+	  worker->idle = YES;
+	  pthread_mutex_unlock(&worker->lock);
+	  op = stealOperation(internal->workers, internal->workerCount, index,
+	    YES);
+	  if (nil != op)
+	    {
+	      pthread_mutex_lock(&worker->lock);
+	      worker->idle = NO;
+	      pthread_mutex_unlock(&worker->lock);
+	    }
 	}
-      else
+
+      if (nil == op)
 	{
-	  // There are no more operations starting.
-          [internal->cond unlockWithCondition: 0];
+	  struct timeval	now;
+	  struct timespec	when;
+	  NSTimeInterval	ti = internal->idleTimeout;
+	  int			result = 0;
+
+	  /* Nothing to do ... wait for an operation to be handed to us
+	   * or to be woken to steal one, but exit the thread if we are
+	   * idle for too long.
+	   */
+	  gettimeofday(&now, NULL);
+	  ti += now.tv_sec + now.tv_usec / 1000000.0;
+	  when.tv_sec = (time_t)ti;
+	  when.tv_nsec = (long)((ti - when.tv_sec) * 1000000000.0);
+
+	  pthread_mutex_lock(&worker->lock);
+	  while (YES == worker->idle && 0 == worker->ops.count
+	    && ETIMEDOUT != result)
+	    {
+	      result = pthread_cond_timedwait(&worker->cond, &worker->lock,
+		&when);
+	    }
+	  if (YES == worker->idle && 0 == worker->ops.count)
+	    {
+	      /* Idle for too long ... exit thread.  Once running is NO
+	       * the queue will start a new thread for this worker if it
+	       * needs one.
+	       */
+	      worker->idle = NO;
+	      worker->running = NO;
+	      pthread_mutex_unlock(&worker->lock);
+	      break;
+	    }
+	  worker->idle = NO;
+	  pthread_mutex_unlock(&worker->lock);
+	  continue;
 	}
 
-      if (nil != op)
+      NS_DURING
 	{
-          NS_DURING
-	    {
-	      NSAutoreleasePool	*opPool = [NSAutoreleasePool new];
+	  NSAutoreleasePool	*opPool = [NSAutoreleasePool new];
 
-	      if (NO == [op isCancelled])
-		{
-		  [NSThread setThreadPriority: [op threadPriority]];
-		  [op main];
-		}
-	      [opPool release];
-	    }
-          NS_HANDLER
+	  if (NO == [op isCancelled])
 	    {
-	      NSLog(@"Problem running operation %@ ... %@",
-		op, localException);
+	      [NSThread setThreadPriority: [op threadPriority]];
+	      [op main];
 	    }
-          NS_ENDHANDLER
-	  [op _finish];
+	  [opPool release];
 	}
+      NS_HANDLER
+	{
+	  NSLog(@"Problem running operation %@ ... %@",
+	    op, localException);
+	}
+      NS_ENDHANDLER
+      [op _finish];
+      RELEASE(op);
     }
 
-  [internal->lock lock];
-  internal->threadCount--;
-  [internal->lock unlock];
   [pool release];
   [NSThread exit];
 }
@@ -979,22 +1269,30 @@ static NSOperationQueue *mainQueue = nil;
     }
 
   while (NO == [self isSuspended]
-    && max > internal->executing
-    && [internal->waiting count] > 0)
+    && max > internal->executing)
     {
-      NSOperation	*op;
+      NSOperation	*op = nil;
+      NSUInteger	i = PRIORITIES;
 
-      /* Make sure we have a sorted queue of operations waiting to execute.
-       */
-      [internal->waiting sortUsingFunction: sortFunc context: 0];
-
-      /* Take the first operation from the queue and start it executing.
+      /* Take the first operation from the highest priority queue which
+       * has operations waiting, and start it executing.
        * We set ourselves up as an observer for the operating finishing
        * and we keep track of the count of operations we have started,
        * but the actual startup is left to the NSOperation -start method.
        */
-      op = [internal->waiting objectAtIndex: 0];
-      [internal->waiting removeObjectAtIndex: 0];
+      while (i-- > 0)
+	{
+	  if ((op = popOperation(&internal->waiting[i])) != nil)
+	    {
+	      break;
+	    }
+	}
+      if (nil == op)
+	{
+	  break;	// Nothing waiting to execute.
+	}
+      [op removeObserver: self
+	      forKeyPath: @"queuePriority"];
       [op addObserver: self
 	   forKeyPath: @"isFinished"
 	      options: NSKeyValueObservingOptionNew
@@ -1006,27 +1304,66 @@ static NSOperationQueue *mainQueue = nil;
 	}
       else
 	{
-	  NSUInteger	pending;
-
-	  [internal->cond lock];
-	  pending = [internal->starting count];
-	  [internal->starting addObject: op];
-
-	  /* Create a new thread if all existing threads are busy and
-	   * we haven't reached the pool limit.
+	  NSUInteger		count = internal->workerCount;
+	  NSUInteger		index;
+	  GSOperationWorker	*worker;
+
+	  /* Hand the operation to an idle worker if there is one,
+	   * otherwise to a worker with no thread (so that a new thread
+	   * is created while we haven't reached the pool limit), and
+	   * if all workers are busy, share operations out between them.
 	   */
-	  if (0 == internal->threadCount
-	    || (pending > 0 && internal->threadCount < POOL))
+	  index = idleWorker(internal->workers, count, NO);
+	  if (index == count)
+	    {
+	      for (index = 0; index < count; index++)
+		{
+		  BOOL	running;
+
+		  worker = &internal->workers[index];
+		  pthread_mutex_lock(&worker->lock);
+		  running = worker->running;
+		  pthread_mutex_unlock(&worker->lock);
+		  if (NO == running)
+		    {
+		      break;
+		    }
+		}
+	    }
+	  if (index == count)
 	    {
-	      internal->threadCount++;
-	      [NSThread detachNewThreadSelector: @selector(_thread)
+	      index = internal->nextWorker++ % count;
+	    }
+	  worker = &internal->workers[index];
+
+	  pthread_mutex_lock(&worker->lock);
+	  pushOperation(&worker->ops, op);
+	  if (NO == worker->running)
+	    {
+	      worker->running = YES;
+	      pthread_mutex_unlock(&worker->lock);
+	      [NSThread detachNewThreadSelector: @selector(_thread:)
 				       toTarget: self
-				     withObject: nil];
+				     withObject:
+		[NSNumber numberWithUnsignedInteger: index]];
+	    }
+	  else if (YES == worker->idle)
+	    {
+	      worker->idle = NO;	// Don't hand it any more for now.
+	      pthread_cond_signal(&worker->cond);
+	      pthread_mutex_unlock(&worker->lock);
+	    }
+	  else
+	    {
+	      pthread_mutex_unlock(&worker->lock);
+	      /* The worker is busy, so if another worker has gone idle
+	       * since we looked, wake it to steal the operation rather
+	       * than leaving it to wait behind the one being run.
+	       */
+	      idleWorker(internal->workers, count, YES);
 	    }
-	  /* Tell the thread pool that there is an operation to start.
-	   */
-	  [internal->cond unlockWithCondition: 1];
 	}
+      RELEASE(op);
     }
   [internal->lock unlock];
 }
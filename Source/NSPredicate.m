@@ -38,11 +38,17 @@
 #import "Foundation/NSPredicate.h"
 
 #import "Foundation/NSArray.h"
+#import "Foundation/NSAutoreleasePool.h"
+#import "Foundation/NSData.h"
+#import "Foundation/NSDecimalNumber.h"
 #import "Foundation/NSDictionary.h"
 #import "Foundation/NSEnumerator.h"
 #import "Foundation/NSException.h"
 #import "Foundation/NSKeyValueCoding.h"
+#import "Foundation/NSLock.h"
 #import "Foundation/NSNull.h"
+#import "Foundation/NSOperation.h"
+#import "Foundation/NSProcessInfo.h"
 #import "Foundation/NSScanner.h"
 #import "Foundation/NSValue.h"
 
@@ -60,6 +66,12 @@
  */
 static NSExpression	*evaluatedObjectExpression = nil;
 
+/* NSObject's key-value coding methods, so that key paths can be followed
+ * without sending messages for objects which do not override them.
+ */
+static IMP		objectValueForKey = 0;
+static IMP		objectValueForKeyPath = 0;
+
 @interface GSPredicateScanner : NSScanner
 {
   NSEnumerator	*_args;		// Not retained.
@@ -105,6 +117,12 @@ static NSExpression	*evaluatedObjectExpression = nil;
 - (id) _expressionWithSubstitutionVariables: (NSDictionary *)variables;
 @end
 
+@interface NSComparisonPredicate (Private)
+- (BOOL) _evaluateLeftValue: (id)leftResult
+		 rightValue: (id)rightResult
+		     object: (id)object;
+@end
+
 @interface GSConstantValueExpression : NSExpression
 {
   @public
@@ -122,10 +140,24 @@ static NSExpression	*evaluatedObjectExpression = nil;
 }
 @end
 
+/* A key path is split into its keys when the expression is created.
+ * Each step holds a key (as a string and in UTF-8), and the remainder
+ * of the path starting at that key, for use with objects which handle
+ * key paths themselves.
+ */
+typedef struct {
+  NSString	*key;
+  NSString	*rest;
+  char		*utf8;
+  unsigned	len;
+} GSKeyPathStep;
+
 @interface GSKeyPathExpression : NSExpression
 {
   @public
   NSString	*_keyPath;
+  unsigned	_count;
+  GSKeyPathStep	*_steps;
 }
 @end
 
@@ -139,6 +171,56 @@ static NSExpression	*evaluatedObjectExpression = nil;
 }
 @end
 
+/* A predicate compiled for evaluation with many objects (as when a
+ * collection is filtered).  Where the predicates and expressions in the
+ * tree are of the standard classes they are evaluated directly from C
+ * structures rather than by sending messages, and comparisons with a
+ * constant number are done on the values of the numbers.  Anything else
+ * is evaluated by the original predicate or expression.
+ */
+typedef enum {
+  GSPNGeneral,
+  GSPNTrue,
+  GSPNFalse,
+  GSPNAnd,
+  GSPNOr,
+  GSPNNot,
+  GSPNCompare
+} GSPredicateNodeKind;
+
+typedef enum {
+  GSPOGeneral,
+  GSPOSelf,
+  GSPOConstant,
+  GSPOKeyPath
+} GSPredicateOperandKind;
+
+typedef struct {
+  GSPredicateOperandKind	kind;
+  NSExpression			*expression;
+} GSPredicateOperand;
+
+typedef struct GSPredicateNode {
+  GSPredicateNodeKind		kind;
+  NSPredicate			*predicate;
+  unsigned			count;
+  struct GSPredicateNode	*subs;
+  GSPredicateOperand		left;
+  GSPredicateOperand		right;
+  char				number;	// Kind of constant number on right
+  long long			ll;
+  double			d;
+} GSPredicateNode;
+
+@interface GSCompiledPredicate : NSPredicate
+{
+  @public
+  NSPredicate		*_predicate;
+  GSPredicateNode	_root;
+}
+- (id) initWithPredicate: (NSPredicate*)predicate;
+@end
+
 
 
 @implementation NSPredicate
@@ -1064,6 +1146,68 @@ GSICUStringMatchesRegex(NSString *string, NSString *regex, NSStringCompareOption
 
 
 
+/* Split the key path of e into the steps used to evaluate it.
+ */
+static void
+GSSplitKeyPath(GSKeyPathExpression *e)
+{
+  NSArray	*keys = [e->_keyPath componentsSeparatedByString: @"."];
+  NSUInteger	length = [e->_keyPath length];
+  NSUInteger	pos = 0;
+  unsigned	i;
+
+  e->_count = [keys count];
+  e->_steps = (GSKeyPathStep*)NSZoneMalloc(NSDefaultMallocZone(),
+    e->_count * sizeof(GSKeyPathStep));
+  for (i = 0; i < e->_count; i++)
+    {
+      GSKeyPathStep	*s = &e->_steps[i];
+      const char	*u;
+
+      s->key = RETAIN([keys objectAtIndex: i]);
+      s->rest = RETAIN([e->_keyPath substringWithRange:
+	NSMakeRange(pos, length - pos)]);
+      pos += [s->key length] + 1;
+      u = [s->key UTF8String];
+      s->len = strlen(u);
+      s->utf8 = (char*)NSZoneMalloc(NSDefaultMallocZone(), s->len + 1);
+      memcpy(s->utf8, u, s->len + 1);
+    }
+}
+
+/* Follow the key path of e from object, getting the value for each key
+ * directly where the object uses NSObject's key-value coding, and passing
+ * the rest of the path to any object which handles key paths itself (so
+ * that collections can apply operators like @count).
+ */
+static id
+GSKeyPathValue(GSKeyPathExpression *e, id object)
+{
+  unsigned	i;
+
+  for (i = 0; i < e->_count && object != nil; i++)
+    {
+      GSKeyPathStep	*s = &e->_steps[i];
+      Class		c = object_getClass(object);
+
+      if (class_getMethodImplementation(c, @selector(valueForKeyPath:))
+	!= objectValueForKeyPath)
+	{
+	  return [object valueForKeyPath: s->rest];
+	}
+      if (class_getMethodImplementation(c, @selector(valueForKey:))
+	== objectValueForKey)
+	{
+	  object = GSPrivateValueForKey(object, s->utf8, s->len);
+	}
+      else
+	{
+	  object = [object valueForKey: s->key];
+	}
+    }
+  return object;
+}
+
 @implementation NSExpression
 
 + (void) initialize
@@ -1071,6 +1215,10 @@ GSICUStringMatchesRegex(NSString *string, NSString *regex, NSStringCompareOption
   if (self == [NSExpression class] && nil == evaluatedObjectExpression)
     {
       evaluatedObjectExpression = [GSEvaluatedObjectExpression new];
+      objectValueForKey = [NSObject instanceMethodForSelector:
+	@selector(valueForKey:)];
+      objectValueForKeyPath = [NSObject instanceMethodForSelector:
+	@selector(valueForKeyPath:)];
     }
 }
 
@@ -1121,6 +1269,7 @@ GSICUStringMatchesRegex(NSString *string, NSString *regex, NSStringCompareOption
   e = [[GSKeyPathExpression alloc] 
           initWithExpressionType: NSKeyPathExpressionType];
   ASSIGN(e->_keyPath, path);
+  GSSplitKeyPath(e);
   return AUTORELEASE(e);
 }
 
@@ -1347,7 +1496,7 @@ GSICUStringMatchesRegex(NSString *string, NSString *regex, NSStringCompareOption
 - (id) expressionValueWithObject: (id)object
 			 context: (NSMutableDictionary *)context
 {
-  return [object valueForKeyPath: _keyPath];
+  return GSKeyPathValue(self, object);
 }
 
 - (NSString *) keyPath
@@ -1357,6 +1506,18 @@ GSICUStringMatchesRegex(NSString *string, NSString *regex, NSStringCompareOption
 
 - (void) dealloc;
 {
+  unsigned	i;
+
+  for (i = 0; i < _count; i++)
+    {
+      RELEASE(_steps[i].key);
+      RELEASE(_steps[i].rest);
+      NSZoneFree(NSDefaultMallocZone(), _steps[i].utf8);
+    }
+  if (_steps != 0)
+    {
+      NSZoneFree(NSDefaultMallocZone(), _steps);
+    }
   RELEASE(_keyPath);
   [super dealloc];
 }
@@ -1367,6 +1528,7 @@ GSICUStringMatchesRegex(NSString *string, NSString *regex, NSStringCompareOption
 
   copy = (GSKeyPathExpression *)[super copyWithZone: zone];
   copy->_keyPath = [_keyPath copyWithZone: zone];
+  GSSplitKeyPath(copy);
   return copy;
 }
 
@@ -1598,18 +1760,568 @@ GSICUStringMatchesRegex(NSString *string, NSString *regex, NSStringCompareOption
 
 
 
+static Class	GSAndCompoundPredicateClass = 0;
+static Class	GSOrCompoundPredicateClass = 0;
+static Class	GSNotCompoundPredicateClass = 0;
+static Class	GSTruePredicateClass = 0;
+static Class	GSFalsePredicateClass = 0;
+static Class	NSComparisonPredicateClass = 0;
+static Class	GSConstantValueExpressionClass = 0;
+static Class	GSKeyPathExpressionClass = 0;
+static Class	NSNumberClass = 0;
+static Class	NSDecimalNumberClass = 0;
+
+/* Return 'i' if o is a number with an integer value which fits in a
+ * long long (storing it in *ll), 'd' if it is a floating point number
+ * (storing it in *d), or zero if it is anything else.
+ */
+static char
+GSNumberKind(id o, long long *ll, double *d)
+{
+  Class	c;
+
+  if (o == nil)
+    {
+      return 0;
+    }
+  c = object_getClass(o);
+  if (GSObjCIsKindOf(c, NSNumberClass) == NO
+    || GSObjCIsKindOf(c, NSDecimalNumberClass) == YES)
+    {
+      return 0;
+    }
+  switch (*[o objCType])
+    {
+      case 'c':
+      case 'C':
+      case 's':
+      case 'S':
+      case 'i':
+      case 'I':
+      case 'l':
+      case 'L':
+      case 'q':
+	*ll = [o longLongValue];
+	return 'i';
+      case 'f':
+      case 'd':
+	*d = [o doubleValue];
+	if (isnan(*d))
+	  {
+	    return 0;
+	  }
+	return 'd';
+      default:
+	return 0;
+    }
+}
+
+static void
+GSCompileOperand(GSPredicateOperand *o, NSExpression *e)
+{
+  Class	c = object_getClass(e);
+
+  o->expression = e;
+  if (e == evaluatedObjectExpression)
+    {
+      o->kind = GSPOSelf;
+    }
+  else if (c == GSConstantValueExpressionClass)
+    {
+      o->kind = GSPOConstant;
+    }
+  else if (c == GSKeyPathExpressionClass)
+    {
+      o->kind = GSPOKeyPath;
+    }
+  else
+    {
+      o->kind = GSPOGeneral;
+    }
+}
+
+static void
+GSCompilePredicate(GSPredicateNode *n, NSPredicate *p)
+{
+  Class	c = object_getClass(p);
+
+  memset(n, '\0', sizeof(*n));
+  n->predicate = p;
+  if (c == GSTruePredicateClass)
+    {
+      n->kind = GSPNTrue;
+    }
+  else if (c == GSFalsePredicateClass)
+    {
+      n->kind = GSPNFalse;
+    }
+  else if (c == GSAndCompoundPredicateClass
+    || c == GSOrCompoundPredicateClass
+    || (c == GSNotCompoundPredicateClass
+    && [((NSCompoundPredicate*)p)->_subs count] > 0))
+    {
+      NSArray	*subs = ((NSCompoundPredicate*)p)->_subs;
+      unsigned	i;
+
+      if (c == GSAndCompoundPredicateClass)
+	{
+	  n->kind = GSPNAnd;
+	  n->count = [subs count];
+	}
+      else if (c == GSOrCompoundPredicateClass)
+	{
+	  n->kind = GSPNOr;
+	  n->count = [subs count];
+	}
+      else
+	{
+	  n->kind = GSPNNot;
+	  n->count = 1;
+	}
+      if (n->count > 0)
+	{
+	  n->subs = (GSPredicateNode*)NSZoneMalloc(NSDefaultMallocZone(),
+	    n->count * sizeof(GSPredicateNode));
+	  for (i = 0; i < n->count; i++)
+	    {
+	      GSCompilePredicate(&n->subs[i], [subs objectAtIndex: i]);
+	    }
+	}
+    }
+  else if (c == NSComparisonPredicateClass)
+    {
+      NSComparisonPredicate	*cp = (NSComparisonPredicate*)p;
+
+      n->kind = GSPNCompare;
+      GSCompileOperand(&n->left, cp->_left);
+      GSCompileOperand(&n->right, cp->_right);
+      if (n->right.kind == GSPOConstant)
+	{
+	  switch (cp->_type)
+	    {
+	      case NSLessThanPredicateOperatorType:
+	      case NSLessThanOrEqualToPredicateOperatorType:
+	      case NSGreaterThanPredicateOperatorType:
+	      case NSGreaterThanOrEqualToPredicateOperatorType:
+	      case NSEqualToPredicateOperatorType:
+	      case NSNotEqualToPredicateOperatorType:
+		n->number = GSNumberKind(
+		  ((GSConstantValueExpression*)cp->_right)->_obj,
+		  &n->ll, &n->d);
+		break;
+	      default:
+		break;
+	    }
+	}
+    }
+  else
+    {
+      n->kind = GSPNGeneral;
+    }
+}
+
+static void
+GSFreePredicateNode(GSPredicateNode *n)
+{
+  if (n->subs != 0)
+    {
+      unsigned	i;
+
+      for (i = 0; i < n->count; i++)
+	{
+	  GSFreePredicateNode(&n->subs[i]);
+	}
+      NSZoneFree(NSDefaultMallocZone(), n->subs);
+      n->subs = 0;
+    }
+}
+
+static inline id
+GSOperandValue(GSPredicateOperand *o, id object)
+{
+  switch (o->kind)
+    {
+      case GSPOSelf:
+	return object;
+      case GSPOConstant:
+	return ((GSConstantValueExpression*)o->expression)->_obj;
+      case GSPOKeyPath:
+	return GSKeyPathValue((GSKeyPathExpression*)o->expression, object);
+      default:
+	return [o->expression expressionValueWithObject: object context: nil];
+    }
+}
+
+/* Compare a value with that on the right of the node, comparing numbers
+ * directly when the right hand side is a constant number and the value
+ * is a number, and using the predicate's own comparison otherwise.
+ */
+static BOOL
+GSCompareValues(GSPredicateNode *n, id left, id right, id object)
+{
+  NSComparisonPredicate	*p = (NSComparisonPredicate*)n->predicate;
+
+  if (n->number != 0)
+    {
+      long long	ll;
+      double	d;
+      char	kind = GSNumberKind(left, &ll, &d);
+
+      if (kind != 0)
+	{
+	  NSComparisonResult	r;
+
+	  if (kind == 'i' && n->number == 'i')
+	    {
+	      r = (ll < n->ll) ? NSOrderedAscending
+		: ((ll > n->ll) ? NSOrderedDescending : NSOrderedSame);
+	    }
+	  else
+	    {
+	      double	other = (n->number == 'i') ? (double)n->ll : n->d;
+
+	      if (kind == 'i')
+		{
+		  d = [left doubleValue];
+		}
+	      r = (d < other) ? NSOrderedAscending
+		: ((d > other) ? NSOrderedDescending : NSOrderedSame);
+	    }
+	  switch (p->_type)
+	    {
+	      case NSLessThanPredicateOperatorType:
+		return (r == NSOrderedAscending) ? YES : NO;
+	      case NSLessThanOrEqualToPredicateOperatorType:
+		return (r != NSOrderedDescending) ? YES : NO;
+	      case NSGreaterThanPredicateOperatorType:
+		return (r == NSOrderedDescending) ? YES : NO;
+	      case NSGreaterThanOrEqualToPredicateOperatorType:
+		return (r != NSOrderedAscending) ? YES : NO;
+	      case NSEqualToPredicateOperatorType:
+		return (r == NSOrderedSame) ? YES : NO;
+	      default:
+		return (r != NSOrderedSame) ? YES : NO;
+	    }
+	}
+    }
+  return [p _evaluateLeftValue: left rightValue: right object: object];
+}
+
+static BOOL
+GSEvaluateNode(GSPredicateNode *n, id object)
+{
+  unsigned	i;
+
+  switch (n->kind)
+    {
+      case GSPNTrue:
+	return YES;
+
+      case GSPNFalse:
+	return NO;
+
+      case GSPNAnd:
+	for (i = 0; i < n->count; i++)
+	  {
+	    if (GSEvaluateNode(&n->subs[i], object) == NO)
+	      {
+		return NO;
+	      }
+	  }
+	return YES;
+
+      case GSPNOr:
+	for (i = 0; i < n->count; i++)
+	  {
+	    if (GSEvaluateNode(&n->subs[i], object) == YES)
+	      {
+		return YES;
+	      }
+	  }
+	return NO;
+
+      case GSPNNot:
+	return GSEvaluateNode(n->subs, object) ? NO : YES;
+
+      case GSPNCompare:
+	{
+	  NSComparisonPredicate	*p = (NSComparisonPredicate*)n->predicate;
+	  id			left = GSOperandValue(&n->left, object);
+	  id			right = GSOperandValue(&n->right, object);
+	  NSEnumerator		*e;
+	  id			value;
+	  BOOL			result;
+
+	  if (p->_modifier == NSDirectPredicateModifier)
+	    {
+	      return GSCompareValues(n, left, right, object);
+	    }
+	  result = (p->_modifier == NSAllPredicateModifier);
+	  if (left == evaluatedObjectExpression)
+	    {
+	      left = object;
+	    }
+	  if (![left respondsToSelector: @selector(objectEnumerator)])
+	    {
+	      [NSException raise: NSInvalidArgumentException
+			  format: @"The left hand side for an ALL or ANY"
+		@" operator must be a collection"];
+	    }
+	  e = [left objectEnumerator];
+	  while ((value = [e nextObject]))
+	    {
+	      BOOL	eval = GSCompareValues(n, value, right, object);
+
+	      if (eval != result)
+		{
+		  return eval;
+		}
+	    }
+	  return result;
+	}
+
+      default:
+	return [n->predicate evaluateWithObject: object];
+    }
+}
+
+@implementation GSCompiledPredicate
+
++ (void) initialize
+{
+  if (self == [GSCompiledPredicate class])
+    {
+      GSAndCompoundPredicateClass = [GSAndCompoundPredicate class];
+      GSOrCompoundPredicateClass = [GSOrCompoundPredicate class];
+      GSNotCompoundPredicateClass = [GSNotCompoundPredicate class];
+      GSTruePredicateClass = [GSTruePredicate class];
+      GSFalsePredicateClass = [GSFalsePredicate class];
+      NSComparisonPredicateClass = [NSComparisonPredicate class];
+      GSConstantValueExpressionClass = [GSConstantValueExpression class];
+      GSKeyPathExpressionClass = [GSKeyPathExpression class];
+      NSNumberClass = [NSNumber class];
+      NSDecimalNumberClass = [NSDecimalNumber class];
+    }
+}
+
+- (id) copyWithZone: (NSZone *)z
+{
+  return RETAIN(self);
+}
+
+- (void) dealloc
+{
+  GSFreePredicateNode(&_root);
+  RELEASE(_predicate);
+  [super dealloc];
+}
+
+- (BOOL) evaluateWithObject: (id)object
+{
+  return GSEvaluateNode(&_root, object);
+}
+
+- (id) initWithPredicate: (NSPredicate*)predicate
+{
+  if ((self = [super init]) != nil)
+    {
+      ASSIGN(_predicate, predicate);
+      GSCompilePredicate(&_root, _predicate);
+    }
+  return self;
+}
+
+- (NSString *) predicateFormat
+{
+  return [_predicate predicateFormat];
+}
+
+- (NSPredicate *) predicateWithSubstitutionVariables: (NSDictionary *)variables
+{
+  return [_predicate predicateWithSubstitutionVariables: variables];
+}
+
+@end
+
+/* Evaluates a compiled predicate with a range of objects, recording the
+ * result for each in an array of flags shared by all the operations
+ * filtering one collection.  Each operation is run once, either by the
+ * queue or by the thread doing the filtering (whichever claims it first),
+ * and the count of pending operations is decremented when it is done.
+ */
+@interface GSPredicateFilterOperation : NSOperation
+{
+  @public
+  GSCompiledPredicate	*predicate;	// Not retained
+  id			*objects;
+  uint8_t		*flags;
+  NSRange		range;
+  NSException		*exception;
+  NSCondition		*condition;	// Shared by the operations.
+  NSUInteger		*pending;	// Count of operations not done.
+  BOOL			claimed;	// Has been started.
+}
+@end
+
+@implementation GSPredicateFilterOperation
+
+- (void) dealloc
+{
+  RELEASE(condition);
+  RELEASE(exception);
+  [super dealloc];
+}
+
+- (void) main
+{
+  NSAutoreleasePool	*pool;
+  NSUInteger		end = NSMaxRange(range);
+  NSUInteger		i;
+  BOOL			run;
+
+  [condition lock];
+  run = (claimed == NO) ? YES : NO;
+  claimed = YES;
+  [condition unlock];
+  if (run == NO)
+    {
+      return;	// Already run by another thread.
+    }
+
+  pool = [NSAutoreleasePool new];
+  NS_DURING
+    {
+      for (i = range.location; i < end; i++)
+	{
+	  flags[i] = GSEvaluateNode(&predicate->_root, objects[i]);
+	  if ((i & 1023) == 1023)
+	    {
+	      [pool emptyPool];
+	    }
+	}
+    }
+  NS_HANDLER
+    {
+      exception = RETAIN(localException);
+    }
+  NS_ENDHANDLER
+  [pool release];
+
+  [condition lock];
+  (*pending)--;
+  [condition broadcast];
+  [condition unlock];
+}
+
+@end
+
+/* Evaluate predicate with count objects in ranges of chunkSize, as
+ * operations on queue (or on a private queue if queue is nil), setting
+ * the corresponding element of flags for each object which passes.
+ * The calling thread evaluates the first range, then any others which
+ * the queue has not yet started, and then waits for those which it has.
+ * So we never wait for the queue to start an operation, and can not
+ * deadlock when called from an operation running on a serial queue.
+ * Returns the exception raised by the first range to fail, or nil.
+ */
+static NSException *
+GSConcurrentFilter(NSPredicate *predicate, id *objects, NSUInteger count,
+  NSUInteger chunkSize, NSOperationQueue *queue, uint8_t *flags)
+{
+  NSUInteger		cpus;
+  GSCompiledPredicate	*c;
+  NSCondition		*condition;
+  NSMutableArray	*ops;
+  NSUInteger		pending;
+  NSUInteger		pos;
+  NSUInteger		i;
+
+  if (count == 0)
+    {
+      return nil;
+    }
+  cpus = [[NSProcessInfo processInfo] activeProcessorCount];
+  if (cpus == 0)
+    {
+      cpus = 1;
+    }
+  if (chunkSize == 0)
+    {
+      chunkSize = count / (cpus * 4);
+      if (chunkSize < 1024)
+	{
+	  chunkSize = 1024;
+	}
+    }
+
+  c = AUTORELEASE([[GSCompiledPredicate alloc] initWithPredicate: predicate]);
+  condition = AUTORELEASE([NSCondition new]);
+  ops = [NSMutableArray arrayWithCapacity: count / chunkSize + 1];
+  for (pos = 0; pos < count; pos += chunkSize)
+    {
+      GSPredicateFilterOperation	*op = [GSPredicateFilterOperation new];
+
+      op->predicate = c;
+      op->objects = objects;
+      op->flags = flags;
+      op->range = NSMakeRange(pos,
+	(count - pos < chunkSize) ? count - pos : chunkSize);
+      op->condition = RETAIN(condition);
+      op->pending = &pending;
+      [ops addObject: op];
+      RELEASE(op);
+    }
+  pending = [ops count];
+
+  if ([ops count] > 1)
+    {
+      NSArray	*rest;
+
+      if (queue == nil)
+	{
+	  queue = AUTORELEASE([NSOperationQueue new]);
+	  [queue setMaxConcurrentOperationCount: cpus];
+	}
+      rest = [ops subarrayWithRange: NSMakeRange(1, [ops count] - 1)];
+      [queue addOperations: rest waitUntilFinished: NO];
+    }
+  for (i = 0; i < [ops count]; i++)
+    {
+      [[ops objectAtIndex: i] main];
+    }
+  [condition lock];
+  while (pending > 0)
+    {
+      [condition wait];
+    }
+  [condition unlock];
+
+  for (i = 0; i < [ops count]; i++)
+    {
+      GSPredicateFilterOperation	*op = [ops objectAtIndex: i];
+
+      if (op->exception != nil)
+	{
+	  return AUTORELEASE(RETAIN(op->exception));
+	}
+    }
+  return nil;
+}
+
 @implementation NSArray (NSPredicate)
 
 - (NSArray *) filteredArrayUsingPredicate: (NSPredicate *)predicate
 {
   NSMutableArray	*result;
   NSEnumerator		*e = [self objectEnumerator];
+  GSCompiledPredicate	*c;
   id			object;
 
+  c = AUTORELEASE([[GSCompiledPredicate alloc] initWithPredicate: predicate]);
   result = [NSMutableArray arrayWithCapacity: [self count]];
   while ((object = [e nextObject]) != nil)
     {
-      if ([predicate evaluateWithObject: object] == YES)
+      if (GSEvaluateNode(&c->_root, object) == YES)
         {
           [result addObject: object];  // passes filter
         }
@@ -1617,19 +2329,54 @@ GSICUStringMatchesRegex(NSString *string, NSString *regex, NSStringCompareOption
   return [result makeImmutableCopyOnFail: NO];
 }
 
+- (NSArray *) filteredArrayUsingPredicate: (NSPredicate *)predicate
+				chunkSize: (NSUInteger)chunkSize
+				    queue: (NSOperationQueue *)queue
+{
+  NSUInteger		count = [self count];
+  NSMutableArray	*result = [NSMutableArray arrayWithCapacity: count];
+  NSMutableData		*data = [NSMutableData dataWithLength: count];
+  uint8_t		*flags = (uint8_t*)[data mutableBytes];
+  NSException		*exception;
+  NSUInteger		i;
+  GS_BEGINITEMBUF(objects, count, id)
+
+  [self getObjects: objects range: NSMakeRange(0, count)];
+  exception = GSConcurrentFilter(predicate, objects, count, chunkSize,
+    queue, flags);
+  if (exception == nil)
+    {
+      for (i = 0; i < count; i++)
+	{
+	  if (flags[i] != 0)
+	    {
+	      [result addObject: objects[i]];
+	    }
+	}
+    }
+  GS_ENDITEMBUF()
+  if (exception != nil)
+    {
+      [exception raise];
+    }
+  return [result makeImmutableCopyOnFail: NO];
+}
+
 @end
 
 @implementation NSMutableArray (NSPredicate)
 
 - (void) filterUsingPredicate: (NSPredicate *)predicate
 {	
-  unsigned	count = [self count];
+  unsigned		count = [self count];
+  GSCompiledPredicate	*c;
 
+  c = AUTORELEASE([[GSCompiledPredicate alloc] initWithPredicate: predicate]);
   while (count-- > 0)
     {
       id	object = [self objectAtIndex: count];
 	
-      if ([predicate evaluateWithObject: object] == NO)
+      if (GSEvaluateNode(&c->_root, object) == NO)
         {
           [self removeObjectAtIndex: count];
         }
@@ -1642,14 +2389,16 @@ GSICUStringMatchesRegex(NSString *string, NSString *regex, NSStringCompareOption
 
 - (NSSet *) filteredSetUsingPredicate: (NSPredicate *)predicate
 {
-  NSMutableSet	*result;
-  NSEnumerator	*e = [self objectEnumerator];
-  id		object;
+  NSMutableSet		*result;
+  NSEnumerator		*e = [self objectEnumerator];
+  GSCompiledPredicate	*c;
+  id			object;
 
+  c = AUTORELEASE([[GSCompiledPredicate alloc] initWithPredicate: predicate]);
   result = [NSMutableSet setWithCapacity: [self count]];
   while ((object = [e nextObject]) != nil)
     {
-      if ([predicate evaluateWithObject: object] == YES)
+      if (GSEvaluateNode(&c->_root, object) == YES)
         {
           [result addObject: object];  // passes filter
         }
@@ -1657,20 +2406,62 @@ GSICUStringMatchesRegex(NSString *string, NSString *regex, NSStringCompareOption
   return [result makeImmutableCopyOnFail: NO];
 }
 
+- (NSSet *) filteredSetUsingPredicate: (NSPredicate *)predicate
+			    chunkSize: (NSUInteger)chunkSize
+				queue: (NSOperationQueue *)queue
+{
+  NSUInteger	count = [self count];
+  NSMutableSet	*result = [NSMutableSet setWithCapacity: count];
+  NSMutableData	*data = [NSMutableData dataWithLength: count];
+  uint8_t	*flags = (uint8_t*)[data mutableBytes];
+  NSEnumerator	*e = [self objectEnumerator];
+  NSException	*exception;
+  NSUInteger	i;
+  id		o;
+  GS_BEGINITEMBUF(objects, count, id)
+
+  i = 0;
+  while (i < count && (o = [e nextObject]) != nil)
+    {
+      objects[i++] = o;
+    }
+  count = i;
+  exception = GSConcurrentFilter(predicate, objects, count, chunkSize,
+    queue, flags);
+  if (exception == nil)
+    {
+      for (i = 0; i < count; i++)
+	{
+	  if (flags[i] != 0)
+	    {
+	      [result addObject: objects[i]];
+	    }
+	}
+    }
+  GS_ENDITEMBUF()
+  if (exception != nil)
+    {
+      [exception raise];
+    }
+  return [result makeImmutableCopyOnFail: NO];
+}
+
 @end
 
 @implementation NSMutableSet (NSPredicate)
 
 - (void) filterUsingPredicate: (NSPredicate *)predicate
 {
-  NSMutableSet	*rejected;
-  NSEnumerator	*e = [self objectEnumerator];
-  id		object;
+  NSMutableSet		*rejected;
+  NSEnumerator		*e = [self objectEnumerator];
+  GSCompiledPredicate	*c;
+  id			object;
 
+  c = AUTORELEASE([[GSCompiledPredicate alloc] initWithPredicate: predicate]);
   rejected = [NSMutableSet setWithCapacity: [self count]];
   while ((object = [e nextObject]) != nil)
     {
-      if ([predicate evaluateWithObject: object] == NO)
+      if (GSEvaluateNode(&c->_root, object) == NO)
         {
           [rejected addObject: object];
         }
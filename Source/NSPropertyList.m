@@ -37,6 +37,8 @@
 #import "Foundation/NSEnumerator.h"
 #import "Foundation/NSError.h"
 #import "Foundation/NSException.h"
+#import "Foundation/NSLock.h"
+#import "Foundation/NSMapTable.h"
 #import "Foundation/NSPropertyList.h"
 #import "Foundation/NSSerialization.h"
 #import "Foundation/NSStream.h"
@@ -431,7 +433,7 @@ foundIgnorableWhitespace: (NSString *)string
 
 
 
-@interface GSBinaryPLParser : NSObject
+@interface GSBinaryPLParser : NSObject <NSLocking>
 {
   NSPropertyListMutabilityOptions	mutability;
   const unsigned char	*_bytes;
@@ -441,15 +443,79 @@ foundIgnorableWhitespace: (NSString *)string
   unsigned		object_count;	// Number of objects
   unsigned		root_index;	// Index of root object
   unsigned		table_start;	// Start address of object table
+  BOOL			lazy;		// Decode containers on demand
+  NSRecursiveLock	*lock;		// Protects lazily decoded objects
 }
 
 - (id) initWithData: (NSData*)plData
 	 mutability: (NSPropertyListMutabilityOptions)m;
 - (id) rootObject;
 - (id) objectAtIndex: (NSUInteger)index;
+- (unsigned) indexSize;
+- (void) lock;
+- (id) objectForReferenceAt: (unsigned)counter cache: (id*)slot;
+- (void) setLazy: (BOOL)flag;
+- (void) unlock;
 
 @end
 
+/* The cache slots and key map of lazily decoded containers are set with
+ * the parser locked but may be read by other threads without the lock.
+ * So a pointer is stored with release ordering once the object it points
+ * to is complete, and loaded with acquire ordering so that the contents
+ * of that object are seen.  Without the compiler's atomic operations we
+ * load the pointer with the parser locked instead.
+ */
+#if	defined(__ATOMIC_ACQUIRE)
+#define	GSPLPublish(P, V)	__atomic_store_n((P), (V), __ATOMIC_RELEASE)
+#define	GSPLFetch(L, P)		__atomic_load_n((P), __ATOMIC_ACQUIRE)
+#else
+#define	GSPLPublish(P, V)	(*(P) = (V))
+#define	GSPLFetch(L, P)		GSPLFetchLocked((L), (void**)(P))
+
+static void *
+GSPLFetchLocked(GSBinaryPLParser *parser, void **ptr)
+{
+  void	*v;
+
+  [parser lock];
+  v = *ptr;
+  [parser unlock];
+  return v;
+}
+#endif
+
+/* Immutable array and dictionary used for lazily decoded binary property
+ * lists.  They hold the object references from the data, and decode each
+ * member (caching the result) the first time it is asked for.
+ */
+@interface GSBinaryPLArray : NSArray
+{
+  GSBinaryPLParser	*parser;
+  unsigned		count;
+  unsigned		refs;		// Location of object references
+  unsigned		size;		// Number of bytes per reference
+  id			*objects;	// Decoded objects (or nil)
+}
+- (id) initWithParser: (GSBinaryPLParser*)p
+		count: (unsigned)c
+		 refs: (unsigned)r;
+@end
+
+@interface GSBinaryPLDictionary : NSDictionary
+{
+  GSBinaryPLParser	*parser;
+  unsigned		count;
+  unsigned		refs;		// Location of key then value references
+  unsigned		size;		// Number of bytes per reference
+  id			*objects;	// Decoded keys then values (or nil)
+  NSMapTable		*map;		// Maps keys to their positions
+}
+- (id) initWithParser: (GSBinaryPLParser*)p
+		count: (unsigned)c
+		 refs: (unsigned)r;
+@end
+
 @interface GSBinaryPLGenerator : NSObject
 {
   NSMutableData *dest;
@@ -2527,7 +2593,13 @@ GSPropertyListMake(id obj, NSDictionary *loc, BOOL xml,
   id			result = nil;
   const unsigned char	*bytes = 0;
   unsigned int		length = 0;
+  BOOL			lazy = NO;
 
+  if (anOption & NSPropertyListReadLazily)
+    {
+      lazy = YES;
+      anOption &= ~NSPropertyListReadLazily;
+    }
   if (data == nil)
     {
       errorStr = @"nil data argument passed to method";
@@ -2644,6 +2716,10 @@ GSPropertyListMake(id obj, NSDictionary *loc, BOOL xml,
             GSBinaryPLParser	*p = [GSBinaryPLParser alloc];
             
             p = [p initWithData: data mutability: anOption];
+            if (YES == lazy && NSPropertyListImmutable == anOption)
+              {
+                [p setLazy: YES];
+              }
             result = [p rootObject];
             RELEASE(p);
           }
@@ -2669,6 +2745,28 @@ GSPropertyListMake(id obj, NSDictionary *loc, BOOL xml,
   return result;
 }
 
++ (id) propertyListWithContentsOfFile: (NSString*)path
+                              options: (NSPropertyListReadOptions)anOption
+                               format: (NSPropertyListFormat*)aFormat
+                                error: (out NSError**)error
+{
+  NSData	*data = [NSData dataWithContentsOfMappedFile: path];
+
+  if (nil == data)
+    {
+      if (error != NULL)
+	{
+	  *error = create_error(0, [NSString stringWithFormat:
+	    @"unable to read property list from '%@'", path]);
+	}
+      return nil;
+    }
+  return [self propertyListWithData: data
+			    options: anOption
+			     format: aFormat
+			      error: error];
+}
+
 + (id) propertyListWithStream: (NSInputStream*)stream
                       options: (NSPropertyListReadOptions)anOption
                        format: (NSPropertyListFormat*)aFormat
@@ -2775,6 +2873,7 @@ GSPropertyListMake(id obj, NSDictionary *loc, BOOL xml,
 - (void) dealloc
 {
   DESTROY(data);
+  DESTROY(lock);
   [super dealloc];
 }
 
@@ -2965,11 +3064,66 @@ GSPropertyListMake(id obj, NSDictionary *loc, BOOL xml,
   return 0;
 }
 
+- (unsigned) indexSize
+{
+  return index_size;
+}
+
+- (void) lock
+{
+  [lock lock];
+}
+
+- (void) unlock
+{
+  [lock unlock];
+}
+
+/* Returns the object whose reference is stored at counter, using the
+ * value in slot if it has already been decoded, and storing the (retained)
+ * object there if it has not.
+ */
+- (id) objectForReferenceAt: (unsigned)counter cache: (id*)slot
+{
+  id	o;
+
+  [lock lock];
+  NS_DURING
+    {
+      if (nil == (o = *slot))
+	{
+	  o = [self objectAtIndex: [self readObjectIndexAt: &counter]];
+	  GSPLPublish(slot, RETAIN(o));
+	}
+    }
+  NS_HANDLER
+    {
+      [lock unlock];
+      [localException raise];
+    }
+  NS_ENDHANDLER
+  [lock unlock];
+  return o;
+}
+
 - (id) rootObject
 {
   return [self objectAtIndex: root_index];
 }
 
+/* When decoding lazily, the data must stay around for as long as any
+ * of the containers we return, so the data is mapped (if possible) rather
+ * than read into memory, and the containers retain the parser.
+ */
+- (void) setLazy: (BOOL)flag
+{
+  lazy = flag;
+  if (YES == lazy && nil == lock)
+    {
+      lock = [NSRecursiveLock new];
+    }
+}
+
 - (id) objectAtIndex: (NSUInteger)index
 {
   unsigned char	next;
@@ -2980,6 +3134,38 @@ GSPropertyListMake(id obj, NSDictionary *loc, BOOL xml,
   //NSLog(@"read object %d at index %d type %d", index, counter, next);
   counter += 1;
 
+  if (YES == lazy && ((next & 0xF0) == 0xA0 || (next & 0xF0) == 0xD0))
+    {
+      unsigned long	len = next & 0x0F;
+      unsigned long	refs;
+
+      if (0x0F == len)
+	{
+	  len = [self readCountAt: &counter];
+	}
+      refs = len * index_size;
+      if ((next & 0xF0) == 0xD0)
+	{
+	  refs *= 2;
+	}
+      if (refs > table_start || counter > table_start - refs)
+	{
+	  [NSException raise: NSGenericException
+		      format: @"Object references out of bounds at %u", counter];
+	}
+      if ((next & 0xF0) == 0xA0)
+	{
+	  result = [GSBinaryPLArray alloc];
+	}
+      else
+	{
+	  result = [GSBinaryPLDictionary alloc];
+	}
+      return AUTORELEASE([result initWithParser: self
+					  count: len
+					   refs: counter]);
+    }
+
   if (next == 0x08)
     {
       // NO
@@ -3313,6 +3499,215 @@ GSPropertyListMake(id obj, NSDictionary *loc, BOOL xml,
 
 @end
 
+@implementation GSBinaryPLArray
+
+- (id) copyWithZone: (NSZone*)z
+{
+  return RETAIN(self);
+}
+
+- (NSUInteger) count
+{
+  return count;
+}
+
+- (void) dealloc
+{
+  if (objects != 0)
+    {
+      unsigned	i;
+
+      for (i = 0; i < count; i++)
+	{
+	  RELEASE(objects[i]);
+	}
+      NSZoneFree(NSDefaultMallocZone(), objects);
+    }
+  RELEASE(parser);
+  [super dealloc];
+}
+
+- (id) initWithParser: (GSBinaryPLParser*)p
+		count: (unsigned)c
+		 refs: (unsigned)r
+{
+  if (nil != (self = [super init]))
+    {
+      parser = RETAIN(p);
+      count = c;
+      refs = r;
+      size = [p indexSize];
+      if (count > 0)
+	{
+	  objects = NSAllocateCollectable(sizeof(id) * count, NSScannedOption);
+	}
+    }
+  return self;
+}
+
+- (id) objectAtIndex: (NSUInteger)index
+{
+  id	o;
+
+  if (index >= count)
+    {
+      [NSException raise: NSRangeException
+		  format: @"Index %d is out of range %d (in '%@')",
+	(int)index, (int)count, NSStringFromSelector(_cmd)];
+    }
+  if (nil == (o = GSPLFetch(parser, objects + index)))
+    {
+      o = [parser objectForReferenceAt: refs + index * size
+				 cache: objects + index];
+    }
+  return o;
+}
+
+@end
+
+@implementation GSBinaryPLDictionary
+
+- (id) copyWithZone: (NSZone*)z
+{
+  return RETAIN(self);
+}
+
+- (NSUInteger) count
+{
+  return count;
+}
+
+- (void) dealloc
+{
+  if (objects != 0)
+    {
+      unsigned	i;
+
+      for (i = 0; i < count * 2; i++)
+	{
+	  RELEASE(objects[i]);
+	}
+      NSZoneFree(NSDefaultMallocZone(), objects);
+    }
+  if (map != 0)
+    {
+      NSFreeMapTable(map);
+    }
+  RELEASE(parser);
+  [super dealloc];
+}
+
+- (id) initWithParser: (GSBinaryPLParser*)p
+		count: (unsigned)c
+		 refs: (unsigned)r
+{
+  if (nil != (self = [super init]))
+    {
+      parser = RETAIN(p);
+      count = c;
+      refs = r;
+      size = [p indexSize];
+      if (count > 0)
+	{
+	  objects = NSAllocateCollectable(sizeof(id) * count * 2,
+	    NSScannedOption);
+	}
+    }
+  return self;
+}
+
+- (id) _keyAtIndex: (unsigned)index
+{
+  id	o = GSPLFetch(parser, objects + index);
+
+  if (nil == o)
+    {
+      o = [parser objectForReferenceAt: refs + index * size
+				 cache: objects + index];
+    }
+  return o;
+}
+
+/* Decodes all the keys (but none of the values) and builds a table to
+ * look up the position of each key.
+ */
+- (void) _buildMap
+{
+  [parser lock];
+  NS_DURING
+    {
+      if (0 == map)
+	{
+	  NSMapTable	*m;
+	  unsigned	i;
+
+	  m = NSCreateMapTable(NSObjectMapKeyCallBacks,
+	    NSIntegerMapValueCallBacks, count);
+	  for (i = 0; i < count; i++)
+	    {
+	      NSMapInsert(m, [self _keyAtIndex: i], (void*)(uintptr_t)i);
+	    }
+	  GSPLPublish(&map, m);
+	}
+    }
+  NS_HANDLER
+    {
+      [parser unlock];
+      [localException raise];
+    }
+  NS_ENDHANDLER
+  [parser unlock];
+}
+
+- (NSEnumerator*) keyEnumerator
+{
+  NSArray	*keys;
+
+  /* Once the map has been built, all the keys have been decoded.
+   */
+  if (0 == GSPLFetch(parser, &map))
+    {
+      [self _buildMap];
+    }
+  keys = [NSArray arrayWithObjects: objects count: count];
+  return [keys objectEnumerator];
+}
+
+- (id) objectForKey: (id)aKey
+{
+  NSMapTable	*m;
+  void		*k;
+  void		*v;
+
+  if (nil == aKey)
+    {
+      return nil;
+    }
+  if (0 == (m = GSPLFetch(parser, &map)))
+    {
+      [self _buildMap];
+      m = map;
+    }
+  if (NO == NSMapMember(m, aKey, &k, &v))
+    {
+      return nil;
+    }
+  else
+    {
+      unsigned	index = count + (unsigned)(uintptr_t)v;
+      id	o = GSPLFetch(parser, objects + index);
+
+      if (nil == o)
+	{
+	  o = [parser objectForReferenceAt: refs + index * size
+				     cache: objects + index];
+	}
+      return o;
+    }
+}
+
+@end
+
 /* Test two items for equality ... boith are objects.
  * If either is an NSNumber, we insist that they are the same class
  * so that numbers with the same numeric value but different classes
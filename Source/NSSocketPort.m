@@ -76,6 +76,7 @@
 #include <sys/resource.h>
 #include <netdb.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #if	defined(HAVE_SYS_FILE_H)
 #  include	<sys/file.h>
@@ -125,6 +126,11 @@ static uint32_t	maxDataLength = 32 * 1024 * 1024;
 #define	GS_CONNECTION_MSG	0
 #define	NETBLOCK	8192
 
+/*
+ * Maximum number of buffers passed to a single writev() call.
+ */
+#define	WRITEVECS	16
+
 #ifndef INADDR_NONE
 #define	INADDR_NONE	-1
 #endif
@@ -196,12 +202,15 @@ typedef enum {
 {
   SOCKET		desc;		/* File descriptor for I/O.	*/
   unsigned		wItem;		/* Index of item being written.	*/
-  NSMutableData		*wData;		/* Data object being written.	*/
+  NSData		*wData;		/* Data object being written.	*/
   unsigned		wLength;	/* Ammount written so far.	*/
   NSMutableArray	*wMsgs;		/* Message in progress.		*/
   NSMutableData		*rData;		/* Buffer for incoming data	*/
   uint32_t		rLength;	/* Amount read so far.		*/
   uint32_t		rWant;		/* Amount desired.		*/
+  NSMutableData		*rBody;		/* Large data item being read.	*/
+  uint32_t		rBodyLength;	/* Amount of rBody read so far.	*/
+  uint32_t		rBodyWant;	/* Size of large initial item.	*/
   NSMutableArray	*rItems;	/* Message in progress.		*/
   GSPortItemType	rType;		/* Type of data being read.	*/
   uint32_t		rId;		/* Id of incoming message.	*/
@@ -241,6 +250,7 @@ typedef enum {
 - (void) receivedEventRead;
 - (void) receivedEventWrite;
 - (NSSocketPort*) recvPort;
+- (void) readBody: (uint32_t)size;
 - (BOOL) sendMessage: (NSArray*)components beforeDate: (NSDate*)when;
 - (NSSocketPort*) sendPort;
 - (void) setState: (GSHandleState)s;
@@ -669,6 +679,7 @@ static Class	runLoopClass;
   [self finalize];
   DESTROY(defaultAddress);
   DESTROY(rData);
+  DESTROY(rBody);
   DESTROY(rItems);
   DESTROY(wMsgs);
   DESTROY(myLock);
@@ -761,37 +772,49 @@ static Class	runLoopClass;
   void	*bytes;
   int	res;
 
-  /*
-   * Make sure we have a buffer big enough to hold all the data we are
-   * expecting, or NETBLOCK bytes, whichever is greater.
-   */
-  if (rData == nil)
+  if (rBody != nil)
     {
-      rData = [[mutableDataClass alloc] initWithLength: NETBLOCK];
-      rWant = sizeof(GSPortItemHeader);
-      rLength = 0;
-      want = NETBLOCK;
+      /*
+       * We are part way through a large data item, so read straight
+       * into the data object which will hold it rather than into rData.
+       */
+      bytes = [rBody mutableBytes];
+      res = recv(desc, bytes + rBodyLength, [rBody length] - rBodyLength, 0);
     }
   else
     {
-      want = [rData length];
-      if (want < rWant)
-        {
-          want = rWant;
-          [rData setLength: want];
-        }
-      if (want < NETBLOCK)
-        {
-          want = NETBLOCK;
-          [rData setLength: want];
-        }
-    }
+      /*
+       * Make sure we have a buffer big enough to hold all the data we are
+       * expecting, or NETBLOCK bytes, whichever is greater.
+       */
+      if (rData == nil)
+	{
+	  rData = [[mutableDataClass alloc] initWithLength: NETBLOCK];
+	  rWant = sizeof(GSPortItemHeader);
+	  rLength = 0;
+	  want = NETBLOCK;
+	}
+      else
+	{
+	  want = [rData length];
+	  if (want < rWant)
+	    {
+	      want = rWant;
+	      [rData setLength: want];
+	    }
+	  if (want < NETBLOCK)
+	    {
+	      want = NETBLOCK;
+	      [rData setLength: want];
+	    }
+	}
 
-  /*
-   * Now try to fill the buffer with data.
-   */
-  bytes = [rData mutableBytes];
-  res = recv(desc, bytes + rLength, want - rLength, 0);
+      /*
+       * Now try to fill the buffer with data.
+       */
+      bytes = [rData mutableBytes];
+      res = recv(desc, bytes + rLength, want - rLength, 0);
+    }
   if (res <= 0)
     {
       if (res == 0)
@@ -815,9 +838,18 @@ static Class	runLoopClass;
 	res = 0;	/* Interrupted - continue	*/
     }
   NSDebugMLLog(@"GSTcpHandle", @"read %d bytes on 0x%x", res, self);
-  rLength += res;
+  if (rBody != nil)
+    {
+      rBodyLength += res;
+    }
+  else
+    {
+      rLength += res;
+    }
+  bytes = [rData mutableBytes];
 
-  while (valid == YES && rLength >= rWant)
+  while (valid == YES && (rBody != nil
+    ? rBodyLength == [rBody length] : rLength >= rWant))
     {
       BOOL	shouldDispatch = NO;
 
@@ -828,6 +860,22 @@ static Class	runLoopClass;
 	      GSPortItemHeader	*h;
 	      unsigned		l;
 
+	      if (rBody != nil)
+		{
+		  /*
+		   * We have read the whole of a large data item,
+		   * so add it to the current message.
+		   */
+		  [rItems addObject: rBody];
+		  DESTROY(rBody);
+		  rBodyLength = 0;
+		  if (nItems == [rItems count])
+		    {
+		      shouldDispatch = YES;
+		    }
+		  break;
+		}
+
 	      /*
 	       * We have read an item header - set up to read the
 	       * remainder of the item.
@@ -884,17 +932,28 @@ static Class	runLoopClass;
 		          [self invalidate];
 		          return;
 		        }
-		      /*
-		       * If not a port or zero length data,
-		       * we discard the data read so far and fill the
-		       * data object with the data item from the msg.
-		       */
-		      rLength -= rWant;
-		      if (rLength > 0)
+		      if (l > NETBLOCK)
 			{
-			  memmove(bytes, bytes + rWant, rLength);
+			  /*
+			   * Large data is read into its own data object
+			   * rather than into our buffer.
+			   */
+			  [self readBody: l];
+			}
+		      else
+			{
+			  /*
+			   * If not a port or zero length data,
+			   * we discard the data read so far and fill the
+			   * data object with the data item from the msg.
+			   */
+			  rLength -= rWant;
+			  if (rLength > 0)
+			    {
+			      memmove(bytes, bytes + rWant, rLength);
+			    }
+			  rWant = l;
 			}
-		      rWant = l;
 		    }
 		}
 	      else if (rType == GSP_HEAD)
@@ -906,6 +965,16 @@ static Class	runLoopClass;
 		      [self invalidate];
 		      return;
 		    }
+		  if (l > NETBLOCK + sizeof(GSPortMsgHeader))
+		    {
+		      /*
+		       * Read just the message header into our buffer,
+		       * and the data following it into a data object
+		       * of its own.
+		       */
+		      rBodyWant = l - sizeof(GSPortMsgHeader);
+		      l = sizeof(GSPortMsgHeader);
+		    }
 		  /*
 		   * If not a port or zero length data,
 		   * we discard the data read so far and fill the
@@ -968,6 +1037,17 @@ static Class	runLoopClass;
 		      shouldDispatch = YES;
 		    }
 		}
+	      else if (rBodyWant > 0)
+		{
+		  uint32_t	size = rBodyWant;
+
+		  /*
+		   * The first data item of the message is too big for
+		   * our buffer, so read it into a data object of its own.
+		   */
+		  rBodyWant = 0;
+		  [self readBody: size];
+		}
 	      else
 	        {
 	          /*
@@ -1088,6 +1168,35 @@ static Class	runLoopClass;
     }
 }
 
+/*
+ * Sets up to read a data item of the specified size into a data object
+ * of its own, so that rData does not need to grow to hold it and the
+ * data does not need to be copied again once it has been read.
+ * The first rWant bytes in rData (the item header) have been dealt with,
+ * and any bytes after those are the start of the item, so they are
+ * moved into the new data object.
+ */
+- (void) readBody: (uint32_t)size
+{
+  uint8_t	*bytes = [rData mutableBytes];
+  uint8_t	*b = NSZoneMalloc(NSDefaultMallocZone(), size);
+  uint32_t	have;
+
+  rBody = [mutableDataClass allocWithZone: NSDefaultMallocZone()];
+  rBody = [rBody initWithBytesNoCopy: b length: size];
+  rLength -= rWant;
+  have = (rLength < size) ? rLength : size;
+  memcpy(b, bytes + rWant, have);
+  rBodyLength = have;
+  rLength -= have;
+  if (rLength > 0)
+    {
+      memmove(bytes, bytes + rWant + have, rLength);
+    }
+  rWant = sizeof(GSPortItemHeader);
+  rType = GSP_NONE;
+}
+
 - (void) receivedEventWrite
 {
   if (state == GS_H_TRYCON)	/* Connection attempt.	*/
@@ -1128,16 +1237,17 @@ static Class	runLoopClass;
     }
   else
     {
+      NSArray		*components;
+      unsigned		count;
       int		res;
-      unsigned	l;
+      unsigned		l;
       const void	*b;
-      
+
       if (wData == nil)
         {
           if ([wMsgs count] > 0)
             {
-	      NSArray	*components = [wMsgs objectAtIndex: 0];
-
+	      components = [wMsgs objectAtIndex: 0];
 	      wData = [components objectAtIndex: wItem++];
 	      wLength = 0;
 	    }
@@ -1147,9 +1257,36 @@ static Class	runLoopClass;
 	      return;
 	    }
 	}
+      components = [wMsgs objectAtIndex: 0];
+      count = [components count];
       b = [wData bytes];
       l = [wData length];
+#ifdef __MINGW__
       res = send(desc, b + wLength,  l - wLength, 0);
+#else
+      {
+	struct iovec	iov[WRITEVECS];
+	int		vecs = 1;
+	unsigned	i = wItem;
+
+	/*
+	 * Gather the rest of the current item and as many of the items
+	 * following it as we can, and write them in a single operation
+	 * straight from the data objects which hold them.
+	 */
+	iov[0].iov_base = (void*)(b + wLength);
+	iov[0].iov_len = l - wLength;
+	while (vecs < WRITEVECS && i < count)
+	  {
+	    NSData	*d = [components objectAtIndex: i++];
+
+	    iov[vecs].iov_base = (void*)[d bytes];
+	    iov[vecs].iov_len = [d length];
+	    vecs++;
+	  }
+	res = writev(desc, iov, vecs);
+      }
+#endif
       if (res < 0)
         {
 #ifdef __MINGW__
@@ -1174,23 +1311,20 @@ static Class	runLoopClass;
         {
           NSDebugMLLog(@"GSTcpHandle",
             @"wrote %d bytes on 0x%x", res, self);
-	  wLength += res;
-          if (wLength == l)
-            {
-	      NSArray	*components;
-
-	      /*
-	       * We have completed a data item so see what is
-	       * left of the message components.
-	       */
-	      components = [wMsgs objectAtIndex: 0];
+	  /*
+	   * Step through the items covered by the amount written.
+	   */
+	  while (wData != nil && wLength + res >= l)
+	    {
+	      res -= (l - wLength);
 	      wLength = 0;
-	      if ([components count] > wItem)
+	      if (count > wItem)
 	        {
 	          /*
 	           * More to write - get next item.
 	           */
 	          wData = [components objectAtIndex: wItem++];
+		  l = [wData length];
 	        }
 	      else
 	        {
@@ -1204,6 +1338,7 @@ static Class	runLoopClass;
 	          [wMsgs removeObjectAtIndex: 0];
 	        }
 	    }
+	  wLength += res;
 	}
     }
 }
@@ -2401,6 +2536,7 @@ static Class		tcpPortClass;
 		  NSMutableData	*d;
 
 		  pack = NO;
+#ifdef __MINGW__
 		  d = [[NSMutableData alloc] initWithLength: l + h];
 		  b = [d mutableBytes];
 		  pih = (GSPortItemHeader*)b;
@@ -2410,6 +2546,20 @@ static Class		tcpPortClass;
 		  [components replaceObjectAtIndex: i
 					withObject: d];
 		  RELEASE(d);
+#else
+		  /*
+		   * The item header goes in a data object of its own,
+		   * followed by the original data, so that both are
+		   * written together by writev() without copying.
+		   */
+		  d = [[NSMutableData alloc] initWithLength: h];
+		  pih = (GSPortItemHeader*)[d mutableBytes];
+		  pih->type = GSSwapHostI32ToBig(GSP_DATA);
+		  pih->length = GSSwapHostI32ToBig(l);
+		  [components insertObject: d atIndex: i++];
+		  c++;
+		  RELEASE(d);
+#endif
 		}
 	    }
 	  else if ([o isKindOfClass: tcpPortClass])
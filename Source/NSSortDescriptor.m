@@ -199,50 +199,167 @@
 
 @end
 
-/// Swaps the two provided objects.
-static inline void
-SwapObjects(id * o1, id * o2)
+/* An object being sorted, with the values of the keys of the sort
+ * descriptors for it (got once, before sorting).
+ */
+typedef struct {
+  id	object;
+  id	*values;
+} GSSortRecord;
+
+/* A sort descriptor being used to sort, with the comparison method
+ * found for the last class of value it compared.  A descriptor of a
+ * subclass which compares objects itself is asked to do so.
+ */
+typedef struct {
+  NSSortDescriptor	*descriptor;
+  SEL			selector;
+  BOOL			ascending;
+  BOOL			custom;
+  Class			cls;
+  IMP			imp;
+} GSSortKey;
+
+typedef struct {
+  GSSortKey	*keys;
+  unsigned	count;
+} GSSortKeys;
+
+static NSComparisonResult
+CompareRecords(id r1, id r2, void *context)
 {
-  id temp;
+  GSSortRecord	*a = (GSSortRecord*)r1;
+  GSSortRecord	*b = (GSSortRecord*)r2;
+  GSSortKeys	*k = (GSSortKeys*)context;
+  unsigned	i;
+
+  for (i = 0; i < k->count; i++)
+    {
+      GSSortKey			*key = &k->keys[i];
+      NSComparisonResult	r;
+
+      if (key->custom == YES)
+	{
+	  r = [key->descriptor compareObject: a->object toObject: b->object];
+	}
+      else
+	{
+	  id	v = a->values[i];
 
-  temp = *o1;
-  *o1 = *o2;
-  *o2 = temp;
+	  if (v == nil)
+	    {
+	      r = NSOrderedSame;
+	    }
+	  else
+	    {
+	      Class	c = object_getClass(v);
+
+	      if (c != key->cls)
+		{
+		  key->cls = c;
+		  key->imp = class_getMethodImplementation(c, key->selector);
+		}
+	      r = (*(NSComparisonResult (*)(id, SEL, id))key->imp)(v,
+		key->selector, b->values[i]);
+	      if (key->ascending == NO)
+		{
+		  if (r == NSOrderedAscending)
+		    {
+		      r = NSOrderedDescending;
+		    }
+		  else if (r == NSOrderedDescending)
+		    {
+		      r = NSOrderedAscending;
+		    }
+		}
+	    }
+	}
+      if (r != NSOrderedSame)
+	{
+	  return r;
+	}
+    }
+  return NSOrderedSame;
 }
 
-/**
- * Sorts the provided object array's sortRange according to sortDescriptor.
+/* Sort the count objects in buffer using the descriptors.  The value of
+ * each descriptor's key is got for each object once before sorting, the
+ * records holding the objects and values are sorted with a stable sort,
+ * and then the objects are put back in the buffer in their new order.
+ * The buffer is only changed once sorting has succeeded.
  */
-// Quicksort algorithm copied from Wikipedia :-).
 static void
-SortObjectsWithDescriptor(id *objects,
-                          NSRange sortRange,
-                          NSSortDescriptor *sortDescriptor)
+SortObjects(id *objects, NSUInteger count, id *descriptors, unsigned dCount)
 {
-  if (sortRange.length > 1)
+  static Class		sortDescriptorClass = Nil;
+  static IMP		compareImp = 0;
+  GSSortKey		keys[dCount];
+  GSSortKeys		k;
+  NSMutableData		*data;
+  GSSortRecord		*records;
+  id			*values;
+  id			*order;
+  NSUInteger		i;
+  unsigned		j;
+
+  if (sortDescriptorClass == Nil)
     {
-      id pivot = objects[sortRange.location];
-      unsigned int left = sortRange.location + 1;
-      unsigned int right = NSMaxRange(sortRange);
+      compareImp = [NSSortDescriptor instanceMethodForSelector:
+	@selector(compareObject:toObject:)];
+      sortDescriptorClass = [NSSortDescriptor class];
+    }
+  for (j = 0; j < dCount; j++)
+    {
+      NSSortDescriptor	*d = (NSSortDescriptor*)descriptors[j];
+      Class		c = object_getClass(d);
+
+      keys[j].descriptor = d;
+      keys[j].cls = Nil;
+      keys[j].imp = 0;
+      if (GSObjCIsKindOf(c, sortDescriptorClass) == YES
+	&& class_getMethodImplementation(c,
+	@selector(compareObject:toObject:)) == compareImp)
+	{
+	  keys[j].custom = NO;
+	  keys[j].selector = d->_selector;
+	  keys[j].ascending = d->_ascending;
+	}
+      else
+	{
+	  keys[j].custom = YES;
+	}
+    }
+  k.keys = keys;
+  k.count = dCount;
 
-      while (left < right)
-        {
-          if ([sortDescriptor compareObject: objects[left] toObject: pivot] ==
-            NSOrderedDescending)
-            {
-              SwapObjects(&objects[left], &objects[--right]);
-            }
-          else
-            {
-              left++;
-            }
-        }
+  /* The records, the values for their keys, and the array of pointers
+   * to records which is sorted, are all in one block of memory.
+   */
+  data = [NSMutableData dataWithLength:
+    count * (sizeof(GSSortRecord) + sizeof(id) * (dCount + 1))];
+  records = (GSSortRecord*)[data mutableBytes];
+  values = (id*)&records[count];
+  order = values + count * dCount;
+  for (i = 0; i < count; i++)
+    {
+      records[i].object = objects[i];
+      records[i].values = values + i * dCount;
+      for (j = 0; j < dCount; j++)
+	{
+	  if (keys[j].custom == NO)
+	    {
+	      records[i].values[j]
+		= [objects[i] valueForKeyPath: keys[j].descriptor->_key];
+	    }
+	}
+      order[i] = (id)&records[i];
+    }
 
-      SwapObjects(&objects[--left], &objects[sortRange.location]);
-      SortObjectsWithDescriptor(objects, NSMakeRange(sortRange.location, left
-        - sortRange.location), sortDescriptor);
-      SortObjectsWithDescriptor(objects, NSMakeRange(right,
-        NSMaxRange(sortRange) - right), sortDescriptor);
+  GSPrivateSortStable(order, count, CompareRecords, &k);
+
+  for (i = 0; i < count; i++)
+    {
+      objects[i] = ((GSSortRecord*)order[i])->object;
     }
 }
 
@@ -259,47 +376,6 @@ SortObjectsWithDescriptor(id *objects,
 
 @end
 
-/* Sort the objects in range using the first descriptor and, if there
- * are more descriptors, recursively call the function to sort each range
- * of adhacent equal objects using the remaining descriptors.
- */
-static void
-SortRange(id *objects, NSRange range, id *descriptors,
-  unsigned numDescriptors)
-{
-  NSSortDescriptor	*sd = (NSSortDescriptor*)descriptors[0];
-
-  SortObjectsWithDescriptor(objects, range, sd);
-  if (numDescriptors > 1)
-    {
-      unsigned	start = range.location;
-      unsigned	finish = NSMaxRange(range);
-
-      while (start < finish)
-	{
-	  unsigned	pos = start + 1;
-
-	  /* Find next range of adjacent objects.
-	   */
-	  while (pos < finish
-	    && [sd compareObject: objects[start]
-	      toObject: objects[pos]] == NSOrderedSame)
-	    {
-	      pos++;
-	    }
-
-	  /* Sort the range using remaining descriptors.
-	   */
-	  if (pos - start > 1)
-	    {
-	      SortRange(objects, NSMakeRange(start, pos - start),
-		descriptors + 1, numDescriptors - 1);
-	    }
-	  start = pos;
-	}
-    }
-}
-
 @implementation NSMutableArray (NSSortDescriptorSorting)
 
 - (void) sortUsingDescriptors: (NSArray *)sortDescriptors
@@ -327,7 +403,7 @@ SortRange(id *objects, NSRange range, id *descriptors,
 	{
 	  [sortDescriptors getObjects: descriptors];
 	}
-      SortRange(objects, NSMakeRange(0, count), descriptors, numDescriptors);
+      SortObjects(objects, count, descriptors, numDescriptors);
       a = [[NSArray alloc] initWithObjects: objects count: count];
       [self setArray: a];
       RELEASE(a);
@@ -360,7 +436,9 @@ SortRange(id *objects, NSRange range, id *descriptors,
 	{
 	  [sortDescriptors getObjects: descriptors];
 	}
-      SortRange(_contents_array, NSMakeRange(0, _count), descriptors, dCount);
+      _version++;
+      SortObjects(_contents_array, _count, descriptors, dCount);
+      _version++;
 
       GS_ENDIDBUF();
     }
@@ -662,7 +662,8 @@ unregisterActiveThread(NSThread *thread)
   DESTROY(_target);
   DESTROY(_arg);
   DESTROY(_name);
-  if (_autorelease_vars.pool_cache != 0)
+  if (_autorelease_vars.pool_cache != 0
+    || _autorelease_vars.stack_page != 0)
     {
       [NSAutoreleasePool _endThread: self];
     }
@@ -673,14 +674,16 @@ unregisterActiveThread(NSThread *thread)
        * Try again to get rid of thread dictionary.
        */
       DESTROY(_thread_dictionary);
-      if (_autorelease_vars.pool_cache != 0)
+      if (_autorelease_vars.pool_cache != 0
+	|| _autorelease_vars.stack_page != 0)
 	{
 	  [NSAutoreleasePool _endThread: self];
 	}
       if (_thread_dictionary != nil)
 	{
 	  NSLog(@"Oops - leak - thread dictionary is %@", _thread_dictionary);
-	  if (_autorelease_vars.pool_cache != 0)
+	  if (_autorelease_vars.pool_cache != 0
+	    || _autorelease_vars.stack_page != 0)
 	    {
 	      [NSAutoreleasePool _endThread: self];
 	    }
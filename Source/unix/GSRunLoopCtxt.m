@@ -26,9 +26,29 @@
 #ifdef HAVE_POLL_F
 #include <poll.h>
 #endif
+#ifdef HAVE_EPOLL
+#include <sys/epoll.h>
+#include <fcntl.h>
+#endif
 
 #define	FDCOUNT	128
 
+#ifdef	HAVE_EPOLL
+/*
+ * Per-descriptor record of what we want from epoll in the current poll
+ * and what the kernel interest set currently holds for the descriptor.
+ */
+struct GSEpollInfo {
+  unsigned int	generation;	// Poll in which the descriptor was wanted.
+  uint32_t	wanted;		// Events wanted in that poll.
+  uint32_t	registered;	// Events registered with the kernel.
+  void		*watcher[3];	// Watchers (identity only) by event type.
+  BOOL		listed;		// Present in the epollActive array.
+  BOOL		dirty;		// Kernel registration must be refreshed.
+  BOOL		unpollable;	// Refused by epoll (eg. a regular file).
+};
+#endif
+
 #if	GS_WITH_GC == 0
 static SEL	wRelSel;
 static SEL	wRetSel;
@@ -97,6 +117,24 @@ static const NSMapTableValueCallBacks WatcherMapValueCallBacks =
     {
       NSZoneFree(NSDefaultMallocZone(), pollfds);
     }
+#endif
+#ifdef	HAVE_EPOLL
+  if (epollfd >= 0)
+    {
+      close(epollfd);
+    }
+  if (epollInfo != 0)
+    {
+      NSZoneFree(NSDefaultMallocZone(), epollInfo);
+    }
+  if (epollActive != 0)
+    {
+      NSZoneFree(NSDefaultMallocZone(), epollActive);
+    }
+  if (epollEvents != 0)
+    {
+      NSZoneFree(NSDefaultMallocZone(), epollEvents);
+    }
 #endif
   [super dealloc];
 }
@@ -200,6 +238,20 @@ static const NSMapTableValueCallBacks WatcherMapValueCallBacks =
 				      WatcherMapValueCallBacks, 0);
       _wfdMap = NSCreateMapTable (NSIntegerMapKeyCallBacks,
 				      WatcherMapValueCallBacks, 0);
+#ifdef	HAVE_EPOLL
+      /* If we can't get an epoll descriptor we fall back to using poll().
+       */
+      epollfd = epoll_create(FDCOUNT);
+      if (epollfd >= 0)
+	{
+	  fcntl(epollfd, F_SETFD, FD_CLOEXEC);
+	}
+      else
+	{
+	  NSDebugMLLog(@"NSRunLoop", @"epoll_create() failed: %@",
+	    [NSError _last]);
+	}
+#endif
     }
   return self;
 }
@@ -274,14 +326,14 @@ static void setPollfd(int fd, int event, GSRunLoopCtxt *ctxt)
  * and this method must tell those outer contexts not to handle events
  * which are handled by this context.
  */
+#ifdef	HAVE_EPOLL
+- (BOOL) _pollUntil: (int)milliseconds within: (NSArray*)contexts
+#else
 - (BOOL) pollUntil: (int)milliseconds within: (NSArray*)contexts
+#endif
 {
   GSRunLoopThreadInfo   *threadInfo = GSRunLoopInfoForThread(nil);
   int		poll_return;
-  int		fdEnd;	/* Number of descriptors being monitored. */
-  int		fdIndex;
-  int		fdFinish;
-  unsigned	count;
   unsigned int	i;
   BOOL		immediate = NO;
 
@@ -453,6 +505,22 @@ static void setPollfd(int fd, int event, GSRunLoopCtxt *ctxt)
 	}
     }
 
+  return [self _handlePolled: poll_return within: contexts];
+}
+
+/**
+ * Handle the watchers to be triggered unconditionally, and the
+ * poll_return descriptors with events recorded in the pollfds array.
+ */
+- (BOOL) _handlePolled: (int)poll_return within: (NSArray*)contexts
+{
+  GSRunLoopThreadInfo   *threadInfo = GSRunLoopInfoForThread(nil);
+  int		fdEnd;	/* Number of descriptors being monitored. */
+  int		fdIndex;
+  int		fdFinish;
+  unsigned	count;
+  unsigned int	i;
+
   /*
    * Trigger any watchers which are set up to for every runloop wait.
    */
@@ -656,6 +724,373 @@ static void setPollfd(int fd, int event, GSRunLoopCtxt *ctxt)
   return YES;
 }
 
+#ifdef	HAVE_EPOLL
+
+static void *
+growBuffer(void *buf, size_t size)
+{
+#if	GS_WITH_GC
+  if (buf == 0)
+    {
+      return NSAllocateCollectable(size, 0);
+    }
+  return NSReallocateCollectable(buf, size, 0);
+#else
+  if (buf == 0)
+    {
+      return NSZoneMalloc(NSDefaultMallocZone(), size);
+    }
+  return NSZoneRealloc(NSDefaultMallocZone(), buf, size);
+#endif
+}
+
+/*
+ * Record that we want the specified event on a descriptor in the current
+ * poll.  Descriptors seen for the first time are added to the list of
+ * active descriptors, to be registered with the kernel by syncEpoll().
+ */
+static void
+setEpollfd(int fd, uint32_t event, id watcher, int slot, GSRunLoopCtxt *ctxt)
+{
+  struct GSEpollInfo	*info;
+
+  if (fd < 0)
+    {
+      return;
+    }
+  if ((unsigned)fd >= ctxt->epollLimit)
+    {
+      unsigned	old = ctxt->epollLimit;
+
+      ctxt->epollLimit = (fd + 64) & ~63;
+      ctxt->epollInfo = growBuffer(ctxt->epollInfo,
+	ctxt->epollLimit * sizeof(struct GSEpollInfo));
+      memset(ctxt->epollInfo + old, '\0',
+	(ctxt->epollLimit - old) * sizeof(struct GSEpollInfo));
+    }
+  info = &ctxt->epollInfo[fd];
+  if (info->generation != ctxt->epollGeneration)
+    {
+      info->generation = ctxt->epollGeneration;
+      info->wanted = 0;
+      if (info->listed == NO)
+	{
+	  if (ctxt->epollCount >= ctxt->epollCapacity)
+	    {
+	      ctxt->epollCapacity += 64;
+	      ctxt->epollActive = growBuffer(ctxt->epollActive,
+		ctxt->epollCapacity * sizeof(int));
+	      ctxt->epollEvents = growBuffer(ctxt->epollEvents,
+		ctxt->epollCapacity * sizeof(struct epoll_event));
+	    }
+	  ctxt->epollActive[ctxt->epollCount++] = fd;
+	  info->listed = YES;
+	  info->dirty = YES;
+	}
+    }
+  if (info->watcher[slot] != (void*)watcher)
+    {
+      /* A new watcher may mean that the descriptor was closed and
+       * reused, in which case the kernel has already dropped it.
+       */
+      info->watcher[slot] = (void*)watcher;
+      info->dirty = YES;
+    }
+  info->wanted |= event;
+}
+
+/*
+ * Bring the kernel interest set into line with the descriptors wanted
+ * in the current poll.  In the steady state (the same descriptors wanted
+ * for the same events as last time) this makes no system calls at all.
+ * Returns the number of wanted descriptors which epoll can't watch; like
+ * poll(), we treat those as always being ready.
+ */
+static unsigned
+syncEpoll(GSRunLoopCtxt *ctxt)
+{
+  unsigned	unpollable = 0;
+  unsigned	i = ctxt->epollCount;
+
+  while (i-- > 0)
+    {
+      int			fd = ctxt->epollActive[i];
+      struct GSEpollInfo	*info = &ctxt->epollInfo[fd];
+      struct epoll_event	ev;
+
+      memset(&ev, '\0', sizeof(ev));
+      if (info->generation != ctxt->epollGeneration)
+	{
+	  /* No longer wanted.  The descriptor may have been closed, in
+	   * which case the kernel has removed it already and we can
+	   * ignore any error.
+	   */
+	  if (info->registered != 0)
+	    {
+	      epoll_ctl(ctxt->epollfd, EPOLL_CTL_DEL, fd, &ev);
+	    }
+	  memset(info, '\0', sizeof(*info));
+	  ctxt->epollActive[i] = ctxt->epollActive[--ctxt->epollCount];
+	}
+      else if (info->unpollable == YES && info->dirty == NO)
+	{
+	  unpollable++;
+	}
+      else if (info->dirty == YES || info->wanted != info->registered)
+	{
+	  int	result;
+
+	  ev.events = info->wanted;
+	  ev.data.fd = fd;
+	  if (info->registered == 0)
+	    {
+	      result = epoll_ctl(ctxt->epollfd, EPOLL_CTL_ADD, fd, &ev);
+	      if (result < 0 && errno == EEXIST)
+		{
+		  result = epoll_ctl(ctxt->epollfd, EPOLL_CTL_MOD, fd, &ev);
+		}
+	    }
+	  else
+	    {
+	      result = epoll_ctl(ctxt->epollfd, EPOLL_CTL_MOD, fd, &ev);
+	      if (result < 0 && errno == ENOENT)
+		{
+		  result = epoll_ctl(ctxt->epollfd, EPOLL_CTL_ADD, fd, &ev);
+		}
+	    }
+	  if (result < 0)
+	    {
+	      NSDebugFLLog(@"NSRunLoop", @"epoll_ctl() failed for %d: %@",
+		fd, [NSError _last]);
+	      info->registered = 0;
+	      info->unpollable = YES;
+	      unpollable++;
+	    }
+	  else
+	    {
+	      info->registered = info->wanted;
+	      info->unpollable = NO;
+	    }
+	  info->dirty = NO;
+	}
+    }
+  return unpollable;
+}
+
+static inline short
+pollEvents(uint32_t events)
+{
+  short	result = 0;
+
+  if (events & EPOLLIN) result |= POLLIN;
+  if (events & EPOLLPRI) result |= POLLPRI;
+  if (events & EPOLLOUT) result |= POLLOUT;
+  if (events & EPOLLERR) result |= POLLERR;
+  if (events & EPOLLHUP) result |= POLLHUP;
+  return result;
+}
+
+/**
+ * Perform a poll for the specified runloop context using epoll.<br />
+ * Rather than passing every descriptor to the kernel on each call (as
+ * poll() requires), we keep a persistent kernel interest set which is
+ * only updated when the descriptors (or the events wanted on them)
+ * change, so the cost of waiting depends on the number of descriptors
+ * with events rather than on the number being watched.<br />
+ * The ready descriptors are copied into the pollfds array and handled
+ * exactly as for poll().
+ */
+- (BOOL) pollUntil: (int)milliseconds within: (NSArray*)contexts
+{
+  GSRunLoopThreadInfo   *threadInfo = GSRunLoopInfoForThread(nil);
+  int		poll_return;
+  unsigned	unpollable;
+  unsigned int	i;
+  BOOL		immediate = NO;
+
+  if (epollfd < 0)
+    {
+      return [self _pollUntil: milliseconds within: contexts];
+    }
+
+  i = GSIArrayCount(watchers);
+
+  /*
+   * Get ready to listen to file descriptors.
+   * The maps will not have been emptied by any previous call.
+   */
+  NSResetMapTable(_efdMap);
+  NSResetMapTable(_rfdMap);
+  NSResetMapTable(_wfdMap);
+  GSIArrayRemoveAllItems(_trigger);
+
+  if (++epollGeneration == 0)
+    {
+      unsigned	fd;
+
+      /* Counter wrapped ... make sure no descriptor looks current.
+       */
+      for (fd = 0; fd < epollLimit; fd++)
+	{
+	  epollInfo[fd].generation = 0;
+	}
+      epollGeneration = 1;
+    }
+
+  /* Watch for signals from other threads.
+   */
+  setEpollfd(threadInfo->inputFd, EPOLLIN, nil, 1, self);
+
+  while (i-- > 0)
+    {
+      GSRunLoopWatcher	*info;
+      BOOL		trigger;
+
+      info = GSIArrayItemAtIndex(watchers, i).obj;
+      if (info->_invalidated == YES)
+	{
+	  GSIArrayRemoveItemAtIndex(watchers, i);
+	}
+      else if ([info runLoopShouldBlock: &trigger] == NO)
+	{
+	  if (trigger == YES)
+	    {
+	      immediate = YES;
+	      GSIArrayAddItem(_trigger, (GSIArrayItem)(id)info);
+	    }
+	}
+      else
+	{
+	  int	fd;
+
+	  switch (info->type)
+	    {
+	      case ET_EDESC: 
+		fd = (int)(intptr_t)info->data;
+		setEpollfd(fd, EPOLLPRI, info, 0, self);
+		NSMapInsert(_efdMap, (void*)(intptr_t)fd, info);
+		break;
+
+	      case ET_RDESC: 
+		fd = (int)(intptr_t)info->data;
+		setEpollfd(fd, EPOLLIN, info, 1, self);
+		NSMapInsert(_rfdMap, (void*)(intptr_t)fd, info);
+		break;
+
+	      case ET_WDESC: 
+		fd = (int)(intptr_t)info->data;
+		setEpollfd(fd, EPOLLOUT, info, 2, self);
+		NSMapInsert(_wfdMap, (void*)(intptr_t)fd, info);
+		break;
+
+	      case ET_TRIGGER:
+		break;
+
+	      case ET_RPORT: 
+		{
+		  id port = info->receiver;
+		  NSInteger port_fd_count = FDCOUNT;
+		  NSInteger port_fd_array[FDCOUNT];
+
+		  [port getFds: port_fd_array count: &port_fd_count];
+		  NSDebugMLLog(@"NSRunLoop",
+		    @"listening to %d port handles\n", port_fd_count);
+		  while (port_fd_count--)
+		    {
+		      fd = port_fd_array[port_fd_count];
+		      setEpollfd(fd, EPOLLIN, info, 1, self);
+		      NSMapInsert(_rfdMap, 
+			(void*)(intptr_t)port_fd_array[port_fd_count], info);
+		    }
+		}
+		break;
+	    }
+	}
+    }
+
+  unpollable = syncEpoll(self);
+
+  /*
+   * If there are notifications in the 'idle' queue, we try an
+   * instantaneous select so that, if there is no input pending,
+   * we can service the queue.  Similarly, if a task has completed,
+   * we need to deliver its notifications.
+   */
+  if (GSPrivateCheckTasks() || GSPrivateNotifyMore(mode) || immediate == YES
+    || unpollable > 0)
+    {
+      milliseconds = 0;
+    }
+
+  poll_return = epoll_wait(epollfd, epollEvents, epollCapacity, milliseconds);
+
+  NSDebugMLLog(@"NSRunLoop", @"epoll_wait returned %d\n", poll_return);
+
+  if (poll_return < 0)
+    {
+      if (errno == EINTR)
+	{
+	  GSPrivateCheckTasks();
+	  poll_return = 0;
+	}
+      else if (errno == 0)
+	{
+	  poll_return = 0;
+	}
+      else
+	{
+	  /* Some exceptional condition happened. */
+	  NSLog (@"epoll_wait() error in -acceptInputForMode:beforeDate: '%@'",
+	    [NSError _last]);
+	  abort ();
+	}
+    }
+
+  /*
+   * Copy the ready descriptors (and any which epoll can't watch) into
+   * the pollfds array so that they are handled as for poll().
+   */
+  if (pollfds_capacity < poll_return + unpollable + 1)
+    {
+      pollfds_capacity = poll_return + unpollable + 1;
+      pollfds = growBuffer(pollfds, pollfds_capacity * sizeof(*pollfds));
+    }
+  pollfds_count = 0;
+  for (i = 0; i < (unsigned)poll_return; i++)
+    {
+      int	fd = epollEvents[i].data.fd;
+
+      pollfds[pollfds_count].fd = fd;
+      pollfds[pollfds_count].events = 0;
+      pollfds[pollfds_count].revents = pollEvents(epollEvents[i].events);
+      pollfds_count++;
+      /* The handler may close the descriptor, and the number may then
+       * be reused before the next poll; so make sure that we check the
+       * kernel registration again next time.
+       */
+      epollInfo[fd].dirty = YES;
+    }
+  if (unpollable > 0)
+    {
+      for (i = 0; i < epollCount; i++)
+	{
+	  int			fd = epollActive[i];
+	  struct GSEpollInfo	*info = &epollInfo[fd];
+
+	  if (info->unpollable == YES && info->generation == epollGeneration)
+	    {
+	      pollfds[pollfds_count].fd = fd;
+	      pollfds[pollfds_count].events = 0;
+	      pollfds[pollfds_count].revents = pollEvents(info->wanted);
+	      pollfds_count++;
+	    }
+	}
+    }
+  return [self _handlePolled: pollfds_count within: contexts];
+}
+
+#endif	/* HAVE_EPOLL */
+
 + (BOOL) awakenedBefore: (NSDate*)when
 {
   GSRunLoopThreadInfo   *threadInfo = GSRunLoopInfoForThread(nil);
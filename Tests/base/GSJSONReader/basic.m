@@ -0,0 +1,119 @@
+#if     defined(GNUSTEP_BASE_LIBRARY)
+#import <Foundation/Foundation.h>
+#import <GNUstepBase/GSJSONReader.h>
+#import "Testing.h"
+
+/* Records the events from the reader as a string.
+ */
+@interface	Recorder : NSObject
+{
+@public
+  NSMutableString	*log;
+}
+@end
+
+@implementation	Recorder
+- (id) init
+{
+  log = [NSMutableString new];
+  return self;
+}
+- (void) dealloc
+{
+  [log release];
+  [super dealloc];
+}
+- (void) readerDidStartArray: (GSJSONReader*)reader
+{
+  [log appendString: @"["];
+}
+- (void) readerDidEndArray: (GSJSONReader*)reader
+{
+  [log appendString: @"]"];
+}
+- (void) readerDidStartObject: (GSJSONReader*)reader
+{
+  [log appendString: @"{"];
+}
+- (void) readerDidEndObject: (GSJSONReader*)reader
+{
+  [log appendString: @"}"];
+}
+- (void) reader: (GSJSONReader*)reader foundKey: (NSString*)key
+{
+  [log appendFormat: @"k:%@ ", key];
+}
+- (void) reader: (GSJSONReader*)reader foundValue: (id)value
+{
+  [log appendFormat: @"v:%@ ", value];
+}
+@end
+
+int main(int argc,char **argv)
+{
+  NSAutoreleasePool	*arp = [NSAutoreleasePool new];
+  NSString		*json;
+  NSString		*expect;
+  NSData		*data;
+  const char		*bytes;
+  Recorder		*r;
+  GSJSONReader		*reader;
+  BOOL			ok;
+  NSUInteger		i;
+
+  json = @"{\"a\": [1, -2.5, true, null], \"b\\u00e9\": \"x\\ny\"}\n[\"café\"] 42";
+  expect = @"{k:a [v:1 v:-2.5 v:1 v:<null> ]k:bé v:x\ny }[v:café ]v:42 ";
+  data = [json dataUsingEncoding: NSUTF8StringEncoding];
+
+  r = [[Recorder new] autorelease];
+  reader = [[GSJSONReader new] autorelease];
+  [reader setDelegate: r];
+  ok = [reader parse: data];
+  PASS(ok && [reader parse: nil], "can parse a sequence of values");
+  PASS_EQUAL(r->log, expect, "events are reported in order");
+
+  /* Feed the same data one byte at a time, so that every token is split.
+   */
+  r = [[Recorder new] autorelease];
+  reader = [[GSJSONReader new] autorelease];
+  [reader setDelegate: r];
+  bytes = [data bytes];
+  ok = YES;
+  for (i = 0; i < [data length]; i++)
+    {
+      if (NO == [reader parse: [NSData dataWithBytes: bytes + i length: 1]])
+	{
+	  ok = NO;
+	}
+    }
+  PASS(ok && [reader parse: nil], "can parse data a byte at a time");
+  PASS_EQUAL(r->log, expect, "chunked events match");
+
+  r = [[Recorder new] autorelease];
+  reader = [[GSJSONReader new] autorelease];
+  [reader setDelegate: r];
+  PASS([reader parseStream: [NSInputStream inputStreamWithData: data]],
+    "can parse a stream");
+  PASS_EQUAL(r->log, expect, "stream events match");
+
+  reader = [[GSJSONReader new] autorelease];
+  data = [@"{\"a\": [1, 2" dataUsingEncoding: NSUTF8StringEncoding];
+  PASS([reader parse: data] && NO == [reader isComplete],
+    "partial data is accepted");
+  PASS(NO == [reader parse: nil] && [reader error] != nil,
+    "end of data in a value is an error");
+
+  reader = [[GSJSONReader new] autorelease];
+  data = [@"[1, }" dataUsingEncoding: NSUTF8StringEncoding];
+  PASS(NO == [reader parse: data] && [reader error] != nil,
+    "mismatched brackets are an error");
+
+  [arp release]; arp = nil;
+  return 0;
+}
+#else
+int main(int argc,char **argv)
+{
+  return 0;
+}
+#endif
@@ -0,0 +1,144 @@
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSKeyValueCoding.h>
+#import <Foundation/NSString.h>
+#import <Foundation/NSValue.h>
+#import <GNUstepBase/GSObjCRuntime.h>
+
+/* Key-value coding caches the accessors it finds for each class, so check
+ * that repeated use gives the right results and that the cache notices
+ * when methods change.
+ */
+@interface Cached : NSObject
+{
+  NSString	*name;
+  NSString	*title;
+  int		count;
+}
+- (NSString*) title;
+- (void) setTitle: (NSString*)s;
+@end
+
+@implementation Cached
+- (void) dealloc
+{
+  [name release];
+  [title release];
+  [super dealloc];
+}
+- (NSString*) title
+{
+  return title;
+}
+- (void) setTitle: (NSString*)s
+{
+  s = [s uppercaseString];
+  [title release];
+  title = [s retain];
+}
+@end
+
+@interface Other : NSObject
+@end
+
+@implementation Other
+- (NSString*) name
+{
+  return @"method";
+}
+- (NSString*) title
+{
+  return @"replaced";
+}
+@end
+
+@interface Sub : Cached
+@end
+
+@implementation Sub
+- (NSString*) title
+{
+  return @"sub";
+}
+@end
+
+static id
+extraImp(id self, SEL _cmd)
+{
+  return @"added";
+}
+
+static int
+countImp(id self, SEL _cmd)
+{
+  return 42;
+}
+
+int main()
+{
+  NSAutoreleasePool	*arp = [NSAutoreleasePool new];
+  Cached		*a = [[Cached new] autorelease];
+  Cached		*b = [[Cached new] autorelease];
+  Sub			*c = [[Sub new] autorelease];
+  Method		m[2];
+  BOOL			ok = YES;
+  int			i;
+
+  for (i = 0; i < 100; i++)
+    {
+      NSString	*s = [NSString stringWithFormat: @"n%d", i];
+
+      [a setValue: s forKey: @"name"];
+      [b setValue: @"other" forKey: @"name"];
+      [a setValue: s forKey: @"title"];
+      [a setValue: [NSNumber numberWithInt: i] forKey: @"count"];
+      if ([[a valueForKey: @"name"] isEqual: s] == NO
+	|| [[b valueForKey: @"name"] isEqual: @"other"] == NO
+	|| [[a valueForKey: @"title"] isEqual: [s uppercaseString]] == NO
+	|| [[a valueForKey: @"count"] intValue] != i)
+	{
+	  ok = NO;
+	}
+    }
+  PASS(ok, "repeated get and set use the right accessor for each key");
+
+  [c setValue: @"x" forKey: @"title"];
+  PASS_EQUAL([c valueForKey: @"title"], @"sub",
+    "a subclass uses its own accessor");
+  PASS_EQUAL([a valueForKey: @"title"], @"N99",
+    "the superclass still uses its own accessor");
+
+  PASS_EXCEPTION([a valueForKey: @"missing"], NSUndefinedKeyException,
+    "an unknown key raises");
+  PASS_EXCEPTION([a valueForKey: @"missing"], NSUndefinedKeyException,
+    "an unknown key raises again");
+
+  method_setImplementation(class_getInstanceMethod([Cached class],
+    @selector(title)), method_getImplementation(
+    class_getInstanceMethod([Other class], @selector(title))));
+  PASS_EQUAL([a valueForKey: @"title"], @"replaced",
+    "a replaced accessor method is used");
+
+  m[0] = class_getInstanceMethod([Other class], @selector(name));
+  m[1] = 0;
+  GSObjCAddMethods([Cached class], m, NO);
+  PASS_EQUAL([a valueForKey: @"name"], @"method",
+    "an accessor method added after an instance variable was used is found");
+
+  PASS_EXCEPTION([a valueForKey: @"extra"], NSUndefinedKeyException,
+    "a key with no accessor or instance variable raises");
+  class_addMethod([Cached class], sel_registerName("extra"),
+    (IMP)extraImp, "@@:");
+  PASS_EQUAL([a valueForKey: @"extra"], @"added",
+    "an accessor added by class_addMethod() after a failed lookup is found");
+
+  [c setValue: [NSNumber numberWithInt: 7] forKey: @"count"];
+  PASS([[c valueForKey: @"count"] intValue] == 7,
+    "an instance variable is used when there is no accessor");
+  class_addMethod([Sub class], sel_registerName("count"), (IMP)countImp, "i@:");
+  PASS([[c valueForKey: @"count"] intValue] == 42,
+    "an accessor added by class_addMethod() replaces an instance variable");
+
+  [arp release]; arp = nil;
+  return 0;
+}
@@ -0,0 +1,92 @@
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+
+static unsigned	deallocated = 0;
+
+@interface	Counted : NSObject
+@end
+@implementation	Counted
+- (void) dealloc
+{
+  deallocated++;
+  [super dealloc];
+}
+@end
+
+/* An object which autoreleases another object when it is deallocated.
+ */
+@interface	Chained : NSObject
+@end
+@implementation	Chained
+- (void) dealloc
+{
+  [[Counted new] autorelease];
+  [super dealloc];
+}
+@end
+
+int main()
+{
+  NSAutoreleasePool	*arp = [NSAutoreleasePool new];
+  NSAutoreleasePool	*outer;
+  NSAutoreleasePool	*inner;
+  Counted		*o;
+  unsigned		i;
+
+  outer = [NSAutoreleasePool new];
+  PASS([NSAutoreleasePool currentPool] == outer, "new pool is current");
+  for (i = 0; i < 5000; i++)
+    {
+      [[Counted new] autorelease];
+    }
+  inner = [NSAutoreleasePool new];
+  PASS([NSAutoreleasePool currentPool] == inner, "nested pool is current");
+  o = [[Counted new] autorelease];
+  [[Counted new] autorelease];
+  PASS([outer autoreleaseCount] == 5000,
+    "pool counts objects across pages");
+  PASS([inner autoreleaseCount] == 2, "nested pool counts its objects");
+  PASS([NSAutoreleasePool autoreleaseCountForObject: o] == 1,
+    "object is found in the pool");
+  [inner drain];
+  PASS(deallocated == 2, "draining nested pool releases its objects");
+  PASS([NSAutoreleasePool currentPool] == outer, "outer pool is current");
+  [outer drain];
+  PASS(deallocated == 5002, "draining pool releases its objects");
+
+  deallocated = 0;
+  outer = [NSAutoreleasePool new];
+  for (i = 0; i < 1000; i++)
+    {
+      [[Chained new] autorelease];
+    }
+  [outer emptyPool];
+  PASS(deallocated == 1000,
+    "objects autoreleased while emptying a pool are released");
+  PASS([outer autoreleaseCount] == 0, "emptied pool has no objects");
+
+  deallocated = 0;
+  inner = [NSAutoreleasePool new];
+  [[Counted new] autorelease];
+  [outer drain];
+  PASS(deallocated == 1, "draining a pool drains its children");
+  PASS([NSAutoreleasePool currentPool] == arp, "parent becomes current");
+
+#if     defined(GNUSTEP_BASE_LIBRARY)
+  [NSAutoreleasePool resetStatistics];
+  outer = [NSAutoreleasePool new];
+  inner = [NSAutoreleasePool new];
+  [[Counted new] autorelease];
+  [inner drain];
+  [[Counted new] autorelease];
+  [[Counted new] autorelease];
+  [outer drain];
+  PASS([NSAutoreleasePool peakPoolDepth] == 3, "peak depth is recorded");
+  PASS([NSAutoreleasePool drainCount] == 2, "drains are counted");
+  PASS([NSAutoreleasePool drainedObjectCount] == 3,
+    "drained objects are counted");
+#endif
+
+  [arp release]; arp = nil;
+  return 0;
+}
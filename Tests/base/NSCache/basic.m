@@ -0,0 +1,82 @@
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSCache.h>
+#import <Foundation/NSString.h>
+#import <Foundation/NSValue.h>
+
+@interface	CacheDelegate : NSObject
+{
+@public
+  unsigned	evicted;
+}
+@end
+
+@implementation	CacheDelegate
+- (void) cache: (NSCache*)cache willEvictObject: (id)obj
+{
+  evicted++;
+}
+@end
+
+int main()
+{
+  NSAutoreleasePool	*arp = [NSAutoreleasePool new];
+  NSCache		*cache = [[NSCache new] autorelease];
+  CacheDelegate		*delegate = [[CacheDelegate new] autorelease];
+  NSNumber		*n;
+  BOOL			ok;
+  int			i;
+
+  [cache setDelegate: delegate];
+  [cache setObject: @"one" forKey: @"1"];
+  PASS_EQUAL([cache objectForKey: @"1"], @"one", "can retrieve an object");
+  PASS([cache objectForKey: @"2"] == nil, "missing key returns nil");
+  PASS([cache hitCount] == 1 && [cache missCount] == 1,
+    "hits and misses are counted");
+
+  [cache removeObjectForKey: @"1"];
+  PASS([cache objectForKey: @"1"] == nil, "can remove an object");
+  PASS(delegate->evicted == 1, "delegate is told about removal");
+
+  [cache setCountLimit: 3];
+  [cache setObject: @"a" forKey: @"a"];
+  [cache setObject: @"b" forKey: @"b"];
+  [cache setObject: @"c" forKey: @"c"];
+  [cache objectForKey: @"a"];
+  [cache setObject: @"d" forKey: @"d"];
+  PASS([cache objectForKey: @"b"] == nil,
+    "least recently used object is evicted at the count limit");
+  PASS([cache objectForKey: @"a"] != nil
+    && [cache objectForKey: @"c"] != nil
+    && [cache objectForKey: @"d"] != nil,
+    "recently used objects are kept at the count limit");
+  PASS([cache evictionCount] == 1, "evictions are counted");
+
+  [cache removeAllObjects];
+  [cache setCountLimit: 0];
+  [cache setTotalCostLimit: 100];
+  for (i = 0; i < 100; i++)
+    {
+      n = [NSNumber numberWithInt: i];
+      [cache setObject: n forKey: n cost: 10];
+    }
+  ok = YES;
+  for (i = 0; i < 90; i++)
+    {
+      if ([cache objectForKey: [NSNumber numberWithInt: i]] != nil)
+	{
+	  ok = NO;
+	}
+    }
+  for (i = 90; i < 100; i++)
+    {
+      if ([cache objectForKey: [NSNumber numberWithInt: i]] == nil)
+	{
+	  ok = NO;
+	}
+    }
+  PASS(ok, "cost limit keeps the most recently added objects");
+
+  [arp release]; arp = nil;
+  return 0;
+}
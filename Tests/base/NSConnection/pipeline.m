@@ -0,0 +1,138 @@
+#import "Testing.h"
+#import <Foundation/Foundation.h>
+
+/* Check that oneway and void messages sent with pipelining turned on
+ * arrive in order, and that replies are matched to their requests.
+ */
+@protocol	Recorder
+- (oneway void) note: (int)n;
+- (void) append: (int)n;
+- (int) echo: (int)n;
+- (void) fail;
+- (NSArray*) log;
+@end
+
+@interface	Recorder : NSObject <Recorder>
+{
+  NSMutableArray	*log;
+}
+@end
+@implementation	Recorder
+- (void) dealloc
+{
+  [log release];
+  [super dealloc];
+}
+- (id) init
+{
+  log = [NSMutableArray new];
+  return self;
+}
+- (oneway void) note: (int)n
+{
+  [log addObject: [NSNumber numberWithInt: n]];
+}
+- (void) append: (int)n
+{
+  [log addObject: [NSNumber numberWithInt: n]];
+}
+- (int) echo: (int)n
+{
+  return n;
+}
+- (void) fail
+{
+  [NSException raise: NSGenericException format: @"failed"];
+}
+- (NSArray*) log
+{
+  return [[log copy] autorelease];
+}
+@end
+
+@interface	Server : NSObject
+@end
+@implementation	Server
++ (void) run: (NSSocketPort*)port
+{
+  NSAutoreleasePool	*pool = [NSAutoreleasePool new];
+  NSConnection		*c;
+
+  c = [[NSConnection alloc] initWithReceivePort: port sendPort: nil];
+  [c setRootObject: [[Recorder new] autorelease]];
+  [[NSRunLoop currentRunLoop] run];
+  [pool release];
+}
+@end
+
+int main()
+{
+  NSAutoreleasePool	*arp = [NSAutoreleasePool new];
+  NSMutableArray	*expect = [NSMutableArray array];
+  NSSocketPort		*server;
+  NSSocketPort		*remote;
+  NSConnection		*c;
+  id			proxy;
+  BOOL			ok;
+  int			i;
+
+  server = [NSSocketPort portWithNumber: 0
+				 onHost: nil
+			   forceAddress: @"127.0.0.1"
+			       listener: YES];
+  [NSThread detachNewThreadSelector: @selector(run:)
+			   toTarget: [Server class]
+			 withObject: server];
+  [NSThread sleepForTimeInterval: 0.5];
+
+  remote = [NSSocketPort portWithNumber: [server portNumber]
+				 onHost: [NSHost hostWithAddress: @"127.0.0.1"]
+			   forceAddress: nil
+			       listener: NO];
+  c = [NSConnection connectionWithReceivePort:
+    [NSSocketPort portWithNumber: 0
+			  onHost: nil
+		    forceAddress: @"127.0.0.1"
+			listener: YES]
+				     sendPort: remote];
+  proxy = [c rootProxy];
+  [proxy setProtocolForProxy: @protocol(Recorder)];
+  [c setPipelinesRequests: YES];
+  PASS([c pipelinesRequests] == YES, "pipelining can be turned on");
+
+  for (i = 0; i < 100; i++)
+    {
+      [proxy note: i];
+      [expect addObject: [NSNumber numberWithInt: i]];
+    }
+  for (i = 100; i < 200; i++)
+    {
+      [proxy append: i];
+      [expect addObject: [NSNumber numberWithInt: i]];
+    }
+  PASS([proxy echo: 1234] == 1234,
+    "a two-way message after oneway and void messages gets its reply");
+  PASS_EQUAL([proxy log], expect,
+    "oneway and void messages are handled in the order sent");
+
+  ok = YES;
+  for (i = 0; i < 200; i++)
+    {
+      [proxy note: i];
+      [proxy append: i];
+      if ([proxy echo: i] != i)
+	{
+	  ok = NO;
+	}
+    }
+  PASS(ok, "replies are matched to their requests");
+
+  [proxy fail];
+  PASS_EXCEPTION([c flushRequests], NSGenericException,
+    "an exception in a pipelined void message is raised when flushed");
+  PASS([proxy echo: 99] == 99, "the connection works after an exception");
+
+  [c invalidate];
+  [arp release]; arp = nil;
+  return 0;
+}
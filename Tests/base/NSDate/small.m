@@ -0,0 +1,50 @@
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSDate.h>
+#import <Foundation/NSArchiver.h>
+#include <math.h>
+
+int main()
+{
+  NSAutoreleasePool	*arp = [NSAutoreleasePool new];
+  NSTimeInterval	t[] = { 0.0, 1.0, -1.0, 0.1, 123456789.123456,
+    -987654321.000001, 1e-300 };
+  unsigned		i;
+  BOOL			ok = YES;
+
+  for (i = 0; i < sizeof(t) / sizeof(t[0]); i++)
+    {
+      NSDate	*d = [NSDate dateWithTimeIntervalSinceReferenceDate: t[i]];
+      NSDate	*e = [[NSDate alloc] initWithTimeIntervalSinceReferenceDate: t[i]];
+
+      if ([d timeIntervalSinceReferenceDate] != t[i]
+	|| [e timeIntervalSinceReferenceDate] != t[i]
+	|| [d isEqual: e] == NO || [e isEqual: d] == NO
+	|| [d hash] != [e hash] || [d compare: e] != NSOrderedSame)
+	{
+	  ok = NO;
+	}
+      [e release];
+    }
+  PASS(ok, "dates keep their exact time intervals");
+
+  {
+    NSDate	*d1 = [NSDate date];
+    NSDate	*d2 = [d1 addTimeInterval: 0.5];
+    NSDate	*d3;
+
+    PASS(fabs([d2 timeIntervalSinceDate: d1] - 0.5) < 1e-6,
+      "-addTimeInterval: works");
+    PASS([d1 earlierDate: d2] == d1 && [d1 laterDate: d2] == d2,
+      "-earlierDate: and -laterDate: work");
+    PASS([[d1 copy] isEqual: d1], "-copy gives an equal date");
+    d3 = [NSUnarchiver unarchiveObjectWithData:
+      [NSArchiver archivedDataWithRootObject: d1]];
+    PASS_EQUAL(d3, d1, "a date survives archiving");
+  }
+  PASS([NSDate distantFuture] == [NSDate distantFuture],
+    "+distantFuture is a singleton");
+
+  [arp release]; arp = nil;
+  return 0;
+}
@@ -0,0 +1,55 @@
+#import "Testing.h"
+#import <Foundation/Foundation.h>
+
+int main()
+{
+  NSAutoreleasePool	*arp = [NSAutoreleasePool new];
+  NSFileManager		*mgr = [NSFileManager defaultManager];
+  NSString		*base = [NSTemporaryDirectory()
+    stringByAppendingPathComponent:
+    [[NSProcessInfo processInfo] globallyUniqueString]];
+  NSString		*src = [base stringByAppendingString: @"-src"];
+  NSString		*dst = [base stringByAppendingString: @"-dst"];
+  NSMutableData		*big = [NSMutableData dataWithLength: 3000000];
+  unsigned char		*p = [big mutableBytes];
+  NSFileHandle		*r;
+  NSFileHandle		*w;
+  NSData		*d;
+  unsigned		i;
+
+  for (i = 0; i < [big length]; i++)
+    {
+      p[i] = (unsigned char)(i * 7);
+    }
+  [big writeToFile: src atomically: NO];
+
+  r = [NSFileHandle fileHandleForReadingAtPath: src];
+  d = [r readDataToEndOfFile];
+  PASS_EQUAL(d, big, "-readDataToEndOfFile reads a large file");
+
+  [r seekToFileOffset: 0];
+  d = [r readDataOfLength: 100000];
+  PASS_EQUAL(d, [big subdataWithRange: NSMakeRange(0, 100000)],
+    "-readDataOfLength: reads the requested amount");
+  d = [r readDataOfLength: 0];
+  PASS([d length] == 0, "-readDataOfLength: 0 reads nothing");
+  d = [r readDataOfLength: 4000000];
+  PASS_EQUAL(d, [big subdataWithRange: NSMakeRange(100000, 2900000)],
+    "-readDataOfLength: stops at end of file");
+
+  [@"" writeToFile: dst atomically: NO];
+  w = [NSFileHandle fileHandleForWritingAtPath: dst];
+  [r seekToFileOffset: 0];
+  PASS([w transferFromFileHandle: r length: 1000] == 1000,
+    "-transferFromFileHandle:length: copies a limited amount");
+  PASS([w transferFromFileHandle: r length: 0] == [big length] - 1000,
+    "-transferFromFileHandle:length: copies to end of file");
+  [w closeFile];
+  PASS_EQUAL([NSData dataWithContentsOfFile: dst], big,
+    "-transferFromFileHandle:length: copies the data correctly");
+
+  [mgr removeFileAtPath: src handler: nil];
+  [mgr removeFileAtPath: dst handler: nil];
+  [arp release]; arp = nil;
+  return 0;
+}
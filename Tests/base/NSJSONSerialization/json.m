@@ -29,13 +29,13 @@ int main(void)
     NSUTF32LittleEndianStringEncoding,\
     NSUTF32BigEndianStringEncoding};
   NSInputStream *is;
+  NSError *e;
   NSData *data;
   id obj;
   int i;
 
   for (i = 0; i < (sizeof(encs) / sizeof(NSStringEncoding)); i++)
     {
-      NSError	*e;
       id	tmp;
 
       data = [json dataUsingEncoding: encs[i]];
@@ -63,5 +63,39 @@ int main(void)
   is = [NSInputStream inputStreamWithData: data];
   PASS_EQUAL([NSJSONSerialization JSONObjectWithStream: is options: 0 error: 0],
     obj, "Round trip worked through stream");
+
+  data = [@"[\"caf\u00e9\", \"\\u00e9\\ud83d\\ude00\\n\", -1.5e2, 123456]"
+    dataUsingEncoding: NSUTF8StringEncoding];
+  obj = [NSJSONSerialization JSONObjectWithData: data options: 0 error: 0];
+  PASS_EQUAL([obj objectAtIndex: 0], @"caf\u00e9",
+    "UTF-8 string is decoded");
+  PASS_EQUAL([obj objectAtIndex: 1], @"\u00e9\U0001F600\n",
+    "Escapes and surrogate pairs are decoded");
+  PASS([[obj objectAtIndex: 2] doubleValue] == -150.0
+    && [[obj objectAtIndex: 3] doubleValue] == 123456.0,
+    "Numbers are decoded");
+  obj = [NSJSONSerialization JSONObjectWithData: data
+    options: NSJSONReadingMutableContainers | NSJSONReadingMutableLeaves
+    error: 0];
+  PASS([obj isKindOfClass: [NSMutableArray class]]
+    && [[obj objectAtIndex: 0] isKindOfClass: [NSMutableString class]],
+    "Mutable containers and leaves are created on request");
+  data = [@"{\"a\": \"unterminated" dataUsingEncoding: NSUTF8StringEncoding];
+  obj = [NSJSONSerialization JSONObjectWithData: data options: 0 error: &e];
+  PASS(obj == nil && e != nil, "Unterminated string is an error");
+
+  obj = [NSArray arrayWithObjects: [NSNumber numberWithInt: 800],
+    [NSNumber numberWithDouble: 0.1], [NSNumber numberWithBool: YES],
+    @"a\x01\"\u00e9", nil];
+  data = [NSJSONSerialization dataWithJSONObject: obj options: 0 error: 0];
+  PASS_EQUAL(AUTORELEASE([[NSString alloc] initWithData: data
+    encoding: NSUTF8StringEncoding]),
+    @"[800,0.1,true,\"a\\u0001\\\"\u00e9\"]",
+    "Integers, doubles, booleans and escapes are written correctly");
+  PASS_EQUAL([NSJSONSerialization JSONObjectWithData: data options: 0 error: 0],
+    obj, "Round trip of written values worked");
+  obj = [NSArray arrayWithObject: [NSNumber numberWithDouble: 1.0/0.0]];
+  PASS([NSJSONSerialization isValidJSONObject: obj] == NO,
+    "Infinity is not valid JSON");
   return 0;
 }
@@ -0,0 +1,129 @@
+#import "Testing.h"
+#import <Foundation/Foundation.h>
+
+static NSComparisonResult
+byValue(id a, id b, void *context)
+{
+  return [a compare: b];
+}
+
+static NSComparisonResult
+random3(id a, id b, void *context)
+{
+  return (NSComparisonResult)((rand() % 3) - 1);
+}
+
+static NSComparisonResult
+failing(id a, id b, void *context)
+{
+  if ([a intValue] == 42 || [b intValue] == 42)
+    {
+      [NSException raise: NSGenericException format: @"failed"];
+    }
+  return [a compare: b];
+}
+
+/* Check that an array is in ascending order.
+ */
+static BOOL
+ascending(NSArray *a)
+{
+  NSUInteger	i;
+
+  for (i = 1; i < [a count]; i++)
+    {
+      if ([[a objectAtIndex: i - 1] compare: [a objectAtIndex: i]]
+	== NSOrderedDescending)
+	{
+	  return NO;
+	}
+    }
+  return YES;
+}
+
+int main()
+{
+  NSAutoreleasePool	*arp = [NSAutoreleasePool new];
+  NSMutableArray	*m = [NSMutableArray array];
+  NSMutableArray	*c;
+  NSArray		*d;
+  NSCountedSet		*before;
+  NSSortDescriptor	*sd;
+  BOOL			stable;
+  int			i;
+
+  srand(1);
+  for (i = 0; i < 10000; i++)
+    {
+      [m addObject: [NSNumber numberWithInt: rand() % 5000]];
+    }
+  before = [[[NSCountedSet alloc] initWithArray: m] autorelease];
+
+  c = [[m mutableCopy] autorelease];
+  [c sortUsingFunction: byValue context: 0];
+  PASS(ascending(c), "-sortUsingFunction:context: sorts random numbers");
+  PASS_EQUAL([[[NSCountedSet alloc] initWithArray: c] autorelease], before,
+    "sorting keeps the same objects");
+
+  [c sortUsingFunction: byValue context: 0];
+  PASS(ascending(c), "sorting a sorted array leaves it sorted");
+
+  d = [[c reverseObjectEnumerator] allObjects];
+  c = [[d mutableCopy] autorelease];
+  [c sortUsingSelector: @selector(compare:)];
+  PASS(ascending(c), "-sortUsingSelector: sorts a reversed array");
+
+  d = [m sortedArrayUsingFunction: byValue context: 0];
+  PASS(ascending(d), "-sortedArrayUsingFunction:context: sorts");
+
+  c = [NSMutableArray array];
+  for (i = 0; i < 5000; i++)
+    {
+      [c addObject: [NSNumber numberWithInt: i % 3]];
+    }
+  [c sortUsingSelector: @selector(compare:)];
+  PASS(ascending(c), "sorting many equal objects works");
+
+  c = [[m mutableCopy] autorelease];
+  [c sortUsingFunction: random3 context: 0];
+  PASS_EQUAL([[[NSCountedSet alloc] initWithArray: c] autorelease], before,
+    "an inconsistent comparison keeps the same objects");
+
+  c = [[m mutableCopy] autorelease];
+  [c addObject: [NSNumber numberWithInt: 42]];
+  PASS_EXCEPTION([c sortUsingFunction: failing context: 0],
+    NSGenericException, "an exception in the comparison is raised");
+  [c removeLastObject];
+  PASS_EQUAL([[[NSCountedSet alloc] initWithArray: c] autorelease], before,
+    "the array keeps its objects after an exception");
+
+  c = [NSMutableArray array];
+  for (i = 0; i < 5000; i++)
+    {
+      [c addObject: [NSDictionary dictionaryWithObjectsAndKeys:
+	[NSNumber numberWithInt: rand() % 10], @"key",
+	[NSNumber numberWithInt: i], @"index",
+	nil]];
+    }
+  sd = [[[NSSortDescriptor alloc] initWithKey: @"key" ascending: YES]
+    autorelease];
+  [c sortUsingDescriptors: [NSArray arrayWithObject: sd]];
+  stable = YES;
+  for (i = 1; i < 5000; i++)
+    {
+      NSDictionary	*a = [c objectAtIndex: i - 1];
+      NSDictionary	*b = [c objectAtIndex: i];
+      int		ka = [[a objectForKey: @"key"] intValue];
+      int		kb = [[b objectForKey: @"key"] intValue];
+
+      if (ka > kb || (ka == kb && [[a objectForKey: @"index"] intValue]
+	> [[b objectForKey: @"index"] intValue]))
+	{
+	  stable = NO;
+	}
+    }
+  PASS(stable, "-sortUsingDescriptors: is stable");
+
+  [arp release]; arp = nil;
+  return 0;
+}
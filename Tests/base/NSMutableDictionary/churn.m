@@ -0,0 +1,99 @@
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSDictionary.h>
+#import <Foundation/NSEnumerator.h>
+#import <Foundation/NSSet.h>
+#import <Foundation/NSValue.h>
+
+/* Exercise the open addressing map table used by the concrete dictionary
+ * and set classes with large numbers of additions and removals.
+ */
+int main()
+{
+  NSAutoreleasePool	*arp = [NSAutoreleasePool new];
+  NSMutableDictionary	*dict = [NSMutableDictionary dictionary];
+  NSMutableSet		*set = [NSMutableSet set];
+  NSEnumerator		*e;
+  NSNumber		*n;
+  BOOL			ok;
+  int			count;
+  int			i;
+
+  for (i = 0; i < 10000; i++)
+    {
+      n = [NSNumber numberWithInt: i];
+      [dict setObject: n forKey: n];
+      [set addObject: n];
+    }
+  PASS([dict count] == 10000 && [set count] == 10000,
+    "can add many objects");
+
+  ok = YES;
+  for (i = 0; i < 10000; i++)
+    {
+      n = [NSNumber numberWithInt: i];
+      if ([[dict objectForKey: n] isEqual: n] == NO
+	|| [set member: n] == nil)
+	{
+	  ok = NO;
+	}
+    }
+  PASS(ok == YES, "can find all added objects");
+
+  for (i = 0; i < 10000; i += 2)
+    {
+      n = [NSNumber numberWithInt: i];
+      [dict removeObjectForKey: n];
+      [set removeObject: n];
+    }
+  PASS([dict count] == 5000 && [set count] == 5000,
+    "can remove many objects");
+
+  ok = YES;
+  for (i = 0; i < 10000; i++)
+    {
+      n = [NSNumber numberWithInt: i];
+      if (([dict objectForKey: n] == nil) != (i % 2 == 0)
+	|| ([set member: n] == nil) != (i % 2 == 0))
+	{
+	  ok = NO;
+	}
+    }
+  PASS(ok == YES, "lookups are correct after removals");
+
+  for (i = 0; i < 100000; i++)
+    {
+      n = [NSNumber numberWithInt: 20000 + i % 7];
+      [dict setObject: n forKey: n];
+      [dict removeObjectForKey: n];
+      [set addObject: n];
+      [set removeObject: n];
+    }
+  PASS([dict count] == 5000 && [set count] == 5000,
+    "repeated add/remove leaves count unchanged");
+
+  count = 0;
+  ok = YES;
+  e = [dict keyEnumerator];
+  while ((n = [e nextObject]) != nil)
+    {
+      if ([n intValue] % 2 == 0)
+	{
+	  ok = NO;
+	}
+      count++;
+    }
+  PASS(ok == YES && count == 5000, "enumeration sees each key once");
+
+  [set intersectSet: [NSSet setWithObjects:
+    [NSNumber numberWithInt: 1], [NSNumber numberWithInt: 2], nil]];
+  PASS([set count] == 1 && [set member: [NSNumber numberWithInt: 1]] != nil,
+    "removal while enumerating (intersectSet:) works");
+
+  [dict removeAllObjects];
+  PASS([dict count] == 0 && [dict objectForKey: [NSNumber numberWithInt: 1]]
+    == nil, "can empty dictionary");
+
+  [arp release]; arp = nil;
+  return 0;
+}
@@ -0,0 +1,107 @@
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSString.h>
+#include <string.h>
+
+/* Large strings edited in the middle are held in a different form, so
+ * check a long series of edits against a plain buffer of characters.
+ */
+static unsigned	seed = 1;
+
+static unsigned
+next(unsigned limit)
+{
+  seed = seed * 1103515245 + 12345;
+  return ((seed >> 16) & 0x7fff) % limit;
+}
+
+int main()
+{
+  NSAutoreleasePool	*arp = [NSAutoreleasePool new];
+  NSMutableString	*m = [NSMutableString string];
+  unsigned		cap = 200000;
+  unichar		*ref = malloc(cap * sizeof(unichar));
+  unichar		*tmp = malloc(cap * sizeof(unichar));
+  unsigned		len = 0;
+  unsigned		i;
+  BOOL			ok = YES;
+  NSString		*s;
+
+  while (len < 100000)
+    {
+      ref[len] = 'a' + len % 26;
+      [m appendFormat: @"%c", (char)ref[len]];
+      len++;
+    }
+
+  for (i = 0; i < 20000 && ok == YES; i++)
+    {
+      CREATE_AUTORELEASE_POOL(pool);
+      unsigned	loc = next(len + 1);
+      unsigned	del = next(4) == 0 ? next(len - loc + 1) % 3000 : 0;
+      unsigned	ins = next(3) == 0 ? next(2000) : next(5);
+      unsigned	j;
+
+      if (i % 2 == 0 && del == 0 && loc < len)
+	{
+	  del = next(4);
+	  if (loc + del > len)
+	    {
+	      del = len - loc;
+	    }
+	}
+      if (len + ins > cap)
+	{
+	  ins = 0;
+	}
+      for (j = 0; j < ins; j++)
+	{
+	  tmp[j] = (next(10) == 0) ? 0x100 + next(1000) : 'A' + next(26);
+	}
+      [m replaceCharactersInRange: NSMakeRange(loc, del)
+		       withString: [NSString stringWithCharacters: tmp
+							   length: ins]];
+      memmove(ref + loc + ins, ref + loc + del,
+	(len - loc - del) * sizeof(unichar));
+      memcpy(ref + loc, tmp, ins * sizeof(unichar));
+      len = len + ins - del;
+
+      if ([m length] != len)
+	{
+	  ok = NO;
+	}
+      else if (i % 500 == 0)
+	{
+	  s = [NSString stringWithCharacters: ref length: len];
+	  if ([m isEqual: s] == NO || [s isEqual: m] == NO
+	    || [m hash] != [s hash])
+	    {
+	      ok = NO;
+	    }
+	  if (len > 0 && [m characterAtIndex: len / 2] != ref[len / 2])
+	    {
+	      ok = NO;
+	    }
+	}
+      DESTROY(pool);
+    }
+  PASS(ok, "many edits in a large mutable string give the right result");
+
+  s = [NSString stringWithCharacters: ref length: len];
+  PASS_EQUAL([[m copy] autorelease], s, "copy of edited string is correct");
+  PASS_EQUAL([[m mutableCopy] autorelease], s,
+    "mutable copy of edited string is correct");
+
+  [m deleteCharactersInRange: NSMakeRange(10, len - 20)];
+  PASS([m length] == 20, "large deletion leaves the right length");
+  memmove(ref + 10, ref + len - 10, 10 * sizeof(unichar));
+  PASS_EQUAL(m, [NSString stringWithCharacters: ref length: 20],
+    "large deletion leaves the right characters");
+  [m appendString: @"xyz"];
+  PASS([m hasSuffix: @"xyz"], "string is usable after shrinking");
+
+  free(ref);
+  free(tmp);
+  [arp release]; arp = nil;
+  return 0;
+}
@@ -0,0 +1,119 @@
+#import "Testing.h"
+#import <Foundation/NSArray.h>
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSNotification.h>
+#import <Foundation/NSString.h>
+
+static NSMutableString	*record = nil;
+
+@interface	Recorder : NSObject
+{
+  NSString	*tag;
+}
+- (id) initWithTag: (NSString*)aTag;
+- (void) note: (NSNotification*)n;
+@end
+
+@implementation	Recorder
+- (void) dealloc
+{
+  [tag release];
+  [super dealloc];
+}
+- (id) initWithTag: (NSString*)aTag
+{
+  if ((self = [super init]) != nil)
+    {
+      tag = [aTag copy];
+    }
+  return self;
+}
+- (void) note: (NSNotification*)n
+{
+  [record appendString: tag];
+}
+@end
+
+int main()
+{
+  NSAutoreleasePool	*arp = [NSAutoreleasePool new];
+  NSNotificationCenter	*nc = [NSNotificationCenter new];
+  NSObject		*obj = [[NSObject new] autorelease];
+  Recorder		*a = [[[Recorder alloc] initWithTag: @"a"] autorelease];
+  Recorder		*b = [[[Recorder alloc] initWithTag: @"b"] autorelease];
+  Recorder		*c = [[[Recorder alloc] initWithTag: @"c"] autorelease];
+  NSMutableArray	*many = [NSMutableArray array];
+  unsigned		i;
+  BOOL			ok;
+
+  record = [NSMutableString string];
+
+  [nc addObserver: a selector: @selector(note:) name: @"N" object: nil];
+  [nc addObserver: b selector: @selector(note:) name: nil object: obj];
+  [nc addObserver: c selector: @selector(note:) name: @"N" object: obj];
+  [nc postNotificationName: @"N" object: obj];
+  PASS_EQUAL(record, @"acb",
+    "named observers are notified before those without a name");
+
+  [record setString: @""];
+  [nc postNotificationName: @"N" object: nil];
+  PASS_EQUAL(record, @"a", "observer of any object gets nil object");
+
+  [record setString: @""];
+  [nc postNotificationName: @"M" object: obj];
+  PASS_EQUAL(record, @"b", "observer without a name gets any name");
+
+  [record setString: @""];
+  [nc removeObserver: a name: nil object: nil];
+  [nc postNotificationName: @"N" object: obj];
+  PASS_EQUAL(record, @"cb", "observer is removed for all names");
+
+  [record setString: @""];
+  [nc removeObserver: nil name: @"N" object: obj];
+  [nc postNotificationName: @"N" object: obj];
+  PASS_EQUAL(record, @"b", "all observers of a name and object are removed");
+
+  [nc removeObserver: b];
+  [nc removeObserver: c];
+
+  /* Spread observers over many names, each observing its own name.
+   */
+  for (i = 0; i < 200; i++)
+    {
+      NSString	*s = [NSString stringWithFormat: @"%u", i];
+      Recorder	*r = [[[Recorder alloc] initWithTag: s] autorelease];
+
+      [many addObject: r];
+      [nc addObserver: r selector: @selector(note:)
+		 name: [NSString stringWithFormat: @"Name%u", i]
+	       object: nil];
+    }
+  ok = YES;
+  for (i = 0; i < 200; i++)
+    {
+      [record setString: @""];
+      [nc postNotificationName: [NSString stringWithFormat: @"Name%u", i]
+			object: nil];
+      if ([record isEqual: [NSString stringWithFormat: @"%u", i]] == NO)
+	{
+	  ok = NO;
+	}
+    }
+  PASS(ok, "each of many names reaches only its own observer");
+
+  for (i = 0; i < 200; i++)
+    {
+      [nc removeObserver: [many objectAtIndex: i]];
+    }
+  [record setString: @""];
+  for (i = 0; i < 200; i++)
+    {
+      [nc postNotificationName: [NSString stringWithFormat: @"Name%u", i]
+			object: nil];
+    }
+  PASS_EQUAL(record, @"", "observers of many names are all removed");
+
+  [nc release];
+  [arp release]; arp = nil;
+  return 0;
+}
@@ -0,0 +1,54 @@
+#import "Testing.h"
+#import <Foundation/Foundation.h>
+
+int main()
+{
+  NSAutoreleasePool	*arp = [NSAutoreleasePool new];
+
+  START_SET("NSNotificationCenter blocks")
+#if __has_feature(blocks)
+    NSNotificationCenter	*nc = [NSNotificationCenter new];
+    NSOperationQueue		*q = [[NSOperationQueue new] autorelease];
+    __block int			calls = 0;
+    __block BOOL		named = NO;
+    id				o1;
+    id				o2;
+
+    o1 = [nc addObserverForName: @"B"
+			 object: nil
+			  queue: nil
+		     usingBlock: ^(NSNotification *n) {
+	  calls++; named = [[n name] isEqual: @"B"]; }];
+    PASS(o1 != nil, "adding a block observer returns an observer");
+    [nc postNotificationName: @"B" object: nil];
+    PASS(calls == 1, "block is called when notification is posted");
+    PASS(named, "block is passed the notification");
+
+    o2 = [nc addObserverForName: @"B"
+			 object: nil
+			  queue: q
+		     usingBlock: ^(NSNotification *n) { calls += 10; }];
+    [nc postNotificationName: @"B" object: nil];
+    [q waitUntilAllOperationsAreFinished];
+    PASS(calls == 12, "block with a queue is called through the queue");
+
+    [nc removeObserver: o1];
+    [nc removeObserver: o2];
+    [nc postNotificationName: @"B" object: nil];
+    [q waitUntilAllOperationsAreFinished];
+    PASS(calls == 12, "removed block observers are not called");
+
+    PASS_EXCEPTION([nc addObserverForName: @"B"
+				   object: nil
+				    queue: nil
+			       usingBlock: 0];,
+      NSInvalidArgumentException, "a nil block is rejected");
+    [nc release];
+#else
+    SKIP("Your compiler does not support blocks.")
+#endif
+  END_SET("NSNotificationCenter blocks")
+
+  [arp release]; arp = nil;
+  return 0;
+}
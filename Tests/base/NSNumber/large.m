@@ -0,0 +1,41 @@
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSValue.h>
+#import <Foundation/NSString.h>
+
+int main()
+{
+  NSAutoreleasePool	*arp = [NSAutoreleasePool new];
+  long long		v[] = { 2147483647LL, 2147483648LL, -2147483649LL,
+    1LL << 40, -(1LL << 40), (1LL << 59) + 3, -(1LL << 59) - 3,
+    1LL << 61, 9223372036854775807LL, -9223372036854775807LL - 1 };
+  unsigned		i;
+  BOOL			ok = YES;
+
+  for (i = 0; i < sizeof(v) / sizeof(v[0]); i++)
+    {
+      NSNumber	*n = [NSNumber numberWithLongLong: v[i]];
+      NSNumber	*m = [NSNumber numberWithLongLong: v[i]];
+
+      if ([n longLongValue] != v[i] || [n isEqual: m] == NO
+	|| [n hash] != [m hash]
+	|| [[n stringValue] isEqual:
+	  [NSString stringWithFormat: @"%lld", v[i]]] == NO)
+	{
+	  ok = NO;
+	}
+    }
+  PASS(ok, "large integers keep their values");
+  PASS([[NSNumber numberWithLongLong: 1LL << 40]
+    compare: [NSNumber numberWithLongLong: (1LL << 40) + 1]]
+    == NSOrderedAscending, "large integers compare correctly");
+  PASS([[NSNumber numberWithLongLong: -(1LL << 40)]
+    compare: [NSNumber numberWithInt: 0]]
+    == NSOrderedAscending, "negative large integers compare correctly");
+  PASS([[NSNumber numberWithUnsignedLongLong: 1ULL << 50]
+    unsignedLongLongValue] == 1ULL << 50,
+    "unsigned large integers keep their values");
+
+  [arp release]; arp = nil;
+  return 0;
+}
@@ -97,6 +97,37 @@
 }
 @end
 
+@interface      OpWait : OpFlag
+@end
+@implementation OpWait
+static volatile BOOL waitDone = NO;
+- (void) main
+{
+  NSDate	*limit = [NSDate dateWithTimeIntervalSinceNow: 5.0];
+
+  [super main];
+  while (NO == waitDone && [limit timeIntervalSinceNow] > 0.0)
+    {
+      [NSThread sleepForTimeInterval: 0.01];
+    }
+}
+@end
+
+static BOOL
+allFinished(NSArray *ops)
+{
+  NSUInteger	i;
+
+  for (i = 0; i < [ops count]; i++)
+    {
+      if (NO == [[ops objectAtIndex: i] isFinished])
+	{
+	  return NO;
+	}
+    }
+  return YES;
+}
+
 @interface      OpOrder : NSOperation
 @end
 @implementation OpOrder
@@ -122,6 +153,8 @@ int main()
   id                    obj;
   NSMutableArray        *a;
   NSOperationQueue      *q;
+  NSUInteger            i;
+  BOOL                  ok;
   NSAutoreleasePool     *arp = [NSAutoreleasePool new];
 
   cnt = [ThreadCounter new];
@@ -253,6 +286,84 @@ int main()
   PASS(([list objectAtIndex: 0] == [a objectAtIndex: 1] && [list objectAtIndex: 1] == [a objectAtIndex: 0]), "operations ran in order of dependency");
   PASS(1 == [[old dependencies] count], "dependencies not removed when done")
 
+  [list removeAllObjects];
+  [a removeAllObjects];
+  [q setMaxConcurrentOperationCount: 1];
+  [q setSuspended: YES];
+  obj = [OpOrder new];
+  [obj setQueuePriority: NSOperationQueuePriorityLow];
+  [a addObject: obj];
+  [obj release];
+  obj = [OpOrder new];
+  [obj setQueuePriority: NSOperationQueuePriorityVeryHigh];
+  [a addObject: obj];
+  [obj release];
+  obj = [OpOrder new];
+  [a addObject: obj];
+  [obj release];
+  obj = [OpOrder new];
+  [obj setQueuePriority: NSOperationQueuePriorityVeryHigh];
+  [a addObject: obj];
+  [obj release];
+  obj = [OpOrder new];
+  [a addObject: obj];
+  [obj release];
+  [q addOperations: a waitUntilFinished: NO];
+  [[a objectAtIndex: 4] setQueuePriority: NSOperationQueuePriorityHigh];
+  [q setSuspended: NO];
+  [q waitUntilAllOperationsAreFinished];
+  PASS([list count] == 5
+    && [list objectAtIndex: 0] == [a objectAtIndex: 1]
+    && [list objectAtIndex: 1] == [a objectAtIndex: 3]
+    && [list objectAtIndex: 2] == [a objectAtIndex: 4]
+    && [list objectAtIndex: 3] == [a objectAtIndex: 2]
+    && [list objectAtIndex: 4] == [a objectAtIndex: 0],
+    "operations ran in order of priority then addition");
+
+  /* A long running operation must not hold up short ones queued after
+   * it while other workers are available to run them.
+   */
+  [a removeAllObjects];
+  old = [OpWait new];
+  [q setMaxConcurrentOperationCount:
+    NSOperationQueueDefaultMaxConcurrentOperationCount];
+  [q addOperation: old];
+  [NSThread sleepForTimeInterval: 0.1];
+  for (i = 0; i < 20; i++)
+    {
+      obj = [OpFlag new];
+      [a addObject: obj];
+      [q addOperation: obj];
+      [obj release];
+      [NSThread sleepForTimeInterval: 0.01];
+    }
+  for (i = 0; i < 200; i++)
+    {
+      if (allFinished(a))
+	{
+	  break;
+	}
+      [NSThread sleepForTimeInterval: 0.01];
+    }
+  PASS([old isFinished] == NO && allFinished(a),
+    "short operations finish while a long one is running");
+  ok = YES;
+  for (i = 0; i < [a count]; i++)
+    {
+      if ([[a objectAtIndex: i] thread] == [old thread])
+	{
+	  ok = NO;
+	}
+    }
+  PASS(ok, "short operations run on other workers than a long one");
+  waitDone = YES;
+  [q waitUntilAllOperationsAreFinished];
+  [old release];
+
+  PASS([q idleTimeout] == 5.0, "default idle timeout is five seconds");
+  [q setIdleTimeout: -1.0];
+  PASS([q idleTimeout] == 0.0, "negative idle timeout is treated as zero");
+
   [arp release]; arp = nil;
   return 0;
 }
@@ -0,0 +1,92 @@
+#import "Testing.h"
+#import <Foundation/Foundation.h>
+
+/* Filters an array concurrently using the queue it is running on.
+ */
+@interface Nested : NSOperation
+{
+@public
+  NSArray		*array;
+  NSPredicate		*predicate;
+  NSOperationQueue	*queue;
+  NSArray		*result;
+}
+@end
+
+@implementation Nested
+- (void) dealloc
+{
+  [result release];
+  [super dealloc];
+}
+- (void) main
+{
+  result = [[array filteredArrayUsingPredicate: predicate
+				     chunkSize: 100
+					 queue: queue] retain];
+}
+@end
+
+int main()
+{
+  NSAutoreleasePool	*arp = [NSAutoreleasePool new];
+  NSOperationQueue	*q = [[NSOperationQueue new] autorelease];
+  NSMutableArray	*a = [NSMutableArray array];
+  NSPredicate		*p;
+  NSArray		*expect;
+  NSArray		*r;
+  NSSet			*s;
+  int			i;
+
+  for (i = 0; i < 10000; i++)
+    {
+      [a addObject: [NSNumber numberWithInt: (i * 7919) % 10007]];
+    }
+  p = [NSPredicate predicateWithFormat: @"SELF < 5000 AND SELF > 100"];
+  expect = [a filteredArrayUsingPredicate: p];
+
+  r = [a filteredArrayUsingPredicate: p chunkSize: 100 queue: q];
+  PASS_EQUAL(r, expect, "concurrent filter on a queue keeps the order");
+
+  r = [a filteredArrayUsingPredicate: p chunkSize: 0 queue: nil];
+  PASS_EQUAL(r, expect, "concurrent filter on a private queue works");
+
+  r = [a filteredArrayUsingPredicate: p chunkSize: 20000 queue: q];
+  PASS_EQUAL(r, expect, "a single chunk is filtered by the caller");
+
+  r = [[NSArray array] filteredArrayUsingPredicate: p chunkSize: 10 queue: q];
+  PASS([r count] == 0, "an empty array gives an empty result");
+
+  s = [[NSSet setWithArray: a] filteredSetUsingPredicate: p
+					       chunkSize: 100
+						   queue: q];
+  PASS_EQUAL(s, [NSSet setWithArray: expect], "concurrent set filter works");
+
+  PASS_EXCEPTION([a filteredArrayUsingPredicate:
+    [NSPredicate predicateWithFormat: @"missing == 1"] chunkSize: 100
+    queue: q], NSUndefinedKeyException,
+    "an exception in a chunk is raised in the caller");
+
+  {
+    NSOperationQueue	*serial = [[NSOperationQueue new] autorelease];
+    Nested		*n = [[Nested new] autorelease];
+    NSDate		*limit = [NSDate dateWithTimeIntervalSinceNow: 10.0];
+
+    [serial setMaxConcurrentOperationCount: 1];
+    n->array = a;
+    n->predicate = p;
+    n->queue = serial;
+    [serial addOperation: n];
+    while ([n isFinished] == NO && [limit timeIntervalSinceNow] > 0.0)
+      {
+	[NSThread sleepForTimeInterval: 0.01];
+      }
+    PASS([n isFinished] == YES,
+      "filtering on its own serial queue from an operation does not deadlock");
+    PASS_EQUAL(n->result, expect,
+      "filtering on its own serial queue gives the right result");
+  }
+
+  [arp release]; arp = nil;
+  return 0;
+}
@@ -0,0 +1,119 @@
+#import "Testing.h"
+#import <Foundation/Foundation.h>
+
+@interface Person : NSObject
+{
+  NSString	*name;
+  Person	*parent;
+  int		age;
+  double	height;
+  NSArray	*tags;
+}
+@end
+
+@implementation Person
+- (void) dealloc
+{
+  [name release];
+  [parent release];
+  [tags release];
+  [super dealloc];
+}
+- (int) age
+{
+  return age;
+}
+@end
+
+/* Check that filtering gives the same result as evaluating the predicate
+ * with each object in turn.
+ */
+static BOOL
+same(NSArray *a, NSString *format)
+{
+  NSPredicate		*p = [NSPredicate predicateWithFormat: format];
+  NSArray		*f = [a filteredArrayUsingPredicate: p];
+  NSMutableArray	*m = [[a mutableCopy] autorelease];
+  NSMutableSet		*s = [NSMutableSet setWithArray: a];
+  NSMutableArray	*expect = [NSMutableArray array];
+  NSEnumerator		*e = [a objectEnumerator];
+  id			o;
+
+  while ((o = [e nextObject]) != nil)
+    {
+      if ([p evaluateWithObject: o] == YES)
+	{
+	  [expect addObject: o];
+	}
+    }
+  [m filterUsingPredicate: p];
+  [s filterUsingPredicate: p];
+  return [f isEqual: expect] && [m isEqual: expect]
+    && [s isEqual: [NSSet setWithArray: expect]]
+    && [[[NSSet setWithArray: a] filteredSetUsingPredicate: p]
+    isEqual: [NSSet setWithArray: expect]];
+}
+
+int main()
+{
+  NSAutoreleasePool	*arp = [NSAutoreleasePool new];
+  NSMutableArray	*people = [NSMutableArray array];
+  NSMutableArray	*dicts = [NSMutableArray array];
+  Person		*root = [[Person new] autorelease];
+  NSArray		*a;
+  int			i;
+
+  [root setValue: @"root" forKey: @"name"];
+  for (i = 0; i < 100; i++)
+    {
+      Person	*p = [[Person new] autorelease];
+
+      [p setValue: [NSString stringWithFormat: @"p%d", i] forKey: @"name"];
+      [p setValue: [NSNumber numberWithInt: i] forKey: @"age"];
+      [p setValue: [NSNumber numberWithDouble: 1.0 + i / 100.0]
+	   forKey: @"height"];
+      [p setValue: (i % 2) ? root : nil forKey: @"parent"];
+      [p setValue: [NSArray arrayWithObjects: (i % 3) ? @"x" : @"y", @"z", nil]
+	   forKey: @"tags"];
+      [people addObject: p];
+      [dicts addObject: [NSDictionary dictionaryWithObjectsAndKeys:
+	[NSNumber numberWithInt: i], @"age",
+	[NSDictionary dictionaryWithObject: [NSNumber numberWithInt: i % 7]
+				    forKey: @"n"], @"inner",
+	nil]];
+    }
+
+  PASS(same(people, @"age < 10"), "integer less than");
+  PASS(same(people, @"age >= 90"), "integer greater than or equal");
+  PASS(same(people, @"age == 42"), "integer equality");
+  PASS(same(people, @"age != 42"), "integer inequality");
+  PASS(same(people, @"age > 10.5"), "integer compared with double");
+  PASS(same(people, @"height <= 1.5"), "double compared with double");
+  PASS(same(people, @"height > 1"), "double compared with integer");
+  PASS(same(people, @"age < 10 OR age > 90"), "OR of comparisons");
+  PASS(same(people, @"age > 10 AND NOT (age > 20)"), "AND and NOT");
+  PASS(same(people, @"parent.name == 'root'"), "two step key path");
+  PASS(same(people, @"parent == nil"), "nil comparison");
+  PASS(same(people, @"name BEGINSWITH 'p1'"), "string comparison");
+  PASS(same(people, @"ANY tags == 'y'"), "ANY modifier");
+  PASS(same(people, @"tags.@count == 2"), "collection operator in path");
+  PASS(same(people, @"TRUEPREDICATE"), "true predicate");
+  PASS(same(people, @"FALSEPREDICATE"), "false predicate");
+  PASS(same(dicts, @"age < 50 AND inner.n == 3"), "dictionary key path");
+
+  a = [people filteredArrayUsingPredicate:
+    [NSPredicate predicateWithFormat: @"age < %@",
+    [NSDecimalNumber decimalNumberWithString: @"3"]]];
+  PASS([a count] == 3, "comparison with a decimal number");
+
+  a = [people filteredArrayUsingPredicate:
+    [NSPredicate predicateWithFormat: @"age == 2 OR parent.age == 0"]];
+  PASS([a count] == 51, "key path through objects accessed by method");
+
+  PASS_EXCEPTION([people filteredArrayUsingPredicate:
+    [NSPredicate predicateWithFormat: @"missing == 1"]],
+    NSUndefinedKeyException, "an unknown key raises");
+
+  [arp release]; arp = nil;
+  return 0;
+}
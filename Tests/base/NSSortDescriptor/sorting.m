@@ -0,0 +1,105 @@
+#import "Testing.h"
+#import <Foundation/Foundation.h>
+
+@interface	Reversed : NSSortDescriptor
+@end
+@implementation	Reversed
+- (NSComparisonResult) compareObject: (id)o1 toObject: (id)o2
+{
+  return [super compareObject: o2 toObject: o1];
+}
+@end
+
+static NSDictionary *
+row(NSString *name, int age, int order)
+{
+  return [NSDictionary dictionaryWithObjectsAndKeys:
+    name, @"name",
+    [NSNumber numberWithInt: age], @"age",
+    [NSNumber numberWithInt: order], @"order",
+    nil];
+}
+
+int main()
+{
+  NSAutoreleasePool	*arp = [NSAutoreleasePool new];
+  NSSortDescriptor	*byName;
+  NSSortDescriptor	*byAge;
+  NSSortDescriptor	*byAgeDown;
+  NSMutableArray	*m;
+  NSArray		*a;
+  NSArray		*s;
+  BOOL			ok;
+  unsigned		i;
+
+  byName = [[[NSSortDescriptor alloc] initWithKey: @"name"
+					ascending: YES] autorelease];
+  byAge = [[[NSSortDescriptor alloc] initWithKey: @"age"
+				       ascending: YES] autorelease];
+  byAgeDown = [[[NSSortDescriptor alloc] initWithKey: @"age"
+					   ascending: NO] autorelease];
+
+  a = [NSArray arrayWithObjects:
+    row(@"b", 3, 0), row(@"a", 2, 1), row(@"b", 1, 2),
+    row(@"a", 2, 3), row(@"c", 1, 4), row(@"a", 5, 5), nil];
+
+  s = [a sortedArrayUsingDescriptors:
+    [NSArray arrayWithObjects: byName, byAgeDown, nil]];
+  PASS_EQUAL([s valueForKey: @"order"],
+    ([NSArray arrayWithObjects: [NSNumber numberWithInt: 5],
+    [NSNumber numberWithInt: 1], [NSNumber numberWithInt: 3],
+    [NSNumber numberWithInt: 0], [NSNumber numberWithInt: 2],
+    [NSNumber numberWithInt: 4], nil]),
+    "sorting on an ascending and a descending key works");
+
+  s = [a sortedArrayUsingDescriptors: [NSArray arrayWithObject: byAge]];
+  PASS_EQUAL([s valueForKey: @"order"],
+    ([NSArray arrayWithObjects: [NSNumber numberWithInt: 2],
+    [NSNumber numberWithInt: 4], [NSNumber numberWithInt: 1],
+    [NSNumber numberWithInt: 3], [NSNumber numberWithInt: 0],
+    [NSNumber numberWithInt: 5], nil]),
+    "sorting keeps the order of objects with equal keys");
+
+  s = [a sortedArrayUsingDescriptors: [NSArray arrayWithObjects:
+    [[[Reversed alloc] initWithKey: @"name" ascending: YES] autorelease],
+    byAge, nil]];
+  PASS_EQUAL([s valueForKey: @"order"],
+    ([NSArray arrayWithObjects: [NSNumber numberWithInt: 4],
+    [NSNumber numberWithInt: 2], [NSNumber numberWithInt: 0],
+    [NSNumber numberWithInt: 1], [NSNumber numberWithInt: 3],
+    [NSNumber numberWithInt: 5], nil]),
+    "a subclass overriding -compareObject:toObject: is used");
+
+  m = [NSMutableArray array];
+  for (i = 0; i < 1000; i++)
+    {
+      [m addObject: row([NSString stringWithFormat: @"%03u", (i * 7) % 1000],
+	(i * 13) % 1000, i)];
+    }
+  [m sortUsingDescriptors: [NSArray arrayWithObject: byName]];
+  ok = YES;
+  for (i = 1; i < [m count]; i++)
+    {
+      if ([[[m objectAtIndex: i - 1] objectForKey: @"name"]
+	compare: [[m objectAtIndex: i] objectForKey: @"name"]]
+	!= NSOrderedAscending)
+	{
+	  ok = NO;
+	}
+    }
+  PASS(ok, "a large mutable array is sorted by a string key");
+  [m sortUsingDescriptors: [NSArray arrayWithObject: byAgeDown]];
+  ok = YES;
+  for (i = 1; i < [m count]; i++)
+    {
+      if ([[[m objectAtIndex: i - 1] objectForKey: @"age"] intValue]
+	<= [[[m objectAtIndex: i] objectForKey: @"age"] intValue])
+	{
+	  ok = NO;
+	}
+    }
+  PASS(ok, "a large mutable array is sorted by a descending number key");
+
+  [arp release]; arp = nil;
+  return 0;
+}
@@ -0,0 +1,41 @@
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSDictionary.h>
+#import <Foundation/NSString.h>
+#include <string.h>
+
+int main()
+{
+  NSAutoreleasePool	*arp = [NSAutoreleasePool new];
+  const char		*c[] = { "", "a", "abcdefgh", "abcdefghi",
+    "Key_Name.1", "abcdefghij", "abcdefghijk", "with space", "dash-name" };
+  unsigned		i;
+  BOOL			ok = YES;
+  NSMutableDictionary	*d = [NSMutableDictionary dictionary];
+
+  for (i = 0; i < sizeof(c) / sizeof(c[0]); i++)
+    {
+      NSString	*a = [NSString stringWithUTF8String: c[i]];
+      NSString	*b = [NSString stringWithCString: c[i]
+					encoding: NSASCIIStringEncoding];
+      NSString	*m = [NSMutableString stringWithUTF8String: c[i]];
+
+      if ([a length] != strlen(c[i]) || strcmp([a UTF8String], c[i]) != 0
+	|| [a isEqual: b] == NO || [a isEqual: m] == NO
+	|| [m isEqual: a] == NO || [a hash] != [m hash])
+	{
+	  ok = NO;
+	}
+      [d setObject: a forKey: m];
+    }
+  PASS(ok, "short strings keep their characters");
+  PASS([d objectForKey: @"Key_Name.1"] != nil,
+    "short strings work as dictionary keys");
+  PASS([[NSString stringWithUTF8String: "abcdefghij"] characterAtIndex: 9]
+    == 'j', "-characterAtIndex: works for ten character strings");
+  PASS_EQUAL([[NSString stringWithUTF8String: "Key_Name.1"]
+    substringFromIndex: 4], @"Name.1", "-substringFromIndex: works");
+
+  [arp release]; arp = nil;
+  return 0;
+}
@@ -0,0 +1,71 @@
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSData.h>
+#import <Foundation/NSString.h>
+#include <string.h>
+
+/* Conversions handle runs of ASCII a block at a time, so check that a
+ * non-ASCII character is dealt with correctly wherever it falls in
+ * relation to those blocks.
+ */
+int main()
+{
+  NSAutoreleasePool	*arp = [NSAutoreleasePool new];
+  const char		*seq[] = { "\xc3\xa9", "\xc4\x81", "\xe6\x97\xa5" };
+  unichar		chr[] = { 0xe9, 0x101, 0x65e5 };
+  BOOL			ok = YES;
+  BOOL			bad = YES;
+  BOOL			ascii = YES;
+  unsigned		len;
+  unsigned		pos;
+  unsigned		k;
+
+  for (k = 0; k < 3; k++)
+    {
+      for (len = 1; len < 80; len++)
+	{
+	  for (pos = 0; pos < len; pos++)
+	    {
+	      CREATE_AUTORELEASE_POOL(pool);
+	      char	buf[100];
+	      unsigned	l = strlen(seq[k]);
+	      NSData	*d;
+	      NSString	*s;
+
+	      memset(buf, 'a', len - 1);
+	      memmove(buf + pos + l, buf + pos, len - 1 - pos);
+	      memcpy(buf + pos, seq[k], l);
+	      d = [NSData dataWithBytes: buf length: len - 1 + l];
+	      s = [[[NSString alloc] initWithData: d
+					 encoding: NSUTF8StringEncoding]
+		autorelease];
+	      if ([s length] != len || [s characterAtIndex: pos] != chr[k]
+		|| [[s dataUsingEncoding: NSUTF8StringEncoding] isEqual: d] == NO)
+		{
+		  ok = NO;
+		}
+
+	      buf[pos] = '\xff';
+	      d = [NSData dataWithBytes: buf length: len - 1 + l];
+	      if ([[[NSString alloc] initWithData: d
+					 encoding: NSUTF8StringEncoding]
+		autorelease] != nil)
+		{
+		  bad = NO;
+		}
+	      if (k == 0 && [[[NSString alloc] initWithData: d
+		encoding: NSASCIIStringEncoding] autorelease] != nil)
+		{
+		  ascii = NO;
+		}
+	      DESTROY(pool);
+	    }
+	}
+    }
+  PASS(ok, "UTF-8 round trips with a non-ASCII character at any position");
+  PASS(bad, "invalid UTF-8 at any position is rejected");
+  PASS(ascii, "non-ASCII data at any position is rejected as ASCII");
+
+  [arp release]; arp = nil;
+  return 0;
+}
@@ -0,0 +1,82 @@
+#import "Testing.h"
+#import <Foundation/NSAutoreleasePool.h>
+#import <Foundation/NSString.h>
+#import <Foundation/NSArray.h>
+#import <Foundation/NSDictionary.h>
+#import <Foundation/NSData.h>
+#import <Foundation/NSError.h>
+#import <Foundation/NSFileManager.h>
+#import <Foundation/NSPropertyList.h>
+#import <Foundation/NSValue.h>
+
+int main()
+{
+  NSAutoreleasePool	*arp = [NSAutoreleasePool new];
+#if     defined(GNUSTEP_BASE_LIBRARY)
+  NSPropertyListFormat	format;
+  NSMutableArray	*big = [NSMutableArray array];
+  NSDictionary		*plist;
+  NSString		*path;
+  NSData		*d;
+  NSError		*e;
+  id			u;
+  int			i;
+
+  for (i = 0; i < 100; i++)
+    {
+      [big addObject: [NSString stringWithFormat: @"item %d", i]];
+    }
+  plist = [NSDictionary dictionaryWithObjectsAndKeys:
+    big, @"big",
+    [NSNumber numberWithInt: 42], @"answer",
+    [NSArray arrayWithObject: [NSDictionary dictionaryWithObject: @"deep"
+      forKey: @"key"]], @"nested",
+    [NSArray array], @"empty",
+    nil];
+  d = [NSPropertyListSerialization dataWithPropertyList: plist
+    format: NSPropertyListBinaryFormat_v1_0 options: 0 error: 0];
+
+  u = [NSPropertyListSerialization propertyListWithData: d
+    options: NSPropertyListImmutable | NSPropertyListReadLazily
+    format: &format
+    error: 0];
+  PASS(format == NSPropertyListBinaryFormat_v1_0, "lazy read finds format");
+  PASS([u count] == 4, "lazy dictionary has the right count");
+  PASS_EQUAL([u objectForKey: @"answer"], [NSNumber numberWithInt: 42],
+    "lazy dictionary value is decoded");
+  PASS_EQUAL([[u objectForKey: @"big"] objectAtIndex: 99], @"item 99",
+    "lazy array member is decoded");
+  PASS([[u objectForKey: @"big"] objectAtIndex: 99]
+    == [[u objectForKey: @"big"] objectAtIndex: 99],
+    "lazy array member is decoded once");
+  PASS_EQUAL([[[u objectForKey: @"nested"] lastObject] objectForKey: @"key"],
+    @"deep", "nested lazy containers work");
+  PASS([u objectForKey: @"missing"] == nil, "missing key gives nil");
+  PASS_EQUAL(u, plist, "lazy property list is equal to the original");
+  PASS_EXCEPTION([[u objectForKey: @"empty"] objectAtIndex: 0],
+    NSRangeException, "out of range index raises");
+
+  u = [NSPropertyListSerialization propertyListWithData: d
+    options: NSPropertyListMutableContainers | NSPropertyListReadLazily
+    format: &format
+    error: 0];
+  PASS([u isKindOfClass: [NSMutableDictionary class]],
+    "lazy option is ignored for mutable containers");
+
+  path = @"lazy-test.plist";
+  [d writeToFile: path atomically: NO];
+  u = [NSPropertyListSerialization propertyListWithContentsOfFile: path
+    options: NSPropertyListImmutable | NSPropertyListReadLazily
+    format: &format
+    error: &e];
+  PASS_EQUAL(u, plist, "mapped lazy property list is equal to the original");
+  [[NSFileManager defaultManager] removeFileAtPath: path handler: nil];
+  u = [NSPropertyListSerialization propertyListWithContentsOfFile: path
+    options: NSPropertyListImmutable
+    format: &format
+    error: &e];
+  PASS(u == nil && e != nil, "missing file gives an error");
+#endif
+  [arp release]; arp = nil;
+  return 0;
+}